@@ -0,0 +1,77 @@
+#include "bench.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include <Arduino.h>
+
+namespace {
+
+std::atomic<uint64_t> g_allocations{0};
+
+struct Entry {
+    const char* name;
+    uint32_t iterations;
+    Bench::Body body;
+};
+
+std::vector<Entry>& registry() {
+    static std::vector<Entry> entries;
+    return entries;
+}
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace Bench {
+
+Registrar::Registrar(const char* name, uint32_t iterations, Body body) {
+    registry().push_back({name, iterations, std::move(body)});
+}
+
+uint64_t allocations() { return g_allocations.load(std::memory_order_relaxed); }
+
+} // namespace Bench
+
+// Usage: water_meter_bench [substring-filter] [--quick]
+int main(int argc, char** argv) {
+    const char* filter = nullptr;
+    bool quick = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) quick = true;
+        else filter = argv[i];
+    }
+
+    HostShim::consoleEnabled() = false;
+
+    printf("%-40s %10s %12s %10s  %s\n", "benchmark", "iters", "ns/op", "allocs/op", "extra");
+    for (auto& e : registry()) {
+        if (filter && !strstr(e.name, filter)) continue;
+
+        Bench::Context ctx{quick ? (e.iterations / 100 > 0 ? e.iterations / 100 : 1) : e.iterations};
+        uint64_t allocsBefore = Bench::allocations();
+        auto start = std::chrono::steady_clock::now();
+        e.body(ctx);
+        auto end = std::chrono::steady_clock::now();
+        uint64_t allocs = Bench::allocations() - allocsBefore;
+
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        printf("%-40s %10u %12.1f %10.2f", e.name, ctx.iterations, ns / ctx.iterations, (double)allocs / ctx.iterations);
+        for (int i = 0; i < ctx.extras; i++) printf("  %.3f %s", ctx.extraValues[i], ctx.extraLabels[i]);
+        printf("\n");
+    }
+    return 0;
+}
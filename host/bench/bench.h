@@ -0,0 +1,56 @@
+#ifndef HOST_BENCH_H
+#define HOST_BENCH_H
+
+// Tiny microbenchmark harness for the host build.
+//
+// A benchmark is a function that runs the measured operation `iterations`
+// times. The harness times it with steady_clock, counts heap allocations
+// through the global operator new hook in bench.cpp and prints ns/op and
+// allocs/op. Benchmarks may attach one extra metric (e.g. virtual bus ms/op).
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace Bench {
+
+struct Context {
+    static constexpr int kMaxExtras = 3;
+
+    uint32_t iterations;
+    // Optional extra columns, filled in by the benchmark body.
+    const char* extraLabels[kMaxExtras] = {};
+    double extraValues[kMaxExtras] = {};
+    int extras = 0;
+
+    void report(const char* label, double value) {
+        if (extras == kMaxExtras) return;
+        extraLabels[extras] = label;
+        extraValues[extras++] = value;
+    }
+};
+
+using Body = std::function<void(Context&)>;
+
+struct Registrar {
+    Registrar(const char* name, uint32_t iterations, Body body);
+};
+
+uint64_t allocations();
+
+// Keeps the optimiser from discarding a value computed by the benchmark.
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} // namespace Bench
+
+#define BENCH_CONCAT_(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_(a, b)
+#define BENCHMARK(name, iterations) \
+    static void BENCH_CONCAT(bench_fn_, __LINE__)(Bench::Context&); \
+    static Bench::Registrar BENCH_CONCAT(bench_reg_, __LINE__)(name, iterations, BENCH_CONCAT(bench_fn_, __LINE__)); \
+    static void BENCH_CONCAT(bench_fn_, __LINE__)(Bench::Context& ctx)
+
+#endif
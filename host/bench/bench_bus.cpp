@@ -0,0 +1,114 @@
+// RS485 supply: a riser of four Pulsars polled every 30 minutes through the
+// bus scheduler, with the transceiver always on vs switched around bursts.
+// Energy is the rail estimate of BusPower (15 mA at 3.3 V while on).
+// Then the same riser with one meter unplugged, polled as before per-meter
+// health (every poll, no retries) and through Smart sources (retries and the
+// circuit breaker).
+
+#include "bench.h"
+
+#include <memory>
+
+#include "bus/bus_power.h"
+#include "bus/bus_scheduler.h"
+#include "drivers/pulsar_ds15_20.h"
+#include "sim/virtual_pulsar.h"
+#include "sources/smart_source.h"
+
+namespace {
+
+constexpr uint32_t kMeters = 4;
+constexpr uint32_t kPollMs = 30 * 60000;
+constexpr uint32_t kDayMs = 24 * 3600000;
+
+// Runs ctx.iterations days of polls; gated == false holds the line on.
+void riser(Bench::Context& ctx, bool gated) {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Sim::VirtualPulsarBus line;
+    Driver::PulsarDu_15_20* drv[kMeters];
+    for (uint32_t i = 0; i < kMeters; i++) {
+        line.addMeter(40000000 + i).volumeM3 = 1.0f;
+        drv[i] = new Driver::PulsarDu_15_20(&line, 40000000 + i);
+    }
+
+    Bus::BusPower power(-1, 20, 15);
+    Bus::BusScheduler sched;
+    sched.setPower(&power);
+    if (!gated) power.hold();
+
+    uint32_t start = millis();
+    for (uint32_t day = 0; day < ctx.iterations; day++) {
+        for (uint32_t t = 0; t < kDayMs; t += kPollMs) {
+            Bus::BusScheduler::Ticket tickets[kMeters];
+            for (uint32_t i = 0; i < kMeters; i++) tickets[i] = sched.submit(drv[i], Driver::PulsarDu_15_20::kSupportedParams, 0, millis() + kPollMs);
+            sched.runBurst();
+            Driver::MeterReading r;
+            bool ok;
+            for (Bus::BusScheduler::Ticket tk : tickets) sched.poll(tk, r, ok);
+            HostShim::setMillis(start + day * kDayMs + t + kPollMs);
+        }
+    }
+    power.shutdown(); // Books the always-on case as one long burst
+    uint32_t onMs = power.stats().onMs;
+    uint32_t elapsed = millis() - start;
+
+    ctx.report("duty %", 100.0 * onMs / elapsed);
+    ctx.report("mJ/day", (double)power.energyUj(1000) * onMs / 1000000 / ctx.iterations); // energyUj() is per burst, 32 bit
+    ctx.report("ms/burst", (double)onMs / power.stats().bursts);
+    for (auto* d : drv) delete d;
+    HostShim::consoleEnabled() = true;
+}
+
+// Riser with the last meter absent; breaker == false submits every meter on
+// every poll the way the sources did before MeterHealth.
+void deadMeter(Bench::Context& ctx, bool breaker) {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Sim::VirtualPulsarBus line;
+    std::unique_ptr<Driver::PulsarDu_15_20> drv[kMeters];
+    std::unique_ptr<Source::BasicSmartSource<Driver::PulsarDu_15_20>> src[kMeters];
+    Bus::BusPower power(-1, 20, 15);
+    Bus::BusScheduler sched;
+    sched.setPower(&power);
+    for (uint32_t i = 0; i < kMeters; i++) {
+        if (i + 1 < kMeters) line.addMeter(40000000 + i).volumeM3 = 1.0f;
+        drv[i].reset(new Driver::PulsarDu_15_20(&line, 40000000 + i));
+        src[i].reset(new Source::BasicSmartSource<Driver::PulsarDu_15_20>(drv[i].get()));
+        src[i]->setPollInterval(kPollMs);
+        src[i]->setBusScheduler(&sched, 0);
+        src[i]->begin();
+        src[i]->tick();
+    }
+
+    uint32_t start = millis();
+    for (uint32_t day = 0; day < ctx.iterations; day++) {
+        for (uint32_t t = 0; t < kDayMs; t += kPollMs) {
+            HostShim::setMillis(start + day * kDayMs + t + kPollMs);
+            if (breaker) {
+                for (auto& s : src) s->tick();
+                sched.runBurst();
+                for (auto& s : src) s->tick();
+            } else {
+                Bus::BusScheduler::Ticket tickets[kMeters];
+                for (uint32_t i = 0; i < kMeters; i++) tickets[i] = sched.submit(drv[i].get(), Driver::PulsarDu_15_20::kSupportedParams, 0, millis() + kPollMs);
+                sched.runBurst();
+                Driver::MeterReading r;
+                bool ok;
+                for (Bus::BusScheduler::Ticket tk : tickets) sched.poll(tk, r, ok);
+            }
+        }
+    }
+    uint32_t onMs = power.stats().onMs;
+    ctx.report("bus s/day", (double)onMs / 1000 / ctx.iterations);
+    ctx.report("mJ/day", (double)power.energyUj(1000) * onMs / 1000000 / ctx.iterations);
+    ctx.report("ms/burst", (double)onMs / power.stats().bursts);
+    HostShim::consoleEnabled() = true;
+}
+
+} // namespace
+
+BENCHMARK("bus.riser4/always-on", 20) { riser(ctx, false); }
+BENCHMARK("bus.riser4/gated", 20) { riser(ctx, true); }
+BENCHMARK("bus.riser4-1dead/no-health", 20) { deadMeter(ctx, false); }
+BENCHMARK("bus.riser4-1dead/breaker", 20) { deadMeter(ctx, true); }
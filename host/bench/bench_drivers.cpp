@@ -0,0 +1,198 @@
+// Driver layer: Pulsar framing/transaction and CRC.
+
+#include "bench.h"
+
+#include "bus/bus_retry.h"
+#include "drivers/crc16_modbus.h"
+#include "drivers/driver_factory.h"
+#include "sim/virtual_pulsar.h"
+
+namespace {
+
+constexpr uint32_t kColdSerial = 10128442;
+
+// The bit-by-bit loop PulsarDu_15_20 used before Driver::Crc16Modbus; kept as the baseline.
+uint16_t bitwiseCrc(const uint8_t* data, uint16_t len) {
+    uint16_t crc = 0xFFFF;
+    for (uint16_t pos = 0; pos < len; pos++) {
+        crc ^= (uint16_t)data[pos];
+        for (int i = 8; i != 0; i--) {
+            if ((crc & 0x0001) != 0) { crc >>= 1; crc ^= 0xA001; }
+            else { crc >>= 1; }
+        }
+    }
+    return crc;
+}
+
+const uint8_t* crcInput() {
+    static uint8_t buf[256];
+    for (int i = 0; i < 256; i++) buf[i] = (uint8_t)(i * 37 + 11);
+    return buf;
+}
+
+bool crcVariantsAgree() {
+    const uint8_t* d = crcInput();
+    for (size_t len = 0; len <= 256; len++) {
+        uint16_t ref = bitwiseCrc(d, (uint16_t)len);
+        Driver::Crc16Modbus inc;
+        for (size_t i = 0; i < len; i++) inc.update(d[i]);
+        if (Driver::Crc16Modbus::compute(d, len) != ref || Driver::Crc16Modbus::computeSliced(d, len) != ref ||
+            inc.value() != ref) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename F>
+void crcLoop(Bench::Context& ctx, size_t len, F fn) {
+    if (!crcVariantsAgree()) {
+        fprintf(stderr, "CRC variants disagree with the bitwise reference\n");
+        abort();
+    }
+    uint8_t buf[256];
+    memcpy(buf, crcInput(), sizeof(buf));
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        buf[0] = (uint8_t)i;
+        Bench::doNotOptimize(fn(buf, len));
+    }
+}
+
+// One Smart source poll (volume + battery, retried like MeterHealth::kRetries)
+// on a line where every fault kind of the virtual Pulsar hits at `rate`.
+void faultyPoll(Bench::Context& ctx, float rate) {
+    HostShim::consoleEnabled() = false;
+    Sim::VirtualPulsarBus bus;
+    bus.addMeter(kColdSerial).volumeM3 = 12.79f;
+    Sim::PulsarFaults f;
+    f.noReply = f.crcError = f.wrongAddress = f.contention = rate;
+    f.byteLoss = rate / 10;
+    f.latencyJitterUs = 20000;
+    bus.setFaults(f, 42);
+    Driver::PulsarDu_15_20 drv(&bus, kColdSerial);
+    const Driver::ParamSet params = Driver::paramBit(Driver::MeterParam::TotalVolume) |
+                                    Driver::paramBit(Driver::MeterParam::BatteryVoltage);
+
+    uint32_t ok = 0;
+    uint64_t startUs = HostShim::clockUs();
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        Driver::MeterReading r;
+        ok += Bus::readWithRetry(&drv, params, r, 2);
+        HostShim::advanceMillis(1000); // Stray bytes of this poll are over before the next
+    }
+    uint64_t idleUs = (uint64_t)ctx.iterations * 1000000;
+    ctx.report("virtual bus ms/op", (HostShim::clockUs() - startUs - idleUs) / 1000.0 / ctx.iterations);
+    ctx.report("bus transactions/op", (double)bus.stats().requests / ctx.iterations);
+    ctx.report("ok %", 100.0 * ok / ctx.iterations);
+    HostShim::consoleEnabled() = true;
+}
+
+} // namespace
+
+BENCHMARK("crc16.bitwise/14B", 2000000) {
+    crcLoop(ctx, 12, [](const uint8_t* d, size_t n) { return bitwiseCrc(d, (uint16_t)n); });
+}
+
+BENCHMARK("crc16.table/14B", 2000000) {
+    crcLoop(ctx, 12, [](const uint8_t* d, size_t n) { return Driver::Crc16Modbus::compute(d, n); });
+}
+
+BENCHMARK("crc16.sliced4/14B", 2000000) {
+    crcLoop(ctx, 12, [](const uint8_t* d, size_t n) { return Driver::Crc16Modbus::computeSliced(d, n); });
+}
+
+// Per-byte update as done by FrameReceiver while the reply arrives.
+BENCHMARK("crc16.incremental/14B", 2000000) {
+    crcLoop(ctx, 12, [](const uint8_t* d, size_t n) {
+        Driver::Crc16Modbus crc;
+        for (size_t i = 0; i < n; i++) crc.update(d[i]);
+        return crc.value();
+    });
+}
+
+BENCHMARK("crc16.bitwise/256B", 200000) {
+    crcLoop(ctx, 256, [](const uint8_t* d, size_t n) { return bitwiseCrc(d, (uint16_t)n); });
+}
+
+BENCHMARK("crc16.table/256B", 200000) {
+    crcLoop(ctx, 256, [](const uint8_t* d, size_t n) { return Driver::Crc16Modbus::compute(d, n); });
+}
+
+BENCHMARK("crc16.sliced4/256B", 200000) {
+    crcLoop(ctx, 256, [](const uint8_t* d, size_t n) { return Driver::Crc16Modbus::computeSliced(d, n); });
+}
+
+BENCHMARK("pulsar.readTotalVolume", 2000) {
+    Sim::VirtualPulsarBus bus;
+    bus.addMeter(kColdSerial).volumeM3 = 12.79f;
+    bus.setTimeout(300);
+    Driver::PulsarDu_15_20 drv(&bus, kColdSerial);
+
+    uint64_t startUs = HostShim::clockUs();
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        float v = 0;
+        Bench::doNotOptimize(drv.getValue(Driver::MeterParam::TotalVolume, v));
+    }
+    ctx.report("virtual bus ms/op", (HostShim::clockUs() - startUs) / 1000.0 / ctx.iterations);
+}
+
+BENCHMARK("pulsar.readBatteryVoltage", 2000) {
+    Sim::VirtualPulsarBus bus;
+    bus.addMeter(kColdSerial);
+    bus.setTimeout(300);
+    Driver::PulsarDu_15_20 drv(&bus, kColdSerial);
+
+    uint64_t startUs = HostShim::clockUs();
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        float v = 0;
+        Bench::doNotOptimize(drv.getValue(Driver::MeterParam::BatteryVoltage, v));
+    }
+    ctx.report("virtual bus ms/op", (HostShim::clockUs() - startUs) / 1000.0 / ctx.iterations);
+}
+
+// Capability query through the interface: a ParamSet, no std::vector per call.
+BENCHMARK("pulsar.supportedParams", 1000000) {
+    Driver::PulsarDu_15_20 drv(nullptr, kColdSerial);
+    Driver::SmartMeterDriver* base = &drv;
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        Bench::doNotOptimize(__builtin_popcount(base->supportedParams()));
+    }
+}
+
+// Meter missing from the bus: bounded by the response timeout, not by a fixed read size.
+BENCHMARK("pulsar.readTotalVolume/no-reply", 200) {
+    Sim::VirtualPulsarBus bus;
+    bus.setTimeout(300);
+    Driver::PulsarDu_15_20 drv(&bus, kColdSerial);
+
+    uint64_t startUs = HostShim::clockUs();
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        float v = 0;
+        Bench::doNotOptimize(drv.getValue(Driver::MeterParam::TotalVolume, v));
+    }
+    ctx.report("virtual bus ms/op", (HostShim::clockUs() - startUs) / 1000.0 / ctx.iterations);
+}
+
+// One SmartSource poll: volume + battery (+ cached thresholds) in a single bus session.
+BENCHMARK("pulsar.readValues/volume+battery", 2000) {
+    Sim::VirtualPulsarBus bus;
+    bus.addMeter(kColdSerial).volumeM3 = 12.79f;
+    Driver::PulsarDu_15_20 drv(&bus, kColdSerial);
+    const Driver::ParamSet params = Driver::paramBit(Driver::MeterParam::TotalVolume) |
+                                    Driver::paramBit(Driver::MeterParam::BatteryVoltage) |
+                                    Driver::paramBit(Driver::MeterParam::BatteryThresholdMin) |
+                                    Driver::paramBit(Driver::MeterParam::BatteryThresholdAlarm);
+
+    bus.resetStats();
+    uint64_t startUs = HostShim::clockUs();
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        Driver::MeterReading r;
+        if (!drv.readValues(params, r)) abort();
+    }
+    ctx.report("virtual bus ms/op", (HostShim::clockUs() - startUs) / 1000.0 / ctx.iterations);
+    ctx.report("bus transactions/op", (double)bus.stats().requests / ctx.iterations);
+}
+
+BENCHMARK("pulsar.poll/faults-0%", 2000) { faultyPoll(ctx, 0.0f); }
+BENCHMARK("pulsar.poll/faults-2%", 2000) { faultyPoll(ctx, 0.02f); }
+BENCHMARK("pulsar.poll/faults-10%", 2000) { faultyPoll(ctx, 0.10f); }
@@ -0,0 +1,132 @@
+// Logging cost on the poll path: awake time of one Pulsar poll (all four
+// transactions on the simulated bus) with the trace the driver used to print
+// synchronously, byte by byte, to a 115200 baud console, against the same
+// trace as binary records in the Log ring, and against the default build,
+// where frame traces are compiled out.
+//
+// The console is modelled as the ESP32 UART: a 128-byte TX FIFO drained at
+// 87 us per byte; a write into a full FIFO blocks the caller, which is what
+// kept the CPU (and the RS485 line power) awake after the last reply.
+
+#include "bench.h"
+
+#include "drivers/pulsar_ds15_20.h"
+#include "log.h"
+#include "sim/virtual_pulsar.h"
+
+namespace {
+
+constexpr uint32_t kSerial = 10128442;
+
+class UartConsole : public Print {
+public:
+    static constexpr uint32_t kByteUs = 87;       // 10 bits at 115200 baud
+    static constexpr uint32_t kFifo = 128;
+
+    uint64_t bytes = 0;
+
+    size_t write(uint8_t) override {
+        uint64_t now = HostShim::clockUs();
+        if (_doneUs < now) _doneUs = now;
+        uint64_t queued = (_doneUs - now) / kByteUs;
+        if (queued >= kFifo) HostShim::advanceMicros((queued - kFifo + 1) * kByteUs);
+        _doneUs += kByteUs;
+        bytes++;
+        return 1;
+    }
+
+private:
+    uint64_t _doneUs = 0;   // When the last queued byte has left
+};
+
+enum class Trace { None, Sync, Ring };
+
+// The bus as the driver sees it, tracing TX/RX frames the way PulsarDu_15_20
+// did before the Log ring (Sync) or as LOG_FRAME records with DRV at Verbose
+// (Ring). Frame traces are compiled out of the driver by default, so the
+// bench reproduces them here.
+class TracedLine : public Stream {
+public:
+    TracedLine(Stream& line, Trace trace, Print& console) : _line(line), _trace(trace), _console(console) {}
+
+    size_t write(uint8_t b) override { return write(&b, 1); }
+    size_t write(const uint8_t* buf, size_t size) override {
+        endReply();
+        if (_trace == Trace::Sync) {
+            _console.printf(">>> TX [%08u]: ", kSerial);
+            for (size_t i = 0; i < size; i++) _console.printf("%02X ", buf[i]);
+            _console.println();
+        } else if (_trace == Trace::Ring) {
+            Log::ring().frame(Log::Module::Drv, Log::Level::Verbose, ">>> TX [%08lu]: ", kSerial, buf, size);
+        }
+        return _line.write(buf, size);
+    }
+    int available() override { return _line.available(); }
+    int read() override {
+        int c = _line.read();
+        if (c >= 0 && _rxLen < sizeof(_rx)) _rx[_rxLen++] = (uint8_t)c;
+        return c;
+    }
+    int peek() override { return _line.peek(); }
+    void flush() override { _line.flush(); }
+
+    // The driver logged each reply once it was in.
+    void endReply() {
+        if (_rxLen == 0) return;
+        if (_trace == Trace::Sync) {
+            _console.printf("<<< RX [%08u]: ", kSerial);
+            for (size_t i = 0; i < _rxLen; i++) _console.printf("%02X ", _rx[i]);
+            _console.println();
+        } else if (_trace == Trace::Ring) {
+            Log::ring().frame(Log::Module::Drv, Log::Level::Verbose, "<<< RX [%08lu]: ", kSerial, _rx, _rxLen);
+        }
+        _rxLen = 0;
+    }
+
+private:
+    Stream& _line;
+    Trace _trace;
+    Print& _console;
+    uint8_t _rx[64];
+    size_t _rxLen = 0;
+};
+
+// One poll per iteration, as WaterSource::tick() runs it; `drain` formats the
+// ring to the console at the end of the wake-up (a USB host is attached).
+// "poll ms" is the poll itself (the bus is held), "awake ms" adds the drain.
+void poll(Bench::Context& ctx, Trace trace, bool drain) {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Sim::VirtualPulsarBus bus;
+    bus.addMeter(kSerial).volumeM3 = 12.5f;
+    UartConsole console;
+    TracedLine line(bus, trace, console);
+    Driver::PulsarDu_15_20 drv(&line, kSerial);
+    Log::ring().clear();
+
+    uint64_t pollUs = 0, awakeUs = 0;
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        uint64_t t0 = HostShim::clockUs();
+        if (trace == Trace::Sync) console.println("Source: Polling for new data...");
+        if (trace == Trace::Ring) Log::ring().write(Log::Module::Src, Log::Level::Debug, "Polling for new data...");
+        Driver::MeterReading r;
+        Bench::doNotOptimize(drv.readValues(Driver::PulsarDu_15_20::kSupportedParams, r));
+        line.endReply();
+        pollUs += HostShim::clockUs() - t0;
+        if (drain) Log::ring().drain(console);   // After the poll: the bus is already released
+        awakeUs += HostShim::clockUs() - t0;
+        HostShim::advanceMillis(600000);
+    }
+    ctx.report("poll ms", pollUs / 1000.0 / ctx.iterations);
+    ctx.report("awake ms", awakeUs / 1000.0 / ctx.iterations);
+    ctx.report("console B", (double)console.bytes / ctx.iterations);
+    Log::ring().clear();
+    HostShim::consoleEnabled() = true;
+}
+
+} // namespace
+
+BENCHMARK("log.poll/sync-printf", 2000) { poll(ctx, Trace::Sync, false); }
+BENCHMARK("log.poll/ring", 2000) { poll(ctx, Trace::Ring, false); }
+BENCHMARK("log.poll/ring+drain", 2000) { poll(ctx, Trace::Ring, true); }
+BENCHMARK("log.poll/default-build", 2000) { poll(ctx, Trace::None, false); }
@@ -0,0 +1,159 @@
+// Main loop: wake-ups of the fixed-delay loop (15 s idle / 100 ms while
+// reporting) against the deadline-driven EventScheduler, on the same device
+// model over one virtual day. ns/op is host time per simulated day; the
+// interesting columns are wakeups/h and the frames both loops send.
+
+#include "bench.h"
+
+#include "event_scheduler.h"
+#include "report_scheduler.h"
+#include "sources/simulation_source.h"
+#include "zigbee_water_meter.h"
+
+namespace {
+
+constexpr uint32_t kDayMs = 86400000;
+constexpr uint32_t kPollMs = 60000 * 30;
+constexpr uint32_t kAutoSaveMs = 900000;
+constexpr uint32_t kIdleDelayMs = 15000;
+constexpr uint32_t kSlackMs = 1000;
+
+// Two channels, their endpoints and the periodic jobs of main.ino.
+struct Device {
+    Source::SimulationSource src[2] = { Source::SimulationSource(1000), Source::SimulationSource(2000) };
+    ZigbeeWaterMeter ep[2] = { ZigbeeWaterMeter(1, true), ZigbeeWaterMeter(2, false) };
+    ReportScheduler<2> reports{100};
+    uint32_t lastSave = 0;
+    uint32_t saves = 0;
+
+    Device() {
+        for (int i = 0; i < 2; i++) {
+            src[i].setPollInterval(kPollMs);
+            src[i].begin();
+            src[i].forceUpdate();
+            ep[i].setSource(&src[i]);
+            ep[i].begin();
+            ep[i].registerAttributes();
+            reports.addEndpoint(&ep[i]);
+        }
+    }
+
+    uint32_t sources(uint32_t now) {
+        uint32_t d = UINT32_MAX;
+        for (auto& s : src) {
+            s.tick();
+            d = std::min(d, s.msUntilDue(now));
+        }
+        return d;
+    }
+
+    uint32_t reporting(uint32_t now) {
+        for (int i = 0; i < 2; i++) {
+            if (src[i].hasHourChanged()) reports.post(i, ReportKind::Hourly);
+            if (ep[i].shouldReport(now)) reports.post(i, ReportKind::Value);
+            if (ep[i].batteryDue(now)) reports.post(i, ReportKind::Battery);
+        }
+        reports.run(now);
+
+        uint32_t next = UINT32_MAX;
+        for (auto& e : ep) {
+            uint32_t ms = e.msUntilReport(now);
+            if (ms != 0) next = std::min(next, ms);
+        }
+        uint32_t due = reports.nextDue(now);
+        return due == UINT32_MAX ? next : std::min(next, due - now);
+    }
+
+    void autoSave(uint32_t now) {
+        if (now - lastSave < kAutoSaveMs) return;
+        lastSave = now;
+        saves++;
+    }
+};
+
+enum { kTimerSources, kTimerReporting, kTimerAutoSave, kTimerCount };
+Device* g_dev = nullptr;
+EventScheduler<kTimerCount>* g_loop = nullptr;
+
+// Timers as in main.ino: sources hand fresh readings to reporting.
+uint32_t runSources(uint32_t now) {
+    uint32_t d = g_dev->sources(now);
+    g_loop->arm(kTimerReporting, now);
+    return d;
+}
+uint32_t runReporting(uint32_t now) { return g_dev->reporting(now); }
+uint32_t runAutoSave(uint32_t) {
+    g_dev->saves++;
+    return kAutoSaveMs;
+}
+
+struct DayResult {
+    uint64_t wakeups = 0;
+    uint32_t frames = 0;
+    uint32_t saves = 0;
+};
+
+// Today's loop: every pass checks everything, then delay().
+DayResult fixedDay() {
+    HostShim::setMillis(0);
+    HostZigbee::stats() = HostZigbee::Stats{};
+    Device dev;
+    DayResult r;
+    while (millis() < kDayMs) {
+        uint32_t now = millis();
+        dev.sources(now);
+        dev.reporting(now);
+        dev.autoSave(now);
+        r.wakeups++;
+        HostShim::setMillis(now + (dev.reports.idle() ? kIdleDelayMs : 100));
+    }
+    r.frames = HostZigbee::stats().frames();
+    r.saves = dev.saves;
+    return r;
+}
+
+// Deadline loop: sleep straight to the earliest timer.
+DayResult deadlineDay() {
+    HostShim::setMillis(0);
+    HostZigbee::stats() = HostZigbee::Stats{};
+    Device dev;
+    EventScheduler<kTimerCount> loop(kSlackMs);
+    g_dev = &dev;
+    g_loop = &loop;
+    loop.add(runSources, 0, 0);
+    loop.add(runReporting, 0, 0);
+    loop.add(runAutoSave, 0, kAutoSaveMs);
+
+    while (millis() < kDayMs) {
+        uint32_t now = millis();
+        loop.noteSleep(now);
+        now += loop.nextDelay(now);
+        HostShim::setMillis(now);
+        loop.noteWake(now, false);
+        loop.runDue(now);
+    }
+    DayResult r;
+    r.wakeups = loop.stats().wakeups;
+    r.frames = HostZigbee::stats().frames();
+    r.saves = dev.saves;
+    g_dev = nullptr;
+    g_loop = nullptr;
+    return r;
+}
+
+void dayBench(Bench::Context& ctx, DayResult (*day)()) {
+    HostShim::consoleEnabled() = false;
+    DayResult r;
+    for (uint32_t i = 0; i < ctx.iterations; i++) r = day();
+    HostShim::consoleEnabled() = true;
+    HostZigbee::stats() = HostZigbee::Stats{};
+    if (r.saves < 95) abort(); // Both loops must still do the day's work
+    ctx.report("wakeups/h", r.wakeups / 24.0);
+    ctx.report("frames/day", r.frames);
+    ctx.report("saves/day", r.saves);
+}
+
+} // namespace
+
+BENCHMARK("loop.idle-day/fixed-delay", 20) { dayBench(ctx, fixedDay); }
+BENCHMARK("loop.idle-day/deadline", 200) { dayBench(ctx, deadlineDay); }
@@ -0,0 +1,36 @@
+// Metrics: cost of an update on the hot paths, and of reading the registry out.
+
+#include "bench.h"
+
+#include "metrics.h"
+
+namespace {
+
+class NullPrint : public Print {
+public:
+    size_t bytes = 0;
+    size_t write(uint8_t) override { return ++bytes, 1; }
+};
+
+} // namespace
+
+BENCHMARK("metrics.count", 10000000) {
+    Metrics::registry().reset();
+    for (uint32_t i = 0; i < ctx.iterations; i++) Metrics::count(Metrics::Counter::RsTransactions);
+    ctx.report("total", Metrics::registry().get(Metrics::Counter::RsTransactions));
+}
+
+// Spread over the whole range so the bucket index is not predictable.
+BENCHMARK("metrics.record", 10000000) {
+    Metrics::registry().reset();
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        Metrics::record(Metrics::Histogram::RsTransactionUs, (i * 2654435761u) >> (12 + (i & 15)));
+    }
+    ctx.report("p95 us", Metrics::registry().percentile(Metrics::Histogram::RsTransactionUs, 95));
+}
+
+BENCHMARK("metrics.dump", 10000) {
+    NullPrint out;
+    for (uint32_t i = 0; i < ctx.iterations; i++) Metrics::registry().dump(out, i * 1000);
+    ctx.report("bytes/line", (double)out.bytes / ctx.iterations);
+}
@@ -0,0 +1,81 @@
+// Smart polling: fixed vs adaptive poll interval over day-long consumption
+// traces. A Pulsar on the simulated bus is read by a Smart source the way
+// the device does it; every liter is timed from the minute it was drawn to
+// the poll that saw it (what the coordinator can report at best).
+
+#include "bench.h"
+
+#include <deque>
+
+#include "drivers/pulsar_ds15_20.h"
+#include "sim/consumption_trace.h"
+#include "sim/virtual_pulsar.h"
+#include "sources/smart_source.h"
+
+namespace {
+
+constexpr uint32_t kMinute = 60000;
+constexpr uint32_t kSerial = 10128442;
+
+// Replays `trace` for ctx.iterations days, one loop pass per minute.
+void replay(Bench::Context& ctx, const Sim::ConsumptionTrace& trace, Source::PollBounds bounds) {
+    HostShim::setMillis(1000);
+    Sim::VirtualPulsarBus line;
+    Sim::PulsarMeterState& meter = line.addMeter(kSerial);
+    uint64_t liters = 12345;
+    meter.volumeM3 = liters / 1000.0f;
+
+    Driver::PulsarDu_15_20 drv(&line, kSerial);
+    Source::BasicSmartSource<Driver::PulsarDu_15_20> src(&drv, liters);
+    src.setPollBounds(bounds);
+    src.begin();
+    src.tick(); // Starts the clocks
+
+    struct Pending { uint32_t at; uint32_t liters; };
+    std::deque<Pending> pending;
+    uint64_t seen = liters, staleLiterMin = 0, drawn = 0;
+    uint32_t polls = 0, maxStaleMin = 0;
+
+    for (uint32_t day = 0; day < ctx.iterations; day++) {
+        for (uint32_t m = 0; m < 1440; m++) {
+            uint32_t l = trace.litersInMinute(m);
+            if (l) {
+                liters += l;
+                drawn += l;
+                meter.volumeM3 = liters / 1000.0f;
+                pending.push_back({ (uint32_t)(day * 1440 + m), l });
+            }
+            HostShim::advanceMillis(kMinute);
+            if (!src.pollDue(millis())) continue;
+            src.tick();
+            polls++;
+            if (src.getLiters() == seen) continue;
+            seen = src.getLiters();
+            uint32_t now = day * 1440 + m + 1;
+            for (const Pending& p : pending) {
+                staleLiterMin += (uint64_t)(now - p.at) * p.liters;
+                maxStaleMin = std::max(maxStaleMin, now - p.at);
+            }
+            pending.clear();
+        }
+    }
+    ctx.report("polls/day", (double)polls / ctx.iterations);
+    ctx.report("mean stale min", drawn ? (double)staleLiterMin / drawn : 0);
+    ctx.report("max stale min", maxStaleMin);
+}
+
+constexpr Source::PollBounds kFixed30 = { 30 * kMinute, 30 * kMinute };   // Before: fixed POLL_INTERVAL
+constexpr Source::PollBounds kDefault = { 10 * kMinute, 120 * kMinute };  // Channel table default
+constexpr Source::PollBounds kHourly = { 10 * kMinute, 60 * kMinute };    // Never older than an hour
+constexpr Source::PollBounds kFresh = { 1 * kMinute, 30 * kMinute };      // Coordinator wants fresher data
+
+} // namespace
+
+BENCHMARK("poll.family/fixed-30min", 700) { replay(ctx, Sim::kFamily, kFixed30); }
+BENCHMARK("poll.family/adaptive-10m..2h", 700) { replay(ctx, Sim::kFamily, kDefault); }
+BENCHMARK("poll.family/adaptive-10m..1h", 700) { replay(ctx, Sim::kFamily, kHourly); }
+BENCHMARK("poll.family/adaptive-1m..30m", 700) { replay(ctx, Sim::kFamily, kFresh); }
+BENCHMARK("poll.vacant/fixed-30min", 700) { replay(ctx, Sim::kVacant, kFixed30); }
+BENCHMARK("poll.vacant/adaptive-10m..2h", 700) { replay(ctx, Sim::kVacant, kDefault); }
+BENCHMARK("poll.leak/fixed-30min", 700) { replay(ctx, Sim::kLeak, kFixed30); }
+BENCHMARK("poll.leak/adaptive-10m..2h", 700) { replay(ctx, Sim::kLeak, kDefault); }
@@ -0,0 +1,134 @@
+// Zigbee layer: report decision and report paths against the host stack shim.
+
+#include "bench.h"
+
+#include "sources/pulse_source.h"
+#include "sources/simulation_source.h"
+#include "zigbee_water_meter.h"
+
+BENCHMARK("zigbee.shouldReport", 5000000) {
+    Source::SimulationSource src(1000);
+    ZigbeeWaterMeter ep(1, true);
+    ep.setSource(&src);
+    ep.begin();
+    ep.registerAttributes();
+    ep.reportValue();
+
+    uint32_t hits = 0;
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        if ((i & 0xFF) == 0) src.setLiters(src.getLiters() + 1);
+        hits += ep.shouldReport();
+    }
+    Bench::doNotOptimize(hits);
+}
+
+BENCHMARK("zigbee.reportValue", 1000000) {
+    Source::SimulationSource src(1000);
+    ZigbeeWaterMeter ep(1, true);
+    ep.setSource(&src);
+    ep.begin();
+    ep.registerAttributes();
+
+    HostZigbee::stats() = HostZigbee::Stats{};
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        src.setLiters(1000 + i);
+        ep.reportValue();
+    }
+    ctx.report("frames/op", (double)HostZigbee::stats().frames() / ctx.iterations);
+    HostZigbee::stats() = HostZigbee::Stats{};
+}
+
+BENCHMARK("zigbee.reportConfig", 100000) {
+    Source::SimulationSource src(1000);
+    ZigbeeWaterMeter ep(1, true);
+    ep.setSource(&src);
+    ep.begin();
+    ep.registerAttributes();
+
+    HostZigbee::stats() = HostZigbee::Stats{};
+    uint64_t startUs = HostShim::clockUs();
+    for (uint32_t i = 0; i < ctx.iterations; i++) ep.reportConfig();
+    ctx.report("virtual ms under lock/op", (HostShim::clockUs() - startUs) / 1000.0 / ctx.iterations);
+    ctx.report("frames/op", (double)HostZigbee::stats().frames() / ctx.iterations);
+    HostZigbee::stats() = HostZigbee::Stats{};
+}
+
+// Everything one endpoint sends on a heartbeat with an hour rollover:
+// total, flow, last hour, battery voltage and percentage.
+static void heartbeat(ZigbeeWaterMeter& ep, bool batched) {
+    if (batched) {
+        ep.queueValue();
+        ep.queueHourly();
+        ep.queueBattery();
+        ep.flushReports();
+    } else {
+        ep.reportValue();
+        ep.reportHourly();
+        ep.reportBattery();
+    }
+}
+
+static void heartbeatBench(Bench::Context& ctx, bool batched) {
+    Source::SimulationSource src(1000);
+    ZigbeeWaterMeter ep(1, true);
+    ep.setSource(&src);
+    ep.begin();
+    ep.registerAttributes();
+
+    HostZigbee::stats() = HostZigbee::Stats{};
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        src.setLiters(1000 + i);
+        heartbeat(ep, batched);
+    }
+    ctx.report("frames/op", (double)HostZigbee::stats().frames() / ctx.iterations);
+    ctx.report("lock windows/op", (double)ep.lockStats().holds / ctx.iterations);
+    ctx.report("max lock hold us", ep.lockStats().maxUs);
+    HostZigbee::stats() = HostZigbee::Stats{};
+}
+
+BENCHMARK("zigbee.heartbeat/per-cluster", 200000) { heartbeatBench(ctx, false); }
+BENCHMARK("zigbee.heartbeat/batched", 200000) { heartbeatBench(ctx, true); }
+
+// A 10 min shower on a pulse meter (1 L every 2 s), the loop checking after
+// every pulse: frames on air and the longest a liter waited to be reported,
+// with "every liter" reporting against the default min interval.
+static void showerBench(Bench::Context& ctx, const ReportingConfig& value) {
+    HostShim::consoleEnabled() = false;
+    uint32_t frames = 0, stalest = 0;
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        HostShim::setMillis(1000);
+        Source::PulseSource src(10, 0, 5000);
+        ZigbeeWaterMeter ep(1);
+        ep.setSource(&src);
+        ep.begin();
+        ep.registerAttributes();
+        ReportingConfig cfg[2] = { value, kFlowReportingDefault };
+        ep.reporting().importConfigs(cfg, 2);
+        ep.reportValue();
+
+        HostZigbee::stats() = HostZigbee::Stats{};
+        uint32_t pendingSince = 0;
+        stalest = 0;
+        for (uint32_t t = 0; t < 600000; t += 2000) {
+            HostShim::advanceMillis(2000);
+            src.increment();
+            src.collect();
+            if (!pendingSince) pendingSince = millis();
+            uint32_t wait = ep.msUntilReport(millis());
+            if (wait >= 2000) continue;      // Next pulse comes first
+            HostShim::advanceMillis(wait);   // Loop timer for the min interval
+            ep.reportValue();
+            stalest = std::max(stalest, millis() - pendingSince);
+            pendingSince = 0;
+            HostShim::setMillis(millis() - wait);
+        }
+        frames = HostZigbee::stats().frames();
+    }
+    HostZigbee::stats() = HostZigbee::Stats{};
+    HostShim::consoleEnabled() = true;
+    ctx.report("frames/shower", frames);
+    ctx.report("max staleness s", stalest / 1000.0);
+}
+
+BENCHMARK("zigbee.shower/every-liter", 50) { showerBench(ctx, { 0, 1800, 1 }); }
+BENCHMARK("zigbee.shower/min-interval", 50) { showerBench(ctx, kValueReportingDefault); }
@@ -0,0 +1,161 @@
+// Source layer: WaterSource::tick() with hour/day rollover and polling.
+
+#include "bench.h"
+
+#include "drivers/pulsar_ds15_20.h"
+#include "sources/factory_source.h"
+#include "sim/virtual_pulsar.h"
+
+namespace {
+
+// Cheapest possible concrete source so tick() itself dominates the numbers.
+class CounterSource : public Source::WaterSource {
+public:
+    uint64_t liters = 0;
+    void begin() override {}
+    void update() override { liters++; }
+    uint64_t getLiters() override { return liters; }
+    void setLiters(uint64_t l) override { liters = l; }
+};
+
+// Meter that answers instantly, so only the source -> driver call path is measured.
+class InstantDriver final : public Driver::SmartMeterDriver {
+public:
+    static constexpr Driver::ParamSet kSupportedParams =
+        Driver::paramBit(Driver::MeterParam::TotalVolume) | Driver::paramBit(Driver::MeterParam::BatteryVoltage);
+
+    InstantDriver() : SmartMeterDriver(nullptr) {}
+    Driver::ParamSet supportedParams() const override { return kSupportedParams; }
+    bool getValue(Driver::MeterParam param, float& result) override {
+        result = param == Driver::MeterParam::TotalVolume ? volume : 3.6f;
+        return true;
+    }
+    bool readValues(Driver::ParamSet params, Driver::MeterReading& out) override {
+        if (params & Driver::paramBit(Driver::MeterParam::TotalVolume)) out.set(Driver::MeterParam::TotalVolume, volume);
+        if (params & Driver::paramBit(Driver::MeterParam::BatteryVoltage)) out.set(Driver::MeterParam::BatteryVoltage, 3.6f);
+        volume += 0.001f;
+        return (out.valid & params) == params;
+    }
+
+    float volume = 1.0f;
+};
+
+template <class Src>
+void smartUpdateLoop(Bench::Context& ctx) {
+    InstantDriver drv;
+    Src src(&drv);
+    for (uint32_t i = 0; i < ctx.iterations; i++) src.update();
+    Bench::doNotOptimize(src.getLiters());
+    if (src.getLiters() == 0) abort();
+}
+
+} // namespace
+
+BENCHMARK("source.tick/idle", 5000000) {
+    CounterSource src;
+    src.setPollInterval(60000 * 30);
+    HostShim::advanceMillis(1);
+    src.tick();
+    for (uint32_t i = 0; i < ctx.iterations; i++) src.tick();
+    Bench::doNotOptimize(src.liters);
+}
+
+// Every call closes an hour and a day and polls the source.
+BENCHMARK("source.tick/rollover+poll", 1000000) {
+    CounterSource src;
+    src.setTestMode(true);
+    src.setPollInterval(1);
+    HostShim::advanceMillis(1);
+    src.tick();
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        HostShim::advanceMillis(20000);
+        src.tick();
+    }
+    Bench::doNotOptimize(src.liters);
+}
+
+BENCHMARK("source.pulse.increment+getLiters", 5000000) {
+    Source::PulseSource src(10, 0);
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        HostShim::advanceMillis(1);
+        src.increment();
+    }
+    Bench::doNotOptimize(src.getLiters());
+}
+
+// Loop side of a pulse: fold the count, drain the ring, update the flow estimate.
+BENCHMARK("source.pulse.collect+flow", 2000000) {
+    Source::PulseSource src(10, 0);
+    uint32_t flow = 0;
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        HostShim::advanceMillis(6000); // 600 L/h
+        src.increment();
+        src.collect();
+        flow = src.getFlowRate();
+    }
+    if (flow != 600) abort();
+    ctx.report("L/h", flow);
+}
+
+// Cold + hot Pulsar on one line. Blocking: loop() pays the full bus time.
+BENCHMARK("source.smart.poll/blocking", 1000) {
+    Sim::VirtualPulsarBus bus;
+    bus.addMeter(10128442).volumeM3 = 12.5f;
+    bus.addMeter(10128939).volumeM3 = 7.25f;
+    Driver::PulsarDu_15_20 coldDrv(&bus, 10128442), hotDrv(&bus, 10128939);
+    Source::SmartSource cold(&coldDrv), hot(&hotDrv);
+
+    uint64_t loopUs = 0;
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        uint64_t t0 = HostShim::clockUs();
+        cold.update();
+        hot.update();
+        loopUs += HostShim::clockUs() - t0;
+    }
+    if (cold.getLiters() != 12500 || hot.getLiters() != 7250) abort();
+    ctx.report("virtual ms in loop()/op", loopUs / 1000.0 / ctx.iterations);
+}
+
+// Same polls through the bus scheduler: loop() only submits and collects;
+// runBurst() stands in for the bus task.
+BENCHMARK("source.smart.poll/scheduled", 1000) {
+    Sim::VirtualPulsarBus bus;
+    bus.addMeter(10128442).volumeM3 = 12.5f;
+    bus.addMeter(10128939).volumeM3 = 7.25f;
+    Driver::PulsarDu_15_20 coldDrv(&bus, 10128442), hotDrv(&bus, 10128939);
+    Source::SmartSource cold(&coldDrv), hot(&hotDrv);
+    Bus::BusScheduler sched;
+    cold.setBusScheduler(&sched, 2);
+    hot.setBusScheduler(&sched, 1);
+
+    uint64_t loopUs = 0, busUs = 0;
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        uint64_t t0 = HostShim::clockUs();
+        cold.update();
+        hot.update();
+        loopUs += HostShim::clockUs() - t0;
+
+        t0 = HostShim::clockUs();
+        sched.runBurst();
+        busUs += HostShim::clockUs() - t0;
+
+        t0 = HostShim::clockUs();
+        cold.collect();
+        hot.collect();
+        loopUs += HostShim::clockUs() - t0;
+    }
+    if (cold.getLiters() != 12500 || hot.getLiters() != 7250) abort();
+    ctx.report("virtual ms in loop()/op", loopUs / 1000.0 / ctx.iterations);
+    ctx.report("virtual ms on bus task/op", busUs / 1000.0 / ctx.iterations);
+    ctx.report("transactions/burst", (double)sched.stats().transactions / sched.stats().bursts);
+}
+
+// Inline poll through the SmartMeterDriver interface (DriverFactory path) ...
+BENCHMARK("source.smart.update/virtual", 2000000) {
+    smartUpdateLoop<Source::SmartSource>(ctx);
+}
+
+// ... and typed on the final driver (SourceFactory::createSmart path).
+BENCHMARK("source.smart.update/static", 2000000) {
+    smartUpdateLoop<Source::BasicSmartSource<InstantDriver>>(ctx);
+}
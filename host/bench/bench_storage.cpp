@@ -0,0 +1,73 @@
+// Persistence: NVS traffic of the periodic save, old per-key layout vs ChannelStore.
+
+#include "bench.h"
+
+#include "storage/channel_store.h"
+
+namespace {
+
+// One 15-minute auto-save of a quiet household: a few liters now and then.
+uint64_t litersAfterSave(uint32_t i) { return 1000 + (i / 4) * 3; }
+
+} // namespace
+
+// Previous saveConfiguration(): six puts per save, changed or not.
+BENCHMARK("nvs.autosave/per-key", 100000) {
+    Preferences prefs;
+    prefs.begin("bench_old");
+    HostShim::nvsStats() = HostShim::NvsStats{};
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        prefs.putUInt("sc", 10128442);
+        prefs.putInt("oc", 0);
+        prefs.putUInt("sh", 10128939);
+        prefs.putInt("oh", 0);
+        prefs.putULong64("cl", litersAfterSave(i));
+        prefs.putULong64("hl", litersAfterSave(i) / 2);
+    }
+    ctx.report("nvs writes/op", (double)HostShim::nvsStats().writes / ctx.iterations);
+    ctx.report("nvs bytes/op", (double)HostShim::nvsStats().bytes / ctx.iterations);
+    prefs.clear();
+}
+
+BENCHMARK("nvs.autosave/channel-store", 100000) {
+    Preferences prefs;
+    prefs.begin("bench_new");
+    Storage::ChannelStore cold(&prefs, 0), hot(&prefs, 1);
+    HostShim::nvsStats() = HostShim::NvsStats{};
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        Storage::ChannelState c, h;
+        c.serial = 10128442;
+        c.liters = litersAfterSave(i);
+        h.serial = 10128939;
+        h.liters = litersAfterSave(i) / 2;
+        cold.save(c);
+        hot.save(h);
+    }
+    ctx.report("nvs writes/op", (double)HostShim::nvsStats().writes / ctx.iterations);
+    ctx.report("nvs bytes/op", (double)HostShim::nvsStats().bytes / ctx.iterations);
+
+    Storage::ChannelState back;
+    if (!cold.load(back) || back.liters + 10 <= litersAfterSave(ctx.iterations - 1)) abort();
+    prefs.clear();
+}
+
+BENCHMARK("nvs.restore/channel-store", 100000) {
+    Preferences prefs;
+    prefs.begin("bench_load");
+    Storage::ChannelStore seed(&prefs, 0);
+    Storage::ChannelState s;
+    s.serial = 10128442;
+    s.liters = 123456;
+    seed.save(s);
+    s.liters += 100;
+    seed.save(s);
+
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < ctx.iterations; i++) {
+        Storage::ChannelStore store(&prefs, 0);
+        Storage::ChannelState out;
+        if (store.load(out)) sum += out.liters;
+    }
+    if (sum != 123556ull * ctx.iterations) abort();
+    prefs.clear();
+}
@@ -0,0 +1,172 @@
+#ifndef HOST_SHIM_ARDUINO_H
+#define HOST_SHIM_ARDUINO_H
+
+// Minimal Arduino core replacement for the host (Linux) build.
+//
+// Only the subset used by main/ is provided. Time is virtual: millis() and
+// micros() return a counter that only moves through delay() or
+// HostShim::advanceMillis(), so timeouts and hour/day rollovers are
+// deterministic and cost no wall-clock time in benchmarks. The counter is
+// atomic so threaded host tests (ISR simulations) may advance it too.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define IRAM_ATTR
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define SERIAL_8N1 0x800001c
+
+namespace HostShim {
+
+inline std::atomic<uint64_t>& clockUs() {
+    static std::atomic<uint64_t> us{0};
+    return us;
+}
+
+inline void advanceMicros(uint64_t us) { clockUs() += us; }
+inline void advanceMillis(uint32_t ms) { clockUs() += (uint64_t)ms * 1000; }
+inline void setMillis(uint32_t ms) { clockUs() = (uint64_t)ms * 1000; }
+
+// Console output of Serial. Benchmarks mute it so printf cost stays out of the numbers.
+inline bool& consoleEnabled() {
+    static bool enabled = true;
+    return enabled;
+}
+
+inline uint8_t* pinLevels() {
+    static uint8_t levels[64] = {};
+    return levels;
+}
+
+inline void setPinLevel(uint8_t pin, uint8_t level) { if (pin < 64) pinLevels()[pin] = level; }
+
+} // namespace HostShim
+
+inline uint32_t millis() { return (uint32_t)(HostShim::clockUs() / 1000); }
+inline uint32_t micros() { return (uint32_t)HostShim::clockUs(); }
+inline void delay(uint32_t ms) { HostShim::advanceMillis(ms); }
+inline void delayMicroseconds(uint32_t us) { HostShim::advanceMicros(us); }
+inline void yield() {}
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+    if (mode == INPUT_PULLUP) HostShim::setPinLevel(pin, HIGH);
+}
+inline void digitalWrite(uint8_t pin, uint8_t val) { HostShim::setPinLevel(pin, val); }
+inline int digitalRead(uint8_t pin) { return pin < 64 ? HostShim::pinLevels()[pin] : LOW; }
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+inline void attachInterrupt(uint8_t, void (*)(), int) {}
+inline void detachInterrupt(uint8_t) {}
+inline void neopixelWrite(uint8_t, uint8_t, uint8_t, uint8_t) {}
+
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t b) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while (size--) n += write(*buffer++);
+        return n;
+    }
+    virtual void flush() {}
+
+    size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(long v) { return printf("%ld", v); }
+    size_t print(unsigned long v) { return printf("%lu", v); }
+    size_t print(int v) { return print((long)v); }
+    size_t print(unsigned int v) { return print((unsigned long)v); }
+
+    size_t println() { return print("\r\n"); }
+    template <typename T>
+    size_t println(T v) { return print(v) + println(); }
+
+    size_t printf(const char* format, ...) {
+        char buf[256];
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        if (len <= 0) return 0;
+        return write((const uint8_t*)buf, std::min((size_t)len, sizeof(buf) - 1));
+    }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout) { _timeout = timeout; }
+    unsigned long getTimeout() const { return _timeout; }
+
+    // Same contract as the Arduino core: stops on count or on timeout measured
+    // from the start of the call. Simulated streams advance the virtual clock
+    // in read() while they have nothing to return.
+    size_t readBytes(uint8_t* buffer, size_t length) {
+        size_t count = 0;
+        while (count < length) {
+            int c = timedRead();
+            if (c < 0) break;
+            *buffer++ = (uint8_t)c;
+            count++;
+        }
+        return count;
+    }
+    size_t readBytes(char* buffer, size_t length) { return readBytes((uint8_t*)buffer, length); }
+
+protected:
+    unsigned long _timeout = 1000;
+    unsigned long _startMillis = 0;
+
+    int timedRead() {
+        _startMillis = millis();
+        do {
+            int c = read();
+            if (c >= 0) return c;
+        } while (millis() - _startMillis < _timeout);
+        return -1;
+    }
+};
+
+// Console-only UART. Anything written goes to stdout; nothing is ever received.
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long, uint32_t = SERIAL_8N1, int = -1, int = -1) {}
+    void end() {}
+
+    size_t write(uint8_t b) override { return write(&b, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        if (HostShim::consoleEnabled()) fwrite(buffer, 1, size, stdout);
+        return size;
+    }
+
+    int available() override { return 0; }
+    int read() override { HostShim::advanceMillis(1); return -1; }
+    int peek() override { return -1; }
+    void flush() override { if (HostShim::consoleEnabled()) fflush(stdout); }
+};
+
+inline HardwareSerial Serial;
+inline HardwareSerial Serial1;
+
+#endif
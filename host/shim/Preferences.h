@@ -0,0 +1,96 @@
+#ifndef HOST_SHIM_PREFERENCES_H
+#define HOST_SHIM_PREFERENCES_H
+
+// In-memory stand-in for the ESP32 Preferences (NVS) library.
+// Every put* call is counted so host code can measure flash write traffic.
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace HostShim {
+
+struct NvsStats {
+    uint32_t writes = 0;
+    uint32_t bytes = 0;
+};
+
+inline std::map<std::string, std::vector<uint8_t>>& nvsStore() {
+    static std::map<std::string, std::vector<uint8_t>> store;
+    return store;
+}
+
+inline NvsStats& nvsStats() {
+    static NvsStats stats;
+    return stats;
+}
+
+} // namespace HostShim
+
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false) {
+        _ns = name;
+        _readOnly = readOnly;
+        return true;
+    }
+    void end() { _ns.clear(); }
+
+    bool clear() {
+        auto& store = HostShim::nvsStore();
+        for (auto it = store.begin(); it != store.end();) {
+            it = it->first.rfind(_ns + "/", 0) == 0 ? store.erase(it) : std::next(it);
+        }
+        return true;
+    }
+    bool remove(const char* key) { return HostShim::nvsStore().erase(path(key)) > 0; }
+    bool isKey(const char* key) { return HostShim::nvsStore().count(path(key)) > 0; }
+
+    size_t putInt(const char* key, int32_t v) { return put(key, &v, sizeof(v)); }
+    size_t putUInt(const char* key, uint32_t v) { return put(key, &v, sizeof(v)); }
+    size_t putULong64(const char* key, uint64_t v) { return put(key, &v, sizeof(v)); }
+    size_t putBytes(const char* key, const void* value, size_t len) { return put(key, value, len); }
+
+    int32_t getInt(const char* key, int32_t def = 0) { return get(key, def); }
+    uint32_t getUInt(const char* key, uint32_t def = 0) { return get(key, def); }
+    uint64_t getULong64(const char* key, uint64_t def = 0) { return get(key, def); }
+
+    size_t getBytesLength(const char* key) {
+        auto it = HostShim::nvsStore().find(path(key));
+        return it == HostShim::nvsStore().end() ? 0 : it->second.size();
+    }
+    size_t getBytes(const char* key, void* buf, size_t maxLen) {
+        auto it = HostShim::nvsStore().find(path(key));
+        if (it == HostShim::nvsStore().end() || it->second.size() > maxLen) return 0;
+        memcpy(buf, it->second.data(), it->second.size());
+        return it->second.size();
+    }
+
+private:
+    std::string _ns;
+    bool _readOnly = false;
+
+    std::string path(const char* key) const { return _ns + "/" + key; }
+
+    size_t put(const char* key, const void* value, size_t len) {
+        if (_readOnly) return 0;
+        const uint8_t* p = static_cast<const uint8_t*>(value);
+        HostShim::nvsStore()[path(key)].assign(p, p + len);
+        HostShim::nvsStats().writes++;
+        HostShim::nvsStats().bytes += len;
+        return len;
+    }
+
+    template <typename T>
+    T get(const char* key, T def) {
+        auto it = HostShim::nvsStore().find(path(key));
+        if (it == HostShim::nvsStore().end() || it->second.size() != sizeof(T)) return def;
+        T v;
+        memcpy(&v, it->second.data(), sizeof(T));
+        return v;
+    }
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef HOST_SHIM_ZIGBEE_H
+#define HOST_SHIM_ZIGBEE_H
+
+// Host stand-in for the Arduino Zigbee library: only the ZigbeeEP base class.
+
+#include "esp_zigbee_core.h"
+
+class ZigbeeEP {
+public:
+    explicit ZigbeeEP(uint8_t endpoint = 10) : _endpoint(endpoint) {}
+    virtual ~ZigbeeEP() {}
+
+    uint8_t getEndpoint() const { return _endpoint; }
+
+    // Registers attribute types so esp_zb_zcl_set_attribute_val() knows value sizes.
+    void registerAttributes() {
+        if (!_cluster_list) return;
+        for (auto& c : _cluster_list->clusters) {
+            for (auto& a : c.first->attrs) {
+                HostZigbee::attributeTypes()[std::make_tuple(_endpoint, c.first->cluster_id, std::get<0>(a))] = std::get<1>(a);
+            }
+        }
+    }
+
+    bool setManufacturerAndModel(const char*, const char*) { return true; }
+
+protected:
+    uint8_t _endpoint;
+    esp_zb_ha_standard_devices_t _device_id = 0;
+    esp_zb_cluster_list_t* _cluster_list = nullptr;
+    esp_zb_endpoint_config_t _ep_config = {};
+};
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef HOST_SHIM_DRIVER_UART_H
+#define HOST_SHIM_DRIVER_UART_H
+
+// ESP-IDF UART driver for the host build.
+//
+// A port only exists once a simulated line (any Stream, e.g. a Sim bus) is
+// attached with HostUart::attach(); otherwise uart_driver_install() fails and
+// callers take their fallback path. Bytes the line delivers go into the
+// driver's RX ring; the event queue posts UART_DATA with timeout_flag once
+// the line has been idle for the configured RX timeout (in byte times), or
+// without it when the RX FIFO full threshold is reached, like the peripheral.
+// Waiting on the queue advances the virtual clock.
+
+#include <Arduino.h>
+#include <algorithm>
+#include <deque>
+
+#include "esp_err.h"
+#include "freertos/queue.h"
+
+typedef int uart_port_t;
+#define UART_NUM_0 0
+#define UART_NUM_1 1
+#define UART_NUM_MAX 2
+#define UART_PIN_NO_CHANGE (-1)
+
+typedef enum { UART_DATA_5_BITS, UART_DATA_6_BITS, UART_DATA_7_BITS, UART_DATA_8_BITS } uart_word_length_t;
+typedef enum { UART_PARITY_DISABLE, UART_PARITY_EVEN = 2, UART_PARITY_ODD } uart_parity_t;
+typedef enum { UART_STOP_BITS_1 = 1, UART_STOP_BITS_1_5, UART_STOP_BITS_2 } uart_stop_bits_t;
+typedef enum { UART_HW_FLOWCTRL_DISABLE } uart_hw_flowcontrol_t;
+typedef enum { UART_SCLK_DEFAULT } uart_sclk_t;
+typedef enum { UART_MODE_UART, UART_MODE_RS485_HALF_DUPLEX } uart_mode_t;
+
+typedef struct {
+    int baud_rate;
+    uart_word_length_t data_bits;
+    uart_parity_t parity;
+    uart_stop_bits_t stop_bits;
+    uart_hw_flowcontrol_t flow_ctrl;
+    uint8_t rx_flow_ctrl_thresh;
+    uart_sclk_t source_clk;
+} uart_config_t;
+
+typedef enum {
+    UART_DATA,
+    UART_BREAK,
+    UART_BUFFER_FULL,
+    UART_FIFO_OVF,
+    UART_FRAME_ERR,
+    UART_PARITY_ERR,
+} uart_event_type_t;
+
+typedef struct {
+    uart_event_type_t type;
+    size_t size;
+    bool timeout_flag;
+} uart_event_t;
+
+namespace HostUart {
+
+struct Port : HostQueue {
+    Stream* wire = nullptr;
+    bool installed = false;
+    size_t rxBufferSize = 0;
+    int baud = 115200;
+    int rtsPin = UART_PIN_NO_CHANGE;
+    uart_mode_t mode = UART_MODE_UART;
+    uint8_t rxTimeoutSymbols = 11;
+    size_t rxFullThreshold = 120;
+    std::deque<uint8_t> ring;
+    size_t unreported = 0;     // Bytes in since the last UART_DATA event
+    uint64_t lastRxUs = 0;
+    bool overflow = false;
+
+    // Calls from the code under test
+    uint32_t readCalls = 0;
+    uint32_t writeCalls = 0;
+    uint32_t events = 0;
+
+    uint32_t byteUs() const { return 10000000u / (uint32_t)baud; }
+
+    // Moves what the line has delivered into the RX ring.
+    void pump() {
+        while (wire && wire->available() > 0) {
+            int c = wire->read();
+            if (c < 0) break;
+            if (ring.size() >= rxBufferSize) {
+                overflow = true;
+                continue;
+            }
+            ring.push_back((uint8_t)c);
+            unreported++;
+            lastRxUs = HostShim::clockUs();
+        }
+    }
+
+    BaseType_t receive(void* item, TickType_t ticks) override {
+        uart_event_t* ev = static_cast<uart_event_t*>(item);
+        uint64_t deadline = ticks == portMAX_DELAY ? UINT64_MAX : HostShim::clockUs() + (uint64_t)ticks * 1000;
+        for (;;) {
+            pump();
+            *ev = uart_event_t{};
+            if (overflow) {
+                overflow = false;
+                ev->type = UART_BUFFER_FULL;
+            } else if (unreported >= rxFullThreshold) {
+                ev->type = UART_DATA;
+                ev->size = unreported;
+            } else if (unreported > 0 && HostShim::clockUs() - lastRxUs >= (uint64_t)rxTimeoutSymbols * byteUs()) {
+                ev->type = UART_DATA;
+                ev->size = unreported;
+                ev->timeout_flag = true;
+            } else {
+                uint64_t now = HostShim::clockUs();
+                if (now >= deadline) return pdFALSE;
+                HostShim::advanceMicros(std::min<uint64_t>(100, deadline - now));
+                continue;
+            }
+            unreported = 0;
+            events++;
+            return pdTRUE;
+        }
+    }
+
+    void reset() override { unreported = 0; }
+};
+
+inline Port& port(uart_port_t p) {
+    static Port ports[UART_NUM_MAX];
+    return ports[p];
+}
+
+// Connects a simulated line to UART `p` (nullptr detaches it).
+inline void attach(uart_port_t p, Stream* wire) {
+    port(p) = Port();
+    port(p).wire = wire;
+}
+
+} // namespace HostUart
+
+inline esp_err_t uart_driver_install(uart_port_t p, int rxBufferSize, int, int, QueueHandle_t* queue, int) {
+    HostUart::Port& u = HostUart::port(p);
+    if (!u.wire || u.installed) return ESP_FAIL;
+    u.installed = true;
+    u.rxBufferSize = rxBufferSize;
+    if (queue) *queue = &u;
+    return ESP_OK;
+}
+
+inline esp_err_t uart_driver_delete(uart_port_t p) {
+    HostUart::port(p).installed = false;
+    return ESP_OK;
+}
+
+inline esp_err_t uart_param_config(uart_port_t p, const uart_config_t* cfg) {
+    HostUart::port(p).baud = cfg->baud_rate;
+    return ESP_OK;
+}
+
+inline esp_err_t uart_set_pin(uart_port_t p, int, int, int rts, int) {
+    HostUart::port(p).rtsPin = rts;
+    return ESP_OK;
+}
+
+inline esp_err_t uart_set_mode(uart_port_t p, uart_mode_t mode) {
+    HostUart::port(p).mode = mode;
+    return ESP_OK;
+}
+
+inline esp_err_t uart_set_rx_timeout(uart_port_t p, uint8_t symbols) {
+    HostUart::port(p).rxTimeoutSymbols = symbols;
+    return ESP_OK;
+}
+
+inline esp_err_t uart_set_rx_full_threshold(uart_port_t p, int threshold) {
+    HostUart::port(p).rxFullThreshold = threshold;
+    return ESP_OK;
+}
+
+inline int uart_write_bytes(uart_port_t p, const void* src, size_t size) {
+    HostUart::Port& u = HostUart::port(p);
+    u.writeCalls++;
+    return (int)u.wire->write(static_cast<const uint8_t*>(src), size);
+}
+
+inline esp_err_t uart_wait_tx_done(uart_port_t, TickType_t) { return ESP_OK; } // The line sims block in write()
+
+inline int uart_read_bytes(uart_port_t p, void* buf, uint32_t length, TickType_t) {
+    HostUart::Port& u = HostUart::port(p);
+    u.pump();
+    u.readCalls++;
+    size_t n = std::min<size_t>(length, u.ring.size());
+    std::copy(u.ring.begin(), u.ring.begin() + n, static_cast<uint8_t*>(buf));
+    u.ring.erase(u.ring.begin(), u.ring.begin() + n);
+    return (int)n;
+}
+
+inline esp_err_t uart_get_buffered_data_len(uart_port_t p, size_t* size) {
+    HostUart::Port& u = HostUart::port(p);
+    u.pump();
+    *size = u.ring.size();
+    return ESP_OK;
+}
+
+inline esp_err_t uart_flush_input(uart_port_t p) {
+    HostUart::Port& u = HostUart::port(p);
+    u.pump();
+    u.ring.clear();
+    u.unreported = 0;
+    return ESP_OK;
+}
+
+#endif
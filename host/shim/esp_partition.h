@@ -0,0 +1,39 @@
+#ifndef HOST_SHIM_ESP_PARTITION_H
+#define HOST_SHIM_ESP_PARTITION_H
+
+// ESP-IDF partition API declarations for the host build. There is no SPI
+// flash, so lookups find nothing; host code uses Sim::FileFlash instead.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "esp_err.h"
+
+#define SPI_FLASH_SEC_SIZE 4096
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01,
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_DATA_SPIFFS = 0x82,
+    ESP_PARTITION_SUBTYPE_ANY = 0xff,
+} esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+} esp_partition_t;
+
+inline const esp_partition_t* esp_partition_find_first(esp_partition_type_t, esp_partition_subtype_t, const char*) {
+    return nullptr;
+}
+inline esp_err_t esp_partition_read(const esp_partition_t*, size_t, void*, size_t) { return ESP_ERR_NOT_SUPPORTED; }
+inline esp_err_t esp_partition_write(const esp_partition_t*, size_t, const void*, size_t) { return ESP_ERR_NOT_SUPPORTED; }
+inline esp_err_t esp_partition_erase_range(const esp_partition_t*, size_t, size_t) { return ESP_ERR_NOT_SUPPORTED; }
+
+#endif
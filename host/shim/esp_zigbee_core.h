@@ -0,0 +1,258 @@
+#ifndef HOST_SHIM_ESP_ZIGBEE_CORE_H
+#define HOST_SHIM_ESP_ZIGBEE_CORE_H
+
+// Subset of the esp-zigbee-sdk API used by main/, backed by an in-memory
+// attribute table. Every report command and stack lock is recorded so host
+// code can count radio frames and lock traffic.
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#define ESP_ZB_ZCL_CLUSTER_ID_BASIC 0x0000
+#define ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG 0x0001
+#define ESP_ZB_ZCL_CLUSTER_ID_METERING 0x0702
+
+#define ESP_ZB_ZCL_CLUSTER_SERVER_ROLE 0x01
+#define ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE 0x02
+
+#define ESP_ZB_ZCL_ATTR_TYPE_8BITMAP 0x18
+#define ESP_ZB_ZCL_ATTR_TYPE_U8 0x20
+#define ESP_ZB_ZCL_ATTR_TYPE_U16 0x21
+#define ESP_ZB_ZCL_ATTR_TYPE_U24 0x22
+#define ESP_ZB_ZCL_ATTR_TYPE_U32 0x23
+#define ESP_ZB_ZCL_ATTR_TYPE_U48 0x25
+#define ESP_ZB_ZCL_ATTR_TYPE_S16 0x29
+#define ESP_ZB_ZCL_ATTR_TYPE_S32 0x2B
+#define ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING 0x41
+
+#define ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY 0x01
+#define ESP_ZB_ZCL_ATTR_ACCESS_WRITE_ONLY 0x02
+#define ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE 0x03
+#define ESP_ZB_ZCL_ATTR_ACCESS_REPORTING 0x04
+
+#define ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT 0x02
+#define ESP_ZB_ZCL_CMD_DIRECTION_TO_SRV 0x00
+#define ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI 0x01
+
+#define ESP_ZB_AF_HA_PROFILE_ID 0x0104
+#define ESP_ZB_HA_METER_INTERFACE_DEVICE_ID 0x0053
+
+typedef uint16_t esp_zb_ha_standard_devices_t;
+typedef uint8_t esp_zb_ieee_addr_t[8];
+
+struct esp_zb_attribute_list_t {
+    uint16_t cluster_id;
+    std::vector<std::tuple<uint16_t, uint8_t, uint8_t>> attrs; // id, type, access
+};
+
+struct esp_zb_cluster_list_t {
+    std::vector<std::pair<esp_zb_attribute_list_t*, uint8_t>> clusters;
+};
+
+typedef struct {
+    uint8_t zcl_version;
+    uint8_t power_source;
+} esp_zb_basic_cluster_cfg_t;
+
+typedef struct {
+    uint8_t endpoint;
+    uint16_t app_profile_id;
+    uint16_t app_device_id;
+    uint32_t app_device_version;
+} esp_zb_endpoint_config_t;
+
+typedef struct {
+    uint8_t type;
+    uint16_t size;
+    void* value;
+} esp_zb_zcl_attribute_data_t;
+
+typedef struct {
+    uint16_t id;
+    esp_zb_zcl_attribute_data_t data;
+} esp_zb_zcl_attribute_t;
+
+typedef struct {
+    int status;
+    uint8_t dst_endpoint;
+    uint16_t cluster;
+} esp_zb_device_cb_common_info_t;
+
+typedef struct {
+    esp_zb_device_cb_common_info_t info;
+    esp_zb_zcl_attribute_t attribute;
+} esp_zb_zcl_set_attr_value_message_t;
+
+typedef union {
+    uint16_t addr_short;
+    esp_zb_ieee_addr_t addr_long;
+} esp_zb_addr_u;
+
+typedef struct {
+    esp_zb_addr_u dst_addr_u;
+    uint8_t dst_endpoint;
+    uint8_t src_endpoint;
+} esp_zb_zcl_basic_cmd_t;
+
+typedef struct {
+    esp_zb_zcl_basic_cmd_t zcl_basic_cmd;
+    uint8_t address_mode;
+    uint16_t clusterID;
+    uint16_t attributeID;
+    uint8_t direction;
+} esp_zb_zcl_report_attr_cmd_t;
+
+typedef struct {
+    uint8_t dst_addr_mode;
+    esp_zb_addr_u dst_addr;
+    uint8_t dst_endpoint;
+    uint16_t profile_id;
+    uint16_t cluster_id;
+    uint8_t src_endpoint;
+    uint32_t asdu_length;
+    uint8_t* asdu;
+    uint8_t tx_options;
+    bool use_alias;
+    uint16_t alias_src_addr;
+    int alias_seq_num;
+    uint8_t radius;
+} esp_zb_apsde_data_req_t;
+
+namespace HostZigbee {
+
+struct ReportRecord {
+    uint8_t endpoint;
+    uint16_t cluster;
+    uint16_t attr;
+};
+
+// Raw APS frame (ZCL header + payload) as handed to esp_zb_aps_data_request().
+struct ApsFrame {
+    uint8_t endpoint;
+    uint16_t cluster;
+    std::vector<uint8_t> asdu;
+    uint16_t dstAddr;
+    uint8_t dstEndpoint;
+};
+
+struct Stats {
+    uint32_t lockAcquires = 0;
+    uint32_t attrWrites = 0;
+    std::vector<ReportRecord> reports;
+    std::vector<ApsFrame> apsFrames;
+
+    // Radio frames: single-attribute reports plus raw APS frames.
+    size_t frames() const { return reports.size() + apsFrames.size(); }
+};
+
+// Result of the next esp_zb_aps_data_request() calls (tests force failures).
+inline esp_err_t& apsResult() {
+    static esp_err_t result = ESP_OK;
+    return result;
+}
+
+inline Stats& stats() {
+    static Stats s;
+    return s;
+}
+
+inline std::map<std::tuple<uint8_t, uint16_t, uint16_t>, std::vector<uint8_t>>& attributes() {
+    static std::map<std::tuple<uint8_t, uint16_t, uint16_t>, std::vector<uint8_t>> table;
+    return table;
+}
+
+inline size_t attrTypeSize(uint8_t type) {
+    switch (type) {
+        case ESP_ZB_ZCL_ATTR_TYPE_8BITMAP:
+        case ESP_ZB_ZCL_ATTR_TYPE_U8: return 1;
+        case ESP_ZB_ZCL_ATTR_TYPE_U16:
+        case ESP_ZB_ZCL_ATTR_TYPE_S16: return 2;
+        case ESP_ZB_ZCL_ATTR_TYPE_U24: return 3;
+        case ESP_ZB_ZCL_ATTR_TYPE_U32:
+        case ESP_ZB_ZCL_ATTR_TYPE_S32: return 4;
+        case ESP_ZB_ZCL_ATTR_TYPE_U48: return 6;
+        default: return 0;
+    }
+}
+
+inline std::map<std::tuple<uint8_t, uint16_t, uint16_t>, uint8_t>& attributeTypes() {
+    static std::map<std::tuple<uint8_t, uint16_t, uint16_t>, uint8_t> types;
+    return types;
+}
+
+} // namespace HostZigbee
+
+inline esp_zb_cluster_list_t* esp_zb_zcl_cluster_list_create() { return new esp_zb_cluster_list_t(); }
+
+inline esp_zb_attribute_list_t* esp_zb_zcl_attr_list_create(uint16_t cluster_id) {
+    esp_zb_attribute_list_t* list = new esp_zb_attribute_list_t();
+    list->cluster_id = cluster_id;
+    return list;
+}
+
+inline esp_zb_attribute_list_t* esp_zb_basic_cluster_create(esp_zb_basic_cluster_cfg_t*) {
+    return esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_BASIC);
+}
+
+inline esp_err_t esp_zb_cluster_add_attr(esp_zb_attribute_list_t* list, uint16_t, uint16_t attr_id,
+                                         uint8_t type, uint8_t access, void*) {
+    list->attrs.emplace_back(attr_id, type, access);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_zb_cluster_list_add_basic_cluster(esp_zb_cluster_list_t* l, esp_zb_attribute_list_t* a, uint8_t role) {
+    l->clusters.emplace_back(a, role);
+    return ESP_OK;
+}
+inline esp_err_t esp_zb_cluster_list_add_power_config_cluster(esp_zb_cluster_list_t* l, esp_zb_attribute_list_t* a, uint8_t role) {
+    l->clusters.emplace_back(a, role);
+    return ESP_OK;
+}
+inline esp_err_t esp_zb_cluster_list_add_metering_cluster(esp_zb_cluster_list_t* l, esp_zb_attribute_list_t* a, uint8_t role) {
+    l->clusters.emplace_back(a, role);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_zb_cluster_list_add_custom_cluster(esp_zb_cluster_list_t* l, esp_zb_attribute_list_t* a, uint8_t role) {
+    l->clusters.emplace_back(a, role);
+    return ESP_OK;
+}
+
+inline bool esp_zb_lock_acquire(TickType_t) {
+    HostZigbee::stats().lockAcquires++;
+    return true;
+}
+inline void esp_zb_lock_release() {}
+
+inline int esp_zb_zcl_set_attribute_val(uint8_t endpoint, uint16_t cluster_id, uint8_t, uint16_t attr_id,
+                                        void* value, bool) {
+    auto key = std::make_tuple(endpoint, cluster_id, attr_id);
+    auto t = HostZigbee::attributeTypes().find(key);
+    size_t size = t != HostZigbee::attributeTypes().end() ? HostZigbee::attrTypeSize(t->second) : 6;
+    const uint8_t* p = static_cast<const uint8_t*>(value);
+    if (t != HostZigbee::attributeTypes().end() && t->second == ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING) size = 1 + p[0];
+    HostZigbee::attributes()[key].assign(p, p + size);
+    HostZigbee::stats().attrWrites++;
+    return 0;
+}
+
+inline esp_err_t esp_zb_zcl_report_attr_cmd_req(esp_zb_zcl_report_attr_cmd_t* cmd) {
+    HostZigbee::stats().reports.push_back({cmd->zcl_basic_cmd.src_endpoint, cmd->clusterID, cmd->attributeID});
+    return ESP_OK;
+}
+
+inline esp_err_t esp_zb_aps_data_request(esp_zb_apsde_data_req_t* req) {
+    if (HostZigbee::apsResult() != ESP_OK) return HostZigbee::apsResult();
+    HostZigbee::stats().apsFrames.push_back({req->src_endpoint, req->cluster_id,
+                                             std::vector<uint8_t>(req->asdu, req->asdu + req->asdu_length),
+                                             req->dst_addr.addr_short, req->dst_endpoint});
+    return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef HOST_SHIM_FREERTOS_H
+#define HOST_SHIM_FREERTOS_H
+
+// FreeRTOS port macros used by main/, mapped onto a std::mutex for the host build.
+
+#include <cstdint>
+#include <mutex>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+
+struct portMUX_TYPE {
+    std::recursive_mutex m;
+};
+
+#define portMUX_INITIALIZER_UNLOCKED {}
+
+#define portENTER_CRITICAL(mux) (mux)->m.lock()
+#define portEXIT_CRITICAL(mux) (mux)->m.unlock()
+#define portENTER_CRITICAL_ISR(mux) (mux)->m.lock()
+#define portEXIT_CRITICAL_ISR(mux) (mux)->m.unlock()
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef HOST_SHIM_FREERTOS_QUEUE_H
+#define HOST_SHIM_FREERTOS_QUEUE_H
+
+// FreeRTOS queue calls used by main/. A host queue is whatever object backs
+// it (see driver/uart.h); blocking waits run on the virtual clock.
+
+#include "FreeRTOS.h"
+
+struct HostQueue {
+    virtual ~HostQueue() {}
+    virtual BaseType_t receive(void* item, TickType_t ticks) = 0;
+    virtual void reset() = 0;
+};
+
+typedef HostQueue* QueueHandle_t;
+
+inline BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t ticks) { return q->receive(item, ticks); }
+inline BaseType_t xQueueReset(QueueHandle_t q) {
+    q->reset();
+    return pdPASS;
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef HOST_SHIM_FREERTOS_SEMPHR_H
+#define HOST_SHIM_FREERTOS_SEMPHR_H
+
+// FreeRTOS recursive mutex used by main/, on top of std::recursive_mutex.
+// Only waits without a timeout are used, so the tick count is ignored.
+
+#include <mutex>
+
+#include "FreeRTOS.h"
+
+struct StaticSemaphore_t {
+    std::recursive_mutex m;
+};
+
+typedef StaticSemaphore_t* SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutexStatic(StaticSemaphore_t* buf) { return buf; }
+
+inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t s, TickType_t) {
+    s->m.lock();
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t s) {
+    s->m.unlock();
+    return pdTRUE;
+}
+
+#endif
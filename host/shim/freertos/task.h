@@ -0,0 +1,77 @@
+#ifndef HOST_SHIM_FREERTOS_TASK_H
+#define HOST_SHIM_FREERTOS_TASK_H
+
+// FreeRTOS task and direct-to-task notification API on top of std::thread.
+// Notification waits use real time; the virtual millis() clock is not thread safe,
+// so host benchmarks drive task bodies synchronously instead of starting tasks.
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "freertos/FreeRTOS.h"
+
+struct HostTask {
+    std::mutex m;
+    std::condition_variable cv;
+    uint32_t notifications = 0;
+};
+
+typedef HostTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+inline HostTask*& hostCurrentTask() {
+    static thread_local HostTask* current = nullptr;
+    return current;
+}
+
+// Threads that never went through xTaskCreate (main, test bodies) get a task on first use.
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+    HostTask*& t = hostCurrentTask();
+    if (!t) t = new HostTask();
+    return t;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t fn, const char*, uint32_t, void* arg, UBaseType_t, TaskHandle_t* out) {
+    HostTask* t = new HostTask();
+    if (out) *out = t;
+    std::thread([fn, arg, t] {
+        hostCurrentTask() = t;
+        fn(arg);
+    }).detach();
+    return pdPASS;
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t t) {
+    if (!t) return pdFALSE;
+    {
+        std::lock_guard<std::mutex> lock(t->m);
+        t->notifications++;
+    }
+    t->cv.notify_one();
+    return pdPASS;
+}
+
+inline void vTaskNotifyGiveFromISR(TaskHandle_t t, BaseType_t* woken) {
+    xTaskNotifyGive(t);
+    if (woken) *woken = pdFALSE;
+}
+
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    HostTask* t = hostCurrentTask();
+    if (!t) return 0;
+    std::unique_lock<std::mutex> lock(t->m);
+    auto ready = [t] { return t->notifications > 0; };
+    if (ticks == portMAX_DELAY) t->cv.wait(lock, ready);
+    else t->cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+    uint32_t n = t->notifications;
+    if (n) t->notifications = clearOnExit ? 0 : n - 1;
+    return n;
+}
+
+inline void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(std::chrono::milliseconds(ticks)); }
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef SIM_CONSUMPTION_TRACE_H
+#define SIM_CONSUMPTION_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Sim {
+
+// One draw of water: `liters` spread evenly over `minutes` from `start`
+// (minute of the day).
+struct Draw {
+    uint16_t start;
+    uint16_t minutes;
+    uint16_t liters;
+};
+
+// A day of consumption on one meter, replayed in a loop.
+struct ConsumptionTrace {
+    const char* name;
+    const Draw* draws;
+    size_t count;
+
+    // Liters drawn during minute `m` of the day (integer, remainder on the last minute).
+    uint32_t litersInMinute(uint32_t m) const {
+        uint32_t total = 0;
+        for (size_t i = 0; i < count; i++) {
+            const Draw& d = draws[i];
+            if (m < d.start || m >= (uint32_t)d.start + d.minutes) continue;
+            uint32_t per = d.liters / d.minutes;
+            total += m + 1 == (uint32_t)d.start + d.minutes ? d.liters - per * (d.minutes - 1) : per;
+        }
+        return total;
+    }
+
+    uint32_t litersPerDay() const {
+        uint32_t total = 0;
+        for (size_t i = 0; i < count; i++) total += draws[i].liters;
+        return total;
+    }
+};
+
+// Typical cold-water day of a two-person flat (~330 L): morning and
+// evening peaks, one flush at night.
+constexpr Draw kFamilyDraws[] = {
+    { 3 * 60 + 10, 1, 6 },     // Toilet
+    { 6 * 60 + 45, 8, 72 },    // Shower
+    { 7 * 60 + 0, 1, 6 },
+    { 7 * 60 + 10, 2, 2 },     // Kettle, sink
+    { 7 * 60 + 20, 1, 6 },
+    { 8 * 60 + 0, 2, 3 },
+    { 12 * 60 + 30, 1, 6 },
+    { 18 * 60 + 30, 5, 10 },   // Cooking
+    { 19 * 60 + 0, 2, 4 },     // Dishwasher fills
+    { 19 * 60 + 15, 1, 6 },
+    { 19 * 60 + 30, 2, 4 },
+    { 20 * 60 + 0, 3, 15 },    // Washing machine fills
+    { 20 * 60 + 10, 2, 4 },
+    { 20 * 60 + 25, 3, 12 },
+    { 20 * 60 + 50, 3, 12 },
+    { 21 * 60 + 15, 3, 11 },
+    { 21 * 60 + 30, 12, 120 }, // Bath
+    { 22 * 60 + 30, 1, 6 },
+    { 23 * 60 + 5, 1, 2 },
+};
+constexpr ConsumptionTrace kFamily = { "family", kFamilyDraws, sizeof(kFamilyDraws) / sizeof(kFamilyDraws[0]) };
+
+// Flat left alone for the holidays: the meter does not move.
+constexpr ConsumptionTrace kVacant = { "vacant", nullptr, 0 };
+
+// Dripping cistern, 1 L every 20 minutes around the clock: the worst case
+// for an adaptive interval, since every poll sees a change.
+struct LeakDraws {
+    Draw d[72];
+    constexpr LeakDraws() : d() {
+        for (uint16_t i = 0; i < 72; i++) d[i] = { (uint16_t)(i * 20), 1, 1 };
+    }
+};
+constexpr LeakDraws kLeakDraws;
+constexpr ConsumptionTrace kLeak = { "leak", kLeakDraws.d, 72 };
+
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef HOST_SIM_FILE_FLASH_H
+#define HOST_SIM_FILE_FLASH_H
+
+// File-backed NOR flash for host tests.
+//
+// Behaves like the SPI flash partition: a fresh file reads as erased (0xFF),
+// writes can only clear bits (the stored byte is ANDed with the new one) and
+// erase works on whole sectors. Writes that try to set a bit are counted as
+// violations. A write can be cut short to model a power loss mid-record; the
+// file survives, so a second FlashRegion over the same path is a "reboot".
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "storage/flash_region.h"
+
+namespace Sim {
+
+class FileFlash : public FlashRegion {
+public:
+    FileFlash(const std::string& path, size_t size, size_t sectorSize = 4096)
+        : _path(path), _size(size), _sectorSize(sectorSize), _erases(size / sectorSize, 0) {}
+
+    ~FileFlash() override {
+        if (_f) fclose(_f);
+    }
+
+    bool begin() override {
+        _f = fopen(_path.c_str(), "r+b");
+        if (!_f) {
+            _f = fopen(_path.c_str(), "w+b");
+            if (!_f) return false;
+            std::vector<uint8_t> blank(_sectorSize, 0xFF);
+            for (size_t i = 0; i < sectorCount(); i++) fwrite(blank.data(), 1, blank.size(), _f);
+            fflush(_f);
+        }
+        return true;
+    }
+
+    size_t size() const override { return _size; }
+    size_t sectorSize() const override { return _sectorSize; }
+
+    bool read(size_t offset, void* dst, size_t len) override {
+        if (!_f || offset + len > _size) return false;
+        fseek(_f, (long)offset, SEEK_SET);
+        return fread(dst, 1, len, _f) == len;
+    }
+
+    bool write(size_t offset, const void* src, size_t len) override {
+        if (!_f || offset + len > _size) return false;
+        bool torn = false;
+        if (_bytesUntilPowerLoss >= 0) {
+            if ((size_t)_bytesUntilPowerLoss < len) {
+                len = (size_t)_bytesUntilPowerLoss;
+                torn = true;
+            }
+            _bytesUntilPowerLoss -= (long)len;
+        }
+        const uint8_t* p = static_cast<const uint8_t*>(src);
+        for (size_t done = 0; done < len;) {
+            uint8_t cur[64];
+            size_t n = len - done < sizeof(cur) ? len - done : sizeof(cur);
+            read(offset + done, cur, n);
+            for (size_t i = 0; i < n; i++) {
+                if (p[done + i] & ~cur[i]) _violations++;
+                cur[i] &= p[done + i];
+            }
+            fseek(_f, (long)(offset + done), SEEK_SET);
+            fwrite(cur, 1, n, _f);
+            done += n;
+        }
+        fflush(_f);
+        _bytesWritten += len;
+        return !torn;
+    }
+
+    bool eraseSector(size_t index) override {
+        if (!_f || index >= sectorCount()) return false;
+        if (_bytesUntilPowerLoss == 0) return false;
+        std::vector<uint8_t> blank(_sectorSize, 0xFF);
+        fseek(_f, (long)(index * _sectorSize), SEEK_SET);
+        fwrite(blank.data(), 1, blank.size(), _f);
+        fflush(_f);
+        _erases[index]++;
+        return true;
+    }
+
+    // Writes stop (silently truncated, then failing) after this many more bytes.
+    void powerLossAfter(long bytes) { _bytesUntilPowerLoss = bytes; }
+
+    uint32_t erases(size_t sector) const { return _erases[sector]; }
+    uint32_t violations() const { return _violations; }
+    uint64_t bytesWritten() const { return _bytesWritten; }
+
+private:
+    std::string _path;
+    size_t _size;
+    size_t _sectorSize;
+    std::FILE* _f = nullptr;
+
+    std::vector<uint32_t> _erases;
+    uint32_t _violations = 0;
+    uint64_t _bytesWritten = 0;
+    long _bytesUntilPowerLoss = -1;
+};
+
+} // namespace Sim
+
+#endif
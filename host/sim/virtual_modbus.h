@@ -0,0 +1,185 @@
+#ifndef HOST_SIM_VIRTUAL_MODBUS_H
+#define HOST_SIM_VIRTUAL_MODBUS_H
+
+// In-process simulation of Modbus RTU slaves sharing one RS485 line.
+//
+// Same timing model as VirtualPulsarBus: a request is decoded when the
+// driver writes it, the reply is queued with per-byte arrival times on the
+// virtual clock (response latency + 9600 8N1 wire time). Slaves answer
+// Read Holding Registers (0x03) and Read Input Registers (0x04); a read
+// that touches a register the slave does not have gets exception 02 unless
+// the slave is set to return zeros for holes.
+
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+namespace Sim {
+
+struct ModbusSlaveState {
+    uint8_t id = 0;
+    bool zeroFillHoles = false;                // Answer unmapped registers with 0 instead of exception 02
+    std::map<uint16_t, uint16_t> holding;      // 0x03
+    std::map<uint16_t, uint16_t> input;        // 0x04
+
+    std::map<uint16_t, uint16_t>& bank(uint8_t function) { return function == 0x04 ? input : holding; }
+
+    void setU16(uint8_t function, uint16_t address, uint16_t v) { bank(function)[address] = v; }
+
+    void setU32(uint8_t function, uint16_t address, uint32_t v, bool highFirst = true) {
+        bank(function)[address] = highFirst ? v >> 16 : v & 0xFFFF;
+        bank(function)[address + 1] = highFirst ? v & 0xFFFF : v >> 16;
+    }
+
+    void setFloat(uint8_t function, uint16_t address, float f, bool highFirst = true) {
+        uint32_t v;
+        memcpy(&v, &f, 4);
+        setU32(function, address, v, highFirst);
+    }
+};
+
+class VirtualModbusBus : public Stream {
+public:
+    static constexpr uint32_t kByteTimeUs = 1042; // 10 bits at 9600 baud
+
+    struct Stats {
+        uint32_t requests = 0;     // Well-formed requests to a present slave
+        uint32_t replies = 0;
+        uint32_t exceptions = 0;
+        uint32_t wordsRead = 0;
+        uint32_t txBytes = 0;
+        uint32_t rxBytes = 0;
+    };
+
+    ModbusSlaveState& addSlave(uint8_t id) {
+        _slaves.push_back(ModbusSlaveState{});
+        _slaves.back().id = id;
+        return _slaves.back();
+    }
+
+    ModbusSlaveState* slave(uint8_t id) {
+        for (auto& s : _slaves) if (s.id == id) return &s;
+        return nullptr;
+    }
+
+    // Time between the end of the request and the first reply byte.
+    void setResponseLatencyUs(uint32_t us) { _latencyUs = us; }
+
+    const Stats& stats() const { return _stats; }
+    void resetStats() { _stats = Stats{}; }
+
+    size_t write(uint8_t b) override { return write(&b, 1); }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        HostShim::advanceMicros((uint64_t)size * kByteTimeUs);
+        _stats.txBytes += size;
+        handleRequest(buffer, size);
+        return size;
+    }
+
+    int available() override {
+        uint64_t now = HostShim::clockUs();
+        int n = 0;
+        for (uint32_t i = _rxHead; i != _rxTail && _rx[i % kRxCapacity].readyUs <= now; i++) n++;
+        return n;
+    }
+
+    int read() override {
+        if (!rxReady()) {
+            uint64_t step = 100;
+            if (_rxHead != _rxTail) step = std::min<uint64_t>(step, _rx[_rxHead % kRxCapacity].readyUs - HostShim::clockUs());
+            HostShim::advanceMicros(step);
+            return -1;
+        }
+        uint8_t b = _rx[_rxHead++ % kRxCapacity].value;
+        _stats.rxBytes++;
+        return b;
+    }
+
+    int peek() override { return rxReady() ? _rx[_rxHead % kRxCapacity].value : -1; }
+
+    void flush() override {}
+
+    static uint16_t crc16(const uint8_t* data, size_t len) {
+        uint16_t crc = 0xFFFF;
+        for (size_t pos = 0; pos < len; pos++) {
+            crc ^= data[pos];
+            for (int i = 0; i < 8; i++) crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+        return crc;
+    }
+
+private:
+    struct TimedByte {
+        uint8_t value;
+        uint64_t readyUs;
+    };
+
+    static constexpr uint32_t kRxCapacity = 512;
+    static constexpr uint16_t kMaxWords = 125;   // Modbus limit for 0x03/0x04
+
+    std::vector<ModbusSlaveState> _slaves;
+    TimedByte _rx[kRxCapacity];
+    uint32_t _rxHead = 0;
+    uint32_t _rxTail = 0;
+    uint32_t _latencyUs = 5000;
+    Stats _stats;
+
+    void handleRequest(const uint8_t* req, size_t len) {
+        if (len != 8) return;
+        if (crc16(req, 6) != (uint16_t)(req[6] | (req[7] << 8))) return;
+        ModbusSlaveState* s = slave(req[0]);
+        if (!s) return;
+        _stats.requests++;
+
+        uint8_t function = req[1];
+        uint16_t start = (uint16_t)(req[2] << 8 | req[3]);
+        uint16_t words = (uint16_t)(req[4] << 8 | req[5]);
+        if (function != 0x03 && function != 0x04) return exception(req, 0x01);
+        if (words == 0 || words > kMaxWords) return exception(req, 0x03);
+
+        uint8_t resp[3 + 2 * kMaxWords + 2];
+        size_t n = 0;
+        resp[n++] = req[0];
+        resp[n++] = function;
+        resp[n++] = (uint8_t)(2 * words);
+        const std::map<uint16_t, uint16_t>& bank = s->bank(function);
+        for (uint16_t a = start; a < start + words; a++) {
+            auto it = bank.find(a);
+            if (it == bank.end() && !s->zeroFillHoles) return exception(req, 0x02);
+            uint16_t v = it == bank.end() ? 0 : it->second;
+            resp[n++] = v >> 8;
+            resp[n++] = v & 0xFF;
+        }
+        _stats.wordsRead += words;
+        send(resp, n);
+        _stats.replies++;
+    }
+
+    void exception(const uint8_t* req, uint8_t code) {
+        uint8_t resp[5] = { req[0], (uint8_t)(req[1] | 0x80), code };
+        send(resp, 3);
+        _stats.exceptions++;
+    }
+
+    void send(uint8_t* resp, size_t n) {
+        uint16_t crc = crc16(resp, n);
+        resp[n++] = crc & 0xFF;
+        resp[n++] = crc >> 8;
+        enqueue(resp, n);
+    }
+
+    bool rxReady() const { return _rxHead != _rxTail && _rx[_rxHead % kRxCapacity].readyUs <= HostShim::clockUs(); }
+
+    void enqueue(const uint8_t* frame, size_t len) {
+        uint64_t t = HostShim::clockUs() + _latencyUs;
+        for (size_t i = 0; i < len && _rxTail - _rxHead < kRxCapacity; i++) {
+            t += kByteTimeUs;
+            _rx[_rxTail++ % kRxCapacity] = {frame[i], t};
+        }
+    }
+};
+
+} // namespace Sim
+
+#endif
@@ -0,0 +1,257 @@
+#ifndef HOST_SIM_VIRTUAL_PULSAR_H
+#define HOST_SIM_VIRTUAL_PULSAR_H
+
+// In-process simulation of Pulsar Du 15/20 meters sharing one RS485 line.
+//
+// Plugs into drivers as their Stream* transport. Requests are decoded when the
+// driver writes them; the reply is queued with per-byte arrival times on the
+// virtual clock (response latency + 9600 8N1 wire time), so a driver that
+// waits for more bytes than the meter sends burns virtual time exactly like
+// it would burn real time on the device.
+//
+// setFaults() makes the line misbehave the way field installations do:
+// meters that miss a request, bytes lost on the wire, bit errors, replies
+// from the wrong meter and another transmitter talking over a reply. Faults
+// are drawn from a seeded xorshift, so a run is reproducible.
+
+#include <Arduino.h>
+#include <algorithm>
+#include <vector>
+
+namespace Sim {
+
+struct PulsarMeterState {
+    uint32_t serial = 0;
+    float volumeM3 = 0;
+    float batteryV = 3.6f;
+    float thresholdMin = 3.0f;
+    float thresholdAlarm = 3.2f;
+};
+
+// Probabilities (0..1) of each fault; all off by default.
+struct PulsarFaults {
+    float noReply = 0;          // Per request: the meter does not answer
+    float byteLoss = 0;         // Per reply byte: lost on the wire (framing error, dropped by the UART)
+    float crcError = 0;         // Per reply: one bit flipped
+    float wrongAddress = 0;     // Per reply: answered with a neighbour's address (valid CRC)
+    float contention = 0;       // Per reply: another transmitter talks over part of it
+    uint32_t latencyJitterUs = 0; // Added to the response latency, uniform 0..jitter
+};
+
+class VirtualPulsarBus : public Stream {
+public:
+    static constexpr uint32_t kByteTimeUs = 1042; // 10 bits at 9600 baud
+
+    struct Stats {
+        uint32_t requests = 0;
+        uint32_t replies = 0;
+        uint32_t txBytes = 0;
+        uint32_t rxBytes = 0;
+        // Injected faults
+        uint32_t noReplies = 0;
+        uint32_t lostBytes = 0;
+        uint32_t corrupted = 0;
+        uint32_t wrongAddress = 0;
+        uint32_t collisions = 0;
+    };
+
+    PulsarMeterState& addMeter(uint32_t serial) {
+        _meters.push_back(PulsarMeterState{});
+        _meters.back().serial = serial;
+        return _meters.back();
+    }
+
+    PulsarMeterState* meter(uint32_t serial) {
+        for (auto& m : _meters) if (m.serial == serial) return &m;
+        return nullptr;
+    }
+
+    // Time between the end of the request and the first reply byte.
+    void setResponseLatencyUs(uint32_t us) { _latencyUs = us; }
+
+    void setFaults(const PulsarFaults& faults, uint32_t seed = 1) {
+        _faults = faults;
+        _rng = seed ? seed : 1;
+    }
+    void clearFaults() { _faults = PulsarFaults{}; }
+
+    const Stats& stats() const { return _stats; }
+    void resetStats() { _stats = Stats{}; }
+
+    size_t write(uint8_t b) override { return write(&b, 1); }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        // The driver's write() + flush() blocks for the TX wire time.
+        HostShim::advanceMicros((uint64_t)size * kByteTimeUs);
+        _stats.txBytes += size;
+        handleRequest(buffer, size);
+        return size;
+    }
+
+    int available() override {
+        uint64_t now = HostShim::clockUs();
+        int n = 0;
+        for (uint32_t i = _rxHead; i != _rxTail && _rx[i % kRxCapacity].readyUs <= now; i++) n++;
+        return n;
+    }
+
+    int read() override {
+        if (!rxReady()) {
+            // Nothing on the wire yet: let virtual time pass like a polling UART would.
+            uint64_t step = 100;
+            if (_rxHead != _rxTail) step = std::min<uint64_t>(step, _rx[_rxHead % kRxCapacity].readyUs - HostShim::clockUs());
+            HostShim::advanceMicros(step);
+            return -1;
+        }
+        uint8_t b = _rx[_rxHead++ % kRxCapacity].value;
+        _stats.rxBytes++;
+        return b;
+    }
+
+    int peek() override { return rxReady() ? _rx[_rxHead % kRxCapacity].value : -1; }
+
+    void flush() override {}
+
+    static uint16_t crc16(const uint8_t* data, size_t len) {
+        uint16_t crc = 0xFFFF;
+        for (size_t pos = 0; pos < len; pos++) {
+            crc ^= data[pos];
+            for (int i = 0; i < 8; i++) crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+        return crc;
+    }
+
+    static uint32_t decodeBcdAddress(const uint8_t* a) {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; i++) v = v * 100 + (a[i] >> 4) * 10 + (a[i] & 0x0F);
+        return v;
+    }
+
+private:
+    struct TimedByte {
+        uint8_t value;
+        uint64_t readyUs;
+    };
+
+    static constexpr uint32_t kRxCapacity = 256;
+
+    std::vector<PulsarMeterState> _meters;
+    TimedByte _rx[kRxCapacity];
+    uint32_t _rxHead = 0;
+    uint32_t _rxTail = 0;
+    uint32_t _latencyUs = 5000;
+    PulsarFaults _faults;
+    uint32_t _rng = 1;
+    Stats _stats;
+
+    void handleRequest(const uint8_t* req, size_t len) {
+        if (len < 8) return;
+        if (crc16(req, len - 2) != (uint16_t)(req[len - 2] | (req[len - 1] << 8))) return;
+        PulsarMeterState* m = meter(decodeBcdAddress(req));
+        if (!m) return;
+        _stats.requests++;
+        if (chance(_faults.noReply)) {
+            _stats.noReplies++;
+            return;
+        }
+
+        uint8_t resp[160];
+        size_t n = 0;
+        for (int i = 0; i < 5; i++) resp[n++] = req[i];
+        resp[n++] = 0; // length, patched below
+
+        if (req[4] == 0x01 && len >= 14) {
+            uint32_t mask = req[6] | (req[7] << 8) | (req[8] << 16) | ((uint32_t)req[9] << 24);
+            for (int ch = 0; ch < 32; ch++) {
+                if (!(mask & (1UL << ch))) continue;
+                float v = (ch == 0) ? m->volumeM3 : 0.0f;
+                n = appendFloat(resp, n, v);
+            }
+            resp[n++] = req[10];
+            resp[n++] = req[11];
+        } else if (req[4] == 0x0A) {
+            uint16_t param = req[6] | (req[7] << 8);
+            float v = 0;
+            switch (param) {
+                case 0x000E: v = m->batteryV; break;
+                case 0x000F: v = m->thresholdMin; break;
+                case 0x0010: v = m->thresholdAlarm; break;
+                default: return;
+            }
+            n = appendFloat(resp, n, v);
+            for (int i = 0; i < 4; i++) resp[n++] = 0;
+            resp[n++] = len >= 12 ? req[8] : 0x00;   // Request ID echo
+            resp[n++] = len >= 12 ? req[9] : 0x00;
+        } else {
+            return;
+        }
+
+        if (chance(_faults.wrongAddress)) {
+            encodeBcdAddress(m->serial % 99999999 + 1, resp);
+            _stats.wrongAddress++;
+        }
+        resp[5] = (uint8_t)(n + 2);
+        uint16_t crc = crc16(resp, n);
+        resp[n++] = crc & 0xFF;
+        resp[n++] = crc >> 8;
+        if (chance(_faults.crcError)) {
+            resp[next() % n] ^= (uint8_t)(1u << (next() % 8));
+            _stats.corrupted++;
+        }
+        enqueue(resp, n);
+        _stats.replies++;
+    }
+
+    static void encodeBcdAddress(uint32_t v, uint8_t* a) {
+        for (int i = 3; i >= 0; i--) {
+            a[i] = (uint8_t)((v % 10) | ((v / 10) % 10) << 4);
+            v /= 100;
+        }
+    }
+
+    uint32_t next() {
+        _rng ^= _rng << 13;
+        _rng ^= _rng >> 17;
+        _rng ^= _rng << 5;
+        return _rng;
+    }
+
+    bool chance(float p) { return p > 0 && next() % 1000000 < (uint32_t)(p * 1000000); }
+
+    bool rxReady() const { return _rxHead != _rxTail && _rx[_rxHead % kRxCapacity].readyUs <= HostShim::clockUs(); }
+
+    static size_t appendFloat(uint8_t* out, size_t n, float v) {
+        memcpy(out + n, &v, 4);
+        return n + 4;
+    }
+
+    // Puts the reply on the wire. A collision garbles the bytes it overlaps
+    // and may run past the end of the reply; lost bytes still take their
+    // wire time.
+    void enqueue(const uint8_t* frame, size_t len) {
+        uint64_t t = HostShim::clockUs() + _latencyUs;
+        // One talker at a time: a late reply to an earlier request goes first
+        if (_rxHead != _rxTail) t = std::max(t, _rx[(_rxTail - 1) % kRxCapacity].readyUs);
+        if (_faults.latencyJitterUs) t += next() % (_faults.latencyJitterUs + 1);
+        size_t from = len, to = len;
+        if (chance(_faults.contention)) {
+            from = next() % len;
+            to = from + 4 + next() % 12;
+            _stats.collisions++;
+        }
+        for (size_t i = 0; i < std::max(len, to) && _rxTail - _rxHead < kRxCapacity; i++) {
+            t += kByteTimeUs;
+            uint8_t b = i < len ? frame[i] : 0;
+            if (i >= from && i < to) b ^= (uint8_t)(next() | 1);
+            if (chance(_faults.byteLoss)) {
+                _stats.lostBytes++;
+                continue;
+            }
+            _rx[_rxTail++ % kRxCapacity] = {b, t};
+        }
+    }
+};
+
+} // namespace Sim
+
+#endif
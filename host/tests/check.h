@@ -0,0 +1,42 @@
+#ifndef HOST_TESTS_CHECK_H
+#define HOST_TESTS_CHECK_H
+
+// Minimal assertion helpers for host tests. Each test file is its own
+// executable registered with ctest; main() returns checkResult().
+
+#include <cstdio>
+
+namespace Check {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+} // namespace Check
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            Check::failures()++;                                                 \
+        }                                                                        \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                               \
+    do {                                                                             \
+        auto va_ = (a);                                                              \
+        auto vb_ = (b);                                                              \
+        if (!(va_ == vb_)) {                                                         \
+            fprintf(stderr, "%s:%d: CHECK_EQ failed: %s == %s (%lld vs %lld)\n", __FILE__, \
+                    __LINE__, #a, #b, (long long)va_, (long long)vb_);               \
+            Check::failures()++;                                                     \
+        }                                                                            \
+    } while (0)
+
+inline int checkResult() {
+    if (Check::failures()) fprintf(stderr, "%d check(s) failed\n", Check::failures());
+    return Check::failures() ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,176 @@
+// RS485 power gating: the supply pin around scheduler bursts, the warm-up
+// wait and its growth, every meter of the line in one power-up, the burst
+// bookkeeping in the metrics registry, and the inline (held) mode.
+
+#include "check.h"
+
+#include "bus/bus_power.h"
+#include "bus/bus_scheduler.h"
+#include "drivers/pulsar_ds15_20.h"
+#include "metrics.h"
+#include "sim/virtual_pulsar.h"
+
+namespace {
+
+constexpr uint8_t kPin = 18;
+
+// Meter interface that needs `readyMs` of power before it answers; records
+// what the line looked like on every transaction.
+class SpyDriver final : public Driver::SmartMeterDriver {
+public:
+    static constexpr Driver::ParamSet kSupportedParams = Driver::paramBit(Driver::MeterParam::TotalVolume);
+
+    explicit SpyDriver(uint32_t readyMs) : SmartMeterDriver(nullptr), _readyMs(readyMs) {}
+
+    Driver::ParamSet supportedParams() const override { return kSupportedParams; }
+
+    bool getValue(Driver::MeterParam, float& result) override {
+        calls++;
+        if (digitalRead(kPin) != HIGH) unpowered++;
+        HostShim::advanceMillis(30);            // Request + reply on the wire
+        if (poweredSince + _readyMs > millis() - 30) return false;
+        result = 1.0f;
+        return true;
+    }
+
+    // Set by the test to the start of the burst (powerUp() runs first thing).
+    uint32_t poweredSince = 0;
+    uint32_t calls = 0;
+    uint32_t unpowered = 0;
+
+private:
+    uint32_t _readyMs;
+};
+
+void testBurstGating() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Metrics::registry().reset();
+    Sim::VirtualPulsarBus line;
+    for (uint32_t i = 0; i < 4; i++) line.addMeter(30000000 + i);
+
+    Bus::BusPower power(kPin, 20, 15);
+    power.begin();
+    CHECK_EQ(digitalRead(kPin), LOW);
+
+    Bus::BusScheduler sched;
+    sched.setPower(&power);
+    CHECK_EQ(sched.runBurst(), 0u);             // Empty queue: the line stays off
+    CHECK_EQ(power.stats().bursts, 0u);
+
+    Driver::PulsarDu_15_20* drv[4];
+    for (uint32_t i = 0; i < 4; i++) drv[i] = new Driver::PulsarDu_15_20(&line, 30000000 + i);
+    for (auto* d : drv) sched.submit(d, Driver::PulsarDu_15_20::kSupportedParams, 0, millis() + 60000);
+
+    uint32_t start = millis();
+    CHECK_EQ(sched.runBurst(), 4u);             // Every meter in one power-up
+    CHECK_EQ(digitalRead(kPin), LOW);
+    CHECK_EQ(power.stats().bursts, 1u);
+    CHECK_EQ(power.stats().onMs, millis() - start);
+    CHECK(power.stats().onMs >= 20);            // Warm-up included
+    CHECK_EQ(Metrics::registry().get(Metrics::Counter::BusBursts), 1u);
+    CHECK_EQ(Metrics::registry().get(Metrics::Counter::BusOnMs), power.stats().onMs);
+    CHECK_EQ(Metrics::registry().max(Metrics::Histogram::BusBurstMs), power.stats().onMs);
+    CHECK_EQ(Metrics::registry().max(Metrics::Histogram::BusBurstUj), power.energyUj(power.stats().onMs));
+    CHECK_EQ(power.energyUj(100), 4950u);       // 15 mA x 3.3 V x 100 ms
+
+    // Expired requests alone do not power the line, but they are completed
+    Bus::BusScheduler::Ticket stale = sched.submit(drv[0], Driver::PulsarDu_15_20::kSupportedParams, 0, millis() - 1);
+    HostShim::advanceMillis(10);
+    size_t completed = 0;
+    CHECK_EQ(sched.runBurst(&completed), 0u);
+    CHECK_EQ(completed, 1u);                    // The bus task wakes the owner for it
+    CHECK_EQ(power.stats().bursts, 1u);
+    Driver::MeterReading r;
+    bool ok = true;
+    CHECK(sched.poll(stale, r, ok));
+    CHECK(!ok);
+
+    // A failed poll still ends the burst with the line off
+    Driver::PulsarDu_15_20 absent(&line, 99999999);
+    sched.submit(&absent, Driver::PulsarDu_15_20::kSupportedParams, 0, millis() + 60000);
+    CHECK_EQ(sched.runBurst(), 1u);
+    CHECK_EQ(digitalRead(kPin), LOW);
+    CHECK_EQ(power.stats().bursts, 2u);
+    CHECK_EQ(power.warmUpMs(), 20u);            // Nothing succeeded: no evidence to learn from
+
+    for (auto* d : drv) delete d;
+    HostShim::consoleEnabled() = true;
+}
+
+void testWarmUpGrows() {
+    HostShim::setMillis(1000);
+    Bus::BusPower power(kPin, 20, 15);
+    power.begin();
+    Bus::BusScheduler sched;
+    sched.setPower(&power);
+
+    // The interface needs 45 ms: the first read of a burst misses, its retry
+    // (30 ms + backoff later) finds it ready, so the warm-up grows.
+    SpyDriver a(45), b(45);
+    uint32_t raises = 0;
+    for (int burst = 0; burst < 5; burst++) {
+        a.poweredSince = b.poweredSince = millis();
+        Bus::BusScheduler::Ticket ta = sched.submit(&a, SpyDriver::kSupportedParams, 1, millis() + 60000, 1);
+        Bus::BusScheduler::Ticket tb = sched.submit(&b, SpyDriver::kSupportedParams, 0, millis() + 60000);
+        CHECK_EQ(sched.runBurst(), 2u);
+        Driver::MeterReading r;
+        bool ok;
+        CHECK(sched.poll(ta, r, ok) && sched.poll(tb, r, ok));
+        raises = power.stats().warmUpRaises;
+        HostShim::advanceMillis(1000);
+    }
+    CHECK_EQ(a.unpowered + b.unpowered, 0u);
+    CHECK(power.warmUpMs() >= 45);              // 20 -> 30 -> 45, then the first read succeeds
+    CHECK_EQ(raises, 2u);
+
+    // A dead meter first in the burst is no evidence, whatever follows it
+    Bus::BusPower fresh(kPin, 20, 15);
+    sched.setPower(&fresh);
+    SpyDriver dead(UINT32_MAX / 2), live(0);
+    sched.submit(&dead, SpyDriver::kSupportedParams, 1, millis() + 60000, 2);
+    sched.submit(&live, SpyDriver::kSupportedParams, 0, millis() + 60000, 2);
+    CHECK_EQ(sched.runBurst(), 2u);
+    CHECK_EQ(dead.calls, 3u);                   // Both retries used
+    CHECK_EQ(live.calls, 1u);
+    CHECK_EQ(fresh.warmUpMs(), 20u);
+
+    // Never past the cap
+    Bus::BusPower slow(kPin, Bus::BusPower::kMaxWarmUpMs - 1, 15);
+    slow.noteBurst(false, true);
+    CHECK_EQ(slow.warmUpMs(), Bus::BusPower::kMaxWarmUpMs);
+    slow.noteBurst(false, true);
+    CHECK_EQ(slow.warmUpMs(), Bus::BusPower::kMaxWarmUpMs);
+}
+
+void testHold() {
+    HostShim::setMillis(1000);
+    Bus::BusPower power(kPin, 20, 15);
+    power.begin();
+    power.hold();                               // No bus task: drivers read inline
+    CHECK_EQ(digitalRead(kPin), HIGH);
+
+    Bus::BusScheduler sched;
+    sched.setPower(&power);
+    SpyDriver d(0);
+    sched.submit(&d, SpyDriver::kSupportedParams, 0, millis() + 60000);
+    CHECK_EQ(sched.runBurst(), 1u);
+    CHECK_EQ(digitalRead(kPin), HIGH);          // Bursts do not switch a held line off
+    CHECK_EQ(power.stats().bursts, 0u);
+
+    uint32_t on = millis();
+    HostShim::advanceMillis(500);
+    power.shutdown();                           // Leave / deep sleep
+    CHECK_EQ(digitalRead(kPin), LOW);
+    CHECK_EQ(power.stats().bursts, 1u);
+    CHECK(power.stats().onMs >= millis() - on);
+}
+
+} // namespace
+
+int main() {
+    testBurstGating();
+    testWarmUpGrows();
+    testHold();
+    return checkResult();
+}
@@ -0,0 +1,215 @@
+// ChannelSet: seven Pulsar meters on one virtual RS485 line (plus a test
+// channel) generated from a constexpr table; aligned polling (one burst per
+// interval, without dragging a slow meter along with a busy one),
+// per-channel NVS records and history series for N channels.
+
+#include "check.h"
+
+#include <cstdio>
+#include <string>
+
+#include "channels.h"
+#include "sim/file_flash.h"
+#include "sim/virtual_pulsar.h"
+#include "storage/history_store.h"
+
+namespace {
+
+constexpr uint32_t kPoll = 60000;
+constexpr uint32_t kPullForward = ChannelSet<1>::kPullForwardShare;
+
+constexpr ChannelConfig kRiser[] = {
+    { "m1", Source::SourceType::Smart, Driver::MeterModel::Pulsar_Du_15_20, 0, { kPoll, kPoll }, true },
+    { "m2", Source::SourceType::Smart, Driver::MeterModel::Pulsar_Du_15_20, 0, { kPoll, kPoll }, false },
+    { "m3", Source::SourceType::Smart, Driver::MeterModel::Pulsar_Du_15_20, 0, { kPoll, kPoll }, false },
+    { "m4", Source::SourceType::Smart, Driver::MeterModel::Pulsar_Du_15_20, 0, { kPoll, kPoll }, false },
+    { "m5", Source::SourceType::Smart, Driver::MeterModel::Pulsar_Du_15_20, 0, { kPoll, kPoll }, false },
+    { "m6", Source::SourceType::Smart, Driver::MeterModel::Pulsar_Du_15_20, 0, { kPoll, kPoll }, false },
+    { "m7", Source::SourceType::Smart, Driver::MeterModel::Pulsar_Du_15_20, 0, { kPoll, kPoll }, false },
+    { "m8", Source::SourceType::Test,  Driver::MeterModel::Mock,            0, { kPoll, kPoll }, false },
+};
+constexpr size_t kCount = sizeof(kRiser) / sizeof(kRiser[0]);
+static_assert(countBusChannels(kRiser) == 7, "Seven meters on the line");
+
+// Everything a channel owns is in the fixed array: no hidden per-channel globals.
+static_assert(sizeof(ChannelSet<kCount>) == kCount * sizeof(Channel), "Linear in N");
+
+void testRiserPolledInOneBurst() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Preferences prefs;
+    prefs.begin("water", false);
+
+    Sim::VirtualPulsarBus line;
+    for (uint32_t i = 0; i < 7; i++) line.addMeter(20000000 + i);
+    for (uint32_t i = 0; i < 7; i++) line.meter(20000000 + i)->volumeM3 = 1.0f + i;
+
+    Bus::BusScheduler sched; // No task on the host: runBurst() stands in for it
+    ChannelSet<kCount> channels(kRiser, &prefs);
+    for (auto& ch : channels) {
+        Storage::ChannelState st;
+        st.serial = 20000000 + ch.index;
+        CHECK(channels.build(ch.index, st, &line, &sched));
+        ch.src->begin();
+        CHECK_EQ(ch.endpoint.getEndpoint(), ch.index + 1);
+    }
+    CHECK(channels[0].endpoint.battery_supported());
+    CHECK(!channels[1].endpoint.battery_supported());
+    CHECK(channels[7].drv == nullptr);
+    // Table models get sources typed on their final driver (no vtable on polls)
+    CHECK(dynamic_cast<Source::BasicSmartSource<Driver::PulsarDu_15_20>*>(channels[0].src.get()) != nullptr);
+    static_assert(Driver::capabilities(Driver::MeterModel::Pulsar_Du_15_20) == Driver::PulsarDu_15_20::kSupportedParams, "");
+
+    channels.tick(); // Первый тик только запускает таймеры часов
+    channels.tick();
+    CHECK_EQ(sched.runBurst(), 7u);
+    channels.tick();
+    for (size_t i = 0; i < 7; i++) CHECK_EQ(channels[i].src->getLiters(), 1000 * (1 + i));
+
+    // A new serial on one meter makes it due early: the rest of the line,
+    // close to its own deadline, is pulled forward with it (one burst).
+    HostShim::advanceMillis(kPoll - kPoll / kPullForward);
+    channels[4].src->setSerialNumber(20000004);
+    uint32_t polledAt = millis();
+    channels.tick();
+    CHECK_EQ(sched.runBurst(), 7u);
+    channels.tick();
+
+    // Mid-interval the others are too far from theirs: it goes alone, and
+    // keeps its own phase from then on.
+    HostShim::advanceMillis(kPoll / 2);
+    channels[4].src->setSerialNumber(20000004);
+    uint32_t aloneAt = millis();
+    channels.tick();
+    CHECK_EQ(sched.runBurst(), 1u);
+    channels.tick();
+
+    // The line now runs on the new phase: nothing until a full interval later.
+    HostShim::setMillis(polledAt + kPoll - 1000);
+    channels.tick();
+    CHECK_EQ(sched.runBurst(), 0u);
+
+    HostShim::setMillis(polledAt + kPoll);
+    line.meter(20000006)->volumeM3 = 9.5f;
+    channels.tick();
+    CHECK_EQ(sched.runBurst(), 6u);
+    channels.tick();
+    CHECK_EQ(channels[6].src->getLiters(), 9500u);
+
+    HostShim::setMillis(aloneAt + kPoll);
+    channels.tick();
+    CHECK_EQ(sched.runBurst(), 1u);
+    CHECK_EQ(sched.stats().bursts, 5u);
+    CHECK_EQ(sched.stats().transactions, 22u);
+    HostShim::consoleEnabled() = true;
+}
+
+// A meter on a long interval shares the line with a busy one: it is only
+// pulled forward near its own deadline, so it keeps most of its back-off.
+void testSlowMeterKeepsItsInterval() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Preferences prefs;
+    prefs.begin("water", false);
+    constexpr uint32_t kFast = 10 * kPoll, kSlow = 120 * kPoll;
+    constexpr ChannelConfig kPair[] = {
+        { "busy", Source::SourceType::Smart, Driver::MeterModel::Pulsar_Du_15_20, 0, { kFast, kFast }, false },
+        { "quiet", Source::SourceType::Smart, Driver::MeterModel::Pulsar_Du_15_20, 0, { kSlow, kSlow }, false },
+    };
+    Sim::VirtualPulsarBus line;
+    line.addMeter(30000000);
+    line.addMeter(30000001);
+    Bus::BusScheduler sched;
+    ChannelSet<2> channels(kPair, &prefs);
+    for (auto& ch : channels) {
+        Storage::ChannelState st;
+        st.serial = 30000000 + ch.index;
+        CHECK(channels.build(ch.index, st, &line, &sched));
+        ch.src->begin();
+    }
+    channels.tick();
+
+    uint32_t transactions = 0;
+    for (uint32_t m = 0; m < 24 * 60; m++) {
+        HostShim::advanceMillis(kPoll);
+        channels.tick();
+        transactions += sched.runBurst();
+        channels.tick();
+    }
+    uint32_t fast = 24 * 60 * kPoll / kFast;
+    uint32_t slow = transactions - fast;
+    CHECK_EQ(sched.stats().bursts, fast);        // Never a power-up of its own
+    CHECK(slow >= 24 * 60 * kPoll / kSlow);
+    CHECK(slow <= 24 * 60 * kPoll / (kSlow - kSlow / kPullForward) + 1); // Not every 10 min
+    HostShim::consoleEnabled() = true;
+}
+
+void testPerChannelRecords() {
+    HostShim::nvsStore().clear();
+    Preferences prefs;
+    prefs.begin("water", false);
+    {
+        ChannelSet<kCount> channels(kRiser, &prefs);
+        for (auto& ch : channels) {
+            Storage::ChannelState st;
+            st.serial = 100 + ch.index;
+            st.offset = -(int32_t)ch.index;
+            st.liters = 1000 * ch.index;
+            CHECK(ch.store.save(st));
+        }
+    }
+    ChannelSet<kCount> channels(kRiser, &prefs);
+    for (auto& ch : channels) {
+        Storage::ChannelState st;
+        CHECK(ch.store.load(st));
+        CHECK_EQ(st.serial, 100u + ch.index);
+        CHECK_EQ(st.offset, -(int32_t)ch.index);
+        CHECK_EQ(st.liters, 1000u * ch.index);
+    }
+}
+
+// History for all eight channels; a region formatted for two channels reads
+// as blank and is taken over.
+void testHistoryForNChannels() {
+    std::string path = "history_channels.bin";
+    std::remove(path.c_str());
+    {
+        Sim::FileFlash flash(path, 8 * 4096);
+        CHECK(flash.begin());
+        Storage::HistoryStore two(&flash);
+        CHECK(two.begin());
+        CHECK(two.append(1, Storage::HistoryKind::Hour, 5));
+    }
+
+    Sim::FileFlash flash(path, 8 * 4096);
+    CHECK(flash.begin());
+    Storage::BasicHistoryStore<kCount> store(&flash);
+    CHECK(store.begin());
+    CHECK_EQ(store.nextIndex(1, Storage::HistoryKind::Hour), 0u);
+    for (uint8_t ch = 0; ch < kCount; ch++) {
+        for (uint32_t h = 0; h < 20; h++) CHECK(store.append(ch, Storage::HistoryKind::Hour, ch * 100 + h));
+        CHECK(store.append(ch, Storage::HistoryKind::Day, ch));
+    }
+    CHECK(!store.append(kCount, Storage::HistoryKind::Hour, 1));
+    CHECK_EQ(flash.violations(), 0u);
+
+    Storage::BasicHistoryStore<kCount> reboot(&flash);
+    CHECK(reboot.begin());
+    uint32_t out[20];
+    uint32_t first = 0;
+    CHECK_EQ(reboot.read(7, Storage::HistoryKind::Hour, 0, out, 20, first), 20u);
+    CHECK_EQ(out[19], 719u);
+    CHECK_EQ(reboot.read(5, Storage::HistoryKind::Day, 0, out, 20, first), 1u);
+    CHECK_EQ(out[0], 5u);
+    std::remove(path.c_str());
+}
+
+} // namespace
+
+int main() {
+    testRiserPolledInOneBurst();
+    testSlowMeterKeepsItsInterval();
+    testPerChannelRecords();
+    testHistoryForNChannels();
+    return checkResult();
+}
@@ -0,0 +1,194 @@
+// EventScheduler: heap order, re-arming, parking, millis() wrap, wake-ups and
+// the time accounting, plus the deadline a source reports to the loop.
+// Time is passed in explicitly (fake clock).
+
+#include "check.h"
+
+#include <string>
+
+#include "event_scheduler.h"
+#include "sources/simulation_source.h"
+
+namespace {
+
+std::string g_trace;
+uint32_t g_delay[4];
+
+template <int Id>
+uint32_t record(uint32_t) {
+    g_trace += (char)('a' + Id);
+    return g_delay[Id];
+}
+
+void reset() {
+    g_trace.clear();
+    for (auto& d : g_delay) d = EventScheduler<4>::kNever;
+}
+
+void testOrderAndTies() {
+    reset();
+    EventScheduler<4> s;
+    CHECK_EQ(s.add(record<0>, 0, 300), 0);
+    CHECK_EQ(s.add(record<1>, 0, 100), 1);
+    CHECK_EQ(s.add(record<2>, 0, 200), 2);
+    CHECK_EQ(s.add(record<3>, 0, 100), 3);
+    CHECK_EQ(s.add(record<0>, 0, 1), -1); // Table full
+
+    CHECK_EQ(s.nextDelay(0), 100u);
+    CHECK_EQ(s.runDue(99), (size_t)0);
+    CHECK_EQ(s.runDue(100), (size_t)2);
+    CHECK(g_trace == "bd"); // Tie: lower id first
+    CHECK_EQ(s.runDue(1000), (size_t)2);
+    CHECK(g_trace == "bdca");
+    CHECK_EQ(s.nextDelay(1000), EventScheduler<4>::kNever); // All parked
+}
+
+void testRearmAndDisarm() {
+    reset();
+    EventScheduler<4> s;
+    s.add(record<0>, 0, 500);
+    s.add(record<1>, 0, 600);
+    s.add(record<2>, 0);               // Parked
+    CHECK(!s.armed(2));
+
+    s.arm(1, 50);                      // Earlier
+    s.arm(0, 700);                     // Later
+    s.arm(2, 60);
+    CHECK_EQ(s.nextDelay(0), 50u);
+    s.disarm(1);
+    CHECK_EQ(s.nextDelay(0), 60u);
+    CHECK_EQ(s.runDue(700), (size_t)2);
+    CHECK(g_trace == "ca");
+}
+
+void testPeriodicAndZeroDelay() {
+    reset();
+    EventScheduler<4> s;
+    g_delay[0] = 1000;                 // Periodic
+    g_delay[1] = 0;                    // "Again": must not spin inside one runDue()
+    s.add(record<0>, 0, 1000);
+    s.add(record<1>, 0, 0);
+
+    CHECK_EQ(s.runDue(0), (size_t)1);
+    CHECK_EQ(s.nextDelay(0), 1u);
+    g_delay[1] = EventScheduler<4>::kNever;
+    for (uint32_t t = 1; t <= 3000; t++) s.runDue(t);
+    CHECK(g_trace == "bbaaa");
+    CHECK_EQ(s.stats().runs, 5u);
+}
+
+void testWrap() {
+    reset();
+    EventScheduler<4> s;
+    uint32_t now = 0xFFFFFF00u;
+    s.add(record<0>, now, 0x200);      // Due after the wrap
+    s.add(record<1>, now, 0x80);       // Before it
+    CHECK_EQ(s.nextDelay(now), 0x80u);
+    CHECK_EQ(s.runDue(0xFFFFFF7Fu), (size_t)0);
+    CHECK_EQ(s.runDue(0x10), (size_t)1);
+    CHECK_EQ(s.nextDelay(0x10), 0xF0u);
+    CHECK_EQ(s.runDue(0x100), (size_t)1);
+    CHECK(g_trace == "ba");
+}
+
+void testSlack() {
+    reset();
+    EventScheduler<4> s(1000);
+    s.add(record<0>, 0, 5000);
+    s.add(record<1>, 0, 5600);         // Within the slack: shares the wake-up
+    s.add(record<2>, 0, 6500);         // Outside it
+    CHECK_EQ(s.nextDelay(0), 5600u);
+    CHECK_EQ(s.runDue(5600), (size_t)2);
+    CHECK_EQ(s.nextDelay(5600), 900u);
+    CHECK_EQ(s.nextDelay(7000), 0u);   // Overdue: no waiting for company
+    CHECK(g_trace == "ab");
+}
+
+// Handler that arms a later timer for "now": it runs in the same pass.
+EventScheduler<4>* g_sched = nullptr;
+uint32_t armsNext(uint32_t now) {
+    g_trace += 'a';
+    g_sched->arm(1, now);
+    return EventScheduler<4>::kNever;
+}
+
+void testChaining() {
+    reset();
+    EventScheduler<4> s;
+    g_sched = &s;
+    s.add(armsNext, 0, 10);
+    s.add(record<1>, 0);
+    CHECK_EQ(s.runDue(10), (size_t)2);
+    CHECK(g_trace == "ab");
+}
+
+void testAccounting() {
+    EventScheduler<2> s;
+    // Awake 40 ms after boot, asleep until 1000, awake 10 ms, event at 1510.
+    s.noteSleep(40);
+    s.noteWake(1000, false);
+    s.noteSleep(1010);
+    s.noteWake(1510, true);
+    CHECK_EQ(s.stats().wakeups, 2u);
+    CHECK_EQ(s.stats().eventWakeups, 1u);
+    CHECK_EQ(s.stats().awakeMs, (uint64_t)50);
+    CHECK_EQ(s.stats().asleepMs, (uint64_t)1460);
+
+    // 2 wake-ups in 1510 ms -> 4768 per hour
+    CHECK_EQ(s.stats().wakeupsPerHour(), 4768u);
+}
+
+uint32_t never(uint32_t) { return EventScheduler<2>::kNever; }
+
+void testWakeCutsSleepShort() {
+    HostShim::setMillis(0);
+    EventScheduler<2> s;
+    s.attachCurrentTask();
+    s.add(never, 0, 60000);            // A minute away (real time in the shim)
+    s.wake();                          // Event before the sleep: returns at once
+    CHECK(s.sleep());
+    CHECK_EQ(s.stats().eventWakeups, 1u);
+
+    EventScheduler<2> t;
+    t.attachCurrentTask();
+    t.add(never, millis(), 5);
+    CHECK(!t.sleep());                 // Deadline, no event
+    CHECK_EQ(t.stats().wakeups, 1u);
+    CHECK_EQ(t.stats().eventWakeups, 0u);
+}
+
+void testSourceDeadline() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Source::SimulationSource src(0);
+    src.setPollInterval(30000);
+    src.begin();
+    src.forceUpdate();
+    CHECK_EQ(src.msUntilDue(millis()), 0u); // Not started: tick right away
+    src.tick();
+    CHECK_EQ(src.msUntilDue(millis()), 0u); // First poll still due
+    src.tick();
+    CHECK_EQ(src.msUntilDue(millis()), 30000u);
+    HostShim::advanceMillis(29000);
+    CHECK_EQ(src.msUntilDue(millis()), 1000u);
+
+    // Hour close comes before the next poll
+    src.setPollInterval(7200000);
+    CHECK_EQ(src.msUntilDue(millis()), 3600000u - 29000u);
+    HostShim::consoleEnabled() = true;
+}
+
+} // namespace
+
+int main() {
+    testOrderAndTies();
+    testRearmAndDisarm();
+    testPeriodicAndZeroDelay();
+    testWrap();
+    testSlack();
+    testChaining();
+    testAccounting();
+    testWakeCutsSleepShort();
+    testSourceDeadline();
+    return checkResult();
+}
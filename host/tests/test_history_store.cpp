@@ -0,0 +1,280 @@
+// HistoryStore on a file-backed NOR flash: append, range reads, ring wrap,
+// crash recovery, reads from another task while the ring wraps, and the ZCL
+// request/page path of ZigbeeWaterMeter.
+
+#include "check.h"
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "sim/file_flash.h"
+#include "storage/history_store.h"
+#include "zigbee_water_meter.h"
+
+using Storage::HistoryKind;
+using Storage::HistoryStore;
+
+namespace {
+
+std::string freshPath(const char* name) {
+    std::string path = std::string("history_") + name + ".bin";
+    std::remove(path.c_str());
+    return path;
+}
+
+void testAppendReadAndReboot() {
+    std::string path = freshPath("reboot");
+    {
+        Sim::FileFlash flash(path, 16 * 4096);
+        CHECK(flash.begin());
+        HistoryStore store(&flash);
+        CHECK(store.begin());
+        for (uint32_t h = 0; h < 50; h++) {
+            CHECK(store.append(0, HistoryKind::Hour, h * 100));
+            CHECK(store.append(1, HistoryKind::Hour, h));
+        }
+        CHECK(store.append(0, HistoryKind::Day, 123456));
+        CHECK_EQ(flash.violations(), 0u);
+    }
+
+    // "Reboot": a new store over the same file rebuilds everything from flash.
+    Sim::FileFlash flash(path, 16 * 4096);
+    CHECK(flash.begin());
+    HistoryStore store(&flash);
+    CHECK(store.begin());
+    CHECK_EQ(store.nextIndex(0, HistoryKind::Hour), 50u);
+    CHECK_EQ(store.nextIndex(1, HistoryKind::Hour), 50u);
+    CHECK_EQ(store.nextIndex(0, HistoryKind::Day), 1u);
+    CHECK_EQ(store.nextIndex(1, HistoryKind::Day), 0u);
+
+    uint32_t out[8];
+    uint32_t first = 0;
+    size_t n = store.read(0, HistoryKind::Hour, 10, out, 8, first);
+    CHECK_EQ(n, 8u);
+    CHECK_EQ(first, 10u);
+    for (size_t i = 0; i < n; i++) CHECK_EQ(out[i], (10 + i) * 100);
+
+    n = store.read(1, HistoryKind::Hour, 47, out, 8, first);
+    CHECK_EQ(n, 3u);
+    CHECK_EQ(out[2], 49u);
+
+    n = store.read(0, HistoryKind::Day, 0, out, 8, first);
+    CHECK_EQ(n, 1u);
+    CHECK_EQ(out[0], 123456u);
+
+    // Appends continue where the previous boot stopped.
+    CHECK(store.append(0, HistoryKind::Hour, 7));
+    n = store.read(0, HistoryKind::Hour, 50, out, 8, first);
+    CHECK_EQ(n, 1u);
+    CHECK_EQ(out[0], 7u);
+    std::remove(path.c_str());
+}
+
+// A small ring wraps many times: oldest buckets go, erases stay even.
+void testRingWrapLevelsWear() {
+    std::string path = freshPath("wrap");
+    const size_t sectors = 4, sectorSize = 256;
+    Sim::FileFlash flash(path, sectors * sectorSize, sectorSize);
+    CHECK(flash.begin());
+    HistoryStore store(&flash);
+    CHECK(store.begin());
+
+    const uint32_t total = 2000;
+    for (uint32_t h = 0; h < total; h++) CHECK(store.append(0, HistoryKind::Hour, h % 300));
+    CHECK_EQ(flash.violations(), 0u);
+    CHECK_EQ(store.nextIndex(0, HistoryKind::Hour), total);
+
+    uint32_t oldest = store.firstIndex(0, HistoryKind::Hour);
+    CHECK(oldest > 0);
+    CHECK(oldest < total);
+
+    // Reads of evicted buckets are clamped to the oldest one kept.
+    uint32_t out[16];
+    uint32_t first = 0;
+    size_t n = store.read(0, HistoryKind::Hour, 0, out, 16, first);
+    CHECK_EQ(first, oldest);
+    CHECK_EQ(n, 16u);
+    for (size_t i = 0; i < n; i++) CHECK_EQ(out[i], (oldest + i) % 300);
+
+    // The newest buckets span the sector boundary and read back in order.
+    n = store.read(0, HistoryKind::Hour, total - 16, out, 16, first);
+    CHECK_EQ(n, 16u);
+    for (size_t i = 0; i < n; i++) CHECK_EQ(out[i], (total - 16 + i) % 300);
+
+    uint32_t minErase = flash.erases(0), maxErase = flash.erases(0);
+    for (size_t s = 1; s < sectors; s++) {
+        if (flash.erases(s) < minErase) minErase = flash.erases(s);
+        if (flash.erases(s) > maxErase) maxErase = flash.erases(s);
+    }
+    CHECK(maxErase - minErase <= 1);
+    CHECK_EQ(store.stats().maxEraseCount, maxErase);
+    std::remove(path.c_str());
+}
+
+// Power loss in the middle of a record: the torn record is dropped on boot
+// and appends continue in a fresh sector.
+void testTornRecordRecovery() {
+    std::string path = freshPath("torn");
+    {
+        Sim::FileFlash flash(path, 8 * 4096);
+        CHECK(flash.begin());
+        HistoryStore store(&flash);
+        CHECK(store.begin());
+        for (uint32_t h = 0; h < 5; h++) CHECK(store.append(0, HistoryKind::Hour, 1000 + h));
+        flash.powerLossAfter(2); // tag + first varint byte only
+        CHECK(!store.append(0, HistoryKind::Hour, 70000));
+    }
+
+    Sim::FileFlash flash(path, 8 * 4096);
+    CHECK(flash.begin());
+    HistoryStore store(&flash);
+    CHECK(store.begin());
+    CHECK_EQ(store.stats().tornRecords, 1u);
+    CHECK_EQ(store.nextIndex(0, HistoryKind::Hour), 5u);
+
+    CHECK(store.append(0, HistoryKind::Hour, 42));
+    CHECK_EQ(store.stats().sectorsOpened, 1u);
+    CHECK_EQ(flash.violations(), 0u);
+
+    uint32_t out[8];
+    uint32_t first = 0;
+    size_t n = store.read(0, HistoryKind::Hour, 0, out, 8, first);
+    CHECK_EQ(n, 6u);
+    CHECK_EQ(out[4], 1004u);
+    CHECK_EQ(out[5], 42u);
+    std::remove(path.c_str());
+}
+
+// Power loss between the erase and the header write leaves no half sector behind.
+void testTornHeaderRecovery() {
+    std::string path = freshPath("header");
+    const size_t sectorSize = 128;
+    {
+        Sim::FileFlash flash(path, 4 * sectorSize, sectorSize);
+        CHECK(flash.begin());
+        HistoryStore store(&flash);
+        CHECK(store.begin());
+        uint32_t h = 0;
+        while (store.stats().sectorsOpened < 2) CHECK(store.append(1, HistoryKind::Day, h++));
+        // Fill the second sector up to the brim, then cut power while opening the third.
+        while (true) {
+            uint32_t before = store.stats().sectorsOpened;
+            flash.powerLossAfter(10); // Enough for a record, not for a sector header
+            bool ok = store.append(1, HistoryKind::Day, h);
+            if (store.stats().sectorsOpened != before || !ok) break;
+            h++;
+        }
+    }
+
+    Sim::FileFlash flash(path, 4 * sectorSize, sectorSize);
+    CHECK(flash.begin());
+    HistoryStore store(&flash);
+    CHECK(store.begin());
+    uint32_t next = store.nextIndex(1, HistoryKind::Day);
+    uint32_t out[64];
+    uint32_t first = 0;
+    size_t n = store.read(1, HistoryKind::Day, 0, out, 64, first);
+    CHECK_EQ(first + n, next);
+    for (size_t i = 0; i < n; i++) CHECK_EQ(out[i], first + i);
+    CHECK(store.append(1, HistoryKind::Day, next));
+    CHECK_EQ(store.nextIndex(1, HistoryKind::Day), next + 1);
+    std::remove(path.c_str());
+}
+
+uint32_t get32(const std::vector<uint8_t>& v, size_t at) {
+    return v[at] | (v[at + 1] << 8) | (v[at + 2] << 16) | ((uint32_t)v[at + 3] << 24);
+}
+
+// Coordinator writes the request attribute, then reads the page attribute.
+void testZclHistoryPage() {
+    std::string path = freshPath("zcl");
+    Sim::FileFlash flash(path, 8 * 4096);
+    CHECK(flash.begin());
+    HistoryStore store(&flash);
+    CHECK(store.begin());
+    for (uint32_t h = 0; h < 25; h++) CHECK(store.append(1, HistoryKind::Hour, 10 * h));
+
+    HostShim::consoleEnabled() = false;
+    ZigbeeWaterMeter ep(2);
+    ep.setHistory(&store, 1);
+    ep.begin();
+    ep.registerAttributes();
+
+    auto request = [&](uint32_t req) {
+        esp_zb_zcl_set_attr_value_message_t msg = {};
+        msg.info.cluster = ESP_ZB_ZCL_CLUSTER_ID_METERING;
+        msg.attribute.id = kAttrHistoryRequest;
+        msg.attribute.data.type = ESP_ZB_ZCL_ATTR_TYPE_U32;
+        msg.attribute.data.size = 4;
+        msg.attribute.data.value = &req;
+        ep.handleAttributeWrite(&msg);
+        return HostZigbee::attributes()[std::make_tuple((uint8_t)2, (uint16_t)ESP_ZB_ZCL_CLUSTER_ID_METERING, kAttrHistoryData)];
+    };
+
+    std::vector<uint8_t> page = request(kHistoryLatest);
+    CHECK_EQ(page.size(), 1 + kHistoryPageLen);
+    CHECK_EQ(page[0], kHistoryPageLen);
+    CHECK_EQ(page[1], 0);              // hour
+    CHECK_EQ(get32(page, 2), 15u);     // first
+    CHECK_EQ(get32(page, 6), 25u);     // next
+    CHECK_EQ(page[10], kHistoryPageSize);
+    CHECK_EQ(get32(page, 11), 150u);
+    CHECK_EQ(get32(page, 11 + 4 * 9), 240u);
+
+    page = request(20);
+    CHECK_EQ(get32(page, 2), 20u);
+    CHECK_EQ(page[10], 5);
+    CHECK_EQ(get32(page, 11 + 4 * 4), 240u);
+
+    page = request((1u << 24) | kHistoryLatest); // days: none yet
+    CHECK_EQ(page[1], 1);
+    CHECK_EQ(page[10], 0);
+    HostShim::consoleEnabled() = true;
+    std::remove(path.c_str());
+}
+
+// History pages served from the Zigbee task while the loop task appends:
+// every page read matches its indexes, also across sector erases.
+void testReadsWhileAppending() {
+    std::string path = freshPath("threads");
+    Sim::FileFlash flash(path, 4 * 256, 256);
+    CHECK(flash.begin());
+    HistoryStore store(&flash);
+    CHECK(store.begin());
+
+    const uint32_t total = 3000;
+    std::atomic<bool> done{ false };
+    std::thread loop([&] {
+        for (uint32_t h = 0; h < total; h++) store.append(0, HistoryKind::Hour, h % 300);
+        done = true;
+    });
+    uint32_t pages = 0, bad = 0;
+    while (!done) {
+        uint32_t next = store.nextIndex(0, HistoryKind::Hour);
+        uint32_t out[10];
+        uint32_t first = 0;
+        size_t n = store.read(0, HistoryKind::Hour, next > 10 ? next - 10 : 0, out, 10, first);
+        for (size_t i = 0; i < n; i++) bad += out[i] != (first + i) % 300;
+        pages++;
+    }
+    loop.join();
+    CHECK(pages > 0);
+    CHECK_EQ(bad, 0u);
+    CHECK_EQ(store.nextIndex(0, HistoryKind::Hour), total);
+    CHECK_EQ(flash.violations(), 0u);
+    std::remove(path.c_str());
+}
+
+} // namespace
+
+int main() {
+    testAppendReadAndReboot();
+    testRingWrapLevelsWear();
+    testTornRecordRecovery();
+    testTornHeaderRecovery();
+    testReadsWhileAppending();
+    testZclHistoryPage();
+    return checkResult();
+}
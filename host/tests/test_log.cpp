@@ -0,0 +1,155 @@
+// Deferred log ring: records are stored raw and formatted only on drain(),
+// with the types they were written with; the oldest records make room and
+// are counted; statements above their module's compile-time level leave no
+// code behind; the Pulsar driver's hot path logs nothing on success.
+
+#include "check.h"
+
+#include <string>
+
+#include "drivers/pulsar_ds15_20.h"
+#include "log.h"
+#include "sim/virtual_pulsar.h"
+
+namespace {
+
+using Log::Level;
+using Log::Module;
+
+class StringPrint : public Print {
+public:
+    std::string text;
+    size_t write(uint8_t b) override {
+        text += (char)b;
+        return 1;
+    }
+};
+
+std::string drainAll() {
+    StringPrint out;
+    Log::ring().drain(out);
+    return out.text;
+}
+
+enum class Mode : uint8_t { Idle = 7 };
+
+void testFormatting() {
+    Log::ring().clear();
+    HostShim::setMillis(1234);
+    uint64_t liters = 12345678901ULL;
+    const char* name = "Cold";
+    LOG_I(Src, "Hour closed. Consumed: %llu L\n", liters);
+    LOG_W(Sys, "%s: %d/%u 0x%04X %c", name, -5, 7u, 0xBEEF, 'x');
+    LOG_I(Zb, "%.2f V, %5.1f%%, %e", 3.14159, 2.5f, 1000.0);
+    LOG_E(Zb, "mode %u, flag %d, %lu", Mode::Idle, true, 4000000000UL);
+    LOG_I(Sys, "no args");
+    CHECK(!Log::ring().empty());
+    CHECK_EQ(Log::ring().stats().records, 5u);
+
+    std::string text = drainAll();
+    CHECK(text ==
+          "1234 I SRC: Hour closed. Consumed: 12345678901 L\r\n"
+          "1234 W SYS: Cold: -5/7 0xBEEF x\r\n"
+          "1234 I ZB: 3.14 V,   2.5%, 1.000000e+03\r\n"
+          "1234 E ZB: mode 7, flag 1, 4000000000\r\n"
+          "1234 I SYS: no args\r\n");
+    CHECK(Log::ring().empty());
+    CHECK(drainAll().empty());
+}
+
+void testFrames() {
+    Log::ring().clear();
+    HostShim::setMillis(10);
+    const uint8_t bytes[] = { 0x01, 0x9A, 0x8D, 0x3A, 0x0A, 0x0C };
+    Log::ring().frame(Module::Drv, Level::Verbose, "<<< RX [%08lu]: ", 10128442, bytes, sizeof(bytes));
+    CHECK(drainAll() == "10 V DRV: <<< RX [10128442]: 01 9A 8D 3A 0A 0C \r\n");
+
+    // Longer frames keep their head
+    uint8_t big[64];
+    for (size_t i = 0; i < sizeof(big); i++) big[i] = (uint8_t)i;
+    Log::ring().frame(Module::Drv, Level::Verbose, "%u: ", 1, big, sizeof(big));
+    std::string text = drainAll();
+    CHECK(text.find(" 1F \r\n") != std::string::npos);
+    CHECK(text.find(" 20 ") == std::string::npos);
+}
+
+void testOverwriteOldest() {
+    Log::ring().clear();
+    HostShim::setMillis(0);
+    for (uint32_t i = 0; i < 1000; i++) LOG_I(Src, "record %lu", i);
+    const Log::Ring::Stats& st = Log::ring().stats();
+    CHECK_EQ(st.records, 1000u);
+    CHECK(st.dropped > 0);
+    CHECK(Log::ring().usedWords() <= Log::Ring::kWords);
+
+    uint32_t kept = st.records - st.dropped;
+    StringPrint out;
+    CHECK_EQ(Log::ring().drain(out, 3), 3u);       // Bounded drain, oldest surviving first
+    CHECK(out.text.find("Log: " + std::to_string(st.dropped) + " record(s) lost\r\n") == 0);
+    CHECK(out.text.find("record " + std::to_string(st.dropped) + "\r\n") != std::string::npos);
+
+    out.text.clear();
+    CHECK_EQ(Log::ring().drain(out), kept - 3);
+    CHECK(out.text.find("lost") == std::string::npos); // Reported once
+    CHECK(out.text.find("record 999\r\n") != std::string::npos);
+}
+
+int sideEffects = 0;
+int touch() { return ++sideEffects; }
+
+void testCompileTimeLevels() {
+    static_assert(Log::enabled(Module::Src, Level::Info), "Default SRC level");
+    static_assert(!Log::enabled(Module::Src, Level::Debug), "Default SRC level");
+    static_assert(!Log::enabled(Module::Drv, Level::Verbose), "Frame traces are off by default");
+    static_assert(Log::enabled(Module::Drv, Level::Warn), "Driver failures are kept");
+
+    Log::ring().clear();
+    LOG_D(Src, "never %d", touch());              // Discarded branch: not even the arguments
+    LOG_V(Drv, "never %d", touch());
+    LOG_FRAME(Drv, "never %u", touch(), nullptr, 0);
+    CHECK_EQ(sideEffects, 0);
+    CHECK(Log::ring().empty());
+}
+
+void testDriverHotPath() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Sim::VirtualPulsarBus bus;
+    bus.addMeter(10128442).volumeM3 = 1.5f;
+    Driver::PulsarDu_15_20 drv(&bus, 10128442);
+    Log::ring().clear();
+
+    Driver::MeterReading r;
+    CHECK(drv.readValues(Driver::PulsarDu_15_20::kSupportedParams, r));
+    CHECK(Log::ring().empty());                   // Frames are Verbose: compiled out
+
+    Driver::PulsarDu_15_20 wrong(&bus, 12345);    // Nobody answers
+    float v;
+    CHECK(!wrong.getValue(Driver::MeterParam::TotalVolume, v));
+    std::string text = drainAll();
+    CHECK(text.find(" W DRV: RX [00012345] failed: status ") != std::string::npos);
+    HostShim::consoleEnabled() = true;
+}
+
+void testEcho() {
+    Log::ring().clear();
+    HostShim::setMillis(5);
+    StringPrint echo;
+    Log::ring().setEcho(&echo);
+    LOG_I(Sys, "now %d", 1);
+    Log::ring().setEcho(nullptr);
+    CHECK(echo.text == "5 I SYS: now 1\r\n");     // Formatted in the caller's context
+    CHECK(drainAll() == "5 I SYS: now 1\r\n");    // And still in the ring
+}
+
+} // namespace
+
+int main() {
+    testFormatting();
+    testFrames();
+    testOverwriteOldest();
+    testCompileTimeLevels();
+    testDriverHotPath();
+    testEcho();
+    return checkResult();
+}
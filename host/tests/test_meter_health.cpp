@@ -0,0 +1,478 @@
+// Per-meter health: retries with jittered backoff, the circuit breaker and
+// its skip growth, a dead meter on a shared line (inline and through the bus
+// scheduler), deep-sleep carry-over, the health attributes over Zigbee (also
+// with every metering report kind in one frame), a serial number change
+// from another task while the meter is on the bus, and battery values that
+// never come in.
+
+#include "check.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "bus/bus_retry.h"
+#include "bus/bus_scheduler.h"
+#include "drivers/pulsar_ds15_20.h"
+#include "metrics.h"
+#include "sim/virtual_pulsar.h"
+#include "sources/smart_source.h"
+#include "zigbee_water_meter.h"
+
+namespace {
+
+using Source::HealthState;
+using Source::MeterHealth;
+
+constexpr uint32_t kMinute = 60000;
+constexpr uint32_t kLive = 10128442;
+constexpr uint32_t kDead = 10128939;
+
+// Fails the first `failures` reads, then answers.
+class FlakyDriver final : public Driver::SmartMeterDriver {
+public:
+    static constexpr Driver::ParamSet kSupportedParams = Driver::paramBit(Driver::MeterParam::TotalVolume);
+
+    explicit FlakyDriver(uint32_t failures) : SmartMeterDriver(nullptr), _failures(failures) {}
+
+    Driver::ParamSet supportedParams() const override { return kSupportedParams; }
+
+    bool getValue(Driver::MeterParam, float& result) override {
+        calls.push_back(millis());
+        if (calls.size() <= _failures) return false;
+        result = 2.5f;
+        return true;
+    }
+
+    std::vector<uint32_t> calls;
+
+private:
+    uint32_t _failures;
+};
+
+// Answers the volume, never the battery.
+class NoBatteryDriver final : public Driver::SmartMeterDriver {
+public:
+    static constexpr Driver::ParamSet kSupportedParams =
+        Driver::paramBit(Driver::MeterParam::TotalVolume) | Driver::paramBit(Driver::MeterParam::BatteryVoltage);
+
+    NoBatteryDriver() : SmartMeterDriver(nullptr) {}
+
+    Driver::ParamSet supportedParams() const override { return kSupportedParams; }
+
+    bool getValue(Driver::MeterParam p, float& result) override {
+        if (p != Driver::MeterParam::TotalVolume) return false;
+        result = 2.5f;
+        return true;
+    }
+};
+
+void testBreaker() {
+    MeterHealth h;
+    CHECK(h.state() == HealthState::Ok);
+    CHECK_EQ(h.lastSuccessAgeMs(100), MeterHealth::kNever);
+    CHECK_EQ(h.retries(), MeterHealth::kRetries);
+
+    h.record(true, 1, 1000);
+    CHECK(h.state() == HealthState::Ok);
+    h.record(true, 2, 2000);                     // Only on a retry
+    CHECK(h.state() == HealthState::Degraded);
+    CHECK_EQ(h.lastSuccessAgeMs(5000), 3000u);
+
+    // Two failed polls: degraded, still polled with retries
+    h.record(false, 3, 10000);
+    h.record(false, 3, 20000);
+    CHECK(h.state() == HealthState::Degraded);
+    CHECK(h.allow(20001));
+
+    // The third opens the circuit
+    h.record(false, 3, 30000);
+    CHECK(h.state() == HealthState::Offline);
+    CHECK(!h.allow(30000 + MeterHealth::kSkipBaseMs - 1));
+    CHECK_EQ(h.msUntilAllowed(30000), MeterHealth::kSkipBaseMs);
+    CHECK(h.allow(30000 + MeterHealth::kSkipBaseMs));
+    CHECK_EQ(h.retries(), 0);                   // The probe goes out once
+
+    // Failed probes double the skip, up to the cap
+    uint32_t now = 30000 + MeterHealth::kSkipBaseMs;
+    h.record(false, 1, now);
+    CHECK_EQ(h.skipMs(), 2 * MeterHealth::kSkipBaseMs);
+    for (int i = 0; i < 10; i++) h.record(false, 1, now);
+    CHECK_EQ(h.skipMs(), MeterHealth::kSkipMaxMs);
+
+    // One good read closes it
+    h.record(true, 1, now);
+    CHECK(h.state() == HealthState::Ok);
+    CHECK(h.allow(now));
+    CHECK_EQ(h.failedPolls(), 0);
+}
+
+void testRetryBackoff() {
+    for (uint8_t k = 1; k <= 3; k++) {
+        uint32_t base = Bus::RetryPolicy::kBackoffMs << (k - 1);
+        for (int i = 0; i < 200; i++) {
+            uint32_t b = Bus::RetryPolicy::backoffMs(k);
+            CHECK(b >= base / 2 && b <= base / 2 + base);
+        }
+    }
+
+    HostShim::setMillis(1000);
+    Metrics::registry().reset();
+    FlakyDriver drv(2);
+    Driver::MeterReading r;
+    uint8_t attempts = 0;
+    CHECK(Bus::readWithRetry(&drv, FlakyDriver::kSupportedParams, r, 2, &attempts));
+    CHECK_EQ(attempts, 3);
+    CHECK_EQ(drv.calls.size(), (size_t)3);
+    CHECK(drv.calls[1] - drv.calls[0] >= Bus::RetryPolicy::kBackoffMs / 2);
+    CHECK(drv.calls[2] - drv.calls[1] >= Bus::RetryPolicy::kBackoffMs);
+    CHECK_EQ(Metrics::registry().get(Metrics::Counter::RsRetries), 2u);
+
+    FlakyDriver never(100);
+    Driver::MeterReading none;
+    CHECK(!Bus::readWithRetry(&never, FlakyDriver::kSupportedParams, none, 2, &attempts));
+    CHECK_EQ(attempts, 3);
+}
+
+struct Line {
+    Sim::VirtualPulsarBus bus;
+    Driver::PulsarDu_15_20 liveDrv;
+    Driver::PulsarDu_15_20 deadDrv;
+    Source::BasicSmartSource<Driver::PulsarDu_15_20> live;
+    Source::BasicSmartSource<Driver::PulsarDu_15_20> dead;
+
+    Line() : liveDrv(&bus, kLive), deadDrv(&bus, kDead), live(&liveDrv, 1000), dead(&deadDrv, 5000) {
+        bus.addMeter(kLive).volumeM3 = 1.0f;
+        for (auto* s : { &live, &dead }) {
+            s->setPollInterval(30 * kMinute);
+            s->begin();
+            s->tick(); // Starts the clocks
+        }
+    }
+};
+
+void testDeadMeterInline() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Metrics::registry().reset();
+    Line line;
+
+    // Every poll of the dead meter retries, until the circuit opens
+    for (int i = 0; i < MeterHealth::kTripAfter; i++) {
+        if (i) HostShim::advanceMillis(30 * kMinute);
+        uint32_t t0 = millis();
+        line.dead.forceUpdate();
+        line.dead.tick();
+        CHECK(millis() - t0 >= 3 * 300);         // Three attempts, each waits out a timeout
+    }
+    CHECK(line.dead.health().state() == HealthState::Offline);
+    CHECK_EQ(line.dead.getLiters(), 5000u);      // Nothing read, nothing lost
+
+    // Skipped: no bytes on the line, no time spent
+    uint32_t tx = line.bus.stats().txBytes;
+    uint32_t t0 = millis();
+    line.dead.forceUpdate();
+    line.dead.tick();
+    CHECK_EQ(line.bus.stats().txBytes, tx);
+    CHECK_EQ(millis(), t0);
+    CHECK_EQ(Metrics::registry().get(Metrics::Counter::RsSkipped), 1u);
+
+    // The live meter on the same line is unaffected
+    line.live.forceUpdate();
+    line.live.tick();
+    CHECK_EQ(line.live.getLiters(), 1000u);
+    CHECK(line.live.health().state() == HealthState::Ok);
+
+    // After the skip: one probe, no retries
+    HostShim::advanceMillis(MeterHealth::kSkipBaseMs);
+    tx = line.bus.stats().txBytes;
+    line.dead.forceUpdate();
+    line.dead.tick();
+    uint32_t probeBytes = line.bus.stats().txBytes - tx;
+    CHECK_EQ(probeBytes, 14u + 12u + 12u);       // One channel read, two parameter reads
+    CHECK_EQ(line.dead.health().skipMs(), 2 * MeterHealth::kSkipBaseMs);
+
+    // The meter comes back (was unplugged): first probe closes the circuit
+    line.bus.addMeter(kDead).volumeM3 = 5.5f;
+    HostShim::advanceMillis(2 * MeterHealth::kSkipBaseMs);
+    line.dead.forceUpdate();
+    line.dead.tick();
+    CHECK(line.dead.health().state() == HealthState::Ok);
+    CHECK_EQ(line.dead.getLiters(), 5500u);
+    HostShim::consoleEnabled() = true;
+}
+
+void testDeadMeterOnScheduler() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Line line;
+    Bus::BusScheduler sched;
+    line.live.setBusScheduler(&sched, 1);
+    line.dead.setBusScheduler(&sched, 0);
+
+    auto poll = [&]() {
+        line.live.forceUpdate();
+        line.dead.forceUpdate();
+        line.live.tick();
+        line.dead.tick();
+        uint32_t t0 = millis();
+        sched.runBurst();
+        uint32_t spent = millis() - t0;
+        line.live.tick();
+        line.dead.tick();
+        HostShim::advanceMillis(30 * kMinute);
+        return spent;
+    };
+
+    uint32_t before = 0;
+    for (int i = 0; i < MeterHealth::kTripAfter; i++) before = poll();
+    CHECK(line.dead.health().state() == HealthState::Offline);
+    CHECK(!line.dead.awaitingData());
+
+    uint32_t after = poll();                     // Only the live meter goes out
+    CHECK(after * 10 < before);
+    CHECK_EQ(sched.stats().transactions, 2u * MeterHealth::kTripAfter + 1);
+    CHECK_EQ(line.live.getLiters(), 1000u);
+
+    // Another serial on the source: a fresh start, polled again at once
+    line.dead.setSerialNumber(kLive);
+    CHECK(line.dead.health().state() == HealthState::Ok);
+    poll();
+    CHECK_EQ(line.dead.getLiters(), 1000u);
+    HostShim::consoleEnabled() = true;
+}
+
+void testSnapshotKeepsBreaker() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Line a;
+    for (int i = 0; i < MeterHealth::kTripAfter; i++) {
+        a.dead.forceUpdate();
+        a.dead.tick();
+    }
+    CHECK(a.dead.health().state() == HealthState::Offline);
+    Source::SourceSnapshot snap = a.dead.snapshot(millis());
+
+    // Slept 10 of the 60 skip minutes: still skipped on the wake-up poll
+    HostShim::setMillis(300);
+    Line b;
+    b.dead.resume(snap, 10 * kMinute, millis());
+    CHECK(b.dead.health().state() == HealthState::Offline);
+    CHECK_EQ(b.dead.health().msUntilAllowed(millis()), MeterHealth::kSkipBaseMs - 10 * kMinute);
+    uint32_t tx = b.bus.stats().txBytes;
+    b.dead.tick();
+    CHECK_EQ(b.bus.stats().txBytes, tx);
+
+    // Last success carries over with the sleep added
+    snap = b.live.snapshot(millis());
+    CHECK_EQ(snap.lastOkAgoMs, MeterHealth::kNever);
+    b.live.forceUpdate();
+    b.live.tick();
+    snap = b.live.snapshot(millis());
+    Line c;
+    c.live.resume(snap, 5 * kMinute, millis());
+    CHECK_EQ(c.live.health().lastSuccessAgeMs(millis()), 5 * kMinute);
+    HostShim::consoleEnabled() = true;
+}
+
+void testZigbeeReport() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Line line;
+    ZigbeeWaterMeter ep(1);
+    ep.setSource(&line.dead);
+    ep.begin();
+    ep.registerAttributes();
+    auto attr = [](uint16_t id) {
+        const std::vector<uint8_t>& v = HostZigbee::attributes()[std::make_tuple((uint8_t)1, (uint16_t)ESP_ZB_ZCL_CLUSTER_ID_METERING, id)];
+        uint32_t x = 0;
+        for (size_t i = 0; i < 4 && i < v.size(); i++) x |= (uint32_t)v[i] << (8 * i);
+        return x;
+    };
+
+    ep.reportValue();
+    CHECK(!ep.shouldReport(millis()));
+
+    line.dead.forceUpdate();
+    line.dead.tick();
+    CHECK(ep.shouldReport(millis()));            // Ok -> Degraded is news
+    CHECK_EQ(ep.msUntilReport(millis()), 0u);
+    ep.reportValue();
+    CHECK_EQ(attr(kAttrMeterHealth), 1u);
+    CHECK_EQ(attr(kAttrLastReadAge), MeterHealth::kNever);
+
+    line.bus.addMeter(kDead).volumeM3 = 5.0f;
+    HostShim::advanceMillis(kMinute);
+    line.dead.forceUpdate();
+    line.dead.tick();
+    HostShim::advanceMillis(90000);
+    CHECK(ep.shouldReport(millis()));
+    ep.reportValue();
+    CHECK_EQ(attr(kAttrMeterHealth), 0u);
+    CHECK_EQ(attr(kAttrLastReadAge), 90u);
+    HostZigbee::stats() = HostZigbee::Stats{};
+    HostShim::consoleEnabled() = true;
+}
+
+// Attribute IDs of a Report Attributes frame (ZCL header, then id, type, value).
+std::vector<uint16_t> reportedIds(const std::vector<uint8_t>& asdu) {
+    std::vector<uint16_t> ids;
+    for (size_t i = 3; i + 3 <= asdu.size();) {
+        ids.push_back(asdu[i] | asdu[i + 1] << 8);
+        uint8_t type = asdu[i + 2];
+        i += 3 + (type == ESP_ZB_ZCL_ATTR_TYPE_U48 ? 6 : type == ESP_ZB_ZCL_ATTR_TYPE_U32 ? 4 : 1);
+    }
+    return ids;
+}
+
+// Config + Hourly + Value pending together while the health changes: all of
+// it goes out in one metering frame, and the health change is not reported twice.
+void testAllKindsInOneFrame() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Line line;
+    ZigbeeWaterMeter ep(1);
+    ep.setSource(&line.dead);
+    ep.begin();
+    ep.registerAttributes();
+    ep.reportValue();
+
+    line.dead.forceUpdate();
+    line.dead.tick();                            // Ok -> Degraded
+    CHECK(ep.shouldReport(millis()));
+
+    ReportScheduler<1> sched(100);
+    sched.addEndpoint(&ep);
+    HostZigbee::stats() = HostZigbee::Stats{};
+    sched.post(0, ReportKind::Config);
+    sched.post(0, ReportKind::Hourly);
+    sched.post(0, ReportKind::Value);
+    CHECK(sched.run(millis()));
+    CHECK_EQ(HostZigbee::stats().frames(), 1u);
+    CHECK_EQ(ep.meteringReportStats().fallbacks, 0u);
+    std::vector<uint16_t> ids = reportedIds(HostZigbee::stats().apsFrames[0].asdu);
+    CHECK((ids == std::vector<uint16_t>{ kAttrIdOffset, kAttrIdSerialNumber, kAttrPollIntervalMin,
+                                         kAttrPollIntervalMax, kAttrHourlyConsumption, 0x0000,
+                                         kAttrMeterHealth, kAttrLastReadAge }));
+    CHECK(!ep.shouldReport(millis()));           // The change went out with the rest
+
+    HostZigbee::stats() = HostZigbee::Stats{};
+    HostShim::consoleEnabled() = true;
+}
+
+// Answers once the test opens the gate; reads no clock (runs on its own thread).
+class GateDriver final : public Driver::SmartMeterDriver {
+public:
+    static constexpr Driver::ParamSet kSupportedParams = Driver::paramBit(Driver::MeterParam::TotalVolume);
+
+    GateDriver() : SmartMeterDriver(nullptr) {}
+
+    Driver::ParamSet supportedParams() const override { return kSupportedParams; }
+
+    bool getValue(Driver::MeterParam, float& result) override {
+        inside = true;
+        while (!open) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        inside = false;
+        result = 1.0f;
+        return true;
+    }
+
+    std::atomic<bool> inside{ false };
+    std::atomic<bool> open{ false };
+};
+
+void testSerialChangeFromOtherTask() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Line line;
+    Bus::BusScheduler sched;
+    line.dead.setBusScheduler(&sched, 0);
+    line.dead.forceUpdate();
+    line.dead.tick();
+    CHECK(line.dead.awaitingData());
+
+    // Written by the Zigbee task: reported at once, applied by the next tick()
+    line.dead.requestSerialNumber(kLive);
+    CHECK_EQ(line.dead.getSerialNumber(), kLive);
+    CHECK(line.dead.awaitingData());             // Request for the old address untouched
+    line.dead.tick();
+    sched.runBurst();                            // Only the request for the new address is left
+    CHECK_EQ(sched.stats().transactions, 1u);
+    line.dead.tick();
+    CHECK_EQ(line.dead.getLiters(), 1000u);
+    CHECK(!line.dead.awaitingData());
+
+    // cancel() of a read that is on the bus returns only once the driver is free
+    GateDriver gate;
+    Bus::BusScheduler::Ticket t = sched.submit(&gate, GateDriver::kSupportedParams, 0, millis() + kMinute);
+    std::thread bus([&] { sched.runBurst(); });
+    while (!gate.inside) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::atomic<bool> cancelled{ false };
+    std::thread owner([&] {
+        sched.cancel(t);
+        cancelled = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(!cancelled);
+    gate.open = true;
+    owner.join();
+    CHECK(cancelled);
+    CHECK(!gate.inside);
+    bus.join();
+    CHECK(sched.idle());
+    Driver::MeterReading r;
+    bool ok = false;
+    CHECK(!sched.poll(t, r, ok));                // Dropped, not delivered
+    HostShim::consoleEnabled() = true;
+}
+
+// A meter whose battery values never come in still reads its volume: it
+// stays Ok, inline and through the bus, and the misses are counted apart.
+void testBatteryFailureIsNotMeterFailure() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Metrics::registry().reset();
+    NoBatteryDriver inlineDrv, busDrv;
+    Source::BasicSmartSource<NoBatteryDriver> inlineSrc(&inlineDrv, 0);
+    Source::BasicSmartSource<NoBatteryDriver> busSrc(&busDrv, 0);
+    Bus::BusScheduler sched;
+    busSrc.setBusScheduler(&sched, 0);
+    for (auto* s : { &inlineSrc, &busSrc }) {
+        s->setPollInterval(kMinute);
+        s->begin();
+        s->tick(); // Starts the clocks
+    }
+
+    for (int i = 0; i < 5; i++) {
+        HostShim::advanceMillis(kMinute);
+        for (auto* s : { &inlineSrc, &busSrc }) {
+            s->forceUpdate();
+            s->tick();
+        }
+        sched.runBurst();
+        busSrc.tick();
+    }
+    for (auto* s : { &inlineSrc, &busSrc }) {
+        CHECK(s->health().state() == HealthState::Ok);
+        CHECK_EQ(s->health().failedPolls(), 0);
+        CHECK_EQ(s->getLiters(), (uint64_t)2500);
+    }
+    CHECK_EQ(Metrics::registry().get(Metrics::Counter::BatteryFails), 10u);
+    CHECK(Metrics::registry().get(Metrics::Counter::RsRetries) > 0); // The battery still gets its retries
+    HostShim::consoleEnabled() = true;
+}
+
+} // namespace
+
+int main() {
+    testBreaker();
+    testRetryBackoff();
+    testDeadMeterInline();
+    testDeadMeterOnScheduler();
+    testSnapshotKeepsBreaker();
+    testZigbeeReport();
+    testAllKindsInOneFrame();
+    testSerialChangeFromOtherTask();
+    testBatteryFailureIsNotMeterFailure();
+    return checkResult();
+}
@@ -0,0 +1,166 @@
+// Metrics registry: counters, log2 histograms and their percentiles, the
+// hourly roll, the serial line, and the instrumented hot paths (Pulsar
+// driver, endpoint flush) feeding the diagnostics cluster.
+
+#include "check.h"
+
+#include <string>
+
+#include "diagnostics_cluster.h"
+#include "drivers/pulsar_ds15_20.h"
+#include "metrics.h"
+#include "sim/virtual_pulsar.h"
+#include "sources/simulation_source.h"
+#include "zigbee_water_meter.h"
+
+namespace {
+
+using Metrics::Counter;
+using Metrics::Histogram;
+
+class StringPrint : public Print {
+public:
+    std::string text;
+    size_t write(uint8_t b) override {
+        text += (char)b;
+        return 1;
+    }
+};
+
+void testCountersAndHistograms() {
+    Metrics::Registry r;
+    r.add(Counter::RsTransactions);
+    r.add(Counter::RsTransactions, 4);
+    r.set(Counter::Wakeups, 77);
+    CHECK_EQ(r.get(Counter::RsTransactions), 5u);
+    CHECK_EQ(r.get(Counter::Wakeups), 77u);
+
+    // Lock wait, 1 us steps: 0 -> bucket 0, 1 -> 1, 2..3 -> 2, 100 -> 7 ([64, 128))
+    for (uint32_t v : { 0u, 1u, 3u, 100u, 100u, 100u, 100u, 100u, 100u, 5000u }) r.record(Histogram::ZbLockWaitUs, v);
+    CHECK_EQ(r.count(Histogram::ZbLockWaitUs), 10u);
+    CHECK_EQ(r.bucketCount(Histogram::ZbLockWaitUs, 0), 1u);
+    CHECK_EQ(r.bucketCount(Histogram::ZbLockWaitUs, 2), 1u);
+    CHECK_EQ(r.bucketCount(Histogram::ZbLockWaitUs, 7), 6u);
+    CHECK_EQ(r.max(Histogram::ZbLockWaitUs), 5000u);
+    CHECK_EQ(r.mean(Histogram::ZbLockWaitUs), 560u);
+    CHECK_EQ(r.percentile(Histogram::ZbLockWaitUs, 50), 128u); // Upper bound of [64, 128)
+    CHECK_EQ(r.percentile(Histogram::ZbLockWaitUs, 100), 5000u); // Capped at the max
+
+    // RS485 counts in 64 us steps; anything from 1 s up shares the last bucket
+    r.record(Histogram::RsTransactionUs, 63);
+    r.record(Histogram::RsTransactionUs, 3000000);
+    CHECK_EQ(r.bucketCount(Histogram::RsTransactionUs, 0), 1u);
+    CHECK_EQ(r.bucketCount(Histogram::RsTransactionUs, Metrics::kBuckets - 1), 1u);
+    CHECK_EQ(Metrics::bucketFloor(Histogram::RsTransactionUs, Metrics::kBuckets - 1), 1048576u);
+    CHECK_EQ(r.percentile(Histogram::ZbLockHoldUs, 50), 0u); // Empty
+}
+
+void testHourlyRoll() {
+    Metrics::Registry r;
+    r.add(Counter::ReportFrames, 10);
+    r.roll(1000);                                // First hour not over
+    CHECK_EQ(r.lastHour(Counter::ReportFrames), 0u);
+    r.roll(3600000);
+    CHECK_EQ(r.lastHour(Counter::ReportFrames), 10u);
+    r.add(Counter::ReportFrames, 3);
+    r.roll(3600000 + 3599999);
+    CHECK_EQ(r.lastHour(Counter::ReportFrames), 10u);
+    r.roll(7200000);
+    CHECK_EQ(r.lastHour(Counter::ReportFrames), 3u);
+    CHECK_EQ(r.get(Counter::ReportFrames), 13u);
+}
+
+void testDump() {
+    Metrics::Registry r;
+    r.add(Counter::RsTransactions, 12);
+    r.add(Counter::RsTimeouts);
+    r.record(Histogram::RsTransactionUs, 40000);
+    StringPrint out;
+    r.dump(out, 125000);
+    CHECK(out.text.find("Metrics: up=125s rs_txn=12(0) rs_crc=0(0) rs_to=1(0)") == 0);
+    CHECK(out.text.find(" rs_us=40000/40000/40000 ") != std::string::npos);
+    CHECK(out.text.back() == '\n');
+    CHECK(out.text.size() < 256);                // One printf buffer
+}
+
+void testDriverInstrumentation() {
+    HostShim::consoleEnabled() = false;
+    Metrics::registry().reset();
+    Sim::VirtualPulsarBus line;
+    line.addMeter(10128442);
+    line.meter(10128442)->volumeM3 = 1.5f;
+
+    Driver::PulsarDu_15_20 ok(&line, 10128442);
+    float v;
+    CHECK(ok.getValue(Driver::MeterParam::TotalVolume, v));
+    CHECK_EQ(Metrics::registry().get(Counter::RsTransactions), 1u);
+    CHECK_EQ(Metrics::registry().get(Counter::RsTimeouts), 0u);
+    uint32_t txn = Metrics::registry().max(Histogram::RsTransactionUs);
+    CHECK(txn > 5000 && txn < 100000);          // Latency + 14 + 14 bytes at 9600 baud
+
+    Driver::PulsarDu_15_20 absent(&line, 99999999);
+    CHECK(!absent.getValue(Driver::MeterParam::TotalVolume, v));
+    CHECK_EQ(Metrics::registry().get(Counter::RsTransactions), 2u);
+    CHECK_EQ(Metrics::registry().get(Counter::RsTimeouts), 1u);
+    CHECK(Metrics::registry().max(Histogram::RsTransactionUs) >= 300000); // Waited out the response timeout
+    HostShim::consoleEnabled() = true;
+}
+
+void testEndpointAndCluster() {
+    HostShim::consoleEnabled() = false;
+    Metrics::registry().reset();
+    Source::SimulationSource src(1000);
+    ZigbeeWaterMeter ep(1, true);
+    ep.setSource(&src);
+    ep.enableDiagnostics();
+    ep.begin();
+    ep.registerAttributes();
+
+    ep.queueValue();
+    ep.queueBattery();
+    ep.flushReports();                          // Metering + power: two frames, one lock window
+    ep.reportValue();
+    CHECK_EQ(Metrics::registry().get(Counter::ReportFrames), 3u);
+    CHECK_EQ(Metrics::registry().count(Histogram::ZbLockHoldUs), 2u);
+    CHECK_EQ(Metrics::registry().count(Histogram::ZbLockWaitUs), 2u);
+
+    Metrics::registry().add(Counter::NvsWrites, 4);
+    typedef Metrics::DiagnosticsCluster Diag;
+    Diag::refresh(1, 90500);
+    auto attr = [](uint16_t id) {
+        const std::vector<uint8_t>& v = HostZigbee::attributes()[std::make_tuple((uint8_t)1, Diag::kClusterId, id)];
+        uint32_t x = 0;
+        for (size_t i = 0; i < 4 && i < v.size(); i++) x |= (uint32_t)v[i] << (8 * i);
+        return x;
+    };
+    CHECK_EQ(attr(Diag::kAttrUptime), 90u);
+    CHECK_EQ(attr(Diag::kAttrCounters + (uint16_t)Counter::ReportFrames), 3u);
+    CHECK_EQ(attr(Diag::kAttrCounters + (uint16_t)Counter::NvsWrites), 4u);
+    CHECK_EQ(attr(Diag::histogramAttr(Histogram::ZbLockHoldUs, 0)), 2u);
+
+    const std::vector<uint8_t>& buckets =
+        HostZigbee::attributes()[std::make_tuple((uint8_t)1, Diag::kClusterId, Diag::histogramAttr(Histogram::ZbLockHoldUs, 5))];
+    CHECK_EQ(buckets.size(), 1 + Diag::kBucketsLen);
+    uint32_t total = 0;
+    for (size_t b = 0; b < Metrics::kBuckets; b++) total += buckets[1 + 2 * b] | (buckets[2 + 2 * b] << 8);
+    CHECK_EQ(total, 2u);
+
+    // Endpoints without the cluster do not register it
+    ZigbeeWaterMeter plain(2);
+    plain.begin();
+    plain.registerAttributes();
+    CHECK(HostZigbee::attributeTypes().count(std::make_tuple((uint8_t)2, Diag::kClusterId, Diag::kAttrUptime)) == 0);
+    HostZigbee::stats() = HostZigbee::Stats{};
+    HostShim::consoleEnabled() = true;
+}
+
+} // namespace
+
+int main() {
+    testCountersAndHistograms();
+    testHourlyRoll();
+    testDump();
+    testDriverInstrumentation();
+    testEndpointAndCluster();
+    return checkResult();
+}
@@ -0,0 +1,316 @@
+// Generic Modbus RTU driver: value decoding for every type and word order,
+// coalescing of a register map into few reads (gaps, block limit, function
+// change), exception and foreign replies, the hole fallback for strict
+// slaves, and a Modbus_Generic channel built by the factories and polled
+// through the bus scheduler.
+
+#include "check.h"
+
+#include <cmath>
+#include <memory>
+
+#include "bus/bus_scheduler.h"
+#include "drivers/driver_factory.h"
+#include "metrics.h"
+#include "sim/virtual_modbus.h"
+#include "sources/factory_source.h"
+#include "sources/smart_source.h"
+
+namespace {
+
+using Driver::MeterParam;
+using Driver::ModbusRegister;
+using Driver::ModbusRegisterMap;
+using Driver::ModbusRtu;
+using Driver::ModbusType;
+using Driver::WordOrder;
+
+constexpr uint8_t kSlave = 17;
+
+bool near(float a, float b) { return std::fabs(a - b) <= 1e-4f * (1.0f + std::fabs(b)); }
+
+// Heat/water meter with input registers for the live values (32-bit words
+// swapped, temperatures in the holes) and a holding block for the battery
+// settings, one setting far off in its own page.
+constexpr ModbusRegister kHeatMeterRegs[] = {
+    { MeterParam::TotalVolume,           0x04, 0x0100, ModbusType::U32,     WordOrder::LowFirst,  10.0f  }, // 10 L units
+    { MeterParam::FlowRateMax,           0x04, 0x0102, ModbusType::Float32, WordOrder::LowFirst,  1.0f   },
+    { MeterParam::FlowRateMin,           0x04, 0x0108, ModbusType::Float32, WordOrder::LowFirst,  1.0f   },
+    { MeterParam::BatteryVoltage,        0x04, 0x0110, ModbusType::U16,     WordOrder::HighFirst, 0.01f  },
+    { MeterParam::BatteryThresholdMin,   0x03, 0x2000, ModbusType::U16,     WordOrder::HighFirst, 0.01f  },
+    { MeterParam::BatteryThresholdAlarm, 0x03, 0x2001, ModbusType::U16,     WordOrder::HighFirst, 0.01f  },
+    { MeterParam::BatteryThresholdMax,   0x03, 0x2040, ModbusType::S16,     WordOrder::HighFirst, 0.01f  },
+};
+constexpr ModbusRegisterMap kHeatMeterMap = { kHeatMeterRegs, sizeof(kHeatMeterRegs) / sizeof(kHeatMeterRegs[0]) };
+
+void fillHeatMeter(Sim::ModbusSlaveState& s) {
+    s.setU32(0x04, 0x0100, 12345, false);
+    s.setFloat(0x04, 0x0102, 2.5f, false);
+    for (uint16_t a = 0x0104; a < 0x0108; a++) s.setU16(0x04, a, 0x1234); // Temperatures
+    s.setFloat(0x04, 0x0108, 0.015f, false);
+    s.setU16(0x04, 0x0110, 361);
+    s.setU16(0x03, 0x2000, 300);
+    s.setU16(0x03, 0x2001, 320);
+    s.setU16(0x03, 0x2040, (uint16_t)-5);
+}
+
+void testDecode() {
+    const uint8_t u16[] = { 0x12, 0x34 };
+    const uint8_t s16[] = { 0xFF, 0xFE };
+    const uint8_t abcd[] = { 0x00, 0x01, 0x86, 0xA0 };   // 100000
+    const uint8_t cdab[] = { 0x86, 0xA0, 0x00, 0x01 };
+    const uint8_t neg[] = { 0xFF, 0xFF, 0xFF, 0x9C };    // -100
+    const uint8_t fAbcd[] = { 0x40, 0x49, 0x0F, 0xDB }; // pi
+    const uint8_t fCdab[] = { 0x0F, 0xDB, 0x40, 0x49 };
+
+    auto reg = [](ModbusType t, WordOrder o, float scale) {
+        return ModbusRegister{ MeterParam::TotalVolume, 0x03, 0, t, o, scale };
+    };
+    CHECK(near(ModbusRtu::decode(u16, reg(ModbusType::U16, WordOrder::HighFirst, 1.0f)), 0x1234));
+    CHECK(near(ModbusRtu::decode(s16, reg(ModbusType::S16, WordOrder::HighFirst, 0.5f)), -1.0f));
+    CHECK(near(ModbusRtu::decode(abcd, reg(ModbusType::U32, WordOrder::HighFirst, 0.001f)), 100.0f));
+    CHECK(near(ModbusRtu::decode(cdab, reg(ModbusType::U32, WordOrder::LowFirst, 0.001f)), 100.0f));
+    CHECK(near(ModbusRtu::decode(neg, reg(ModbusType::S32, WordOrder::HighFirst, 1.0f)), -100.0f));
+    CHECK(near(ModbusRtu::decode(fAbcd, reg(ModbusType::Float32, WordOrder::HighFirst, 1.0f)), 3.14159265f));
+    CHECK(near(ModbusRtu::decode(fCdab, reg(ModbusType::Float32, WordOrder::LowFirst, 2.0f)), 6.2831853f));
+
+    static_assert(ModbusRtu::kSupportedParams == Driver::modbusParams(Driver::kModbusMeterMap), "map params");
+    static_assert(Driver::MeterTraits<Driver::MeterModel::Modbus_Generic>::kParams == ModbusRtu::kSupportedParams,
+                  "traits params");
+}
+
+void testDefaultMapCoalesced() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Metrics::registry().reset();
+    Sim::VirtualModbusBus bus;
+    Sim::ModbusSlaveState& s = bus.addSlave(kSlave);
+    s.zeroFillHoles = true;
+    s.setU32(0x03, 0x0000, 1234567);             // L
+    s.setU16(0x03, 0x0004, 3600);                // mV
+    s.setU16(0x03, 0x0005, 3000);
+    s.setU16(0x03, 0x0006, 3200);
+    s.setFloat(0x03, 0x0020, 1.25f, false);
+    ModbusRtu drv(&bus, kSlave);
+
+    // The poll of a Smart source: volume + battery in one read
+    Driver::MeterReading r;
+    Driver::ParamSet poll = Driver::paramBit(MeterParam::TotalVolume) | Driver::paramBit(MeterParam::BatteryVoltage) |
+                            Driver::paramBit(MeterParam::BatteryThresholdMin);
+    CHECK(drv.readValues(poll, r));
+    CHECK_EQ(bus.stats().requests, 1u);
+    CHECK_EQ(bus.stats().wordsRead, 6u);
+    CHECK(near(r.get(MeterParam::TotalVolume), 1234.567f));
+    CHECK(near(r.get(MeterParam::BatteryVoltage), 3.6f));
+    CHECK(near(r.get(MeterParam::BatteryThresholdMin), 3.0f));
+    CHECK_EQ(Metrics::registry().get(Metrics::Counter::RsTransactions), 1u);
+
+    // Everything: the flow register is too far off to bridge
+    bus.resetStats();
+    Driver::MeterReading all;
+    CHECK(drv.readValues(ModbusRtu::kSupportedParams, all));
+    CHECK_EQ(bus.stats().requests, 2u);
+    CHECK(near(all.get(MeterParam::FlowRateMax), 1.25f));
+    CHECK(near(all.get(MeterParam::BatteryThresholdAlarm), 3.2f));
+
+    // Single parameter
+    float v = 0;
+    CHECK(drv.getValue(MeterParam::BatteryThresholdAlarm, v));
+    CHECK(near(v, 3.2f));
+    CHECK(!drv.getValue(MeterParam::FlowRateMin, v)); // Not in the map: no request
+    CHECK_EQ(bus.stats().requests, 3u);
+    HostShim::consoleEnabled() = true;
+}
+
+void testHeatMeterMap() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Sim::VirtualModbusBus bus;
+    fillHeatMeter(bus.addSlave(kSlave));
+    ModbusRtu drv(&bus, kSlave, kHeatMeterMap);
+    CHECK_EQ(drv.supportedParams(), Driver::modbusParams(kHeatMeterMap));
+
+    // Seven registers, four reads: 0x04 0x0100 x10 (temperature hole
+    // bridged), 0x04 0x0110 x1, 0x03 0x2000 x2 and 0x03 0x2040 x1.
+    Driver::MeterReading r;
+    CHECK(drv.readValues(drv.supportedParams(), r));
+    CHECK_EQ(bus.stats().requests, 4u);
+    CHECK_EQ(bus.stats().wordsRead, 10u + 1u + 2u + 1u);
+    CHECK(near(r.get(MeterParam::TotalVolume), 123450.0f));
+    CHECK(near(r.get(MeterParam::FlowRateMax), 2.5f));
+    CHECK(near(r.get(MeterParam::FlowRateMin), 0.015f));
+    CHECK(near(r.get(MeterParam::BatteryVoltage), 3.61f));
+    CHECK(near(r.get(MeterParam::BatteryThresholdMin), 3.0f));
+    CHECK(near(r.get(MeterParam::BatteryThresholdAlarm), 3.2f));
+    CHECK(near(r.get(MeterParam::BatteryThresholdMax), -0.05f));
+    CHECK_EQ(drv.stats().exceptions, 0u);
+
+    // Requested out of map order: still sorted into the same reads
+    bus.resetStats();
+    Driver::MeterReading two;
+    CHECK(drv.readValues(Driver::paramBit(MeterParam::FlowRateMin) | Driver::paramBit(MeterParam::TotalVolume) |
+                         Driver::paramBit(MeterParam::FlowRateMax), two));
+    CHECK_EQ(bus.stats().requests, 1u);
+    CHECK_EQ(bus.stats().wordsRead, 10u);
+
+    // Without the flow register between them the hole is too wide
+    bus.resetStats();
+    Driver::MeterReading apart;
+    CHECK(drv.readValues(Driver::paramBit(MeterParam::FlowRateMin) | Driver::paramBit(MeterParam::TotalVolume), apart));
+    CHECK_EQ(bus.stats().requests, 2u);
+    CHECK_EQ(bus.stats().wordsRead, 4u);
+    HostShim::consoleEnabled() = true;
+}
+
+void testBlockLimit() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    // One U32 every 6 words: a block grows past kMaxReadWords and is split
+    static ModbusRegister regs[Driver::kMeterParamCount];
+    for (size_t i = 0; i < Driver::kMeterParamCount; i++) {
+        regs[i] = { (MeterParam)i, 0x03, (uint16_t)(i * 6), ModbusType::U32, WordOrder::HighFirst, 1.0f };
+    }
+    ModbusRegisterMap map = { regs, Driver::kMeterParamCount };
+    Sim::VirtualModbusBus bus;
+    Sim::ModbusSlaveState& s = bus.addSlave(kSlave);
+    s.zeroFillHoles = true;
+    for (size_t i = 0; i < Driver::kMeterParamCount; i++) s.setU32(0x03, (uint16_t)(i * 6), (uint32_t)(100 + i));
+    ModbusRtu drv(&bus, kSlave, map);
+
+    // Holes of 4 words are bridged; 7 registers x 6 words - 4 = 38 > 32
+    Driver::MeterReading r;
+    CHECK(drv.readValues(drv.supportedParams(), r));
+    CHECK_EQ(bus.stats().requests, 2u);
+    for (size_t i = 0; i < Driver::kMeterParamCount; i++) CHECK(near(r.get((MeterParam)i), 100.0f + i));
+
+    // Holes of 5 words are not
+    for (size_t i = 0; i < Driver::kMeterParamCount; i++) regs[i].address = (uint16_t)(i * 7);
+    for (size_t i = 0; i < Driver::kMeterParamCount; i++) s.setU32(0x03, (uint16_t)(i * 7), (uint32_t)(200 + i));
+    bus.resetStats();
+    Driver::MeterReading split;
+    CHECK(drv.readValues(drv.supportedParams(), split));
+    CHECK_EQ(bus.stats().requests, (uint32_t)Driver::kMeterParamCount);
+    CHECK(near(split.get(MeterParam::FlowRateMax), 200.0f + (size_t)MeterParam::FlowRateMax));
+    HostShim::consoleEnabled() = true;
+}
+
+void testStrictSlaveHoles() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Sim::VirtualModbusBus bus;
+    Sim::ModbusSlaveState& s = bus.addSlave(kSlave);   // No registers 0x0002..0x0003
+    s.setU32(0x03, 0x0000, 5000);
+    s.setU16(0x03, 0x0004, 3600);
+    s.setU16(0x03, 0x0005, 3000);
+    ModbusRtu drv(&bus, kSlave);
+    Driver::ParamSet poll = Driver::paramBit(MeterParam::TotalVolume) | Driver::paramBit(MeterParam::BatteryVoltage) |
+                            Driver::paramBit(MeterParam::BatteryThresholdMin);
+
+    // Bridged read refused, then the two blocks one by one
+    Driver::MeterReading r;
+    CHECK(drv.readValues(poll, r));
+    CHECK_EQ(bus.stats().exceptions, 1u);
+    CHECK_EQ(bus.stats().replies, 2u);
+    CHECK_EQ(drv.stats().exceptions, 1u);
+    CHECK_EQ(drv.maxGapWords(), 0);
+    CHECK(near(r.get(MeterParam::TotalVolume), 5.0f));
+
+    // Learned: no more exceptions
+    bus.resetStats();
+    Driver::MeterReading again;
+    CHECK(drv.readValues(poll, again));
+    CHECK_EQ(bus.stats().requests, 2u);
+    CHECK_EQ(bus.stats().exceptions, 0u);
+
+    // An unmapped register itself is a plain failure
+    Driver::MeterReading alarm;
+    CHECK(!drv.readValues(Driver::paramBit(MeterParam::BatteryThresholdAlarm), alarm));
+    CHECK_EQ(alarm.valid, 0u);
+    HostShim::consoleEnabled() = true;
+}
+
+void testFailures() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Metrics::registry().reset();
+    Sim::VirtualModbusBus bus;
+    fillHeatMeter(bus.addSlave(kSlave));
+
+    // Nobody at that id: timeout
+    ModbusRtu absent(&bus, kSlave + 1, kHeatMeterMap);
+    Driver::MeterReading r;
+    uint32_t t0 = millis();
+    CHECK(!absent.readValues(Driver::paramBit(MeterParam::TotalVolume), r));
+    CHECK(millis() - t0 >= 300);
+    CHECK_EQ(Metrics::registry().get(Metrics::Counter::RsTimeouts), 1u);
+
+    // Out of range ids never go out
+    ModbusRtu broadcast(&bus, 0, kHeatMeterMap);
+    CHECK(!broadcast.readValues(Driver::paramBit(MeterParam::TotalVolume), r));
+    ModbusRtu tooHigh(&bus, 248, kHeatMeterMap);
+    CHECK(!tooHigh.readValues(Driver::paramBit(MeterParam::TotalVolume), r));
+    CHECK_EQ(bus.stats().txBytes, 8u);
+
+    // Exception replies end on the idle line, not on the response timeout
+    bus.slave(kSlave)->input.erase(0x0110);
+    ModbusRtu drv(&bus, kSlave, kHeatMeterMap);
+    t0 = millis();
+    CHECK(!drv.readValues(Driver::paramBit(MeterParam::BatteryVoltage), r));
+    CHECK(millis() - t0 < 100);
+    CHECK_EQ(drv.stats().exceptions, 1u);
+    CHECK_EQ(Metrics::registry().get(Metrics::Counter::RsTimeouts), 1u);
+
+    // Partial success: the other reads still land
+    Driver::MeterReading part;
+    CHECK(!drv.readValues(drv.supportedParams(), part));
+    CHECK(part.has(MeterParam::TotalVolume));
+    CHECK(part.has(MeterParam::BatteryThresholdMax));
+    CHECK(!part.has(MeterParam::BatteryVoltage));
+    HostShim::consoleEnabled() = true;
+}
+
+void testFactoryChannelOnScheduler() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Sim::VirtualModbusBus bus;
+    Sim::ModbusSlaveState& s = bus.addSlave(kSlave);
+    s.zeroFillHoles = true;
+    s.setU32(0x03, 0x0000, 42500);
+    s.setU16(0x03, 0x0004, 3550);
+    s.setU16(0x03, 0x0005, 3000);
+
+    std::unique_ptr<Driver::SmartMeterDriver> drv(Driver::DriverFactory::create(Driver::MeterModel::Modbus_Generic, &bus, kSlave));
+    CHECK(drv != nullptr);
+    CHECK_EQ(Driver::capabilities(Driver::MeterModel::Modbus_Generic), ModbusRtu::kSupportedParams);
+    std::unique_ptr<Source::WaterSource> base(Source::SourceFactory::createSmart(Driver::MeterModel::Modbus_Generic, 0, drv.get()));
+    auto* src = static_cast<Source::BasicSmartSource<ModbusRtu>*>(base.get());
+    Bus::BusScheduler sched;
+    src->setBusScheduler(&sched, 0);
+    src->setPollInterval(30 * 60000);
+    src->begin();
+    src->tick();
+
+    src->forceUpdate();
+    src->tick();
+    CHECK(src->awaitingData());
+    sched.runBurst();
+    src->tick();
+    CHECK_EQ(src->getLiters(), 42500u);
+    CHECK(near(src->getBatteryVoltage(), 3.55f));
+    CHECK_EQ(bus.stats().requests, 1u);         // One transaction per poll
+    CHECK_EQ(sched.stats().transactions, 1u);
+    HostShim::consoleEnabled() = true;
+}
+
+} // namespace
+
+int main() {
+    testDecode();
+    testDefaultMapCoalesced();
+    testHeatMeterMap();
+    testBlockLimit();
+    testStrictSlaveHoles();
+    testFailures();
+    testFactoryChannelOnScheduler();
+    return checkResult();
+}
@@ -0,0 +1,106 @@
+// PcntSource accumulation and wrap handling against a fake hardware counter.
+
+#include "check.h"
+
+#include "sources/factory_source.h"
+
+namespace {
+
+// Behaves like the PCNT unit: wraps to 0 at limit and counts the wraps.
+class FakePulseCounter : public PulseCounter {
+public:
+    explicit FakePulseCounter(int32_t limit) : _limit(limit) {}
+
+    bool begin() override { return true; }
+    int32_t count() override {
+        int32_t c = _count;
+        // Simulate an edge landing between the overflows() and count() reads.
+        if (_wrapDuringRead) {
+            _wrapDuringRead = false;
+            pulse(_limit - _count);
+        }
+        return c;
+    }
+    uint32_t overflows() override { return _overflows; }
+    int32_t limit() const override { return _limit; }
+
+    void pulse(uint32_t n = 1) {
+        while (n--) {
+            if (++_count == _limit) {
+                _count = 0;
+                _overflows++;
+            }
+        }
+    }
+    void wrapOnNextRead() { _wrapDuringRead = true; }
+    void setOverflows(uint32_t n) { _overflows = n; }
+
+private:
+    int32_t _limit;
+    int32_t _count = 0;
+    uint32_t _overflows = 0;
+    bool _wrapDuringRead = false;
+};
+
+void testAccumulatesAcrossWraps() {
+    FakePulseCounter* counter = new FakePulseCounter(100);
+    Source::PcntSource src(counter, 5000);
+    src.begin();
+    CHECK_EQ(src.getLiters(), 5000u);
+
+    counter->pulse(99);
+    CHECK_EQ(src.getLiters(), 5099u);
+    counter->pulse(1); // Exactly at the limit: counter reads 0, one overflow
+    CHECK_EQ(src.getLiters(), 5100u);
+    counter->pulse(12345);
+    CHECK_EQ(src.getLiters(), 5000u + 12445u);
+}
+
+void testWrapBetweenReadsIsNotLost() {
+    FakePulseCounter* counter = new FakePulseCounter(100);
+    Source::PcntSource src(counter);
+    src.begin();
+    counter->pulse(95);
+    counter->wrapOnNextRead();
+    // First attempt sees stale overflows; total() must retry and land on 100.
+    CHECK_EQ(src.getLiters(), 100u);
+}
+
+void testSetLitersRebases() {
+    FakePulseCounter* counter = new FakePulseCounter(100);
+    Source::PcntSource src(counter, 10);
+    src.begin();
+    counter->pulse(250);
+    src.setLiters(1000);
+    CHECK_EQ(src.getLiters(), 1000u);
+    counter->pulse(3);
+    CHECK_EQ(src.getLiters(), 1003u);
+}
+
+void testOverflowCounterBeyond32BitPulses() {
+    FakePulseCounter counter(10000);
+    // 500000 wraps of 10000 is past 2^32; total() must widen before multiplying.
+    counter.setOverflows(500000);
+    counter.pulse(7);
+    CHECK_EQ(counter.total(), 5000000007ull);
+}
+
+void testFactoryFallsBackToIsrWithoutPcnt() {
+    // The host PCNT shim always fails to create a unit.
+    std::unique_ptr<Source::WaterSource> src(
+        Source::SourceFactory::create(Source::SourceType::PulsePcnt, 42, 10, nullptr));
+    CHECK(src != nullptr);
+    CHECK(src->needsPulseIsr());
+    CHECK_EQ(src->getLiters(), 42u);
+}
+
+} // namespace
+
+int main() {
+    testAccumulatesAcrossWraps();
+    testWrapBetweenReadsIsNotLost();
+    testSetLitersRebases();
+    testOverflowCounterBeyond32BitPulses();
+    testFactoryFallsBackToIsrWithoutPcnt();
+    return checkResult();
+}
@@ -0,0 +1,244 @@
+// Adaptive Smart polling: interval arithmetic, a Pulsar on the simulated bus
+// backing off and catching up, deep-sleep carry-over, the coordinator's
+// bounds over Zigbee and their NVS record (incl. the v1 layout).
+
+#include "check.h"
+
+#include <vector>
+
+#include "drivers/pulsar_ds15_20.h"
+#include "sim/virtual_pulsar.h"
+#include "sources/smart_source.h"
+#include "storage/channel_store.h"
+#include "zigbee_water_meter.h"
+
+namespace {
+
+constexpr uint32_t kMinute = 60000;
+constexpr uint32_t kSerial = 10128442;
+
+void testPolicy() {
+    Source::AdaptivePollPolicy p;
+    uint32_t interval = 3;
+    p.setBounds({ 10, 80 }, interval);
+    CHECK_EQ(interval, 10u);                  // Clamped into the range
+    CHECK(p.adaptive());
+
+    interval = p.next(interval, false); CHECK_EQ(interval, 20u);
+    interval = p.next(interval, false); CHECK_EQ(interval, 40u);
+    interval = p.next(interval, false); CHECK_EQ(interval, 80u);
+    interval = p.next(interval, false); CHECK_EQ(interval, 80u);
+    CHECK_EQ(p.unchanged(), 4);
+    interval = p.next(interval, true);  CHECK_EQ(interval, 40u);
+    CHECK_EQ(p.unchanged(), 0);
+    interval = p.next(interval, true);  CHECK_EQ(interval, 20u);
+    interval = p.next(interval, true);  CHECK_EQ(interval, 10u);
+    interval = p.next(interval, true);  CHECK_EQ(interval, 10u);
+
+    // Narrower bounds clamp the current interval; max < min collapses to min
+    p.setBounds({ 30, 20 }, interval);
+    CHECK_EQ(interval, 30u);
+    CHECK(!p.adaptive());
+    CHECK_EQ(p.next(interval, false), 30u);
+    CHECK_EQ(p.next(interval, true), 30u);
+
+    // No overflow at the top of the range
+    p.setBounds({ 1, UINT32_MAX }, interval);
+    interval = UINT32_MAX - 1;
+    CHECK_EQ(p.next(interval, false), UINT32_MAX);
+}
+
+struct Rig {
+    Sim::VirtualPulsarBus line;
+    Sim::PulsarMeterState& meter;
+    Driver::PulsarDu_15_20 drv;
+    Source::BasicSmartSource<Driver::PulsarDu_15_20> src;
+
+    explicit Rig(uint64_t liters)
+        : meter(line.addMeter(kSerial)), drv(&line, kSerial), src(&drv, liters) {
+        meter.volumeM3 = liters / 1000.0f;
+        src.setPollBounds({ 10 * kMinute, 120 * kMinute });
+        src.begin();
+        src.tick(); // Starts the clocks
+    }
+
+    // Moves time to the next poll and runs it (hours close on the way).
+    void pollNext() {
+        uint32_t sent = line.stats().txBytes;
+        while (line.stats().txBytes == sent) {
+            HostShim::advanceMillis(src.msUntilDue(millis()));
+            src.tick();
+        }
+    }
+};
+
+void testSourceBacksOffAndCatchesUp() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Rig rig(5000);
+    CHECK_EQ(rig.src.getPollInterval(), 10 * kMinute);
+
+    // Quiet night: 10, 20, 40, 80, 120 min
+    rig.pollNext();
+    CHECK_EQ(rig.src.getPollInterval(), 20 * kMinute);
+    for (int i = 0; i < 4; i++) rig.pollNext();
+    CHECK_EQ(rig.src.getPollInterval(), 120 * kMinute);
+    uint32_t quiet = millis();
+    rig.pollNext();
+    CHECK(millis() - quiet - 120 * kMinute <= 1u); // Polls end at fractional ms
+
+    // Morning shower shows up on the next poll, the following ones come sooner
+    rig.meter.volumeM3 = 5.072f;
+    rig.pollNext();
+    CHECK_EQ(rig.src.getLiters(), 5072u);
+    CHECK_EQ(rig.src.getPollInterval(), 60 * kMinute);
+    rig.meter.volumeM3 = 5.080f;
+    rig.pollNext();
+    CHECK_EQ(rig.src.getPollInterval(), 30 * kMinute);
+
+    // Meter does not answer: no reading, no change of pace
+    rig.drv.setAddress(99999999);
+    rig.pollNext();
+    CHECK_EQ(rig.src.getPollInterval(), 30 * kMinute);
+    HostShim::consoleEnabled() = true;
+}
+
+void testResumeKeepsInterval() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Rig a(7000);
+    for (int i = 0; i < 3; i++) a.pollNext();
+    CHECK_EQ(a.src.getPollInterval(), 80 * kMinute);
+    Source::SourceSnapshot snap = a.src.snapshot(millis());
+
+    // Deep sleep: fresh millis(), bounds from the channel table first
+    HostShim::setMillis(500);
+    Rig b(0);
+    b.src.setPollBounds({ 10 * kMinute, 120 * kMinute });
+    b.src.resume(snap, 80 * kMinute, millis());
+    CHECK_EQ(b.src.getPollInterval(), 80 * kMinute);
+    CHECK(b.src.pollDue(millis()));           // The wake-up poll still happens
+    b.meter.volumeM3 = 7.0f;                  // Same meter as before the sleep
+    b.src.tick();
+    CHECK_EQ(b.src.getPollInterval(), 120 * kMinute); // Unchanged against the RTC copy
+    HostShim::consoleEnabled() = true;
+}
+
+void testCoordinatorBounds() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Rig rig(100);
+    ZigbeeWaterMeter ep(1);
+    ep.setSource(&rig.src);
+    ep.begin();
+    ep.registerAttributes();
+
+    auto write = [&](uint16_t id, uint32_t sec) {
+        esp_zb_zcl_set_attr_value_message_t msg = {};
+        msg.info.cluster = ESP_ZB_ZCL_CLUSTER_ID_METERING;
+        msg.attribute.id = id;
+        msg.attribute.data.type = ESP_ZB_ZCL_ATTR_TYPE_U32;
+        msg.attribute.data.size = 4;
+        msg.attribute.data.value = &sec;
+        ep.handleAttributeWrite(&msg);
+    };
+    auto attr = [](uint16_t id) {
+        const std::vector<uint8_t>& v = HostZigbee::attributes()[std::make_tuple((uint8_t)1, (uint16_t)ESP_ZB_ZCL_CLUSTER_ID_METERING, id)];
+        uint32_t x = 0;
+        for (size_t i = 0; i < 4 && i < v.size(); i++) x |= (uint32_t)v[i] << (8 * i);
+        return x;
+    };
+
+    write(kAttrPollIntervalMax, 4 * 3600);
+    CHECK(ep.isConfigDirty());
+    CHECK_EQ(rig.src.getPollBounds().maxMs, 4 * 3600 * 1000u);
+    CHECK_EQ(rig.src.getPollBounds().minMs, 10 * kMinute);
+
+    // Min past max drags max along; below the floor is raised to it
+    write(kAttrPollIntervalMin, 5 * 3600);
+    CHECK_EQ(rig.src.getPollBounds().maxMs, 5 * 3600 * 1000u);
+    CHECK_EQ(rig.src.getPollInterval(), 10 * kMinute); // Written in the Zigbee task...
+    rig.src.tick();
+    CHECK_EQ(rig.src.getPollInterval(), 5 * 3600 * 1000u); // ...applied by the loop task
+    write(kAttrPollIntervalMax, 1);
+    CHECK_EQ(rig.src.getPollBounds().maxMs, kPollIntervalFloorS * 1000);
+    CHECK_EQ(rig.src.getPollBounds().minMs, kPollIntervalFloorS * 1000);
+
+    // Wrong type is ignored
+    ep.clearConfigDirty();
+    esp_zb_zcl_set_attr_value_message_t bad = {};
+    uint16_t v16 = 60;
+    bad.info.cluster = ESP_ZB_ZCL_CLUSTER_ID_METERING;
+    bad.attribute.id = kAttrPollIntervalMin;
+    bad.attribute.data.type = ESP_ZB_ZCL_ATTR_TYPE_U16;
+    bad.attribute.data.value = &v16;
+    ep.handleAttributeWrite(&bad);
+    CHECK(!ep.isConfigDirty());
+
+    // The config report carries the effective range back
+    write(kAttrPollIntervalMax, 7200);
+    ep.reportConfig();
+    CHECK_EQ(attr(kAttrPollIntervalMin), kPollIntervalFloorS);
+    CHECK_EQ(attr(kAttrPollIntervalMax), 7200u);
+    HostZigbee::stats() = HostZigbee::Stats{};
+    HostShim::consoleEnabled() = true;
+}
+
+void testStoreKeepsBounds() {
+    HostShim::nvsStore().clear();
+    Preferences prefs;
+    prefs.begin("water", false);
+
+    // Record of the previous firmware (v1, 32 bytes, no bounds)
+    std::vector<uint8_t> v1(32, 0);
+    v1[0] = 1;
+    v1[4] = 7;                                // seq
+    uint32_t serial = kSerial;
+    uint64_t liters = 4242;
+    memcpy(&v1[8], &serial, 4);
+    memcpy(&v1[16], &liters, 8);
+    uint16_t crc = Driver::Crc16Modbus::compute(v1.data(), 24);
+    memcpy(&v1[24], &crc, 2);
+    prefs.putBytes("ch0a", v1.data(), v1.size());
+
+    Storage::ChannelStore store(&prefs, 0);
+    Storage::ChannelState st;
+    CHECK(store.load(st));
+    CHECK_EQ(st.serial, kSerial);
+    CHECK_EQ(st.liters, 4242u);
+    CHECK_EQ(st.pollMinMs, 0u);
+    CHECK_EQ(st.pollMaxMs, 0u);
+    CHECK(!store.isDirty(st));
+
+    // Only the bounds changed: still a write, into the other slot, as v2
+    st.pollMinMs = 60000;
+    st.pollMaxMs = 3600000;
+    CHECK(store.isDirty(st));
+    CHECK(store.save(st));
+    CHECK_EQ(HostShim::nvsStore()["water/ch0b"].size(), (size_t)40);
+
+    Storage::ChannelStore fresh(&prefs, 0);
+    Storage::ChannelState back;
+    CHECK(fresh.load(back));
+    CHECK_EQ(back.liters, 4242u);
+    CHECK_EQ(back.pollMinMs, 60000u);
+    CHECK_EQ(back.pollMaxMs, 3600000u);
+
+    // A corrupted v1 slot is rejected like any other
+    HostShim::nvsStore()["water/ch0b"].clear();
+    v1[16] ^= 1;
+    prefs.putBytes("ch0a", v1.data(), v1.size());
+    Storage::ChannelStore broken(&prefs, 0);
+    CHECK(!broken.load(back));
+}
+
+} // namespace
+
+int main() {
+    testPolicy();
+    testSourceBacksOffAndCatchesUp();
+    testResumeKeepsInterval();
+    testCoordinatorBounds();
+    testStoreKeepsBounds();
+    return checkResult();
+}
@@ -0,0 +1,328 @@
+// Virtual Pulsar fault injection: each fault on its own against the driver
+// (what it costs, that it is rejected, that the line recovers), malformed
+// but CRC-correct replies (short frame, foreign request ID), then a
+// week-long soak of two Smart sources on one faulty line through the bus
+// scheduler, retries and the circuit breaker: no bad value is ever taken and
+// the readings keep up with the meters.
+
+#include "check.h"
+
+#include <cmath>
+#include <vector>
+
+#include "bus/bus_scheduler.h"
+#include "drivers/pulsar_ds15_20.h"
+#include "metrics.h"
+#include "sim/virtual_pulsar.h"
+#include "sources/smart_source.h"
+
+namespace {
+
+using Driver::MeterParam;
+using Metrics::Counter;
+
+constexpr uint32_t kMinute = 60000;
+constexpr uint32_t kCold = 10128442;
+constexpr uint32_t kHot = 10128939;
+
+// One fault kind at probability `p`.
+Sim::PulsarFaults only(float Sim::PulsarFaults::*fault, float p) {
+    Sim::PulsarFaults f;
+    f.*fault = p;
+    return f;
+}
+
+// Answers each request with a frame made from it by `make` (right away,
+// CRC appended): malformed replies the meter simulation never sends.
+class CraftedLine : public Stream {
+public:
+    std::vector<uint8_t> (*make)(const uint8_t* req, size_t len) = nullptr;
+
+    size_t write(uint8_t b) override { return write(&b, 1); }
+    size_t write(const uint8_t* req, size_t len) override {
+        std::vector<uint8_t> f = make(req, len);
+        uint16_t crc = Sim::VirtualPulsarBus::crc16(f.data(), f.size());
+        f.push_back(crc & 0xFF);
+        f.push_back(crc >> 8);
+        _rx.insert(_rx.end(), f.begin(), f.end());
+        return len;
+    }
+    int available() override { return (int)_rx.size(); }
+    int read() override {
+        if (_rx.empty()) {
+            HostShim::advanceMicros(100);
+            return -1;
+        }
+        int c = _rx.front();
+        _rx.erase(_rx.begin());
+        return c;
+    }
+    int peek() override { return _rx.empty() ? -1 : _rx.front(); }
+    void flush() override {}
+
+private:
+    std::vector<uint8_t> _rx;
+};
+
+// Reply header echoing the request: address, command, length.
+std::vector<uint8_t> header(const uint8_t* req, uint8_t length) {
+    return { req[0], req[1], req[2], req[3], req[4], length };
+}
+
+struct Rig {
+    Sim::VirtualPulsarBus bus;
+    Driver::PulsarDu_15_20 drv;
+
+    Rig() : drv(&bus, kCold) {
+        HostShim::setMillis(1000);
+        Metrics::registry().reset();
+        bus.addMeter(kCold).volumeM3 = 12.5f;
+    }
+
+    bool read(Driver::MeterReading& r) {
+        r = Driver::MeterReading{};
+        return drv.readValues(Driver::PulsarDu_15_20::kSupportedParams, r);
+    }
+
+    // The line is clean again: the next poll must go through.
+    bool recovers() {
+        bus.clearFaults();
+        HostShim::advanceMillis(100);
+        Driver::MeterReading r;
+        return read(r) && r.get(MeterParam::TotalVolume) == 12.5f;
+    }
+};
+
+void testNoReply() {
+    Rig rig;
+    rig.bus.setFaults(only(&Sim::PulsarFaults::noReply, 1.0f));
+    Driver::MeterReading r;
+    uint32_t t0 = millis();
+    CHECK(!rig.read(r));
+    CHECK(!r.has(MeterParam::TotalVolume));
+    CHECK_EQ(rig.bus.stats().noReplies, 4u);
+    CHECK_EQ(Metrics::registry().get(Counter::RsTimeouts), 4u);
+    CHECK(millis() - t0 >= 4 * 300);              // Each request waits out the response timeout
+    CHECK(rig.recovers());
+}
+
+void testCrcError() {
+    Rig rig;
+    rig.bus.setFaults(only(&Sim::PulsarFaults::crcError, 1.0f));
+    Driver::MeterReading r;
+    CHECK(!rig.read(r));
+    CHECK(!r.has(MeterParam::TotalVolume));
+    CHECK_EQ(rig.bus.stats().corrupted, 4u);
+    // A flipped length byte ends the frame early (CRC error) or late (timeout)
+    CHECK_EQ(Metrics::registry().get(Counter::RsCrcErrors) + Metrics::registry().get(Counter::RsTimeouts), 4u);
+    CHECK(rig.recovers());
+}
+
+void testWrongAddress() {
+    Rig rig;
+    rig.bus.setFaults(only(&Sim::PulsarFaults::wrongAddress, 1.0f));
+    Driver::MeterReading r;
+    CHECK(!rig.read(r));                          // Intact frames, rejected by the address check
+    CHECK_EQ(r.valid, 0u);
+    CHECK_EQ(rig.bus.stats().wrongAddress, 4u);
+    CHECK_EQ(Metrics::registry().get(Counter::RsCrcErrors), 0u);
+    CHECK_EQ(Metrics::registry().get(Counter::RsTimeouts), 0u);
+    CHECK(rig.recovers());
+}
+
+void testByteLoss() {
+    Rig rig;
+    rig.bus.setFaults(only(&Sim::PulsarFaults::byteLoss, 0.02f), 7);
+    uint32_t failed = 0;
+    for (int i = 0; i < 50; i++) {
+        Driver::MeterReading r;
+        if (!rig.read(r)) failed++;
+        // Whatever got through is right
+        if (r.has(MeterParam::TotalVolume)) CHECK_EQ(r.get(MeterParam::TotalVolume), 12.5f);
+        if (r.has(MeterParam::BatteryVoltage)) CHECK(std::fabs(r.get(MeterParam::BatteryVoltage) - 3.6f) < 1e-6f);
+        HostShim::advanceMillis(100);
+    }
+    CHECK(failed > 0);
+    CHECK(failed <= rig.bus.stats().lostBytes);   // No failure without a lost byte
+    CHECK(Metrics::registry().get(Counter::RsTimeouts) > 0);
+    CHECK(rig.recovers());
+}
+
+void testContention() {
+    Rig rig;
+    rig.bus.setFaults(only(&Sim::PulsarFaults::contention, 1.0f), 3);
+    Driver::MeterReading r;
+    CHECK(!rig.read(r));
+    CHECK(!r.has(MeterParam::TotalVolume));
+    CHECK_EQ(rig.bus.stats().collisions, rig.bus.stats().replies);
+    CHECK(Metrics::registry().get(Counter::RsCrcErrors) + Metrics::registry().get(Counter::RsTimeouts) >= 4u);
+    CHECK(rig.recovers());                        // Leftovers of the foreign frame are flushed
+}
+
+void testLatency() {
+    Rig rig;
+    Driver::MeterReading r;
+    rig.bus.setResponseLatencyUs(250000);         // Slow, but within the 300 ms response timeout
+    CHECK(rig.read(r));
+    rig.bus.setResponseLatencyUs(350000);
+    CHECK(!rig.read(r));
+    CHECK(!r.has(MeterParam::TotalVolume));
+    // The late volume reply lands in the battery read: rejected by the command check, not taken
+    CHECK(!r.has(MeterParam::BatteryVoltage));
+    CHECK_EQ(Metrics::registry().get(Counter::RsTimeouts), 1u);
+    rig.bus.setResponseLatencyUs(5000);
+    HostShim::advanceMillis(1000);                // Until the last late reply is over
+    CHECK(rig.recovers());                        // and flushed before the next request
+
+    Sim::PulsarFaults jitter;
+    jitter.latencyJitterUs = 100000;
+    rig.bus.setFaults(jitter, 5);
+    uint64_t slowest = 0;
+    for (int i = 0; i < 20; i++) {
+        HostShim::advanceMillis(100);
+        uint64_t t0 = HostShim::clockUs();
+        float v;
+        CHECK(rig.drv.getValue(MeterParam::TotalVolume, v));
+        slowest = std::max(slowest, HostShim::clockUs() - t0);
+    }
+    CHECK(slowest > 50000);                       // The jitter shows up in the poll time
+    CHECK(slowest < 130000);
+}
+
+void testMalformedReplies() {
+    HostShim::setMillis(1000);
+    CraftedLine line;
+    Driver::PulsarDu_15_20 drv(&line, kCold);
+    float v = 0;
+
+    // Intact frame that announces only 10 bytes: no data where the value would be
+    line.make = [](const uint8_t* req, size_t len) {
+        std::vector<uint8_t> f = header(req, 10);
+        f.push_back(req[len - 4]);
+        f.push_back(req[len - 3]);
+        return f;
+    };
+    CHECK(!drv.getValue(MeterParam::TotalVolume, v));
+
+    // Full-length reply to some other request (ID does not match)
+    line.make = [](const uint8_t* req, size_t len) {
+        std::vector<uint8_t> f = header(req, 14);
+        for (uint8_t b : { 0x00, 0x00, 0x48, 0x41 }) f.push_back(b); // 12.5f
+        f.push_back(req[len - 4] ^ 0xFF);
+        f.push_back(req[len - 3]);
+        return f;
+    };
+    CHECK(!drv.getValue(MeterParam::TotalVolume, v));
+
+    // The same with the right ID is taken
+    line.make = [](const uint8_t* req, size_t len) {
+        std::vector<uint8_t> f = header(req, 14);
+        for (uint8_t b : { 0x00, 0x00, 0x48, 0x41 }) f.push_back(b);
+        f.push_back(req[len - 4]);
+        f.push_back(req[len - 3]);
+        return f;
+    };
+    CHECK(drv.getValue(MeterParam::TotalVolume, v));
+    CHECK_EQ(v, 12.5f);
+}
+
+// Two meters on one line with every fault at once, polled through the bus
+// scheduler for a week while water is drawn.
+void testSoak() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Metrics::registry().reset();
+
+    Sim::VirtualPulsarBus bus;
+    bus.addMeter(kCold);
+    bus.addMeter(kHot);
+    Sim::PulsarMeterState* meters[] = { bus.meter(kCold), bus.meter(kHot) };
+    meters[0]->volumeM3 = 100.0f;
+    meters[1]->volumeM3 = 40.0f;
+    Sim::PulsarFaults faults;
+    faults.noReply = 0.02f;
+    faults.byteLoss = 0.002f;
+    faults.crcError = 0.03f;
+    faults.wrongAddress = 0.02f;
+    faults.contention = 0.02f;
+    faults.latencyJitterUs = 20000;
+    bus.setFaults(faults, 2024);
+
+    Driver::PulsarDu_15_20 drvs[] = { { &bus, kCold }, { &bus, kHot } };
+    using Src = Source::BasicSmartSource<Driver::PulsarDu_15_20>;
+    Src srcs[] = { Src(&drvs[0], 100000), Src(&drvs[1], 40000) };
+    Bus::BusScheduler sched;
+    for (int i = 0; i < 2; i++) {
+        srcs[i].setPollInterval(10 * kMinute);
+        srcs[i].setBusScheduler(&sched, (uint8_t)i);
+        srcs[i].begin();
+        srcs[i].tick();
+    }
+
+    uint32_t polls = 0, fresh = 0, maxStale = 0, stale[2] = {};
+    bool monotonic = true, neverAhead = true;
+    uint64_t last[2] = { 100000, 40000 };
+    for (uint32_t m = 0; m < 7 * 1440; m++) {
+        if (m % 7 == 0) meters[0]->volumeM3 += 0.004f;
+        if (m % 11 == 0) meters[1]->volumeM3 += 0.002f;
+        HostShim::advanceMillis(kMinute);
+        for (auto& s : srcs) s.tick();
+        if (!sched.runBurst()) continue;
+        for (int i = 0; i < 2; i++) {
+            srcs[i].tick();
+            uint64_t liters = srcs[i].getLiters();
+            uint64_t truth = (uint64_t)(meters[i]->volumeM3 * 1000.0f);
+            monotonic &= liters >= last[i];
+            neverAhead &= liters <= truth;
+            last[i] = liters;
+            polls++;
+            if (liters == truth) {
+                fresh++;
+                stale[i] = 0;
+            } else {
+                maxStale = std::max(maxStale, ++stale[i]);
+            }
+        }
+    }
+    const Sim::VirtualPulsarBus::Stats& st = bus.stats();
+    fprintf(stderr, "soak: %u polls, %u fresh, max %u stale in a row; faults: %u no reply, %u lost bytes, "
+                    "%u corrupted, %u wrong address, %u collisions; %u retries, %u skipped\n",
+            polls, fresh, maxStale, st.noReplies, st.lostBytes, st.corrupted, st.wrongAddress, st.collisions,
+            Metrics::registry().get(Counter::RsRetries), Metrics::registry().get(Counter::RsSkipped));
+
+    CHECK(monotonic);
+    CHECK(neverAhead);                            // No garbled or foreign frame was ever taken
+    CHECK(polls >= 2 * 7 * 144 - 10);
+    CHECK(fresh * 100 >= polls * 97);             // Retries absorb nearly every fault
+    CHECK(maxStale <= 3);                         // Never more than half an hour behind
+    for (auto* n : { &st.noReplies, &st.lostBytes, &st.corrupted, &st.wrongAddress, &st.collisions }) CHECK(*n > 0);
+    CHECK(Metrics::registry().get(Counter::RsRetries) > 0);
+    CHECK(Metrics::registry().get(Counter::RsCrcErrors) > 0);
+    CHECK(Metrics::registry().get(Counter::RsTimeouts) > 0);
+
+    // Faults gone: both meters caught up and healthy on the next poll
+    bus.clearFaults();
+    HostShim::advanceMillis(10 * kMinute);
+    for (auto& s : srcs) s.tick();
+    sched.runBurst();
+    for (int i = 0; i < 2; i++) {
+        srcs[i].tick();
+        CHECK_EQ(srcs[i].getLiters(), (uint64_t)(meters[i]->volumeM3 * 1000.0f));
+        CHECK(srcs[i].health().state() != Source::HealthState::Offline);
+    }
+    HostShim::consoleEnabled() = true;
+}
+
+} // namespace
+
+int main() {
+    testNoReply();
+    testCrcError();
+    testWrongAddress();
+    testByteLoss();
+    testContention();
+    testLatency();
+    testMalformedReplies();
+    testSoak();
+    return checkResult();
+}
@@ -0,0 +1,97 @@
+// PulseSource lock-free accounting: an ISR-like producer thread against the loop.
+
+#include "check.h"
+
+#include <atomic>
+#include <thread>
+
+#include "sources/pulse_source.h"
+
+namespace {
+
+// Producer hammers increment() while the consumer folds and reads concurrently.
+// No pulse may be lost, getLiters() must never go backwards, and every
+// timestamp is either drained or counted as dropped.
+void testConcurrentIncrementAndCollect() {
+    constexpr uint32_t kPulses = 2000000;
+    constexpr uint64_t kStart = 1000;
+
+    HostShim::setMillis(1);
+    Source::PulseSource src(10, 0, kStart);
+
+    std::atomic<bool> done{false};
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < kPulses; i++) {
+            HostShim::advanceMillis(1); // debounce 0: each call is a new pulse
+            src.increment();
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    uint64_t last = src.getLiters();
+    bool monotonic = true;
+    uint32_t collects = 0;
+    while (!done.load(std::memory_order_acquire)) {
+        uint64_t l = src.getLiters();
+        if (l < last) monotonic = false;
+        last = l;
+        if (++collects % 4 == 0) src.collect();
+    }
+    producer.join();
+    src.collect();
+
+    CHECK(monotonic);
+    CHECK_EQ(src.getLiters(), kStart + kPulses);
+    CHECK_EQ(src.getLastPulseInterval(), 1u);
+}
+
+// Timestamps that do not fit the ring are dropped, pulses are not.
+void testRingOverflowKeepsCount() {
+    HostShim::setMillis(1);
+    Source::PulseSource src(10, 0);
+    const uint32_t n = Source::PulseSource::kPulseRingSize * 3;
+    for (uint32_t i = 0; i < n; i++) {
+        HostShim::advanceMillis(5);
+        src.increment();
+    }
+    CHECK_EQ(src.getDroppedPulseTimes(), n - Source::PulseSource::kPulseRingSize);
+    src.collect();
+    CHECK_EQ(src.getLiters(), (uint64_t)n);
+    CHECK_EQ(src.getLastPulseInterval(), 5u);
+}
+
+void testDebounce() {
+    HostShim::setMillis(1000);
+    Source::PulseSource src(10, 50);
+    src.increment();
+    HostShim::advanceMillis(20);
+    src.increment(); // дребезг
+    HostShim::advanceMillis(60);
+    src.increment();
+    CHECK_EQ(src.getLiters(), 2u);
+}
+
+void testSetLitersRebasesPendingPulses() {
+    HostShim::setMillis(1);
+    Source::PulseSource src(10, 0, 500);
+    for (int i = 0; i < 3; i++) {
+        HostShim::advanceMillis(1);
+        src.increment();
+    }
+    src.setLiters(42); // pulses before this point are part of the new value
+    HostShim::advanceMillis(1);
+    src.increment();
+    CHECK_EQ(src.getLiters(), 43u);
+    src.collect();
+    CHECK_EQ(src.getLiters(), 43u);
+}
+
+} // namespace
+
+int main() {
+    testConcurrentIncrementAndCollect();
+    testRingOverflowKeepsCount();
+    testDebounce();
+    testSetLitersRebasesPendingPulses();
+    return checkResult();
+}
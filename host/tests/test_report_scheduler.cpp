@@ -0,0 +1,167 @@
+// ReportScheduler: priority, dedup/coalescing, spacing and N endpoints, driven
+// by an explicit fake clock.
+
+#include "check.h"
+
+#include <string>
+#include <vector>
+
+#include "report_scheduler.h"
+#include "sources/simulation_source.h"
+#include "zigbee_water_meter.h"
+
+namespace {
+
+// Records what the scheduler asked for, one string per flush: "<id>:<kinds>".
+struct Log {
+    std::vector<std::string> flushes;
+};
+
+class FakeSink : public ReportSink {
+public:
+    FakeSink(char id, Log& log) : _id(id), _log(log) {}
+
+    void queueReport(ReportKind kind) override { _staged += "CHVB"[(int)kind]; }
+    void flushReports() override {
+        _log.flushes.push_back(std::string(1, _id) + ":" + _staged);
+        _staged.clear();
+    }
+
+private:
+    char _id;
+    Log& _log;
+    std::string _staged;
+};
+
+void testPriorityAcrossEndpoints() {
+    Log log;
+    FakeSink a('a', log), b('b', log), c('c', log);
+    ReportScheduler<4> sched(100);
+    CHECK_EQ(sched.addEndpoint(&a), 0);
+    CHECK_EQ(sched.addEndpoint(&b), 1);
+    CHECK_EQ(sched.addEndpoint(&c), 2);
+
+    sched.post(0, ReportKind::Battery);
+    sched.post(1, ReportKind::Value);
+    sched.post(2, ReportKind::Config);
+
+    uint32_t now = 1000;
+    while (!sched.idle()) {
+        sched.run(now);
+        now += 100;
+    }
+    CHECK_EQ(log.flushes.size(), 3u);
+    CHECK(log.flushes[0] == "c:C"); // config > value > battery
+    CHECK(log.flushes[1] == "b:V");
+    CHECK(log.flushes[2] == "a:B");
+}
+
+// Heartbeat on top of a pending on-change report: one job, one flush; all
+// kinds pending on an endpoint leave together.
+void testDedupAndCoalescing() {
+    Log log;
+    FakeSink a('a', log);
+    ReportScheduler<1> sched(100);
+    sched.addEndpoint(&a);
+
+    sched.post(0, ReportKind::Value);   // on-change
+    sched.postAll(ReportKind::Value);   // heartbeat at the same moment
+    sched.post(0, ReportKind::Battery);
+    sched.post(0, ReportKind::Hourly);
+    CHECK_EQ(sched.stats().coalesced, 1u);
+
+    CHECK(sched.run(0));
+    CHECK(sched.idle());
+    CHECK_EQ(log.flushes.size(), 1u);
+    CHECK(log.flushes[0] == "a:HVB");
+    CHECK_EQ(sched.stats().jobsSent, 3u);
+}
+
+void testMinimumSpacing() {
+    Log log;
+    FakeSink a('a', log), b('b', log);
+    ReportScheduler<2> sched(100);
+    sched.addEndpoint(&a);
+    sched.addEndpoint(&b);
+    sched.postAll(ReportKind::Value);
+
+    CHECK_EQ(sched.nextDue(5000), 5000u);
+    CHECK(sched.run(5000));
+    CHECK(!sched.run(5050));            // too soon
+    CHECK_EQ(sched.nextDue(5050), 5100u);
+    CHECK(sched.run(5100));
+    CHECK_EQ(log.flushes.size(), 2u);
+    CHECK_EQ(sched.nextDue(5100), UINT32_MAX);
+
+    // Spacing also holds across a millis() wrap.
+    ReportScheduler<2> wrap(100);
+    wrap.addEndpoint(&a);
+    wrap.post(0, ReportKind::Value);
+    CHECK(wrap.run(UINT32_MAX - 20));
+    wrap.post(0, ReportKind::Value);
+    CHECK(!wrap.run(30));
+    CHECK(wrap.run(80));
+}
+
+// Equal priority: the endpoint that has been waiting longest goes first.
+void testFairnessAndScale() {
+    Log log;
+    std::vector<FakeSink> sinks;
+    for (char id = 'a'; id < 'a' + 8; id++) sinks.emplace_back(id, log);
+    ReportScheduler<8> sched(10);
+    for (auto& s : sinks) CHECK(sched.addEndpoint(&s) >= 0);
+    CHECK_EQ(sched.addEndpoint(&sinks[0]), -1); // full
+
+    for (int i = 7; i >= 0; i--) sched.post(i, ReportKind::Value);
+    uint32_t now = 0;
+    while (sched.run(now) || !sched.idle()) now += 10;
+    CHECK_EQ(log.flushes.size(), 8u);
+    CHECK(log.flushes.front() == "h:V");
+    CHECK(log.flushes.back() == "a:V");
+}
+
+// Real endpoints: a coinciding heartbeat + on-change + battery is one
+// metering frame and one power frame per endpoint.
+void testWithWaterMeterEndpoints() {
+    HostShim::consoleEnabled() = false;
+    Source::SimulationSource coldSrc(1000), hotSrc(2000);
+    ZigbeeWaterMeter cold(1, true), hot(2, false);
+    cold.setSource(&coldSrc);
+    hot.setSource(&hotSrc);
+    cold.begin();
+    hot.begin();
+    cold.registerAttributes();
+    hot.registerAttributes();
+
+    ReportScheduler<2> sched(100);
+    sched.addEndpoint(&cold);
+    sched.addEndpoint(&hot);
+
+    HostZigbee::stats() = HostZigbee::Stats{};
+    sched.post(0, ReportKind::Value);
+    sched.postAll(ReportKind::Value);
+    sched.post(0, ReportKind::Battery);
+    uint32_t now = 0;
+    while (!sched.idle()) {
+        sched.run(now);
+        now += 100;
+    }
+    CHECK_EQ(HostZigbee::stats().frames(), 3u);
+    CHECK_EQ(cold.lockStats().holds, 1u);
+    CHECK_EQ(hot.lockStats().holds, 1u);
+    CHECK(!cold.shouldReport());
+    CHECK(!hot.shouldReport());
+    HostZigbee::stats() = HostZigbee::Stats{};
+    HostShim::consoleEnabled() = true;
+}
+
+} // namespace
+
+int main() {
+    testPriorityAcrossEndpoints();
+    testDedupAndCoalescing();
+    testMinimumSpacing();
+    testFairnessAndScale();
+    testWithWaterMeterEndpoints();
+    return checkResult();
+}
@@ -0,0 +1,231 @@
+// RS485 on the IDF UART driver: half-duplex setup (DE on the UART, no GPIO
+// writes), frames handed over on the idle line in one copy, short Modbus
+// exception replies, a meter pausing mid-frame, RX overflow, the byte-wise
+// Stream path for drivers without the frame link, and the install failure
+// that makes main.ino fall back to Serial1.
+
+#include "check.h"
+
+#include <cmath>
+#include <vector>
+
+#include "drivers/modbus_rtu.h"
+#include "drivers/pulsar_ds15_20.h"
+#include "hwi_streams/rs485_uart_stream.h"
+#include "sim/virtual_modbus.h"
+#include "sim/virtual_pulsar.h"
+
+namespace {
+
+constexpr uart_port_t kPort = UART_NUM_1;
+constexpr int kDePin = 19;
+constexpr uint32_t kSerial = 10128442;
+constexpr uint8_t kSlave = 5;
+
+// Answers every request with a fixed frame, optionally pausing after byte
+// `pauseAt` for `pauseUs`.
+class ScriptedLine : public Stream {
+public:
+    std::vector<uint8_t> reply;
+    size_t pauseAt = 0;
+    uint32_t pauseUs = 0;
+
+    size_t write(uint8_t b) override { return write(&b, 1); }
+    size_t write(const uint8_t*, size_t size) override {
+        HostShim::advanceMicros((uint64_t)size * Sim::VirtualModbusBus::kByteTimeUs);
+        uint64_t t = HostShim::clockUs() + 3000;
+        for (size_t i = 0; i < reply.size(); i++) {
+            t += Sim::VirtualModbusBus::kByteTimeUs;
+            if (pauseAt && i == pauseAt) t += pauseUs;
+            _rx.push_back({ reply[i], t });
+        }
+        return size;
+    }
+    int available() override {
+        int n = 0;
+        for (auto& b : _rx) n += b.readyUs <= HostShim::clockUs();
+        return n;
+    }
+    int read() override {
+        if (!available()) return -1;
+        int c = _rx.front().value;
+        _rx.erase(_rx.begin());
+        return c;
+    }
+    int peek() override { return available() ? _rx.front().value : -1; }
+    void flush() override {}
+
+private:
+    struct TimedByte {
+        uint8_t value;
+        uint64_t readyUs;
+    };
+    std::vector<TimedByte> _rx;
+};
+
+// Modbus reply to "read 2 holding registers" from kSlave: 0x0001 0x86A0.
+std::vector<uint8_t> modbusReply() {
+    std::vector<uint8_t> f = { kSlave, 0x03, 0x04, 0x00, 0x01, 0x86, 0xA0 };
+    uint16_t crc = Sim::VirtualModbusBus::crc16(f.data(), f.size());
+    f.push_back(crc & 0xFF);
+    f.push_back(crc >> 8);
+    return f;
+}
+
+constexpr Driver::ModbusRegister kVolumeReg[] = {
+    { Driver::MeterParam::TotalVolume, 0x03, 0x0000, Driver::ModbusType::U32, Driver::WordOrder::HighFirst, 0.001f },
+};
+constexpr Driver::ModbusRegisterMap kVolumeMap = { kVolumeReg, 1 };
+
+void testInstall() {
+    HostUart::attach(kPort, nullptr);
+    RS485UartStream none(kPort, kDePin);
+    CHECK(!none.begin(9600, 21, 20));             // No UART driver: caller falls back
+
+    Sim::VirtualPulsarBus line;
+    HostUart::attach(kPort, &line);
+    HostShim::setPinLevel(kDePin, LOW);
+    {
+        RS485UartStream rs(kPort, kDePin);
+        CHECK(rs.begin(9600, 21, 20));
+        CHECK(HostUart::port(kPort).mode == UART_MODE_RS485_HALF_DUPLEX);
+        CHECK_EQ(HostUart::port(kPort).rtsPin, kDePin);
+        CHECK_EQ(HostUart::port(kPort).rxTimeoutSymbols, RS485UartStream::kRxIdleSymbols);
+        RS485UartStream second(kPort, kDePin);
+        CHECK(!second.begin(9600, 21, 20));       // Port taken
+    }
+    CHECK(!HostUart::port(kPort).installed);      // Released by the destructor
+}
+
+void testPulsarFrames() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Sim::VirtualPulsarBus line;
+    line.addMeter(kSerial).volumeM3 = 12.5f;
+    HostUart::attach(kPort, &line);
+    RS485UartStream rs(kPort, kDePin);
+    CHECK(rs.begin(9600, 21, 20));
+    HostShim::setPinLevel(kDePin, LOW);
+
+    Driver::PulsarDu_15_20 drv(&rs, kSerial);
+    drv.setFrameLink(&rs);
+    Driver::MeterReading r;
+    CHECK(drv.readValues(Driver::PulsarDu_15_20::kSupportedParams, r));
+    CHECK_EQ(r.get(Driver::MeterParam::TotalVolume), 12.5f);
+
+    // One copy out of the ring per reply, DE never touched by software
+    CHECK_EQ(line.stats().replies, 4u);          // Channels + three battery parameters
+    CHECK_EQ(HostUart::port(kPort).readCalls, 4u);
+    CHECK_EQ(rs.stats().frames, 4u);
+    CHECK_EQ(HostUart::port(kPort).events, 4u);   // One wake-up per reply: the length is reached
+    CHECK_EQ(digitalRead(kDePin), LOW);
+
+    // Same driver without the link: works through the Stream, byte by byte
+    HostUart::port(kPort).readCalls = 0;
+    line.resetStats();
+    Driver::PulsarDu_15_20 legacy(&rs, kSerial);
+    Driver::MeterReading l;
+    CHECK(legacy.readValues(Driver::PulsarDu_15_20::kSupportedParams, l));
+    CHECK_EQ(l.get(Driver::MeterParam::TotalVolume), 12.5f);
+    CHECK_EQ(HostUart::port(kPort).readCalls, line.stats().rxBytes);
+    HostShim::consoleEnabled() = true;
+}
+
+void testModbusException() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Sim::VirtualModbusBus line;
+    line.addSlave(kSlave);                        // No registers: exception 02
+    HostUart::attach(kPort, &line);
+    RS485UartStream rs(kPort, kDePin);
+    CHECK(rs.begin(9600, 21, 20));
+
+    Driver::ModbusRtu viaLink(&rs, kSlave, kVolumeMap);
+    viaLink.setFrameLink(&rs);
+    Driver::MeterReading r;
+    uint32_t t0 = micros();
+    CHECK(!viaLink.readValues(viaLink.supportedParams(), r));
+    uint32_t linkUs = micros() - t0;
+    CHECK_EQ(viaLink.stats().exceptions, 1u);
+
+    // The Stream path only gives up after the 20 ms inter-byte gap
+    Driver::ModbusRtu viaStream(&rs, kSlave, kVolumeMap);
+    t0 = micros();
+    CHECK(!viaStream.readValues(viaStream.supportedParams(), r));
+    uint32_t streamUs = micros() - t0;
+    CHECK_EQ(viaStream.stats().exceptions, 1u);
+    CHECK(linkUs + 15000 < streamUs);
+    HostShim::consoleEnabled() = true;
+}
+
+void testPauseMidFrame() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    ScriptedLine line;
+    line.reply = modbusReply();
+    line.pauseAt = 4;
+    line.pauseUs = 8000;                          // Longer than the idle timeout, shorter than the gap
+    HostUart::attach(kPort, &line);
+    RS485UartStream rs(kPort, kDePin);
+    CHECK(rs.begin(9600, 21, 20));
+
+    Driver::ModbusRtu drv(&rs, kSlave, kVolumeMap);
+    drv.setFrameLink(&rs);
+    Driver::MeterReading r;
+    CHECK(drv.readValues(drv.supportedParams(), r));
+    CHECK(std::fabs(r.get(Driver::MeterParam::TotalVolume) - 100.0f) < 1e-3f);
+    CHECK_EQ(rs.stats().frames, 2u);              // Two pieces, one frame
+    HostShim::consoleEnabled() = true;
+}
+
+void testOverflow() {
+    HostShim::setMillis(1000);
+    ScriptedLine line;
+    line.reply.assign(RS485UartStream::kRxBufferSize + 50, 0x55);
+    HostUart::attach(kPort, &line);
+    RS485UartStream rs(kPort, kDePin);
+    CHECK(rs.begin(9600, 21, 20));
+
+    uint8_t req[8] = {};
+    rs.write(req, sizeof(req));
+    HostShim::advanceMillis(400);                 // Nobody reads while the reply pours in
+    uint8_t buf[64];
+    CHECK_EQ(rs.readFrame(buf, sizeof(buf), 300), sizeof(buf)); // Cap reached
+    size_t n = 1;
+    while (n) n = rs.readFrame(buf, sizeof(buf), 300);
+    CHECK_EQ(rs.stats().overflows, 1u);
+    CHECK_EQ(rs.available(), 0);
+}
+
+void testStreamInterface() {
+    HostShim::setMillis(1000);
+    ScriptedLine line;
+    line.reply = { 0x11, 0x22, 0x33 };
+    HostUart::attach(kPort, &line);
+    RS485UartStream rs(kPort, kDePin);
+    CHECK(rs.begin(9600, 21, 20));
+
+    rs.write(0x01);
+    rs.flush();
+    CHECK_EQ(rs.available(), 0);
+    HostShim::advanceMillis(10);
+    CHECK_EQ(rs.available(), 3);
+    CHECK_EQ(rs.peek(), 0x11);
+    CHECK_EQ(rs.available(), 3);
+    CHECK_EQ(rs.read(), 0x11);
+    CHECK_EQ(rs.read(), 0x22);
+    CHECK_EQ(rs.read(), 0x33);
+    CHECK_EQ(rs.read(), -1);
+}
+
+} // namespace
+
+int main() {
+    testInstall();
+    testPulsarFrames();
+    testModbusException();
+    testPauseMidFrame();
+    testOverflow();
+    testStreamInterface();
+    return checkResult();
+}
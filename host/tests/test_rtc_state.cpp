@@ -0,0 +1,221 @@
+// Deep-sleep resume: source snapshots carry hour/day accounting over a sleep
+// on a fresh millis() timeline, the RTC record rejects anything it did not
+// seal itself, and a channel rebuilt from RTC (no NVS reads) polls at once
+// and keeps the NVS slot sequence going.
+
+#include "check.h"
+
+#include <cstring>
+
+#include "channels.h"
+#include "sim/virtual_pulsar.h"
+#include "storage/rtc_state.h"
+
+namespace {
+
+constexpr uint32_t kMinute = 60000;
+
+// Liters are set by the test; nothing to poll.
+class ManualSource : public Source::WaterSource {
+public:
+    uint64_t liters = 0;
+    uint32_t polls = 0;
+
+    void begin() override {}
+    void update() override { polls++; }
+    uint64_t getLiters() override { return liters; }
+    void setLiters(uint64_t l) override { liters = l; }
+};
+
+void testHourContinuesAcrossSleep() {
+    HostShim::setMillis(1000);
+    ManualSource a;
+    a.setPollInterval(24 * 60 * kMinute);
+    a.liters = 100;
+    a.tick();                               // Hour and day start here
+    HostShim::advanceMillis(20 * kMinute);
+    a.liters = 150;
+    a.setOffset(-7);
+    a.setSerialNumber(10128442);
+    Source::SourceSnapshot snap = a.snapshot(millis());
+
+    // 30 min of deep sleep; the new boot's millis() starts near 0
+    HostShim::setMillis(50);
+    ManualSource b;
+    uint64_t closed = 0;
+    int closes = 0;
+    b.onPeriodClosed([&](bool daily, uint64_t l) { if (!daily) { closed = l; closes++; } });
+    b.setPollInterval(24 * 60 * kMinute);
+    b.begin();
+    b.resume(snap, 30 * kMinute, millis());
+    CHECK_EQ(b.getLiters(), (uint64_t)150);
+    CHECK_EQ(b.getSerialNumber(), 10128442u);
+    CHECK_EQ(b.getOffset(), -7);
+    CHECK(b.pollDue(millis()));             // Wake-ups are for fresh data
+
+    b.liters = 170;                         // Read by the wake-up poll
+    b.tick();
+    CHECK_EQ(b.polls, 1u);
+    CHECK_EQ(closes, 0);
+    CHECK_EQ(b.msUntilDue(millis()), 10 * kMinute); // 60 - 20 awake - 30 asleep
+
+    HostShim::advanceMillis(10 * kMinute);
+    b.tick();
+    CHECK_EQ(closes, 1);
+    CHECK_EQ(closed, (uint64_t)70);         // 100 -> 170 within the same hour
+    CHECK(b.hasHourChanged());
+}
+
+void testOverlongSleepClosesOnce() {
+    HostShim::setMillis(5000);
+    ManualSource a;
+    a.liters = 10;
+    a.tick();
+    Source::SourceSnapshot snap = a.snapshot(millis());
+
+    HostShim::setMillis(30);
+    ManualSource b;
+    int hours = 0, days = 0;
+    b.onPeriodClosed([&](bool daily, uint64_t) { (daily ? days : hours)++; });
+    b.begin();
+    b.resume(snap, 3 * 60 * kMinute, millis());
+    b.liters = 40;
+    b.tick();
+    CHECK_EQ(hours, 1);                     // Not three, and no wrap to "49 days ago"
+    CHECK_EQ(days, 0);
+    CHECK_EQ(b.getLastHourConsumption(), (uint64_t)30);
+    b.tick();
+    CHECK_EQ(hours, 1);
+}
+
+void testPendingHourSurvives() {
+    HostShim::setMillis(1000);
+    ManualSource a;
+    a.tick();
+    HostShim::advanceMillis(60 * kMinute);
+    a.tick();                               // Closed, not reported yet
+    Source::SourceSnapshot snap = a.snapshot(millis());
+
+    HostShim::setMillis(10);
+    ManualSource b;
+    b.begin();
+    b.resume(snap, kMinute, millis());
+    CHECK(b.hasHourChanged());
+}
+
+Storage::RtcState<2> g_rtc; // Zero, like RTC_DATA_ATTR after power-on
+
+void testRtcRecord() {
+    CHECK(!g_rtc.valid());
+
+    g_rtc.resumes = 3;
+    g_rtc.reporters[0][1].msSinceReport = 12345;
+    g_rtc.channels[1].liters = 987654;
+    g_rtc.reporting[1][0] = { 10, 600, 5 };
+    g_rtc.seal();
+    CHECK(g_rtc.valid());
+
+    uint8_t* raw = reinterpret_cast<uint8_t*>(&g_rtc);
+    raw[sizeof(g_rtc) - 3] ^= 0x10;         // Bit flip in the last reporting config
+    CHECK(!g_rtc.valid());
+    raw[sizeof(g_rtc) - 3] ^= 0x10;
+    CHECK(g_rtc.valid());
+
+    g_rtc.invalidate();
+    CHECK(!g_rtc.valid());
+
+    // Same bytes, other channel count: different size, rejected
+    Storage::RtcState<1> one;
+    memset(&one, 0, sizeof(one));
+    one.seal();
+    CHECK(one.valid());
+    one.size++;
+    CHECK(!one.valid());
+}
+
+constexpr ChannelConfig kPair[] = {
+    { "cold", Source::SourceType::Smart, Driver::MeterModel::Pulsar_Du_15_20, 0, { 30 * kMinute, 30 * kMinute }, true },
+    { "hot",  Source::SourceType::Smart, Driver::MeterModel::Pulsar_Du_15_20, 0, { 30 * kMinute, 30 * kMinute }, false },
+};
+
+void testChannelResumeFastPath() {
+    HostShim::setMillis(1000);
+    HostShim::nvsStore().clear();
+    Preferences prefs;
+    prefs.begin("water", false);
+
+    Sim::VirtualPulsarBus line;
+    line.addMeter(10128442);
+    line.addMeter(10128939);
+    line.meter(10128442)->volumeM3 = 12.5f;
+    line.meter(10128939)->volumeM3 = 3.0f;
+
+    // Before the sleep: normal boot, a few saves so slot b holds the newest record
+    Storage::RtcState<2> rtc;
+    memset(&rtc, 0, sizeof(rtc));
+    {
+        Bus::BusScheduler sched;
+        ChannelSet<2> a(kPair, &prefs);
+        for (auto& ch : a) {
+            Storage::ChannelState st;
+            ch.store.load(st);
+            st.serial = ch.index ? 10128939 : 10128442;
+            CHECK(a.build(ch.index, st, &line, &sched));
+            ch.src->begin();
+        }
+        a.tick();                           // Starts the hour/day clocks
+        a.tick();
+        CHECK(a.awaitingData());
+        sched.runBurst();
+        a.tick();
+        CHECK(!a.awaitingData());
+        for (int i = 0; i < 2; i++) {
+            Storage::ChannelState st{ a[0].src->getSerialNumber(), 0, a[0].src->getLiters() + i * 100 };
+            a[0].store.save(st);
+        }
+        for (auto& ch : a) rtc.channels[ch.index] = ch.src->snapshot(millis());
+        rtc.seal();
+    }
+    CHECK(rtc.valid());
+
+    // Wake-up: built from RTC only, then one poll burst
+    line.meter(10128442)->volumeM3 = 12.75f;
+    HostShim::setMillis(20);
+    Bus::BusScheduler sched;
+    ChannelSet<2> b(kPair, &prefs);
+    for (auto& ch : b) {
+        const Source::SourceSnapshot& snap = rtc.channels[ch.index];
+        Storage::ChannelState st{ snap.serial, snap.offset, snap.liters };
+        CHECK(b.build(ch.index, st, &line, &sched));
+        ch.src->begin();
+        ch.src->resume(snap, 29 * kMinute, millis());
+    }
+    CHECK_EQ(b[0].src->getLiters(), (uint64_t)12500);
+    uint32_t txBefore = line.stats().requests;
+    b.tick();
+    sched.runBurst();
+    b.tick();
+    CHECK_EQ(b[0].src->getLiters(), (uint64_t)12750);
+    CHECK(line.stats().requests > txBefore);
+
+    // First save after the resume continues the slot sequence instead of
+    // writing "seq 1" behind the newer record
+    Storage::ChannelState st{ 10128442, 0, 12750 };
+    CHECK(b[0].store.save(st));
+    Storage::ChannelStore fresh(&prefs, 0);
+    Storage::ChannelState back;
+    CHECK(fresh.load(back));
+    CHECK_EQ(back.liters, (uint64_t)12750);
+}
+
+} // namespace
+
+int main() {
+    HostShim::consoleEnabled() = false;
+    testHourContinuesAcrossSleep();
+    testOverlongSleepClosesOnce();
+    testPendingHourSurvives();
+    testRtcRecord();
+    testChannelResumeFastPath();
+    return checkResult();
+}
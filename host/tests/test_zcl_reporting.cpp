@@ -0,0 +1,326 @@
+// ZCL reporting configuration: min/max interval and reportable change per
+// attribute, Configure Reporting / Read Reporting Configuration frames from
+// the Zigbee task against reads on the loop task, NVS persistence, and what
+// it does to a shower on a pulse meter and to a slowly rising flow.
+
+#include "check.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "sources/pulse_source.h"
+#include "storage/reporting_store.h"
+#include "zigbee_water_meter.h"
+
+namespace {
+
+constexpr uint32_t kSecond = 1000;
+
+void testReporterIntervals() {
+    AttributeReporter r;
+    r.config = { 10, 60, 5 };
+    CHECK(r.due(0, false));                  // Never reported: report now
+    r.markReported(100, 1000);
+
+    CHECK(!r.exceeds(104));
+    CHECK(r.exceeds(105));
+    CHECK(r.exceeds(95));                    // Either direction
+    CHECK(!r.due(5000, true));               // Changed, but inside the min interval
+    CHECK_EQ(r.msUntilDue(5000, true), 6000u);
+    CHECK(r.due(11000, true));
+    CHECK(!r.due(11000, false));
+    CHECK_EQ(r.msUntilDue(11000, false), 50000u);
+    CHECK(r.due(61000, false));              // Max interval: heartbeat
+
+    r.config = { 10, 0, 0 };                 // On change only; 0 = any change
+    CHECK(r.exceeds(101));
+    CHECK_EQ(r.msUntilDue(61000, false), UINT32_MAX);
+
+    r.config = { 0, kReportingOff, 1 };      // Off
+    CHECK(!r.due(61000, true));
+    CHECK_EQ(r.msUntilDue(61000, true), UINT32_MAX);
+
+    // Across deep sleep: 20 s awake + 30 s asleep since the last report
+    r.config = { 10, 60, 5 };
+    ReporterState st = r.save(21000);
+    AttributeReporter b;
+    b.config = r.config;
+    b.restore(st, 30000, 500);
+    CHECK(b.reported());
+    CHECK_EQ(b.lastValue(), (uint64_t)100);
+    CHECK_EQ(b.msUntilDue(500, false), 10000u);
+}
+
+// One pulse (1 L) every 2 s for 10 minutes, reports checked every 100 ms as
+// the main loop would after each pulse wake-up. Returns the frames sent;
+// `stalest` is the longest a liter waited before being reported.
+uint32_t shower(const ReportingConfig& value, uint32_t& stalest) {
+    HostShim::setMillis(1000);
+    Source::PulseSource src(10, 0, 5000);
+    ZigbeeWaterMeter ep(1);
+    ep.setSource(&src);
+    ep.begin();
+    ep.registerAttributes();
+    ReportingConfig cfg[2] = { value, kFlowReportingDefault };
+    ep.reporting().importConfigs(cfg, 2);
+    ep.reportValue();
+
+    HostZigbee::stats() = HostZigbee::Stats{};
+    uint32_t unreportedSince = 0;
+    bool unreported = false;
+    stalest = 0;
+    for (uint32_t t = 0; t < 600 * kSecond; t += 100) {
+        HostShim::advanceMillis(100);
+        uint32_t now = millis();
+        if (t % 2000 == 0) {
+            src.increment();
+            src.collect();
+            if (!unreported) unreportedSince = now;
+            unreported = true;
+        }
+        if (ep.shouldReport(now)) {
+            ep.reportValue();
+            if (unreported) stalest = std::max(stalest, now - unreportedSince);
+            unreported = false;
+        }
+    }
+    return HostZigbee::stats().frames();
+}
+
+void testShowerIsRateLimited() {
+    HostShim::consoleEnabled() = false;
+    uint32_t stalest;
+
+    // Before: every liter was a frame
+    uint32_t legacy = shower({ 0, 1800, 1 }, stalest);
+    CHECK(legacy >= 300);
+    CHECK(stalest <= 100);
+
+    // Defaults: at most one frame per 10 s, and no liter waits longer than that
+    uint32_t def = shower(kValueReportingDefault, stalest);
+    CHECK(def <= 61 + 5);                    // + flow changes riding along, not extra frames
+    CHECK(def * 4 < legacy);
+    CHECK(stalest <= 10 * kSecond);
+
+    // Coordinator asked for min 60 s / 10 L
+    uint32_t tuned = shower({ 60, 1800, 10 }, stalest);
+    CHECK(tuned <= 11);
+    CHECK(stalest <= 60 * kSecond);
+    HostShim::consoleEnabled() = true;
+}
+
+// Flow steps from 600 to about 650 L/h, one pulse every 5.5 s instead of 6 s.
+// True if that alone asks for a report within two minutes.
+bool flowStepReported(const ReportingConfig& flow) {
+    HostShim::setMillis(1000);
+    Source::PulseSource src(10, 0, 0);
+    ZigbeeWaterMeter ep(1);
+    ep.setSource(&src);
+    ep.begin();
+    ep.registerAttributes();
+    ReportingConfig cfg[2] = { { 10, 0, 1000000 }, flow }; // Total out of the way
+    ep.reporting().importConfigs(cfg, 2);
+    auto pulse = [&](uint32_t ms) {
+        HostShim::advanceMillis(ms);
+        src.increment();
+        src.collect();
+    };
+    pulse(0);
+    pulse(6000);
+    CHECK_EQ(src.getFlowRate(), 600u);
+    ep.reportValue();
+    for (int i = 0; i < 22; i++) {
+        pulse(5500);
+        if (ep.shouldReport(millis())) return true;
+    }
+    return false;
+}
+
+void testFlowReportableChange() {
+    HostShim::consoleEnabled() = false;
+    CHECK(!flowStepReported(kFlowReportingDefault));  // Under 1/8 of 600 L/h
+    CHECK(flowStepReported({ 10, 0, 10 }));           // The coordinator asked for 10 L/h
+    CHECK(!flowStepReported({ 10, 0, 200 }));
+    HostShim::consoleEnabled() = true;
+}
+
+// No consumption at all: one report per max interval, and the endpoint says
+// exactly when, so the loop can sleep until then.
+void testHeartbeatIsMaxInterval() {
+    HostShim::consoleEnabled() = false;
+    HostShim::setMillis(1000);
+    Source::PulseSource src(10, 0, 42);
+    ZigbeeWaterMeter ep(1, true);
+    ep.setSource(&src);
+    ep.begin();
+    ep.registerAttributes();
+    CHECK(ep.shouldReport(millis()));
+    CHECK(ep.batteryDue(millis()));
+    ep.reportValue();
+    ep.reportBattery();
+
+    CHECK(!ep.shouldReport(millis()));
+    CHECK_EQ(ep.msUntilReport(millis()), 1800 * kSecond);
+    HostShim::advanceMillis(1800 * kSecond - 1);
+    CHECK(!ep.shouldReport(millis()));
+    HostShim::advanceMillis(1);
+    CHECK(ep.shouldReport(millis()));
+    CHECK(ep.batteryDue(millis()));
+    HostShim::consoleEnabled() = true;
+}
+
+std::vector<uint8_t> lastFrame() {
+    return HostZigbee::stats().apsFrames.back().asdu;
+}
+
+void testConfigureReportingCommand() {
+    HostShim::consoleEnabled() = false;
+    Source::PulseSource src(10, 0, 0);
+    ZigbeeWaterMeter ep(2, true);
+    ep.setSource(&src);
+    ep.begin();
+    HostZigbee::stats() = HostZigbee::Stats{};
+
+    // 0x0000 (u48): min 60, max 600, change 10 L
+    const uint8_t total[] = { 0x00, 0x00, 0x00, ESP_ZB_ZCL_ATTR_TYPE_U48, 60, 0, 0x58, 0x02, 10, 0, 0, 0, 0, 0 };
+    CHECK(ep.handleReportingCommand(0x06, ESP_ZB_ZCL_CLUSTER_ID_METERING, 0x42, 0x0000, 1, total, sizeof(total)));
+    CHECK_EQ(HostZigbee::stats().apsFrames.size(), (size_t)1);
+    const HostZigbee::ApsFrame& f = HostZigbee::stats().apsFrames[0];
+    CHECK_EQ(f.endpoint, 2);
+    CHECK_EQ(f.dstEndpoint, 1);
+    CHECK_EQ(f.cluster, ESP_ZB_ZCL_CLUSTER_ID_METERING);
+    CHECK(f.asdu == std::vector<uint8_t>({ 0x18, 0x42, 0x07, 0x00 })); // Same seq, SUCCESS
+    CHECK(ep.reporting().isDirty());
+    CHECK_EQ(ep.reporting()[0].config.minIntervalS, 60);
+    CHECK_EQ(ep.reporting()[0].config.maxIntervalS, 600);
+    CHECK_EQ(ep.reporting()[0].config.reportableChange, 10u);
+
+    // Three records: unknown attribute, wrong type, max < min. Nothing applied.
+    const uint8_t bad[] = {
+        0x00, 0x00, 0x04, ESP_ZB_ZCL_ATTR_TYPE_U32, 1, 0, 2, 0, 1, 0, 0, 0,
+        0x00, 0x10, 0x04, ESP_ZB_ZCL_ATTR_TYPE_U16, 1, 0, 2, 0, 1, 0,
+        0x00, 0x10, 0x04, ESP_ZB_ZCL_ATTR_TYPE_U32, 30, 0, 10, 0, 1, 0, 0, 0,
+    };
+    ep.handleReportingCommand(0x06, ESP_ZB_ZCL_CLUSTER_ID_METERING, 0x43, 0x0000, 1, bad, sizeof(bad));
+    CHECK(lastFrame() == std::vector<uint8_t>({ 0x18, 0x43, 0x07,
+                                                0x8C, 0x00, 0x00, 0x04,
+                                                0x8D, 0x00, 0x10, 0x04,
+                                                0x87, 0x00, 0x10, 0x04 }));
+    CHECK_EQ(ep.reporting()[1].config.minIntervalS, kFlowReportingDefault.minIntervalS);
+
+    // Truncated record
+    ep.handleReportingCommand(0x06, ESP_ZB_ZCL_CLUSTER_ID_METERING, 0x44, 0x0000, 1, total, 7);
+    CHECK(lastFrame() == std::vector<uint8_t>({ 0x18, 0x44, 0x07, 0x80 }));
+
+    // Battery in the Power Config cluster, then read back both
+    const uint8_t batt[] = { 0x00, 0x21, 0x00, ESP_ZB_ZCL_ATTR_TYPE_U8, 0x10, 0x0E, 0x20, 0x1C, 4 };
+    ep.handleReportingCommand(0x06, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x45, 0x0000, 1, batt, sizeof(batt));
+    CHECK(lastFrame() == std::vector<uint8_t>({ 0x18, 0x45, 0x07, 0x00 }));
+
+    const uint8_t read[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x04 };
+    ep.handleReportingCommand(0x08, ESP_ZB_ZCL_CLUSTER_ID_METERING, 0x46, 0x0000, 1, read, sizeof(read));
+    CHECK(lastFrame() == std::vector<uint8_t>({ 0x18, 0x46, 0x09,
+                                                0x00, 0x00, 0x00, 0x00, ESP_ZB_ZCL_ATTR_TYPE_U48, 60, 0, 0x58, 0x02, 10, 0, 0, 0, 0, 0,
+                                                0x8C, 0x00, 0x00, 0x04 }));
+
+    // min 0xFFFF / max 0: back to the defaults
+    const uint8_t revert[] = { 0x00, 0x00, 0x00, ESP_ZB_ZCL_ATTR_TYPE_U48, 0xFF, 0xFF, 0, 0, 0, 0, 0, 0, 0, 0 };
+    ep.handleReportingCommand(0x06, ESP_ZB_ZCL_CLUSTER_ID_METERING, 0x47, 0x0000, 1, revert, sizeof(revert));
+    CHECK_EQ(ep.reporting()[0].config.minIntervalS, kValueReportingDefault.minIntervalS);
+    CHECK_EQ(ep.reporting()[0].config.maxIntervalS, kValueReportingDefault.maxIntervalS);
+
+    // Not ours
+    CHECK(!ep.handleReportingCommand(0x00, ESP_ZB_ZCL_CLUSTER_ID_METERING, 0x48, 0x0000, 1, read, 3));
+    HostZigbee::stats() = HostZigbee::Stats{};
+    HostShim::consoleEnabled() = true;
+}
+
+// Configure Reporting applied by the Zigbee task while the loop reads the
+// table: a config is seen whole or not at all, and no change escapes NVS.
+void testConfigureFromZigbeeTask() {
+    ZigbeeWaterMeter ep(1);
+    ReportingTable& rt = ep.reporting();
+    // 0x0000: min 60 / max 600 / 10 L, or min 120 / max 1200 / 20 L
+    const uint8_t a[] = { 0x00, 0x00, 0x00, ESP_ZB_ZCL_ATTR_TYPE_U48, 60, 0, 0x58, 0x02, 10, 0, 0, 0, 0, 0 };
+    const uint8_t b[] = { 0x00, 0x00, 0x00, ESP_ZB_ZCL_ATTR_TYPE_U48, 120, 0, 0xB0, 0x04, 20, 0, 0, 0, 0, 0 };
+    uint8_t resp[ReportingTable::kMaxResponse];
+    rt.configure(ESP_ZB_ZCL_CLUSTER_ID_METERING, a, sizeof(a), resp);
+
+    std::atomic<bool> done{ false };
+    std::thread zigbee([&] {
+        for (int i = 0; i < 20000; i++) {
+            const uint8_t* p = i & 1 ? b : a;
+            rt.configure(ESP_ZB_ZCL_CLUSTER_ID_METERING, p, sizeof(a), resp);
+        }
+        done = true;
+    });
+    uint32_t torn = 0, saves = 0;
+    ReportingConfig cfg[kMaxReportedAttrs];
+    while (!done) {
+        {
+            ReportingTable::Guard g(rt);
+            const ReportingConfig& c = rt[0].config;
+            bool isA = c.minIntervalS == 60 && c.maxIntervalS == 600 && c.reportableChange == 10;
+            bool isB = c.minIntervalS == 120 && c.maxIntervalS == 1200 && c.reportableChange == 20;
+            torn += !isA && !isB;
+        }
+        if (rt.takeDirty(cfg)) saves++;
+    }
+    zigbee.join();
+    CHECK_EQ(torn, 0u);
+    CHECK(saves > 0);
+
+    rt.takeDirty(cfg);
+    rt.configure(ESP_ZB_ZCL_CLUSTER_ID_METERING, a, sizeof(a), resp);
+    CHECK(rt.takeDirty(cfg));
+    CHECK_EQ(cfg[0].minIntervalS, 60);
+    CHECK(!rt.takeDirty(cfg));
+    rt.markDirty();                              // NVS write failed: again next pass
+    CHECK(rt.isDirty());
+}
+
+void testPersistence() {
+    HostShim::nvsStore().clear();
+    Preferences prefs;
+    prefs.begin("water", false);
+
+    ZigbeeWaterMeter a(1, true);
+    ReportingConfig cfg[kMaxReportedAttrs];
+    CHECK_EQ(a.reporting().size(), (size_t)3);
+    a.reporting()[0].config = { 30, 900, 5 };
+    a.reporting()[2].config = { 600, 3600, 10 };
+    a.reporting().exportConfigs(cfg);
+    Storage::ReportingStore store(&prefs, 0);
+    CHECK(store.save(cfg, a.reporting().size()));
+
+    ZigbeeWaterMeter b(1, true);
+    ReportingConfig back[kMaxReportedAttrs];
+    Storage::ReportingStore fresh(&prefs, 0);
+    CHECK(fresh.load(back, b.reporting().size()));
+    b.reporting().importConfigs(back, b.reporting().size());
+    CHECK_EQ(b.reporting()[0].config.maxIntervalS, 900);
+    CHECK_EQ(b.reporting()[0].config.reportableChange, 5u);
+    CHECK_EQ(b.reporting()[1].config.reportableChange, kFlowReportDeltaLph);
+    CHECK_EQ(b.reporting()[2].config.minIntervalS, 600);
+
+    // Other endpoint layout (no battery) or a flipped bit: defaults
+    CHECK(!fresh.load(back, 2));
+    CHECK(!Storage::ReportingStore(&prefs, 1).load(back, 3));
+    std::vector<uint8_t>& raw = HostShim::nvsStore()["water/rc0"];
+    raw[6] ^= 0x01;
+    CHECK(!fresh.load(back, 3));
+}
+
+} // namespace
+
+int main() {
+    testReporterIntervals();
+    testShowerIsRateLimited();
+    testFlowReportableChange();
+    testHeartbeatIsMaxInterval();
+    testConfigureReportingCommand();
+    testConfigureFromZigbeeTask();
+    testPersistence();
+    return checkResult();
+}
@@ -0,0 +1,112 @@
+#ifndef BUS_POWER_H
+#define BUS_POWER_H
+
+#include <Arduino.h>
+#include <algorithm>
+#include "metrics.h"
+
+namespace Bus {
+
+// Supply switch of the RS485 transceiver and meter interface.
+//
+// The line is powered only while a burst of transactions runs: BusScheduler
+// calls powerUp() before the first transaction, waits out the warm-up, runs
+// every queued request and calls powerDown() when the queue is empty. Each
+// burst adds its powered time and estimated energy (rail current x voltage
+// x time) to the metrics registry; duty cycle is powered time over uptime.
+//
+// The warm-up starts at the configured value and only grows: when the first
+// read of a burst fails but its retry succeeds, the line was not ready yet
+// and the next bursts wait half as long again (up to kMaxWarmUpMs). A meter
+// that does not answer at all says nothing about the warm-up.
+class BusPower {
+public:
+    static constexpr uint32_t kMaxWarmUpMs = 500;
+
+    struct Stats {
+        uint32_t bursts = 0;
+        uint32_t onMs = 0;          // Total powered time
+        uint32_t lastBurstMs = 0;
+        uint32_t warmUpRaises = 0;
+    };
+
+    // pin < 0: no switch (always powered), the bookkeeping still runs.
+    BusPower(int pin, uint32_t warmUpMs, uint32_t railMa, uint32_t railMv = 3300)
+        : _pin(pin), _warmUpMs(warmUpMs), _railMa(railMa), _railMv(railMv) {}
+
+    // Supply off until the first burst.
+    void begin() {
+        if (_pin < 0) return;
+        pinMode(_pin, OUTPUT);
+        digitalWrite(_pin, LOW);
+    }
+
+    // Keeps the supply on for good (bus read inline, without bursts).
+    void hold() {
+        _held = true;
+        powerUp();
+    }
+
+    // Off regardless of hold() (leave network, deep sleep).
+    void shutdown() {
+        _held = false;
+        powerDown();
+    }
+
+    bool isOn() const { return _on; }
+
+    // Switches on and blocks for the warm-up. Returns the time waited.
+    uint32_t powerUp() {
+        if (_on) return 0;
+        if (_pin >= 0) digitalWrite(_pin, HIGH);
+        _on = true;
+        _onSince = millis();
+        delay(_warmUpMs);
+        return _warmUpMs;
+    }
+
+    // Switches off unless held, and books the burst.
+    void powerDown() {
+        if (!_on || _held) return;
+        if (_pin >= 0) digitalWrite(_pin, LOW);
+        _on = false;
+
+        uint32_t ms = millis() - _onSince;
+        _stats.bursts++;
+        _stats.onMs += ms;
+        _stats.lastBurstMs = ms;
+        Metrics::count(Metrics::Counter::BusBursts);
+        Metrics::count(Metrics::Counter::BusOnMs, ms);
+        Metrics::record(Metrics::Histogram::BusBurstMs, ms);
+        Metrics::record(Metrics::Histogram::BusBurstUj, energyUj(ms));
+    }
+
+    // Outcome of the first request of the burst that just ran, before powerDown():
+    // read on the first attempt, or only on a retry.
+    void noteBurst(bool firstOk, bool retryOk) {
+        if (firstOk || !retryOk || _warmUpMs >= kMaxWarmUpMs) return;
+        _warmUpMs = std::min(kMaxWarmUpMs, std::max(_warmUpMs + _warmUpMs / 2, _warmUpMs + 1));
+        _stats.warmUpRaises++;
+    }
+
+    uint32_t warmUpMs() const { return _warmUpMs; }
+
+    // Energy drawn by the rail over `ms` of powered time, in microjoules.
+    uint32_t energyUj(uint32_t ms) const { return (uint32_t)((uint64_t)ms * _railMa * _railMv / 1000); }
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    int _pin;
+    uint32_t _warmUpMs;
+    uint32_t _railMa;
+    uint32_t _railMv;
+    bool _on = false;
+    bool _held = false;
+    uint32_t _onSince = 0;
+    Stats _stats;
+};
+
+}
+
+#endif
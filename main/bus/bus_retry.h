@@ -0,0 +1,59 @@
+#ifndef BUS_RETRY_H
+#define BUS_RETRY_H
+
+#include <Arduino.h>
+#include "drivers/smart_driver.h"
+#include "metrics.h"
+
+namespace Bus {
+
+// Retries of one meter read after a CRC error or timeout, inside the same
+// bus power-up. Retry k waits kBackoffMs << (k - 1), jittered to 50..150 %,
+// so a meter that answered into a collision or was still waking up gets a
+// second chance without lock-stepping with the next request. Only the
+// parameters still missing are asked for again.
+struct RetryPolicy {
+    static constexpr uint32_t kBackoffMs = 20;
+
+    // Backoff before retry `k` (1-based).
+    static uint32_t backoffMs(uint8_t k) {
+        uint32_t base = kBackoffMs << (k - 1);
+        return base / 2 + next() % (base + 1);
+    }
+
+    // xorshift32; seeded from the clock on first use.
+    static uint32_t next() {
+        static uint32_t s = 0;
+        if (s == 0) s = micros() | 1;
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        return s;
+    }
+};
+
+// Reads `params` with up to `retries` extra attempts, until every value is in
+// `out`. Returns true once the `required` ones are (0: all of `params`);
+// `attempts` (if given) gets the reads that took, or all reads on failure.
+// Drv: concrete final driver or SmartMeterDriver (see BasicSmartSource).
+template <class Drv>
+bool readWithRetry(Drv* drv, Driver::ParamSet params, Driver::MeterReading& out, uint8_t retries,
+                   uint8_t* attempts = nullptr, Driver::ParamSet required = 0) {
+    if (!required) required = params;
+    uint8_t n = 1;
+    bool all = drv->readValues(params, out);
+    uint8_t took = (out.valid & required) == required ? 1 : 0;
+    for (; !all && n <= retries; n++) {
+        delay(RetryPolicy::backoffMs(n));
+        Metrics::count(Metrics::Counter::RsRetries);
+        drv->readValues(params & ~out.valid, out);
+        all = (out.valid & params) == params;
+        if (!took && (out.valid & required) == required) took = n + 1;
+    }
+    if (attempts) *attempts = took ? took : n;
+    return took != 0;
+}
+
+}
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef BUS_SCHEDULER_H
+#define BUS_SCHEDULER_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "drivers/smart_driver.h"
+#include "bus/bus_power.h"
+#include "bus/bus_retry.h"
+
+namespace Bus {
+
+// Asynchronous scheduler for one shared RS485 line.
+//
+// Sources submit read requests and get a ticket back immediately; a dedicated
+// FreeRTOS task executes the transactions and the source collects the result
+// later with poll(). Nothing on the loop() side ever waits for the bus.
+//
+// Requests are keyed by driver (i.e. by meter address): submitting again for a
+// meter that is still queued merges the parameter sets instead of adding a
+// second transaction. The task drains the whole queue in one burst, ordered
+// by priority and then by deadline, so polls for every meter on the line run
+// back to back in a single bus power-up. Requests whose deadline has passed
+// before they reach the bus are dropped.
+//
+// With a BusPower attached (setPower), the transceiver is switched on once the
+// burst has something to execute and off when the queue is empty; requests
+// submitted while a burst runs join it instead of costing another warm-up.
+//
+// A request may carry retries (see RetryPolicy): a failed read is repeated
+// within the same burst after a short jittered backoff.
+class BusScheduler {
+public:
+    typedef int Ticket;
+    static constexpr Ticket kNoTicket = -1;
+    static constexpr size_t kMaxRequests = 8;
+
+    enum class State : uint8_t {
+        Free,
+        Queued,
+        Running,
+        Done,      // Result ready for poll()
+        Cancelled  // Owner gave up while the request was on the bus
+    };
+
+    struct BurstStats {
+        uint32_t bursts = 0;
+        uint32_t transactions = 0;
+        uint32_t expired = 0;
+        uint32_t lastBurstMs = 0;
+    };
+
+    // Starts the bus task. Without it, runBurst() must be called by the owner.
+    bool begin(UBaseType_t priority = 5, uint32_t stackSize = 4096) {
+        return xTaskCreate(&BusScheduler::taskEntry, "rs485_bus", stackSize, this, priority, &_task) == pdPASS;
+    }
+
+    // Task to notify after a burst that executed anything, so the owner can
+    // collect results without polling for them (see EventScheduler::wake).
+    void setListener(TaskHandle_t task) { _listener = task; }
+
+    // Supply switch cycled around each burst. nullptr: line always powered.
+    void setPower(BusPower* power) { _power = power; }
+
+    // Queues a read. priority: higher runs first. deadlineMs: absolute millis()
+    // after which the result is no longer wanted. retries: extra attempts on failure.
+    // required: values that decide ok and attempts (0: all of `params`).
+    Ticket submit(Driver::SmartMeterDriver* drv, Driver::ParamSet params, uint8_t priority, uint32_t deadlineMs,
+                  uint8_t retries = 0, Driver::ParamSet required = 0) {
+        if (!drv) return kNoTicket;
+        if (!required) required = params;
+        Ticket t = kNoTicket;
+
+        portENTER_CRITICAL(&_lock);
+        for (size_t i = 0; i < kMaxRequests; i++) {
+            Request& r = _requests[i];
+            if (r.state == State::Queued && r.drv == drv) {
+                r.params |= params;
+                r.required |= required;
+                if (priority > r.priority) r.priority = priority;
+                if (retries > r.retries) r.retries = retries;
+                if ((int32_t)(deadlineMs - r.deadlineMs) < 0) r.deadlineMs = deadlineMs;
+                t = (Ticket)i;
+                break;
+            }
+        }
+        if (t == kNoTicket) {
+            for (size_t i = 0; i < kMaxRequests; i++) {
+                Request& r = _requests[i];
+                if (r.state != State::Free) continue;
+                r.drv = drv;
+                r.params = params;
+                r.required = required;
+                r.priority = priority;
+                r.deadlineMs = deadlineMs;
+                r.retries = retries;
+                r.seq = _seq++;
+                r.ok = false;
+                r.attempts = 0;
+                r.result = Driver::MeterReading();
+                r.state = State::Queued;
+                t = (Ticket)i;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&_lock);
+
+        if (t != kNoTicket && _task) xTaskNotifyGive(_task);
+        return t;
+    }
+
+    // Non-blocking: returns true once the request finished (successfully or not)
+    // and releases the ticket. ok tells whether every required value was read;
+    // attempts, if given, how many reads that took (0: expired before the bus).
+    bool poll(Ticket t, Driver::MeterReading& out, bool& ok, uint8_t* attempts = nullptr) {
+        if (t < 0 || (size_t)t >= kMaxRequests) return false;
+        bool done = false;
+        portENTER_CRITICAL(&_lock);
+        Request& r = _requests[t];
+        if (r.state == State::Done) {
+            out = r.result;
+            ok = r.ok;
+            if (attempts) *attempts = r.attempts;
+            r.state = State::Free;
+            done = true;
+        }
+        portEXIT_CRITICAL(&_lock);
+        return done;
+    }
+
+    // Frees the request. One that is on the bus right now is waited for, so
+    // the caller may readdress or destroy the driver as soon as this returns.
+    // Never called from the bus task itself.
+    void cancel(Ticket t) {
+        if (t < 0 || (size_t)t >= kMaxRequests) return;
+        portENTER_CRITICAL(&_lock);
+        Request& r = _requests[t];
+        if (r.state == State::Queued || r.state == State::Done) r.state = State::Free;
+        else if (r.state == State::Running) r.state = State::Cancelled;
+        bool inFlight = r.state == State::Cancelled;
+        portEXIT_CRITICAL(&_lock);
+        // runBurst() frees it once the driver call is over (at most one read with retries)
+        while (inFlight && r.state == State::Cancelled) vTaskDelay(1);
+    }
+
+    bool idle() {
+        portENTER_CRITICAL(&_lock);
+        bool any = false;
+        for (auto& r : _requests) any |= (r.state == State::Queued || r.state == State::Running);
+        portEXIT_CRITICAL(&_lock);
+        return !any;
+    }
+
+    // Executes queued requests until the queue is empty. Runs on the bus task;
+    // the driver calls happen outside the lock. Returns the transactions;
+    // `completed` gets the requests that turned Done, expired ones included.
+    size_t runBurst(size_t* completed = nullptr) {
+        size_t executed = 0;
+        size_t done = 0;
+        bool firstOk = false;
+        bool retryOk = false;
+        uint32_t start = millis();
+        while (true) {
+            int next = -1;
+            uint32_t now = millis();
+            portENTER_CRITICAL(&_lock);
+            for (size_t i = 0; i < kMaxRequests; i++) {
+                Request& r = _requests[i];
+                if (r.state != State::Queued) continue;
+                if ((int32_t)(now - r.deadlineMs) > 0) {
+                    r.ok = false;
+                    r.state = State::Done; // Expired: owner sees ok == false
+                    _stats.expired++;
+                    done++;
+                    continue;
+                }
+                if (next < 0 || before(r, _requests[next])) next = (int)i;
+            }
+            if (next >= 0) _requests[next].state = State::Running;
+            portEXIT_CRITICAL(&_lock);
+            if (next < 0) break;
+            if (_power && !executed) _power->powerUp();
+
+            Request& r = _requests[next];
+            Driver::MeterReading result;
+            uint8_t attempts = 0;
+            bool ok = readWithRetry(r.drv, r.params, result, r.retries, &attempts, r.required);
+            if (!executed) {
+                // Warm-up evidence: the first meter of the burst only answered on a retry
+                firstOk = ok && attempts == 1;
+                retryOk = ok && attempts > 1;
+            }
+            executed++;
+
+            portENTER_CRITICAL(&_lock);
+            if (r.state == State::Cancelled) {
+                r.state = State::Free;
+            } else {
+                r.result = result;
+                r.ok = ok;
+                r.attempts = attempts;
+                r.state = State::Done;
+                done++;
+            }
+            portEXIT_CRITICAL(&_lock);
+        }
+        if (executed) {
+            if (_power) {
+                _power->noteBurst(firstOk, retryOk);
+                _power->powerDown();
+            }
+            _stats.bursts++;
+            _stats.transactions += executed;
+            _stats.lastBurstMs = millis() - start;
+        }
+        if (completed) *completed = done;
+        return executed;
+    }
+
+    const BurstStats& stats() const { return _stats; }
+
+private:
+    struct Request {
+        Driver::SmartMeterDriver* drv = nullptr;
+        Driver::ParamSet params = 0;
+        Driver::ParamSet required = 0;
+        uint8_t priority = 0;
+        uint32_t deadlineMs = 0;
+        uint8_t retries = 0;
+        uint8_t attempts = 0;
+        uint32_t seq = 0;
+        bool ok = false;
+        Driver::MeterReading result;
+        volatile State state = State::Free;
+    };
+
+    // Short window after the first wake-up so requests submitted in the same
+    // loop() pass (cold + hot) are ordered together.
+    static constexpr uint32_t kGatherMs = 5;
+
+    Request _requests[kMaxRequests];
+    portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+    TaskHandle_t _task = nullptr;
+    TaskHandle_t _listener = nullptr;
+    BusPower* _power = nullptr;
+    uint32_t _seq = 0;
+    BurstStats _stats;
+
+    static bool before(const Request& a, const Request& b) {
+        if (a.priority != b.priority) return a.priority > b.priority;
+        if (a.deadlineMs != b.deadlineMs) return (int32_t)(a.deadlineMs - b.deadlineMs) < 0;
+        return (int32_t)(a.seq - b.seq) < 0;
+    }
+
+    static void taskEntry(void* arg) {
+        BusScheduler* self = static_cast<BusScheduler*>(arg);
+        for (;;) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            vTaskDelay(pdMS_TO_TICKS(kGatherMs));
+            size_t completed = 0;
+            self->runBurst(&completed);
+            // Expired requests too: their owner must collect them to stop waiting
+            if (completed && self->_listener) xTaskNotifyGive(self->_listener);
+        }
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef CHANNELS_H
+#define CHANNELS_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include "zigbee_water_meter.h"
+#include "bus/bus_scheduler.h"
+#include "drivers/driver_factory.h"
+#include "sources/factory_source.h"
+#include "storage/channel_store.h"
+#include "storage/reporting_store.h"
+
+// One row of the device's channel table (see kChannels in main.ino).
+struct ChannelConfig {
+    const char* name;           // For logs only
+    Source::SourceType type;
+    Driver::MeterModel model;   // Smart: protocol of the meter on the RS485 line
+    uint8_t pin;                // Pulse/PulsePcnt: input pin
+    Source::PollBounds poll;    // Default poll interval range (min == max: fixed)
+    bool battery;               // Endpoint carries the Power Config cluster
+};
+
+// Smart channels talk over the shared RS485 line.
+constexpr bool usesBus(const ChannelConfig& c) { return c.type == Source::SourceType::Smart; }
+
+template <size_t N>
+constexpr size_t countBusChannels(const ChannelConfig (&table)[N]) {
+    size_t n = 0;
+    for (size_t i = 0; i < N; i++) n += usesBus(table[i]) ? 1 : 0;
+    return n;
+}
+
+// Everything one metering channel owns at runtime. Channel i is Zigbee
+// endpoint i + 1 and NVS records "ch<i>a/b" and "rc<i>"; the history store
+// uses index i.
+struct Channel {
+    Channel(uint8_t idx, const ChannelConfig& cfg, Preferences* prefs)
+        : config(cfg), index(idx), endpoint(idx + 1, cfg.battery), store(prefs, idx), reporting(prefs, idx) {}
+
+    const ChannelConfig config;
+    const uint8_t index;
+    ZigbeeWaterMeter endpoint;
+    Storage::ChannelStore store;
+    Storage::ReportingStore reporting;
+    std::unique_ptr<Driver::SmartMeterDriver> drv;
+    std::unique_ptr<Source::WaterSource> src;
+};
+
+// Fixed array of N channels generated from a constexpr table. No per-channel
+// globals or ISRs: RAM is N * sizeof(Channel) plus what the sources allocate.
+template <size_t N>
+class ChannelSet {
+public:
+    static_assert(N >= 1, "At least one channel");
+    static_assert(N <= Bus::BusScheduler::kMaxRequests, "Every Smart channel needs a bus request slot");
+    static_assert(N < 240, "Zigbee endpoint ids are 1..240");
+
+    ChannelSet(const ChannelConfig (&table)[N], Preferences* prefs)
+        : ChannelSet(table, prefs, std::make_index_sequence<N>()) {}
+
+    static constexpr size_t size() { return N; }
+    Channel& operator[](size_t i) { return _ch[i]; }
+    Channel* begin() { return _ch; }
+    Channel* end() { return _ch + N; }
+
+    // Creates driver and source of channel i from its restored state. Smart
+    // channels share `rs485` (and its frame path `link`, if it has one); with
+    // a bus task (`sched`) their polls are queued there, lower channel index
+    // first within a burst.
+    bool build(size_t i, const Storage::ChannelState& st, Stream* rs485, Bus::BusScheduler* sched,
+               Driver::FrameLink* link = nullptr) {
+        Channel& c = _ch[i];
+        if (usesBus(c.config)) {
+            // Model from the table: the source is typed on its driver (no vtable on polls)
+            c.drv.reset(Driver::DriverFactory::create(c.config.model, rs485, st.serial));
+            if (c.drv) c.drv->setFrameLink(link);
+            c.src.reset(Source::SourceFactory::createSmart(c.config.model, st.liters, c.drv.get()));
+        } else {
+            c.src.reset(Source::SourceFactory::create(c.config.type, st.liters, c.config.pin, nullptr));
+        }
+        if (!c.src) return false;
+
+        if (sched && usesBus(c.config)) {
+            static_cast<Source::SmartSourceBase*>(c.src.get())->setBusScheduler(sched, (uint8_t)(N - i));
+        }
+        // Bounds set by the coordinator win over the table
+        c.src->setPollBounds(st.pollMaxMs ? Source::PollBounds{ st.pollMinMs, st.pollMaxMs } : c.config.poll);
+        c.src->setOffset(st.offset);
+        c.src->setSerialNumber(st.serial);
+        return true;
+    }
+
+    // A bus channel is pulled forward only this close to its own next poll
+    // (share of its interval): a meter backed off to a long interval is not
+    // dragged along by a busy one at the rate of the busy one.
+    static constexpr uint32_t kPullForwardShare = 4;
+
+    // Ticks every source. Channels on the bus poll together: as soon as one
+    // of them is due, the others within kPullForwardShare of their own
+    // deadline are pulled forward, so meters on similar intervals are read in
+    // one burst (one bus power-up) rather than one per meter.
+    void tick() {
+        uint32_t now = millis();
+        bool busDue = false;
+        for (auto& c : _ch) {
+            if (c.src && usesBus(c.config) && c.src->pollDue(now)) busDue = true;
+        }
+        for (auto& c : _ch) {
+            if (!c.src) continue;
+            if (busDue && usesBus(c.config) &&
+                c.src->msUntilPoll(now) <= c.src->getPollInterval() / kPullForwardShare) {
+                c.src->forceUpdate();
+            }
+            c.src->tick();
+        }
+    }
+
+    // Time until tick() has work on any channel (see WaterSource::msUntilDue).
+    uint32_t msUntilDue(uint32_t now) const {
+        uint32_t d = UINT32_MAX;
+        for (const auto& c : _ch) {
+            if (c.src) d = std::min(d, c.src->msUntilDue(now));
+        }
+        return d;
+    }
+
+    // True while any channel still waits for a bus result.
+    bool awaitingData() const {
+        for (const auto& c : _ch) {
+            if (c.src && c.src->awaitingData()) return true;
+        }
+        return false;
+    }
+
+private:
+    template <size_t... I>
+    ChannelSet(const ChannelConfig (&table)[N], Preferences* prefs, std::index_sequence<I...>)
+        : _ch{ Channel((uint8_t)I, table[I], prefs)... } {}
+
+    Channel _ch[N];
+};
+
+#endif
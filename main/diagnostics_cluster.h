@@ -0,0 +1,91 @@
+#ifndef DIAGNOSTICS_CLUSTER_H
+#define DIAGNOSTICS_CLUSTER_H
+
+#include "esp_zigbee_core.h"
+#include "metrics.h"
+
+namespace Metrics {
+
+// Manufacturer-specific cluster that exposes the metrics registry, all
+// attributes read-only u32 unless noted:
+//
+//   0x0000          uptime, s
+//   0x0010 + i      Counter i, total since boot
+//   0x0020 + i      Counter i, growth over the last completed hour
+//   0x0100 + 16*h   Histogram h: +0 count, +1 p50, +2 p95, +3 max, +4 mean,
+//                   +5 bucket counts (octet string, kBuckets x u16 LE, saturated)
+//
+// Nothing is copied on the hot path: the attribute table is filled by
+// refresh() right before the stack answers a Read Attributes for the cluster
+// (raw command hook in main.ino).
+class DiagnosticsCluster {
+public:
+    static constexpr uint16_t kClusterId = 0xFC00;
+    static constexpr uint16_t kAttrUptime = 0x0000;
+    static constexpr uint16_t kAttrCounters = 0x0010;
+    static constexpr uint16_t kAttrCountersLastHour = 0x0020;
+    static constexpr uint16_t kAttrHistograms = 0x0100;
+    static constexpr size_t kBucketsLen = 2 * kBuckets;
+
+    static uint16_t histogramAttr(Histogram h, uint8_t field) {
+        return kAttrHistograms + 16 * static_cast<uint16_t>(h) + field;
+    }
+
+    // Attribute list for esp_zb_cluster_list_add_custom_cluster().
+    static esp_zb_attribute_list_t* create() {
+        esp_zb_attribute_list_t* list = esp_zb_zcl_attr_list_create(kClusterId);
+        uint32_t zero = 0;
+        uint8_t buckets[1 + kBucketsLen] = { (uint8_t)kBucketsLen };
+        addU32(list, kAttrUptime, &zero);
+        for (size_t i = 0; i < kCounters; i++) {
+            addU32(list, kAttrCounters + i, &zero);
+            addU32(list, kAttrCountersLastHour + i, &zero);
+        }
+        for (size_t h = 0; h < kHistograms; h++) {
+            for (uint8_t f = 0; f < 5; f++) addU32(list, histogramAttr((Histogram)h, f), &zero);
+            esp_zb_cluster_add_attr(list, kClusterId, histogramAttr((Histogram)h, 5), ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING,
+                                    ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, buckets);
+        }
+        return list;
+    }
+
+    // Copies the registry into the attribute table of `endpoint`. Runs in the
+    // stack callback, so no lock here.
+    static void refresh(uint8_t endpoint, uint32_t now) {
+        const Registry& r = registry();
+        setU32(endpoint, kAttrUptime, now / 1000);
+        for (size_t i = 0; i < kCounters; i++) {
+            setU32(endpoint, kAttrCounters + i, r.get((Counter)i));
+            setU32(endpoint, kAttrCountersLastHour + i, r.lastHour((Counter)i));
+        }
+        for (size_t i = 0; i < kHistograms; i++) {
+            Histogram h = (Histogram)i;
+            setU32(endpoint, histogramAttr(h, 0), r.count(h));
+            setU32(endpoint, histogramAttr(h, 1), r.percentile(h, 50));
+            setU32(endpoint, histogramAttr(h, 2), r.percentile(h, 95));
+            setU32(endpoint, histogramAttr(h, 3), r.max(h));
+            setU32(endpoint, histogramAttr(h, 4), r.mean(h));
+
+            uint8_t buckets[1 + kBucketsLen];
+            buckets[0] = kBucketsLen;
+            for (size_t b = 0; b < kBuckets; b++) {
+                uint32_t n = std::min<uint32_t>(r.bucketCount(h, b), 0xFFFF);
+                buckets[1 + 2 * b] = n & 0xFF;
+                buckets[2 + 2 * b] = n >> 8;
+            }
+            esp_zb_zcl_set_attribute_val(endpoint, kClusterId, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, histogramAttr(h, 5), buckets, false);
+        }
+    }
+
+private:
+    static void addU32(esp_zb_attribute_list_t* list, uint16_t id, uint32_t* value) {
+        esp_zb_cluster_add_attr(list, kClusterId, id, ESP_ZB_ZCL_ATTR_TYPE_U32, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, value);
+    }
+    static void setU32(uint8_t endpoint, uint16_t id, uint32_t value) {
+        esp_zb_zcl_set_attribute_val(endpoint, kClusterId, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, id, &value, false);
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef CRC16_MODBUS_H
+#define CRC16_MODBUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Driver {
+
+// CRC16/MODBUS (poly 0xA001 reflected, init 0xFFFF) shared by all RS485 drivers.
+//
+// Lookup tables are generated at compile time and live in .rodata, which on the
+// ESP32-C6 is mapped from flash: the byte-wise table costs 512 B of flash and no
+// RAM, the optional slicing-by-4 tables 2 KiB of flash. Tables are only emitted
+// when the corresponding function is actually used.
+//
+// A frame followed by its own CRC (low byte first) yields a CRC of 0, so the
+// incremental API can validate a reply while it streams in from the UART.
+template <size_t Slices>
+struct Crc16Tables {
+    uint16_t t[Slices][256];
+};
+
+template <size_t Slices>
+constexpr Crc16Tables<Slices> makeCrc16Tables() {
+    Crc16Tables<Slices> r{};
+    for (uint16_t i = 0; i < 256; i++) {
+        uint16_t crc = i;
+        for (int b = 0; b < 8; b++) crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        r.t[0][i] = crc;
+    }
+    for (size_t s = 1; s < Slices; s++) {
+        for (uint16_t i = 0; i < 256; i++) {
+            uint16_t prev = r.t[s - 1][i];
+            r.t[s][i] = (prev >> 8) ^ r.t[0][prev & 0xFF];
+        }
+    }
+    return r;
+}
+
+template <size_t Slices>
+inline constexpr Crc16Tables<Slices> kCrc16Tables = makeCrc16Tables<Slices>();
+
+class Crc16Modbus {
+public:
+    static constexpr uint16_t kInit = 0xFFFF;
+
+    constexpr Crc16Modbus() = default;
+
+    void reset() { _crc = kInit; }
+    void update(uint8_t b) { _crc = step(_crc, b); }
+    void update(const uint8_t* data, size_t len) { _crc = compute(data, len, _crc); }
+    uint16_t value() const { return _crc; }
+
+    // One-shot, byte-wise table lookup. Usable in constant expressions.
+    static constexpr uint16_t compute(const uint8_t* data, size_t len, uint16_t crc = kInit) {
+        for (size_t i = 0; i < len; i++) crc = step(crc, data[i]);
+        return crc;
+    }
+
+    // Slicing-by-4: four lookups per 4 input bytes. Only pays off on long
+    // buffers (history dumps, Modbus block reads); meter replies are ~14-40 B.
+    static uint16_t computeSliced(const uint8_t* data, size_t len, uint16_t crc = kInit) {
+        const auto& t = kCrc16Tables<4>.t;
+        while (len >= 4) {
+            crc = t[3][(crc ^ data[0]) & 0xFF] ^ t[2][((crc >> 8) ^ data[1]) & 0xFF] ^
+                  t[1][data[2]] ^ t[0][data[3]];
+            data += 4;
+            len -= 4;
+        }
+        while (len--) crc = step(crc, *data++);
+        return crc;
+    }
+
+private:
+    uint16_t _crc = kInit;
+
+    static constexpr uint16_t step(uint16_t crc, uint8_t b) {
+        return (crc >> 8) ^ kCrc16Tables<1>.t[0][(crc ^ b) & 0xFF];
+    }
+};
+
+namespace crc16_check {
+constexpr uint8_t kCheckInput[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+static_assert(Crc16Modbus::compute(kCheckInput, sizeof(kCheckInput)) == 0x4B37, "CRC16/MODBUS check value");
+}
+
+}
+
+#endif
@@ -3,24 +3,69 @@
 
 #include "smart_driver.h"
 #include "pulsar_ds15_20.h"
+#include "modbus_rtu.h"
 #include "mock_meter_driver.h"
 
 namespace Driver {
 enum class MeterModel {
     Mock,           // Симуляция
     Pulsar_Du_15_20,      // Наш текущий Пульсар
-    Modbus_Generic  // (на будущее)
+    Modbus_Generic  // Modbus RTU по карте регистров (kModbusMeterMap)
 };
 
+// Compile-time description of a model: concrete driver type, what it can
+// read and how it is built. Only implemented models are specialised, so
+// asking for an unknown one at build time does not compile.
+template <MeterModel M>
+struct MeterTraits;
+
+template <>
+struct MeterTraits<MeterModel::Pulsar_Du_15_20> {
+    typedef PulsarDu_15_20 Type;
+    static constexpr ParamSet kParams = PulsarDu_15_20::kSupportedParams;
+    static Type* create(Stream* transport, uint32_t address) { return new PulsarDu_15_20(transport, address); }
+};
+
+template <>
+struct MeterTraits<MeterModel::Modbus_Generic> {
+    typedef ModbusRtu Type;
+    static constexpr ParamSet kParams = ModbusRtu::kSupportedParams;
+    static Type* create(Stream* transport, uint32_t address) { return new ModbusRtu(transport, address); } // address: slave id
+};
+
+template <>
+struct MeterTraits<MeterModel::Mock> {
+    typedef MockMeterDriver Type;
+    static constexpr ParamSet kParams = MockMeterDriver::kSupportedParams;
+    static Type* create(Stream*, uint32_t) { return new MockMeterDriver(); } // Ему транспорт не нужен
+};
+
+template <MeterModel M>
+using DriverFor = typename MeterTraits<M>::Type;
+
+// Capability table keyed by model; 0 for models without a driver.
+constexpr ParamSet capabilities(MeterModel model) {
+    switch (model) {
+        case MeterModel::Pulsar_Du_15_20: return MeterTraits<MeterModel::Pulsar_Du_15_20>::kParams;
+        case MeterModel::Modbus_Generic:  return MeterTraits<MeterModel::Modbus_Generic>::kParams;
+        case MeterModel::Mock:            return MeterTraits<MeterModel::Mock>::kParams;
+        default:                          return 0;
+    }
+}
+
+// Runtime selection; the model -> type mapping comes from MeterTraits.
 class DriverFactory {
 public:
     static SmartMeterDriver* create(MeterModel model, Stream* transport, uint32_t address) {
         switch (model) {
             case MeterModel::Pulsar_Du_15_20:
-                return new PulsarDu_15_20(transport, address);
-            
+                return MeterTraits<MeterModel::Pulsar_Du_15_20>::create(transport, address);
+
+            case MeterModel::Modbus_Generic:
+                return MeterTraits<MeterModel::Modbus_Generic>::create(transport, address);
+
             case MeterModel::Mock:
-                return new MockMeterDriver(); // Ему транспорт не нужен
+                return MeterTraits<MeterModel::Mock>::create(transport, address);
 
             default:
                 return nullptr;
@@ -28,4 +73,4 @@ public:
     }
 };
 }
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,132 @@
+#ifndef FRAME_RECEIVER_H
+#define FRAME_RECEIVER_H
+
+#include <Arduino.h>
+#include "crc16_modbus.h"
+
+namespace Driver {
+
+// Shape of an expected reply frame.
+//
+// The receiver stops as soon as `expectedLen` bytes are in, or, if the protocol
+// carries its own length byte, as soon as the length announced at
+// `lengthOffset` is reached. Trailing two bytes are a little-endian CRC16/MODBUS.
+struct FrameSpec {
+    size_t expectedLen;        // Length we expect for this command (upper bound if lengthOffset is used)
+    int lengthOffset = -1;     // Index of the total-length byte, -1 if the frame has none
+    size_t minLen = 4;         // Shortest frame that can possibly be valid
+};
+
+enum class RxStatus {
+    Ok,
+    Timeout,      // Nothing arrived before the response timeout
+    Incomplete,   // Frame started but the line went idle (inter-byte gap exceeded)
+    BadLength,    // Length byte is outside [minLen, buffer size]
+    CrcError
+};
+
+// Transport that hands over received bytes a burst at a time: everything up
+// to the next idle line, copied out in one go (see RS485UartStream). Drivers
+// get one through SmartMeterDriver::setFrameLink(); without it they read the
+// Stream byte by byte.
+class FrameLink {
+public:
+    virtual ~FrameLink() {}
+
+    // Waits up to `waitMs` for data, then until the line goes idle or `cap`
+    // bytes are in. Returns the number of bytes copied to buf, 0 on timeout.
+    virtual size_t readFrame(uint8_t* buf, size_t cap, uint32_t waitMs) = 0;
+};
+
+// Frame-length-aware receive on top of any Stream.
+//
+// Replaces Stream::readBytes(buf, N), which always waits out the full stream
+// timeout when the reply is shorter than N. Here the wait ends when the frame
+// is complete, when the line stays idle longer than the inter-byte gap, or
+// when no byte at all arrived within the response timeout. The CRC is
+// accumulated per byte, so there is no second pass over the buffer.
+class FrameReceiver {
+public:
+    FrameReceiver(uint32_t responseTimeoutMs = 300, uint32_t interByteGapMs = 20)
+        : _responseTimeoutMs(responseTimeoutMs), _interByteGapMs(interByteGapMs) {}
+
+    void setTimeouts(uint32_t responseTimeoutMs, uint32_t interByteGapMs) {
+        _responseTimeoutMs = responseTimeoutMs;
+        _interByteGapMs = interByteGapMs;
+    }
+
+    // Receives one frame into buf (capacity cap). rxLen is always set to the
+    // number of bytes read so callers can log partial frames.
+    RxStatus receive(Stream* s, uint8_t* buf, size_t cap, const FrameSpec& spec, size_t& rxLen) {
+        rxLen = 0;
+        size_t want = spec.expectedLen < cap ? spec.expectedLen : cap;
+        uint32_t start = millis();
+        uint32_t lastByte = start;
+        Crc16Modbus crc;
+
+        while (rxLen < want) {
+            if (s->available() <= 0) {
+                uint32_t now = millis();
+                if (rxLen == 0 && now - start >= _responseTimeoutMs) return RxStatus::Timeout;
+                if (rxLen > 0 && now - lastByte >= _interByteGapMs) return RxStatus::Incomplete;
+                delay(1); // UART FIFO keeps collecting; let the CPU idle meanwhile
+                continue;
+            }
+            int c = s->read();
+            if (c < 0) continue;
+            buf[rxLen++] = (uint8_t)c;
+            crc.update((uint8_t)c);
+            lastByte = millis();
+
+            if (spec.lengthOffset >= 0 && rxLen == (size_t)spec.lengthOffset + 1) {
+                size_t announced = buf[spec.lengthOffset];
+                if (announced < spec.minLen || announced > cap) return RxStatus::BadLength;
+                want = announced;
+            }
+        }
+
+        if (rxLen < 2) return RxStatus::Incomplete;
+        // CRC over payload + its own CRC bytes is zero for an intact frame
+        return crc.value() == 0 ? RxStatus::Ok : RxStatus::CrcError;
+    }
+
+    // Same on a FrameLink, if the transport has one. A reply normally comes in
+    // one piece; a meter that pauses mid-frame longer than the link's idle
+    // time (but within the inter-byte gap) gives several. A CRC-correct piece
+    // shorter than expected ends the wait at once instead of after the gap.
+    RxStatus receive(Stream* s, FrameLink* link, uint8_t* buf, size_t cap, const FrameSpec& spec, size_t& rxLen) {
+        if (!link) return receive(s, buf, cap, spec, rxLen);
+        rxLen = 0;
+        size_t want = spec.expectedLen < cap ? spec.expectedLen : cap;
+        bool lengthKnown = spec.lengthOffset < 0;
+
+        while (rxLen < want) {
+            size_t n = link->readFrame(buf + rxLen, want - rxLen, rxLen ? _interByteGapMs : _responseTimeoutMs);
+            if (n == 0) return rxLen ? RxStatus::Incomplete : RxStatus::Timeout;
+            rxLen += n;
+
+            if (!lengthKnown && rxLen > (size_t)spec.lengthOffset) {
+                size_t announced = buf[spec.lengthOffset];
+                if (announced < spec.minLen || announced > cap) return RxStatus::BadLength;
+                want = announced;
+                lengthKnown = true;
+            }
+            if (rxLen > want) rxLen = want; // Line noise after the frame
+            // Shorter but intact frame (e.g. a Modbus exception): the idle line ended it
+            if (rxLen < want && rxLen >= spec.minLen && Crc16Modbus::compute(buf, rxLen) == 0) {
+                return RxStatus::Incomplete;
+            }
+        }
+
+        if (rxLen < 2) return RxStatus::Incomplete;
+        return Crc16Modbus::compute(buf, rxLen) == 0 ? RxStatus::Ok : RxStatus::CrcError;
+    }
+
+private:
+    uint32_t _responseTimeoutMs;
+    uint32_t _interByteGapMs;
+};
+
+}
+
+#endif
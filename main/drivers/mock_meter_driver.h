@@ -5,16 +5,17 @@
 #include <cmath>
 
 namespace Driver {
-    class MockMeterDriver : public SmartMeterDriver {
+    class MockMeterDriver final : public SmartMeterDriver {
     private:
         float _mockVol = 100.0;
 
     public:
         MockMeterDriver() : SmartMeterDriver(nullptr) {} // Транспорт не нужен
 
-        std::vector<MeterParam> getSupportedParams() const override {
-            return { MeterParam::TotalVolume, MeterParam::BatteryVoltage };
-        }
+        static constexpr ParamSet kSupportedParams =
+            paramBit(MeterParam::TotalVolume) | paramBit(MeterParam::BatteryVoltage);
+
+        ParamSet supportedParams() const override { return kSupportedParams; }
 
         void setAddress(uint32_t address) override { _address = address; }
 
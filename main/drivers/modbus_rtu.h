@@ -0,0 +1,239 @@
+#ifndef MODBUS_RTU_H
+#define MODBUS_RTU_H
+
+#include "smart_driver.h"
+#include "frame_receiver.h"
+#include "crc16_modbus.h"
+#include "metrics.h"
+#include "log.h"
+
+namespace Driver {
+
+// Value encoding of one mapped register (or register pair).
+enum class ModbusType : uint8_t {
+    U16,
+    S16,
+    U32,
+    S32,
+    Float32   // IEEE 754
+};
+
+// Order of the two 16-bit words of a 32-bit value (bytes within a word are
+// always big-endian, as Modbus defines).
+enum class WordOrder : uint8_t {
+    HighFirst, // ABCD
+    LowFirst   // CDAB ("word swapped"), common on meters
+};
+
+// Where one MeterParam lives on the slave. value = raw * scale, in the units
+// MeterReading uses (m3 for volume, V for battery, m3/h for flow).
+struct ModbusRegister {
+    MeterParam param;
+    uint8_t function;      // 0x03 holding or 0x04 input registers
+    uint16_t address;      // Protocol address (0-based)
+    ModbusType type;
+    WordOrder order;
+    float scale;
+};
+
+struct ModbusRegisterMap {
+    const ModbusRegister* regs;
+    size_t count;
+};
+
+constexpr uint8_t modbusWords(ModbusType t) { return t == ModbusType::U16 || t == ModbusType::S16 ? 1 : 2; }
+
+constexpr ParamSet modbusParams(const ModbusRegisterMap& map) {
+    ParamSet p = 0;
+    for (size_t i = 0; i < map.count; i++) p |= paramBit(map.regs[i].param);
+    return p;
+}
+
+// Register map used for Modbus_Generic channels: a battery water meter with
+// the volume as a 32-bit liter counter and the battery block right behind it.
+// Replace for another meter; the typed source polls what this map covers.
+constexpr ModbusRegister kModbusMeterRegs[] = {
+    { MeterParam::TotalVolume,           0x03, 0x0000, ModbusType::U32,     WordOrder::HighFirst, 0.001f }, // L
+    { MeterParam::BatteryVoltage,        0x03, 0x0004, ModbusType::U16,     WordOrder::HighFirst, 0.001f }, // mV
+    { MeterParam::BatteryThresholdMin,   0x03, 0x0005, ModbusType::U16,     WordOrder::HighFirst, 0.001f },
+    { MeterParam::BatteryThresholdAlarm, 0x03, 0x0006, ModbusType::U16,     WordOrder::HighFirst, 0.001f },
+    { MeterParam::FlowRateMax,           0x03, 0x0020, ModbusType::Float32, WordOrder::LowFirst,  1.0f   }, // m3/h
+};
+constexpr ModbusRegisterMap kModbusMeterMap = { kModbusMeterRegs, sizeof(kModbusMeterRegs) / sizeof(kModbusMeterRegs[0]) };
+
+// Modbus RTU master for any meter described by a ModbusRegisterMap.
+//
+// A batched read sorts the requested registers by function and address and
+// merges neighbours into one read (0x03/0x04) as long as the hole between
+// them is at most kMaxGapWords and the block stays within kMaxReadWords:
+// two bytes per skipped register are cheaper than another request, reply
+// latency and turnaround. Values are decoded straight out of the receive
+// buffer. The bus address is the slave id (1..247).
+//
+// Some slaves refuse a read that touches an unmapped register (exception
+// 02). Then the span is read again without holes, and the driver stops
+// bridging holes for good: one extra request once instead of on every poll.
+class ModbusRtu final : public SmartMeterDriver {
+public:
+    static constexpr ParamSet kSupportedParams = modbusParams(kModbusMeterMap);
+    static constexpr size_t kMaxRegisters = 16;
+    static constexpr uint16_t kMaxReadWords = 32;
+    static constexpr uint16_t kMaxGapWords = 4;
+    // 3.5 character times at 9600 baud: frame delimiter before every request
+    static constexpr uint32_t kFrameGapUs = 4010;
+
+    struct Stats {
+        uint32_t requests = 0;
+        uint32_t exceptions = 0;   // Slave answered with an exception code
+    };
+
+    static constexpr uint8_t kIllegalDataAddress = 0x02;
+
+    ModbusRtu(Stream* stream, uint32_t address, const ModbusRegisterMap& map = kModbusMeterMap)
+        : SmartMeterDriver(stream), _map(map) {
+        setAddress(address);
+    }
+
+    ParamSet supportedParams() const override { return modbusParams(_map); }
+
+    bool getValue(MeterParam param, float &result) override {
+        MeterReading r;
+        if (!readValues(paramBit(param), r)) return false;
+        result = r.get(param);
+        return true;
+    }
+
+    bool readValues(ParamSet params, MeterReading &out) override {
+        if (!_transport || _address < 1 || _address > 247) return false;
+
+        // Requested registers, by (function, address)
+        uint8_t idx[kMaxRegisters];
+        size_t n = 0;
+        for (size_t i = 0; i < _map.count && n < kMaxRegisters; i++) {
+            if (!(params & paramBit(_map.regs[i].param))) continue;
+            size_t j = n++;
+            for (; j > 0 && after(_map.regs[idx[j - 1]], _map.regs[i]); j--) idx[j] = idx[j - 1];
+            idx[j] = (uint8_t)i;
+        }
+
+        for (size_t i = 0; i < n;) {
+            const ModbusRegister& first = _map.regs[idx[i]];
+            uint16_t start = first.address;
+            uint16_t end = start + modbusWords(first.type);
+            uint16_t mapped = end - start;
+            size_t j = i + 1;
+            for (; j < n; j++) {
+                const ModbusRegister& r = _map.regs[idx[j]];
+                uint16_t rEnd = r.address + modbusWords(r.type);
+                if (r.function != first.function || r.address > end + _maxGapWords) break;
+                if ((rEnd > end ? rEnd : end) - start > kMaxReadWords) break;
+                if (rEnd > end) end = rEnd;
+                mapped += modbusWords(r.type);
+            }
+
+            const uint8_t* data = readRegisters(first.function, start, end - start);
+            if (!data && _lastException == kIllegalDataAddress && _maxGapWords && mapped < end - start) {
+                _maxGapWords = 0;
+                continue; // Same registers again, without holes
+            }
+            if (data) {
+                for (size_t k = i; k < j; k++) {
+                    const ModbusRegister& r = _map.regs[idx[k]];
+                    out.set(r.param, decode(data + 2 * (r.address - start), r));
+                }
+            }
+            i = j;
+        }
+        return (out.valid & params) == params;
+    }
+
+    void setAddress(uint32_t address) override { _address = address; }
+
+    void setMap(const ModbusRegisterMap& map) {
+        _map = map;
+        _maxGapWords = kMaxGapWords;
+    }
+
+    // Holes currently bridged inside one read (0 once the slave refused one).
+    uint16_t maxGapWords() const { return _maxGapWords; }
+
+    const Stats& stats() const { return _stats; }
+
+    // Raw register words -> value, big-endian words in `order`.
+    static float decode(const uint8_t* p, const ModbusRegister& r) {
+        uint32_t w0 = (uint32_t)p[0] << 8 | p[1];
+        if (r.type == ModbusType::U16) return w0 * r.scale;
+        if (r.type == ModbusType::S16) return (int16_t)w0 * r.scale;
+        uint32_t w1 = (uint32_t)p[2] << 8 | p[3];
+        uint32_t raw = r.order == WordOrder::HighFirst ? (w0 << 16 | w1) : (w1 << 16 | w0);
+        if (r.type == ModbusType::U32) return raw * r.scale;
+        if (r.type == ModbusType::S32) return (int32_t)raw * r.scale;
+        float f;
+        memcpy(&f, &raw, 4);
+        return f * r.scale;
+    }
+
+private:
+    // Reply: SLAVE(1) F(1) COUNT(1) DATA(2 per word) CRC(2)
+    static constexpr size_t kReplyOverhead = 5;
+    static constexpr uint8_t kExceptionBit = 0x80;
+
+    ModbusRegisterMap _map;
+    FrameReceiver _rx;
+    uint8_t _res[kReplyOverhead + 2 * kMaxReadWords];
+    Stats _stats;
+    uint16_t _maxGapWords = kMaxGapWords;
+    uint8_t _lastException = 0;
+
+    static bool after(const ModbusRegister& a, const ModbusRegister& b) {
+        return a.function != b.function ? a.function > b.function : a.address > b.address;
+    }
+
+    // One read request; returns the first data byte in the receive buffer
+    // (valid until the next request) or nullptr.
+    const uint8_t* readRegisters(uint8_t function, uint16_t start, uint16_t words) {
+        uint8_t packet[8] = { (uint8_t)_address, function, (uint8_t)(start >> 8), (uint8_t)start,
+                              (uint8_t)(words >> 8), (uint8_t)words };
+        uint16_t crc = Crc16Modbus::compute(packet, 6);
+        packet[6] = crc & 0xFF;
+        packet[7] = crc >> 8;
+
+        LOG_V(Drv, ">>> TX [%u] F%02X %04X x%u", _address, function, start, words);
+
+        _lastException = 0;
+        uint32_t t0 = micros();
+        while (_transport->available()) _transport->read();
+        delayMicroseconds(kFrameGapUs);
+        _transport->write(packet, sizeof(packet));
+        _transport->flush();
+        _stats.requests++;
+
+        size_t replyLen = kReplyOverhead + 2 * words;
+        size_t rxLen = 0;
+        RxStatus st = _rx.receive(_transport, _link, _res, replyLen, FrameSpec{replyLen, -1, kReplyOverhead}, rxLen);
+        Metrics::record(Metrics::Histogram::RsTransactionUs, micros() - t0);
+        Metrics::count(Metrics::Counter::RsTransactions);
+
+        // Exception replies are shorter than the data we asked for: the
+        // receiver ends on the idle line with a full, CRC-correct 5-byte frame.
+        if (st == RxStatus::Incomplete && rxLen == kReplyOverhead && _res[1] == (function | kExceptionBit) &&
+            Crc16Modbus::compute(_res, rxLen) == 0) {
+            _stats.exceptions++;
+            _lastException = _res[2];
+            LOG_W(Drv, "RX [%u] exception %u", _address, _res[2]);
+            return nullptr;
+        }
+        if (st == RxStatus::CrcError) Metrics::count(Metrics::Counter::RsCrcErrors);
+        else if (st == RxStatus::Timeout || st == RxStatus::Incomplete) Metrics::count(Metrics::Counter::RsTimeouts);
+        if (st != RxStatus::Ok) LOG_W(Drv, "RX [%u] failed: status %d", _address, st);
+        if (st != RxStatus::Ok) return nullptr;
+
+        // От того же slave, на ту же функцию, ровно запрошенные слова
+        if (_res[0] != packet[0] || _res[1] != function || _res[2] != 2 * words) return nullptr;
+        return _res + 3;
+    }
+};
+
+}
+
+#endif
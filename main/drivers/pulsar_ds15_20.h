@@ -2,41 +2,73 @@
 #define PULSAR_DS15_20_RS485_H
 
 #include "smart_driver.h"
+#include "frame_receiver.h"
+#include "crc16_modbus.h"
+#include "metrics.h"
+#include "log.h"
 
 
 namespace Driver {
-class PulsarDu_15_20 : public SmartMeterDriver {
+class PulsarDu_15_20 final : public SmartMeterDriver {
 public:
     PulsarDu_15_20(Stream* stream, uint32_t address) : SmartMeterDriver(stream) {
         setAddress(address);
     }
 
-    // Сообщаем, что этот Пульсар умеет отдавать
-    std::vector<MeterParam> getSupportedParams() const override {
-        return {
-            MeterParam::TotalVolume,
-            MeterParam::BatteryVoltage,
-            MeterParam::BatteryThresholdMin,
-            MeterParam::BatteryThresholdAlarm
-        };
-    }
+    // Что этот Пульсар умеет отдавать
+    static constexpr ParamSet kSupportedParams =
+        paramBit(MeterParam::TotalVolume) |
+        paramBit(MeterParam::BatteryVoltage) |
+        paramBit(MeterParam::BatteryThresholdMin) |
+        paramBit(MeterParam::BatteryThresholdAlarm);
+
+    ParamSet supportedParams() const override { return kSupportedParams; }
 
     // Универсальный метод чтения
     bool getValue(MeterParam param, float &result) override {
+        MeterReading r;
+        if (!readValues(paramBit(param), r)) return false;
+        result = r.get(param);
+        return true;
+    }
+
+    // Пакетное чтение за одно включение шины: все канальные параметры идут
+    // одним запросом 0x01 с общей маской каналов, параметры 0x0A (батарея) —
+    // следом в той же сессии. Пороги батареи — настройки счетчика, они
+    // читаются один раз и дальше отдаются из кэша.
+    bool readValues(ParamSet params, MeterReading &out) override {
         if (!_transport) return false; // Защита от разыменования нулевого указателя
 
-        switch (param) {
-            case MeterParam::TotalVolume:
-                return readTotalValue(result);
-            case MeterParam::BatteryVoltage:
-                return readParameter(0x000E, result); // Напряжение батареи
-            case MeterParam::BatteryThresholdMin:
-                return readParameter(0x000F, result); // Порог MIN
-            case MeterParam::BatteryThresholdAlarm:
-                return readParameter(0x0010, result); // Порог ALARM
-            default:
-                return false;
+        uint32_t mask = 0;
+        for (const auto& ch : kChannels) {
+            if (params & paramBit(ch.param)) mask |= 1UL << (ch.channel - 1);
         }
+        if (mask) {
+            float values[kMaxBatchChannels];
+            if (readChannels(mask, values)) {
+                // Значения в ответе идут по возрастанию номера канала
+                for (const auto& ch : kChannels) {
+                    if (!(mask & (1UL << (ch.channel - 1)))) continue;
+                    out.set(ch.param, values[channelSlot(mask, ch.channel)]);
+                }
+            }
+        }
+
+        for (const auto& prm : kParams) {
+            if (!(params & paramBit(prm.param))) continue;
+            if (prm.cacheable && (_cached & paramBit(prm.param))) {
+                out.set(prm.param, _cache.get(prm.param));
+                continue;
+            }
+            float v;
+            if (!readParameter(prm.id, v)) continue;
+            out.set(prm.param, v);
+            if (prm.cacheable) {
+                _cache.set(prm.param, v);
+                _cached |= paramBit(prm.param);
+            }
+        }
+        return (out.valid & params) == params;
     }
 
     void setAddress(uint32_t address) override {
@@ -46,45 +78,67 @@ public:
         _addr[2] = ((address / 100) % 10) | (((address / 1000) % 10) << 4);
         _addr[1] = ((address / 10000) % 10) | (((address / 100000) % 10) << 4);
         _addr[0] = ((address / 1000000) % 10) | (((address / 10000000) % 10) << 4);
+        _cached = 0; // Другой счетчик — другие настройки
     }
 
 private:
+    // Параметр, который счетчик отдает как канал команды 0x01 (номер канала с 1)
+    struct ChannelMapping { MeterParam param; uint8_t channel; };
+    // Параметр, который читается командой 0x0A по идентификатору
+    struct ParamMapping { MeterParam param; uint16_t id; bool cacheable; };
+
+    static constexpr ChannelMapping kChannels[] = {
+        { MeterParam::TotalVolume, 1 },
+    };
+    static constexpr ParamMapping kParams[] = {
+        { MeterParam::BatteryVoltage,        0x000E, false }, // Напряжение батареи
+        { MeterParam::BatteryThresholdMin,   0x000F, true  }, // Порог MIN
+        { MeterParam::BatteryThresholdAlarm, 0x0010, true  }, // Порог ALARM
+    };
+
+    static constexpr size_t kMaxBatchChannels = 8;
+    // Ответ на 0x01: ADDR(4) F(1) L(1) DATA(4 на канал) ID(2) CRC(2)
+    static constexpr size_t kChannelReplyOverhead = 10;
+    // Ответ на 0x0A: ADDR(4) F(1) L(1) DATA(8) ID(2) CRC(2)
+    static constexpr size_t kParamReplyLen = 18;
+
+    FrameReceiver _rx;
+
     uint8_t _addr[4];
+    uint16_t _requestId = 0;   // Echoed by the meter; a late reply to an earlier request does not match
+    MeterReading _cache;
+    ParamSet _cached = 0;
+
+    static size_t channelSlot(uint32_t mask, uint8_t channel) {
+        return __builtin_popcount(mask & ((1UL << (channel - 1)) - 1));
+    }
+
+    // Читает все каналы из маски одним запросом 0x01; out[i] — i-й канал маски.
+    bool readChannels(uint32_t mask, float* out) {
+        size_t count = __builtin_popcount(mask);
+        if (count == 0 || count > kMaxBatchChannels) return false;
 
-    bool readTotalValue(float &result) {
         uint8_t packet[14];
         int len = 0;
         for(int i=0; i<4; i++) packet[len++] = _addr[i];
-        packet[len++] = 0x01; packet[len++] = 0x0E; packet[len++] = 0x01;
-        packet[len++] = 0x00; packet[len++] = 0x00; packet[len++] = 0x00;
-        packet[len++] = 0x00; packet[len++] = 0x01;
-        uint16_t crc = calculateCRC(packet, len);
+        packet[len++] = 0x01; packet[len++] = 0x0E;
+        packet[len++] = mask & 0xFF; packet[len++] = (mask >> 8) & 0xFF;
+        packet[len++] = (mask >> 16) & 0xFF; packet[len++] = (mask >> 24) & 0xFF;
+        len = appendRequestId(packet, len);
+        uint16_t crc = Crc16Modbus::compute(packet, len);
         packet[len++] = crc & 0xFF; packet[len++] = (crc >> 8) & 0xFF;
 
-        if (log_serial) {
-            log_serial->printf(">>> TX [%08u] Vol: ", _address);
-            for(int i=0; i<len; i++) log_serial->printf("%02X ", packet[i]);
-            log_serial->println();
-        }
+        LOG_FRAME(Drv, ">>> TX [%08lu]: ", _address, packet, len);
 
-        while(_transport->available()) _transport->read();
-        _transport->write(packet, len); 
-        _transport->flush();
+        uint8_t res[kChannelReplyOverhead + 4 * kMaxBatchChannels];
+        size_t replyLen = kChannelReplyOverhead + 4 * count;
+        if (!transact(packet, len, res, replyLen)) return false;
 
-        uint8_t res[64];
-        size_t rxLen = _transport->readBytes(res, 64);
-        
-        if (log_serial && rxLen > 0) {
-            log_serial->printf("<<< RX [%08u]: ", _address);
-            for(int i=0; i<rxLen; i++) log_serial->printf("%02X ", res[i]);
-            log_serial->println();
+        for (size_t i = 0; i < count; i++) {
+            union { uint8_t b[4]; float f; } data;
+            memcpy(data.b, &res[6 + 4 * i], 4);
+            out[i] = data.f;
         }
-
-        if (rxLen < 10 || calculateCRC(res, rxLen-2) != (res[rxLen-2]|(res[rxLen-1]<<8))) return false;
-
-        union { uint8_t b[4]; float f; } data;
-        memcpy(data.b, &res[6], 4);
-        result = data.f;
         return true;
     }
 
@@ -94,18 +148,15 @@ private:
         for(int i=0; i<4; i++) packet[len++] = _addr[i];
         packet[len++] = 0x0A; packet[len++] = 0x0C;
         packet[len++] = paramId & 0xFF; packet[len++] = (paramId >> 8) & 0xFF;
-        
-        uint16_t crc = calculateCRC(packet, len);
-        packet[len++] = crc & 0xFF; packet[len++] = (crc >> 8) & 0xFF;
+        len = appendRequestId(packet, len);
 
-        if (log_serial) log_serial->printf(">>> TX [%08u] Param 0x%04X\n", _address, paramId);
+        uint16_t crc = Crc16Modbus::compute(packet, len);
+        packet[len++] = crc & 0xFF; packet[len++] = (crc >> 8) & 0xFF;
 
-        while(_transport->available()) _transport->read();
-        _transport->write(packet, len); _transport->flush();
+        LOG_FRAME(Drv, ">>> TX [%08lu]: ", _address, packet, len);
 
-        uint8_t res[18];
-        size_t rxLen = _transport->readBytes(res, 18);
-        if (rxLen < 18 || calculateCRC(res, 16) != (res[16]|(res[17]<<8))) return false;
+        uint8_t res[kParamReplyLen];
+        if (!transact(packet, len, res, kParamReplyLen)) return false;
 
         union { uint8_t b[4]; float f; } data;
         memcpy(data.b, &res[6], 4);
@@ -113,16 +164,40 @@ private:
         return true;
     }
 
-    uint16_t calculateCRC(uint8_t *data, uint16_t len) {
-        uint16_t crc = 0xFFFF;
-        for (uint16_t pos = 0; pos < len; pos++) {
-            crc ^= (uint16_t)data[pos];
-            for (int i = 8; i != 0; i--) {
-                if ((crc & 0x0001) != 0) { crc >>= 1; crc ^= 0xA001; }
-                else { crc >>= 1; }
-            }
-        }
-        return crc;
+    // ID запроса (2 байта перед CRC); счетчик повторяет его в ответе.
+    int appendRequestId(uint8_t* packet, int len) {
+        if (++_requestId == 0) _requestId = 1;
+        packet[len++] = _requestId & 0xFF;
+        packet[len++] = _requestId >> 8;
+        return len;
+    }
+
+    // Отправляет запрос и принимает ответ ровно той длины, что объявил счетчик.
+    // Возвращается сразу по приходу последнего байта, а не по таймауту потока.
+    bool transact(const uint8_t* packet, size_t len, uint8_t* res, size_t replyLen) {
+        uint32_t t0 = micros();
+        while(_transport->available()) _transport->read();
+        _transport->write(packet, len);
+        _transport->flush();
+
+        FrameSpec spec{replyLen, 5, 10};
+        size_t rxLen = 0;
+        RxStatus st = _rx.receive(_transport, _link, res, replyLen, spec, rxLen);
+        Metrics::record(Metrics::Histogram::RsTransactionUs, micros() - t0);
+        Metrics::count(Metrics::Counter::RsTransactions);
+        // A corrupted length byte is a corrupted frame as well
+        if (st == RxStatus::CrcError || st == RxStatus::BadLength) Metrics::count(Metrics::Counter::RsCrcErrors);
+        else if (st == RxStatus::Timeout || st == RxStatus::Incomplete) Metrics::count(Metrics::Counter::RsTimeouts);
+
+        if (rxLen > 0) LOG_FRAME(Drv, "<<< RX [%08lu]: ", _address, res, rxLen);
+        if (st != RxStatus::Ok) LOG_W(Drv, "RX [%08lu] failed: status %d", _address, st);
+        if (st != RxStatus::Ok) return false;
+
+        // Короткий, но целый кадр (счетчик объявил меньшую длину) — данных в нем нет
+        if (rxLen != replyLen || res[5] != replyLen) return false;
+        // Ответ должен прийти от того же счетчика, на ту же команду и на этот же запрос
+        return memcmp(res, packet, 4) == 0 && res[4] == packet[4] &&
+               res[replyLen - 4] == packet[len - 4] && res[replyLen - 3] == packet[len - 3];
     }
 };
 
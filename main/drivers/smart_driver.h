@@ -2,9 +2,10 @@
 #define SMART_DRIVER_H
 
 #include <Arduino.h>
-#include <vector>
 
 namespace Driver {
+class FrameLink; // frame_receiver.h
+
 enum class MeterParam {
     TotalVolume,           // Accumulated volume (liters/m3)
     BatteryVoltage,        // Current voltage (Volts)
@@ -14,33 +15,73 @@ enum class MeterParam {
     BatteryThresholdMax,   // Maximum allowable voltage threshold
     
     FlowRateMin,           // Minimum detectable flow rate
-    FlowRateMax            // Maximum allowable flow rate
+    FlowRateMax,           // Maximum allowable flow rate
+
+    Count                  // Number of parameters, not a parameter
+};
+
+constexpr size_t kMeterParamCount = static_cast<size_t>(MeterParam::Count);
+
+// Set of parameters as a bitmask, one bit per MeterParam.
+typedef uint32_t ParamSet;
+
+constexpr ParamSet paramBit(MeterParam p) { return 1UL << static_cast<uint32_t>(p); }
+
+// Result of a batched read: one slot per MeterParam plus a validity mask.
+struct MeterReading {
+    ParamSet valid = 0;
+    float values[kMeterParamCount] = {};
+
+    bool has(MeterParam p) const { return (valid & paramBit(p)) != 0; }
+    float get(MeterParam p) const { return values[static_cast<size_t>(p)]; }
+    void set(MeterParam p, float v) {
+        values[static_cast<size_t>(p)] = v;
+        valid |= paramBit(p);
+    }
 };
 
 // Interface for physical meter drivers (Modbus/RS485).
+//
+// Concrete drivers are `final`: code that holds one by its concrete type
+// (see MeterTraits in driver_factory.h, BasicSmartSource) calls it without
+// virtual dispatch and lets the compiler inline the read path.
 class SmartMeterDriver {
 public:
     virtual ~SmartMeterDriver() {}
 
     void setTransport(Stream* transport) { _transport = transport; }
 
-    // Sets the port for TX/RX packet logging (any Serial).
-    void setLogger(Print* logger) { log_serial = logger; }
+    // Frame-level receive path of the transport, if it has one (RS485UartStream).
+    // Drivers that know it take whole replies from it; the rest keep using the Stream.
+    void setFrameLink(FrameLink* link) { _link = link; }
 
     // Sets the device address on the bus.
     virtual void setAddress(uint32_t address) {
          _address = address;
     }
 
-    // Returns a list of parameters that this specific driver can read.
-    virtual std::vector<MeterParam> getSupportedParams() const = 0;
+    // Parameters this driver can read. Every driver also exposes the same set
+    // as `static constexpr ParamSet kSupportedParams` for compile-time use.
+    virtual ParamSet supportedParams() const = 0;
 
     // Main method for retrieving data.
     virtual bool getValue(MeterParam param, float &result) = 0;
 
+    // Reads a set of parameters in as few bus transactions as the protocol allows.
+    // Fills whatever could be read; returns true only if every requested value is valid.
+    // The default falls back to one getValue() per parameter.
+    virtual bool readValues(ParamSet params, MeterReading &out) {
+        for (size_t i = 0; i < kMeterParamCount; i++) {
+            MeterParam p = static_cast<MeterParam>(i);
+            float v;
+            if ((params & paramBit(p)) && getValue(p, v)) out.set(p, v);
+        }
+        return (out.valid & params) == params;
+    }
+
 protected:
     Stream* _transport = nullptr; // Abstract transport (can be RS485, Modbus, etc.)
-    Print* log_serial = nullptr;
+    FrameLink* _link = nullptr;
     uint32_t _address = 0;
     
     SmartMeterDriver(Stream* transport) : _transport(transport) {}
@@ -0,0 +1,214 @@
+#ifndef EVENT_SCHEDULER_H
+#define EVENT_SCHEDULER_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Deadline-driven main loop.
+//
+// Every subsystem is a timer: a handler plus the absolute millis() at which it
+// wants to run. Timers sit in a binary min-heap, so the loop task only has to
+// look at the top to know how long it may sleep. A handler returns the delay
+// until its next run (kNever parks it until someone arm()s it again).
+//
+// Things that cannot be scheduled — a pulse edge, an attribute write from the
+// coordinator, a finished bus burst — wake the sleeping task early through a
+// direct-to-task notification (wake() / wakeFromIsr()); the owner then arms
+// whatever has to react. Deadlines compare by signed difference, so millis()
+// wrapping every 49 days is harmless as long as no timer is armed more than
+// ~24 days ahead.
+//
+// Timer slack: a deadline up to slackMs after the earliest one shares its
+// wake-up (the earliest waits for it), so jobs that drift close to each other
+// — a poll and a heartbeat a few ms apart — cost one wake-up, not two.
+template <size_t MaxTimers>
+class EventScheduler {
+public:
+    static_assert(MaxTimers >= 1 && MaxTimers <= 32, "Timer ids are bits of a uint32_t");
+
+    typedef int TimerId;
+    static constexpr uint32_t kNever = UINT32_MAX;
+
+    // Gets the current time, returns ms until the next run or kNever.
+    typedef uint32_t (*Handler)(uint32_t now);
+
+    struct Stats {
+        uint32_t wakeups = 0;       // Returns from sleep()
+        uint32_t eventWakeups = 0;  // ... cut short by wake()/wakeFromIsr()
+        uint32_t runs = 0;          // Handler calls
+        uint64_t awakeMs = 0;       // Time between wake-up and the next sleep()
+        uint64_t asleepMs = 0;
+
+        // Wake-ups per hour over everything measured so far.
+        uint32_t wakeupsPerHour() const {
+            uint64_t total = awakeMs + asleepMs;
+            return total ? (uint32_t)((uint64_t)wakeups * 3600000ULL / total) : 0;
+        }
+    };
+
+    explicit EventScheduler(uint32_t slackMs = 0) : _slackMs(slackMs) {}
+
+    // Returns the timer id, or -1 if the table is full. The timer starts parked
+    // unless a first delay is given.
+    TimerId add(Handler fn, uint32_t now, uint32_t delayMs = kNever) {
+        if (_count == MaxTimers || !fn) return -1;
+        TimerId id = (TimerId)_count++;
+        _timers[id] = { fn, 0, -1 };
+        if (delayMs != kNever) arm(id, now + delayMs);
+        return id;
+    }
+
+    // (Re)schedules a timer for absolute time `at`, replacing any earlier deadline.
+    void arm(TimerId id, uint32_t at) {
+        if (!valid(id)) return;
+        Timer& t = _timers[id];
+        t.due = at;
+        if (t.slot < 0) {
+            t.slot = (int8_t)_size;
+            _heap[_size++] = (uint8_t)id;
+        }
+        siftDown(siftUp(t.slot));
+    }
+
+    void disarm(TimerId id) {
+        if (!valid(id) || _timers[id].slot < 0) return;
+        size_t slot = (size_t)_timers[id].slot;
+        _timers[id].slot = -1;
+        if (--_size == slot) return;
+        place(slot, _heap[_size]);
+        siftDown(siftUp(slot));
+    }
+
+    bool armed(TimerId id) const { return valid(id) && _timers[id].slot >= 0; }
+
+    // How long the loop may sleep: 0 if something is due, kNever if nothing is
+    // armed. Otherwise until the latest deadline within the slack of the earliest.
+    uint32_t nextDelay(uint32_t now) const {
+        if (_size == 0) return kNever;
+        uint32_t first = _timers[_heap[0]].due;
+        if ((int32_t)(first - now) <= 0) return 0;
+        uint32_t wakeAt = first;
+        for (size_t i = 1; i < _size; i++) {
+            uint32_t due = _timers[_heap[i]].due;
+            if (due - first <= _slackMs && (int32_t)(due - wakeAt) > 0) wakeAt = due;
+        }
+        return wakeAt - now;
+    }
+
+    // Runs every timer that is due, earliest first (lower id first on a tie),
+    // each at most once per call. Handlers may arm other timers; those still
+    // run in this pass if they are due and have not run yet.
+    size_t runDue(uint32_t now) {
+        uint32_t ran = 0;
+        size_t calls = 0;
+        while (_size && (int32_t)(_timers[_heap[0]].due - now) <= 0) {
+            TimerId id = _heap[0];
+            if (ran & (1UL << id)) break; // Re-armed for now by a later handler: next pass
+            disarm(id);
+            ran |= 1UL << id;
+            uint32_t delayMs = _timers[id].fn(now);
+            calls++;
+            if (delayMs != kNever) arm(id, now + (delayMs ? delayMs : 1)); // 0 = "again soon", not a spin
+        }
+        _stats.runs += calls;
+        return calls;
+    }
+
+    // Makes the calling task (loop()) the one that sleep() blocks and wake() notifies.
+    void attachCurrentTask() { _task = xTaskGetCurrentTaskHandle(); }
+    TaskHandle_t task() const { return _task; }
+
+    // Blocks until the earliest deadline or a wake(). True if woken by an event.
+    bool sleep() {
+        uint32_t now = millis();
+        uint32_t ms = nextDelay(now);
+        noteSleep(now);
+        uint32_t n = ulTaskNotifyTake(pdTRUE, ms == kNever ? portMAX_DELAY : pdMS_TO_TICKS(ms));
+        noteWake(millis(), n != 0);
+        return n != 0;
+    }
+
+    // From another task (Zigbee stack, bus task).
+    void wake() {
+        if (_task) xTaskNotifyGive(_task);
+    }
+
+    // From a GPIO interrupt.
+    void IRAM_ATTR wakeFromIsr() {
+        if (!_task) return;
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(_task, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+
+    // Time accounting around one sleep; sleep() calls these, tests drive them directly.
+    void noteSleep(uint32_t now) {
+        _stats.awakeMs += now - _awakeSince;
+        _asleepSince = now;
+    }
+    void noteWake(uint32_t now, bool byEvent) {
+        _stats.asleepMs += now - _asleepSince;
+        _stats.wakeups++;
+        if (byEvent) _stats.eventWakeups++;
+        _awakeSince = now;
+    }
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    struct Timer {
+        Handler fn;
+        uint32_t due;
+        int8_t slot; // Position in _heap, -1 when parked
+    };
+
+    Timer _timers[MaxTimers];
+    uint8_t _heap[MaxTimers];
+    uint32_t _slackMs;
+    size_t _count = 0;
+    size_t _size = 0;
+    TaskHandle_t _task = nullptr;
+    uint32_t _awakeSince = 0; // millis() starts at 0: awake since boot
+    uint32_t _asleepSince = 0;
+    Stats _stats;
+
+    bool valid(TimerId id) const { return id >= 0 && (size_t)id < _count; }
+
+    bool earlier(uint8_t a, uint8_t b) const {
+        int32_t d = (int32_t)(_timers[a].due - _timers[b].due);
+        return d != 0 ? d < 0 : a < b;
+    }
+
+    void place(size_t slot, uint8_t id) {
+        _heap[slot] = id;
+        _timers[id].slot = (int8_t)slot;
+    }
+
+    size_t siftUp(size_t slot) {
+        uint8_t id = _heap[slot];
+        while (slot > 0) {
+            size_t parent = (slot - 1) / 2;
+            if (!earlier(id, _heap[parent])) break;
+            place(slot, _heap[parent]);
+            slot = parent;
+        }
+        place(slot, id);
+        return slot;
+    }
+
+    void siftDown(size_t slot) {
+        uint8_t id = _heap[slot];
+        while (true) {
+            size_t child = 2 * slot + 1;
+            if (child >= _size) break;
+            if (child + 1 < _size && earlier(_heap[child + 1], _heap[child])) child++;
+            if (!earlier(_heap[child], id)) break;
+            place(slot, _heap[child]);
+            slot = child;
+        }
+        place(slot, id);
+    }
+};
+
+#endif
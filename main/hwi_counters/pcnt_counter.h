@@ -0,0 +1,85 @@
+#ifndef PCNT_COUNTER_H
+#define PCNT_COUNTER_H
+
+#include <Arduino.h>
+#include "driver/pulse_cnt.h"
+#include "pulse_counter.h"
+
+// PulseCounter on the ESP32-C6 PCNT peripheral.
+//
+// Counts FALLING edges of the reed switch in hardware; the CPU is only
+// interrupted when the counter reaches its high limit (watch point), so a
+// bouncing contact costs nothing until the source is polled.
+//
+// Limits:
+//  - The glitch filter tops out at ~12.7 us (1023 APB cycles). It removes EMI
+//    spikes, not millisecond-long reed bounce; boards need an RC filter on the
+//    input, otherwise stay on the ISR-based PulseSource with software debounce.
+//  - PCNT is clock-gated in light sleep. Edges that arrive while the Zigbee
+//    stack keeps the chip in light sleep are not counted.
+class PcntCounter : public PulseCounter {
+public:
+    PcntCounter(uint8_t pin, uint32_t glitchNs = 12000, int32_t limit = 10000)
+        : _pin(pin), _glitchNs(glitchNs), _limit(limit) {}
+
+    ~PcntCounter() override {
+        if (_unit) {
+            pcnt_unit_stop(_unit);
+            pcnt_unit_disable(_unit);
+            if (_channel) pcnt_del_channel(_channel);
+            pcnt_del_unit(_unit);
+        }
+    }
+
+    bool begin() override {
+        pcnt_unit_config_t unit_cfg = {};
+        unit_cfg.low_limit = -1;
+        unit_cfg.high_limit = _limit;
+        if (pcnt_new_unit(&unit_cfg, &_unit) != ESP_OK) return false;
+
+        pcnt_glitch_filter_config_t filter_cfg = {};
+        filter_cfg.max_glitch_ns = _glitchNs;
+        pcnt_unit_set_glitch_filter(_unit, &filter_cfg); // Best effort: not fatal if clamped/unsupported
+
+        pcnt_chan_config_t chan_cfg = {};
+        chan_cfg.edge_gpio_num = _pin;
+        chan_cfg.level_gpio_num = -1;
+        if (pcnt_new_channel(_unit, &chan_cfg, &_channel) != ESP_OK) return false;
+        pcnt_channel_set_edge_action(_channel, PCNT_CHANNEL_EDGE_ACTION_HOLD, PCNT_CHANNEL_EDGE_ACTION_INCREASE);
+
+        // Counter resets to 0 at high_limit; the watch point tells us it wrapped.
+        pcnt_unit_add_watch_point(_unit, _limit);
+        pcnt_event_callbacks_t cbs = {};
+        cbs.on_reach = &PcntCounter::onReach;
+        if (pcnt_unit_register_event_callbacks(_unit, &cbs, this) != ESP_OK) return false;
+
+        return pcnt_unit_enable(_unit) == ESP_OK &&
+               pcnt_unit_clear_count(_unit) == ESP_OK &&
+               pcnt_unit_start(_unit) == ESP_OK;
+    }
+
+    int32_t count() override {
+        int value = 0;
+        if (_unit) pcnt_unit_get_count(_unit, &value);
+        return value;
+    }
+
+    uint32_t overflows() override { return _overflows; }
+    int32_t limit() const override { return _limit; }
+
+private:
+    uint8_t _pin;
+    uint32_t _glitchNs;
+    int32_t _limit;
+    pcnt_unit_handle_t _unit = nullptr;
+    pcnt_channel_handle_t _channel = nullptr;
+    volatile uint32_t _overflows = 0;
+
+    static bool IRAM_ATTR onReach(pcnt_unit_handle_t, const pcnt_watch_event_data_t* edata, void* ctx) {
+        PcntCounter* self = static_cast<PcntCounter*>(ctx);
+        if (edata->watch_point_value == self->_limit) self->_overflows = self->_overflows + 1;
+        return false; // No higher-priority task woken
+    }
+};
+
+#endif
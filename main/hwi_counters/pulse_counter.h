@@ -0,0 +1,37 @@
+#ifndef PULSE_COUNTER_H
+#define PULSE_COUNTER_H
+
+#include <Arduino.h>
+
+// Hardware edge counter with a limited range.
+//
+// The counter runs from 0 up to limit() and then wraps to 0; every wrap is
+// counted in overflows(). Sources combine both into a 64-bit pulse total, so
+// the counting backend can be swapped (PCNT peripheral on the device, a fake
+// on the host).
+class PulseCounter {
+public:
+    virtual ~PulseCounter() {}
+
+    virtual bool begin() = 0;
+
+    // Current counter value, 0 <= count() < limit().
+    virtual int32_t count() = 0;
+
+    // Number of wraps since begin(). Updated from the overflow interrupt.
+    virtual uint32_t overflows() = 0;
+
+    virtual int32_t limit() const = 0;
+
+    // Total pulses since begin(). Re-reads if a wrap happened between the two
+    // reads, so the result is consistent without disabling interrupts.
+    uint64_t total() {
+        for (;;) {
+            uint32_t ov = overflows();
+            int32_t c = count();
+            if (ov == overflows()) return (uint64_t)ov * (uint64_t)limit() + (uint64_t)c;
+        }
+    }
+};
+
+#endif
@@ -5,6 +5,8 @@
 
 // Wrapper around HardwareSerial to handle RS485 Direction Enable (DE) pin.
 // Automatically toggles the DE pin when writing data.
+// Fallback for RS485UartStream (rs485_uart_stream.h) when the IDF UART
+// driver cannot be installed.
 class RS485Stream : public Stream {
 private:
     HardwareSerial* _serial;
@@ -0,0 +1,154 @@
+#ifndef RS485_UART_STREAM_H
+#define RS485_UART_STREAM_H
+
+#include <Arduino.h>
+#include "driver/uart.h"
+#include "freertos/queue.h"
+#include "drivers/frame_receiver.h"
+
+// RS485 on the ESP-IDF UART driver in RS485 half-duplex mode.
+//
+// The peripheral drives DE itself (wired to the UART's RTS pin): it is
+// asserted for the first start bit and released after the last stop bit,
+// so write() only queues the request and nothing toggles a GPIO around it.
+// Replies are taken from the driver's RX ring as whole frames: the UART's RX
+// full interrupt is set to the expected reply length and the RX timeout
+// interrupt fires once the line has been idle for kRxIdleSymbols byte times
+// (Modbus t3.5); readFrame() blocks on the driver's event queue until either
+// (the CPU sleeps meanwhile) and copies the frame out with one
+// uart_read_bytes(). Drivers reach this through Driver::FrameLink; the
+// Stream interface still works byte by byte for those that do not.
+//
+// begin() fails if the UART driver cannot be installed; fall back to
+// RS485Stream over HardwareSerial then.
+class RS485UartStream : public Stream, public Driver::FrameLink {
+public:
+    static constexpr int kRxBufferSize = 256;     // > RX FIFO (128), holds any meter reply
+    static constexpr int kEventQueueLen = 8;
+    static constexpr uint8_t kRxIdleSymbols = 4;  // 3.5 characters, rounded up
+
+    struct Stats {
+        uint32_t frames = 0;      // readFrame() calls that returned data
+        uint32_t overflows = 0;   // RX ring or FIFO overran; input dropped
+    };
+
+    RS485UartStream(uart_port_t port, int de_pin) : _port(port), _de_pin(de_pin) {}
+
+    ~RS485UartStream() {
+        if (_ready) uart_driver_delete(_port);
+    }
+
+    bool begin(unsigned long baud, int rx, int tx) {
+        uart_config_t cfg = {};
+        cfg.baud_rate = (int)baud;
+        cfg.data_bits = UART_DATA_8_BITS;
+        cfg.parity = UART_PARITY_DISABLE;
+        cfg.stop_bits = UART_STOP_BITS_1;
+        cfg.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+        cfg.source_clk = UART_SCLK_DEFAULT;
+
+        if (uart_driver_install(_port, kRxBufferSize, 0, kEventQueueLen, &_events, 0) != ESP_OK) return false;
+        if (uart_param_config(_port, &cfg) != ESP_OK ||
+            uart_set_pin(_port, tx, rx, _de_pin, UART_PIN_NO_CHANGE) != ESP_OK ||
+            uart_set_mode(_port, UART_MODE_RS485_HALF_DUPLEX) != ESP_OK ||
+            uart_set_rx_timeout(_port, kRxIdleSymbols) != ESP_OK) {
+            uart_driver_delete(_port);
+            return false;
+        }
+        _ready = true;
+        return true;
+    }
+
+    size_t write(uint8_t b) override {
+        return write(&b, 1);
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override {
+        // Events from before the request (noise, a late reply) must not end the next wait
+        xQueueReset(_events);
+        _peek = -1;
+        int n = uart_write_bytes(_port, buffer, size);
+        return n < 0 ? 0 : (size_t)n;
+    }
+
+    // Waits until the request is on the wire (blocks on the driver, no polling).
+    void flush() override { uart_wait_tx_done(_port, pdMS_TO_TICKS(kTxDoneTimeoutMs)); }
+
+    int available() override {
+        size_t n = 0;
+        uart_get_buffered_data_len(_port, &n);
+        return (int)n + (_peek >= 0 ? 1 : 0);
+    }
+
+    int read() override {
+        if (_peek >= 0) {
+            int c = _peek;
+            _peek = -1;
+            return c;
+        }
+        uint8_t b;
+        return uart_read_bytes(_port, &b, 1, 0) == 1 ? b : -1;
+    }
+
+    int peek() override {
+        if (_peek < 0) _peek = read();
+        return _peek;
+    }
+
+    size_t readFrame(uint8_t* buf, size_t cap, uint32_t waitMs) override {
+        uint32_t start = millis();
+        // A reply of the expected length is complete without waiting for the idle line
+        uart_set_rx_full_threshold(_port, cap < kRxFullMax ? (int)cap : kRxFullMax);
+        for (;;) {
+            size_t have = 0;
+            uart_get_buffered_data_len(_port, &have);
+            uint32_t elapsed = millis() - start;
+            if (have >= cap || elapsed >= waitMs) return take(buf, cap, have);
+
+            uart_event_t ev;
+            if (xQueueReceive(_events, &ev, pdMS_TO_TICKS(waitMs - elapsed)) != pdTRUE) continue;
+            switch (ev.type) {
+                case UART_DATA:
+                    // Without the timeout flag the threshold was reached: checked above
+                    if (ev.timeout_flag) {
+                        uart_get_buffered_data_len(_port, &have);
+                        return take(buf, cap, have);
+                    }
+                    break;
+                case UART_FIFO_OVF:
+                case UART_BUFFER_FULL:
+                    uart_flush_input(_port);
+                    xQueueReset(_events);
+                    _stats.overflows++;
+                    return 0;
+                default:
+                    break; // Framing/parity errors: the CRC check rejects the frame
+            }
+        }
+    }
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    static constexpr uint32_t kTxDoneTimeoutMs = 100;
+    static constexpr int kRxFullMax = 120;        // Below the 128-byte RX FIFO
+
+    uart_port_t _port;
+    int _de_pin;
+    QueueHandle_t _events = nullptr;
+    bool _ready = false;
+    int _peek = -1;
+    Stats _stats;
+
+    // One copy out of the driver's ring buffer for the whole frame.
+    size_t take(uint8_t* buf, size_t cap, size_t have) {
+        size_t n = have < cap ? have : cap;
+        if (n == 0) return 0;
+        int got = uart_read_bytes(_port, buf, n, 0);
+        if (got <= 0) return 0;
+        _stats.frames++;
+        return (size_t)got;
+    }
+};
+
+#endif
@@ -0,0 +1,344 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <type_traits>
+#include "freertos/FreeRTOS.h"
+
+// Deferred binary logging.
+//
+// LOG_I(Src, "Hour closed. Consumed: %llu L", liters) does not format
+// anything: it appends a record (format string pointer, millis(), module,
+// level, raw argument words) to a RAM ring and returns. Text is only made
+// when the ring is drained to a console (drain(), called from loop() while
+// a USB host is attached, before deep sleep, or on request). Until then the
+// ring keeps the newest ~4 KiB of records; the oldest are overwritten.
+//
+// Levels are fixed per module at compile time: a statement above its
+// module's level (LOG_LEVEL_<MODULE>, capped by LOG_LEVEL_MAX) is a
+// discarded `if constexpr` branch, so neither the call nor its arguments
+// nor the format string end up in the binary. Production builds set
+// -D LOG_LEVEL_MAX=1 (errors only) or 0.
+//
+// Arguments: integers up to 64 bit, bool, float/double (stored as float)
+// and C strings that outlive the record (literals, table names). At most
+// kMaxArgs per record. LOG_FRAME() stores raw bytes for RX/TX traces.
+#ifndef LOG_LEVEL_MAX
+#define LOG_LEVEL_MAX 3
+#endif
+#ifndef LOG_LEVEL_SYS
+#define LOG_LEVEL_SYS 3
+#endif
+#ifndef LOG_LEVEL_DRV
+#define LOG_LEVEL_DRV 2    // Frame traces are Verbose (5)
+#endif
+#ifndef LOG_LEVEL_SRC
+#define LOG_LEVEL_SRC 3
+#endif
+#ifndef LOG_LEVEL_ZB
+#define LOG_LEVEL_ZB 3
+#endif
+
+namespace Log {
+
+enum class Level : uint8_t { None = 0, Error, Warn, Info, Debug, Verbose };
+enum class Module : uint8_t { Sys, Drv, Src, Zb, Count };
+
+constexpr uint8_t kModuleLevel[] = { LOG_LEVEL_SYS, LOG_LEVEL_DRV, LOG_LEVEL_SRC, LOG_LEVEL_ZB };
+static_assert(sizeof(kModuleLevel) == static_cast<size_t>(Module::Count), "One level per module");
+constexpr const char* kModuleNames[] = { "SYS", "DRV", "SRC", "ZB" };
+constexpr char kLevelChars[] = "-EWIDV";
+
+constexpr bool enabled(Module m, Level l) {
+    return static_cast<uint8_t>(l) <= LOG_LEVEL_MAX && static_cast<uint8_t>(l) <= kModuleLevel[static_cast<size_t>(m)];
+}
+
+class Ring {
+public:
+    static constexpr size_t kWords = 1024;     // 4 KiB
+    static constexpr size_t kMaxArgs = 8;
+    static constexpr size_t kMaxFrameBytes = 32;
+
+    struct Stats {
+        uint32_t records = 0;    // Written since boot
+        uint32_t dropped = 0;    // Overwritten before they were drained
+    };
+
+    template <typename... Args>
+    void write(Module m, Level l, const char* fmt, Args... args) {
+        static_assert(sizeof...(Args) <= kMaxArgs, "Too many log arguments");
+        uint32_t payload[kPayloadMax] = {};
+        uint16_t types = 0;
+        size_t words = 0;
+        size_t i = 0;
+        (encode(args, payload, words, types, i++), ...);
+        commit(m, l, fmt, types, false, payload, words);
+        (void)i;
+    }
+
+    // `fmt` with one integer argument, followed by the bytes as hex.
+    void frame(Module m, Level l, const char* fmt, uint32_t arg, const uint8_t* data, size_t len) {
+        uint32_t payload[kPayloadMax];
+        if (len > kMaxFrameBytes) len = kMaxFrameBytes;
+        payload[0] = arg;
+        payload[1] = (uint32_t)len;
+        payload[2 + len / 4] = 0;
+        memcpy(payload + 2, data, len);
+        commit(m, l, fmt, 0, true, payload, 2 + (len + 3) / 4);
+    }
+
+    // Formats and removes up to `max` records, oldest first. Formatting runs
+    // outside the lock; writers are never held up by a slow console.
+    size_t drain(Print& out, size_t max = SIZE_MAX) {
+        size_t n = 0;
+        uint32_t dropped = _stats.dropped;
+        if (dropped != _reportedDropped) {
+            out.printf("Log: %lu record(s) lost", (unsigned long)(dropped - _reportedDropped));
+            out.println();
+            _reportedDropped = dropped;
+        }
+        Header h;
+        uint32_t payload[kPayloadMax];
+        while (n < max && pop(h, payload)) {
+            print(out, h, payload);
+            n++;
+        }
+        return n;
+    }
+
+    // Also formats every record to `out` as it is written, in the caller's
+    // context (the old synchronous behaviour; for debugging sessions only).
+    void setEcho(Print* out) { _echo = out; }
+
+    size_t usedWords() const { return _used; }
+    bool empty() const { return _used == 0; }
+    const Stats& stats() const { return _stats; }
+
+    void clear() {
+        portENTER_CRITICAL(&_lock);
+        _head = _tail = _used = 0;
+        portEXIT_CRITICAL(&_lock);
+        _stats = Stats{};
+        _reportedDropped = 0;
+    }
+
+private:
+    enum Tag : uint8_t { U32 = 0, U64 = 1, F32 = 2, Str = 3 };
+
+    struct Header {
+        const char* fmt;
+        uint32_t ms;
+        uint8_t words;     // Payload words
+        uint8_t meta;      // Module (bits 0-2), level (3-5), frame (7)
+        uint16_t types;    // Tag per argument, 2 bits each
+    };
+    static constexpr size_t kHeaderWords = (sizeof(Header) + 3) / 4;
+    static constexpr size_t kPtrWords = (sizeof(const char*) + 3) / 4;
+    static constexpr size_t kPayloadMax = 2 * kMaxArgs + 2;
+    static_assert(kPayloadMax >= 2 + kMaxFrameBytes / 4, "Frame payload fits");
+
+    uint32_t _buf[kWords];
+    size_t _head = 0;      // Next word to write
+    size_t _tail = 0;      // Oldest record
+    size_t _used = 0;
+    Stats _stats;
+    uint32_t _reportedDropped = 0;
+    Print* _echo = nullptr;
+    portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+
+    template <typename T>
+    static void encode(T v, uint32_t* p, size_t& words, uint16_t& types, size_t i) {
+        if constexpr (std::is_same<T, const char*>::value || std::is_same<T, char*>::value) {
+            memcpy(p + words, &v, sizeof(v));
+            words += kPtrWords;
+            types |= Str << (2 * i);
+        } else if constexpr (std::is_floating_point<T>::value) {
+            float f = (float)v;
+            memcpy(p + words++, &f, 4);
+            types |= F32 << (2 * i);
+        } else if constexpr (sizeof(T) > 4) {
+            uint64_t x = (uint64_t)v;
+            p[words++] = (uint32_t)x;
+            p[words++] = (uint32_t)(x >> 32);
+            types |= U64 << (2 * i);
+        } else {
+            static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "Unsupported log argument");
+            p[words++] = (uint32_t)v;   // Signed values keep their bits; %d restores the sign
+        }
+    }
+
+    void commit(Module m, Level l, const char* fmt, uint16_t types, bool isFrame, const uint32_t* payload, size_t words) {
+        Header h{ fmt, millis(), (uint8_t)words,
+                  (uint8_t)(static_cast<uint8_t>(m) | static_cast<uint8_t>(l) << 3 | (isFrame ? 0x80 : 0)), types };
+        uint32_t hw[kHeaderWords] = {};
+        memcpy(hw, &h, sizeof(h));
+        size_t need = kHeaderWords + words;
+
+        portENTER_CRITICAL(&_lock);
+        while (kWords - _used < need) dropOldest();
+        for (size_t i = 0; i < kHeaderWords; i++) put(hw[i]);
+        for (size_t i = 0; i < words; i++) put(payload[i]);
+        _stats.records++;
+        portEXIT_CRITICAL(&_lock);
+
+        if (_echo) print(*_echo, h, payload);
+    }
+
+    void put(uint32_t w) {
+        _buf[_head] = w;
+        _head = (_head + 1) % kWords;
+        _used++;
+    }
+
+    Header headerAt(size_t pos) const {
+        uint32_t hw[kHeaderWords];
+        for (size_t i = 0; i < kHeaderWords; i++) hw[i] = _buf[(pos + i) % kWords];
+        Header h;
+        memcpy(&h, hw, sizeof(h));
+        return h;
+    }
+
+    void dropOldest() {
+        size_t len = kHeaderWords + headerAt(_tail).words;
+        _tail = (_tail + len) % kWords;
+        _used -= len;
+        _stats.dropped++;
+    }
+
+    bool pop(Header& h, uint32_t* payload) {
+        portENTER_CRITICAL(&_lock);
+        bool any = _used > 0;
+        if (any) {
+            h = headerAt(_tail);
+            for (size_t i = 0; i < h.words; i++) payload[i] = _buf[(_tail + kHeaderWords + i) % kWords];
+            _tail = (_tail + kHeaderWords + h.words) % kWords;
+            _used -= kHeaderWords + h.words;
+        }
+        portEXIT_CRITICAL(&_lock);
+        return any;
+    }
+
+    static void print(Print& out, const Header& h, const uint32_t* p) {
+        out.printf("%lu %c %s: ", (unsigned long)h.ms, kLevelChars[(h.meta >> 3) & 7], kModuleNames[h.meta & 7]);
+        if (h.meta & 0x80) {
+            format(out, h.fmt, U32, p, 1);
+            for (uint32_t i = 0; i < p[1]; i++) out.printf("%02X ", ((const uint8_t*)(p + 2))[i]);
+        } else {
+            format(out, h.fmt, h.types, p, h.words);
+        }
+        out.println();
+    }
+
+    // printf over the stored words: every conversion gets its argument with
+    // the type it was stored as, whatever length modifier the format has.
+    static void format(Print& out, const char* fmt, uint16_t types, const uint32_t* p, size_t words) {
+        size_t w = 0;
+        size_t arg = 0;
+        char spec[16];
+        char text[64];
+        for (const char* c = fmt; *c;) {
+            if (*c != '%') {
+                const char* end = strchr(c, '%');
+                size_t len = end ? (size_t)(end - c) : strlen(c);
+                size_t next = len;
+                if (!end && len && c[len - 1] == '\n') len--; // Records are lines; println() ends them
+                out.write((const uint8_t*)c, len);
+                c += next;
+                continue;
+            }
+            if (c[1] == '%') {
+                out.print('%');
+                c += 2;
+                continue;
+            }
+            // %[flags][width][.precision][length]conversion
+            size_t n = 0;
+            spec[n++] = *c++;
+            while (*c && strchr("-+ #0123456789.", *c) && n < sizeof(spec) - 4) spec[n++] = *c++;
+            while (*c && strchr("hlLqjzt", *c)) c++;
+            char conv = *c ? *c++ : 's';
+            if (w >= words) {
+                out.print("?");
+                continue;
+            }
+            Tag tag = (Tag)((types >> (2 * arg++)) & 3);
+            int len = 0;
+            switch (tag) {
+                case U32: {
+                    uint32_t v = p[w++];
+                    if (conv == 'c') {
+                        text[0] = (char)v;
+                        len = 1;
+                        break;
+                    }
+                    spec[n++] = 'l';
+                    spec[n++] = strchr("diuxXo", conv) ? conv : 'u';
+                    spec[n] = 0;
+                    if (conv == 'd' || conv == 'i') len = snprintf(text, sizeof(text), spec, (long)(int32_t)v);
+                    else len = snprintf(text, sizeof(text), spec, (unsigned long)v);
+                    break;
+                }
+                case U64: {
+                    uint64_t x = (uint64_t)p[w] | (uint64_t)p[w + 1] << 32;
+                    w += 2;
+                    spec[n++] = 'l';
+                    spec[n++] = 'l';
+                    spec[n++] = strchr("diuxXo", conv) ? conv : 'u';
+                    spec[n] = 0;
+                    if (conv == 'd' || conv == 'i') len = snprintf(text, sizeof(text), spec, (long long)x);
+                    else len = snprintf(text, sizeof(text), spec, (unsigned long long)x);
+                    break;
+                }
+                case F32: {
+                    float f;
+                    memcpy(&f, p + w++, 4);
+                    spec[n++] = (conv == 'e' || conv == 'g') ? conv : 'f';
+                    spec[n] = 0;
+                    len = snprintf(text, sizeof(text), spec, (double)f);
+                    break;
+                }
+                case Str: {
+                    const char* s;
+                    memcpy(&s, p + w, sizeof(s));
+                    w += kPtrWords;
+                    spec[n++] = 's';
+                    spec[n] = 0;
+                    len = snprintf(text, sizeof(text), spec, s ? s : "(null)");
+                    break;
+                }
+            }
+            if (len > 0) out.write((const uint8_t*)text, std::min((size_t)len, sizeof(text) - 1));
+        }
+    }
+};
+
+inline Ring& ring() {
+    static Ring r;
+    return r;
+}
+
+} // namespace Log
+
+#define LOG_AT(mod, lvl, fmt, ...)                                                                             \
+    do {                                                                                                      \
+        if constexpr (::Log::enabled(::Log::Module::mod, ::Log::Level::lvl))                                  \
+            ::Log::ring().write(::Log::Module::mod, ::Log::Level::lvl, fmt, ##__VA_ARGS__);                  \
+    } while (0)
+
+#define LOG_E(mod, fmt, ...) LOG_AT(mod, Error, fmt, ##__VA_ARGS__)
+#define LOG_W(mod, fmt, ...) LOG_AT(mod, Warn, fmt, ##__VA_ARGS__)
+#define LOG_I(mod, fmt, ...) LOG_AT(mod, Info, fmt, ##__VA_ARGS__)
+#define LOG_D(mod, fmt, ...) LOG_AT(mod, Debug, fmt, ##__VA_ARGS__)
+#define LOG_V(mod, fmt, ...) LOG_AT(mod, Verbose, fmt, ##__VA_ARGS__)
+
+// Raw bytes (TX/RX frames) at Verbose: `fmt` takes the one integer `arg`.
+#define LOG_FRAME(mod, fmt, arg, data, len)                                                                   \
+    do {                                                                                                      \
+        if constexpr (::Log::enabled(::Log::Module::mod, ::Log::Level::Verbose))                              \
+            ::Log::ring().frame(::Log::Module::mod, ::Log::Level::Verbose, fmt, arg, data, len);              \
+    } while (0)
+
+#endif
@@ -15,17 +15,30 @@
 
 #include "Zigbee.h"
 #include "esp_zigbee_core.h"
+#include "zboss_api.h" // zb_zcl_parsed_hdr_t for the raw command hook
 #include <Preferences.h>
 #include "nvs_flash.h"
 #include "esp_partition.h"
 #include <memory> // For std::unique_ptr
+#include <sys/time.h>
 
 // Abstraction Layers
 #include "utils.h"
 #include "zigbee_water_meter.h"
 #include "hwi_streams/rs485_stream.h"
+#include "hwi_streams/rs485_uart_stream.h"
+#include "bus/bus_scheduler.h"
 #include "drivers/driver_factory.h"
 #include "sources/factory_source.h"
+#include "storage/partition_flash.h"
+#include "storage/history_store.h"
+#include "storage/channel_store.h"
+#include "storage/rtc_state.h"
+#include "channels.h"
+#include "event_scheduler.h"
+#include "metrics.h"
+#include "log.h"
+#include "diagnostics_cluster.h"
 
 /* --- VERSION --- */
 #include "include/version.h"
@@ -39,8 +52,9 @@
 #define RS485_EN         19
 #define RS485_BAUD       9600
 #define RS485_CONFIG     SERIAL_8N1
-#define PULSE_COLD_PIN   10
-#define PULSE_HOT_PIN    11
+#define RS485_UART       UART_NUM_1 // IDF UART driver; Serial1 (same UART) is the fallback
+#define RS485_WARMUP_MS  20   // Transceiver + meter interface ready after power-up (grows if measured longer)
+#define RS485_RAIL_MA    15   // Rail current while powered, for the energy estimate
 #define BATTERY_ADC_PIN   34
 
 /* --- ZIGBEE CONFIGURATION --- */
@@ -51,46 +65,114 @@
 
 /* --- APPLICATION CONFIGURATION --- */
 constexpr bool kEnableTestIntervals = false; // Set to true for fast hourly/daily reports (10s/20s)
+constexpr bool kEnableDeepSleep = false; // Deep sleep between polls instead of Zigbee light sleep (Smart channels only)
 
-// constexpr Source::SourceType COLD_TYPE = Source::SourceType::Test;
-// constexpr Source::SourceType HOT_TYPE  = Source::SourceType::Test;
-// constexpr uint32_t COLD_POOL_INTERVAL = 3000; // Интервал опроса для холодного канала (мс) Test
-// constexpr uint32_t HOT_POOL_INTERVAL  = 3000; // Интервал опроса для горячего канала (мс) Test
-
-// constexpr uint32_t HEARTBEAT_INTERVAL = 60000; // Heartbeat interval for HA (ms)
-// constexpr uint32_t BATTERY_REPORT_INTERVAL = 60000; // Interval for reporting battery status (ms)
+// constexpr Source::PollBounds POLL_INTERVAL = { 3000, 3000 }; // Интервал опроса каналов (мс) Test
 
 /* PRODUCT CONFIGURATION */
-constexpr uint32_t HEARTBEAT_INTERVAL = 60000 * 30; // Heartbeat interval for HA (ms)
-constexpr uint32_t BATTERY_REPORT_INTERVAL = 60000 * 30; // Interval for reporting battery status (ms)
-constexpr uint32_t COLD_POOL_INTERVAL = 60000 * 30; // Polling interval for cold channel (ms)
-constexpr uint32_t HOT_POOL_INTERVAL  = 60000 * 30; // Polling interval for hot channel (ms)
+// Smart channels poll every 10 min while water flows and back off to 2 h
+// when nothing changes; the coordinator can move both bounds (0x0430/0x0431)
+constexpr Source::PollBounds POLL_INTERVAL = { 60000 * 10, 60000 * 120 }; // Poll interval range for metering channels (ms)
 constexpr uint32_t DEEP_SLEEP_THRESHOLD = 60; // Time in seconds before entering deep sleep when idle
-constexpr uint32_t LOOP_IDLE_DELAY = 15000; // Main loop idle delay (ms)
+constexpr uint32_t LOOP_IDLE_DELAY = 15000; // Reporting retry while not joined (ms)
+constexpr uint32_t AUTOSAVE_INTERVAL = 900000; // Periodic NVS save (ms)
+constexpr uint32_t LOOP_TIMER_SLACK = 1000; // Timers this close share one wake-up (ms)
+constexpr uint32_t DEEP_SLEEP_MIN_MS = 60000; // Deep sleep only if the next timer is this far away (ms)
+
+/* CHANNEL TABLE: one row per meter = one Zigbee endpoint (row index + 1).
+ * Up to Bus::BusScheduler::kMaxRequests rows; all Smart rows share the RS485 line
+ * and are polled in one burst. Pin is used by Pulse/PulsePcnt rows only. */
+constexpr ChannelConfig kChannels[] = {
+    // name   type                         model                               pin  poll           battery
+    { "cold", Source::SourceType::Smart,   Driver::MeterModel::Pulsar_Du_15_20, 10, POLL_INTERVAL, true },
+    { "hot",  Source::SourceType::Smart,   Driver::MeterModel::Pulsar_Du_15_20, 11, POLL_INTERVAL, false },
+};
+constexpr size_t kChannelCount = sizeof(kChannels) / sizeof(kChannels[0]);
 
-constexpr Source::SourceType COLD_TYPE = Source::SourceType::Smart;
-constexpr Source::SourceType HOT_TYPE = Source::SourceType::Smart;
+// NVS keys of firmware before the per-channel records (first two channels only)
+constexpr const char* kLegacyKeys[][3] = { { "sc", "oc", "cl" }, { "sh", "oh", "hl" } };
 
-constexpr Driver::MeterModel COLD_DRV_MODEL = Driver::MeterModel::Pulsar_Du_15_20;
-constexpr Driver::MeterModel HOT_DRV_MODEL = Driver::MeterModel::Pulsar_Du_15_20;
+constexpr bool NEED_RS485 = countBusChannels(kChannels) > 0;
 
-constexpr bool NEED_RS485 = (COLD_TYPE == Source::SourceType::Smart || HOT_TYPE == Source::SourceType::Smart);
+// Pulse inputs (ISR or PCNT) stop counting while the chip is powered down
+static_assert(!kEnableDeepSleep || countBusChannels(kChannels) == kChannelCount,
+              "Deep sleep needs every channel on the RS485 bus");
 
 /* --- GLOBAL OBJECTS --- */
 Preferences prefs;
-std::unique_ptr<RS485Stream> rs485Bus = nullptr; 
-
-// Zigbee Endpoints
-ZigbeeWaterMeter zigbeeCold(1, true); 
-ZigbeeWaterMeter zigbeeHot(2, false);
+std::unique_ptr<RS485UartStream> rs485Uart = nullptr; // DE driven by the UART, frames on idle line
+std::unique_ptr<RS485Stream> rs485Bus = nullptr;      // Fallback: HardwareSerial, DE by digitalWrite
+Stream* rs485Line = nullptr;
+Bus::BusScheduler busScheduler; // Owns all RS485 traffic, runs in its own task
+Bus::BusPower busPower(RS485_POWER_PIN, RS485_WARMUP_MS, RS485_RAIL_MA); // Bus supply, on only during bursts
+bool busTaskRunning = false;
+PartitionFlash historyFlash("spiffs"); // Unused by any filesystem, holds consumption history
+Storage::BasicHistoryStore<kChannelCount> history(&historyFlash);
+
+// Endpoint, NVS record, driver and source of every channel
+ChannelSet<kChannelCount> channels(kChannels, &prefs);
+
+// Report jobs for all endpoints go through one queue (see report_scheduler.h)
+ReportScheduler<kChannelCount> reportScheduler(100); // >= 100 ms between frame groups
+
+// Main loop timers, in the order setupLoopTimers() adds them; on equal
+// deadlines the lower one runs first (sources before reporting).
+enum LoopTimer { kTimerSources, kTimerReporting, kTimerConfigSave, kTimerAutoSave, kTimerStatus, kTimerButton, kTimerCount };
+typedef EventScheduler<kTimerCount> LoopScheduler;
+LoopScheduler loopScheduler(LOOP_TIMER_SLACK); // loop() sleeps until the earliest timer or an event
+
+// Survives deep sleep; valid() only after a sleep entered by maybeDeepSleep()
+RTC_DATA_ATTR Storage::RtcState<kChannelCount> rtcState;
+bool resumedFromSleep = false; // This boot is a deep-sleep wake-up with a usable rtcState
+uint32_t sleptMs = 0;          // How long the chip was down, by the RTC clock
+
+// NVS namespace and history store. A resume opens them only after its first
+// report; hours and days closed before that wait here (one of each per channel).
+bool storage_open = false;
+struct PendingBucket {
+    uint8_t channel;
+    Storage::HistoryKind kind;
+    uint32_t liters;
+};
+PendingBucket pendingBuckets[2 * kChannelCount];
+size_t pendingBucketCount = 0;
 
-// Interfaces (Pointers)
-std::unique_ptr<Driver::SmartMeterDriver> coldDrv = nullptr;
-std::unique_ptr<Driver::SmartMeterDriver> hotDrv = nullptr;
-std::unique_ptr<Source::WaterSource> coldSrc = nullptr;
-std::unique_ptr<Source::WaterSource> hotSrc = nullptr;
+// Report state; globals so a deep-sleep resume can carry it over. Per-attribute
+// report timing (heartbeat = max interval) lives in the endpoints.
+bool initial_config_sent = false;
+bool resume_report_pending = false; // Report fresh readings once the wake-up poll is in
+bool first_report_done = false;
+volatile bool leave_pending = false; // Set by the stack task, acted on by loop()
 
 /* --- ZIGBEE EVENT HANDLER --- */
+// Configure Reporting / Read Reporting Configuration: answered by the endpoint,
+// because reports are sent by the application (see zcl_reporting.h) and the
+// stack's reporting engine never sees them. Everything else goes on to the stack.
+static bool zb_raw_command_handler(uint8_t bufid) {
+    zb_zcl_parsed_hdr_t *hdr = ZB_BUF_GET_PARAM(bufid, zb_zcl_parsed_hdr_t);
+    if (!hdr->is_common_command || hdr->cmd_direction != ZB_ZCL_FRAME_DIRECTION_TO_SRV) return false;
+
+    // Diagnostics are copied into the attribute table only when someone reads them
+    if (hdr->cluster_id == Metrics::DiagnosticsCluster::kClusterId && hdr->cmd_id == ZB_ZCL_CMD_READ_ATTRIB) {
+        Metrics::DiagnosticsCluster::refresh(hdr->addr_data.common_data.dst_endpoint, millis());
+        return false; // The stack answers from the table
+    }
+    if (hdr->is_manuf_specific) return false;
+    if (hdr->cmd_id != ReportingTable::kCmdConfigureReporting && hdr->cmd_id != ReportingTable::kCmdReadReportingConfig) return false;
+
+    for (auto& ch : channels) {
+        if (ch.endpoint.getEndpoint() != hdr->addr_data.common_data.dst_endpoint) continue;
+        if (!ch.endpoint.handleReportingCommand(hdr->cmd_id, hdr->cluster_id, hdr->seq_number,
+                                                hdr->addr_data.common_data.source.u.short_addr,
+                                                hdr->addr_data.common_data.src_endpoint,
+                                                (const uint8_t *)zb_buf_begin(bufid), zb_buf_len(bufid))) return false;
+        zb_buf_free(bufid);   // Handled: the buffer is ours
+        loopScheduler.wake(); // Persist the new config and re-plan reports
+        return true;
+    }
+    return false;
+}
+
 static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id, const void *message) {
     if (message == nullptr) {
         return ESP_OK;  // Safety: некоторые callback могут приходить без данных
@@ -106,6 +188,7 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
                 break;
             }
         }
+        loopScheduler.wake(); // Sources apply the write, the new config is saved without waiting for a timer
         return ESP_OK;
     }
 
@@ -133,25 +216,23 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
 
     switch (sig_type) {
         case ESP_ZB_ZDO_SIGNAL_LEAVE:
-            Serial.println("Zigbee: Connection lost (Leave). Rebooting...");
-            Utils::flashLed(50, 0, 0, 500);
-            if constexpr (NEED_RS485) digitalWrite(RS485_POWER_PIN, LOW);
-            delay(100);
-            esp_restart();
+            LOG_W(Zb, "Connection lost (Leave). Rebooting...");
+            leave_pending = true; // loop() drains the log and restarts
+            loopScheduler.wake();
             break;
 
         case ESP_ZB_BDB_SIGNAL_STEERING:
             if (sig_status == ESP_OK) {
-                Serial.println("Zigbee: Connected successfully. Enabling RS485 power.");
-                if constexpr (NEED_RS485) digitalWrite(RS485_POWER_PIN, HIGH);
+                LOG_I(Zb, "Connected successfully.");
+                loopScheduler.wake();
             } else {
-                Serial.printf("Zigbee: Steering failed with status 0x%x\n", sig_status);
+                LOG_W(Zb, "Steering failed with status 0x%x", sig_status);
             }
             break;
 
         case ESP_ZB_ZDO_SIGNAL_SKIP_STARTUP:
-            Serial.println("Zigbee: Device already commissioned, skipping pairing.");
-            if constexpr (NEED_RS485) digitalWrite(RS485_POWER_PIN, HIGH);
+            LOG_I(Zb, "Device already commissioned, skipping pairing.");
+            loopScheduler.wake();
             break;
 
         default:
@@ -162,66 +243,92 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
     return ESP_OK;
 }
 
-/* --- INTERRUPTS (PulseSource Only) --- */
-void IRAM_ATTR isr_cold() { 
-    if(coldSrc) { // Проверка типа неявна в static_cast
-        static_cast<Source::PulseSource*>(coldSrc.get())->increment(); 
-    }
+/* --- INTERRUPTS (PulseSource Only; PulsePcnt counts in hardware) --- */
+// One handler for every pulse channel; the source comes in as the argument.
+void IRAM_ATTR isr_pulse(void* arg) {
+    static_cast<Source::PulseSource*>(arg)->increment();
+    loopScheduler.wakeFromIsr(); // On-change reports should not wait for the next timer
 }
 
-void IRAM_ATTR isr_hot() { 
-    if(hotSrc) {
-        static_cast<Source::PulseSource*>(hotSrc.get())->increment(); 
-    }
+// Service button: wakes the loop, which then follows the press with a timer.
+void IRAM_ATTR isr_wake() {
+    loopScheduler.wakeFromIsr();
 }
 
 // Saves the current configuration and meter readings to NVS.
+// Each channel is written only if its settings changed or liters moved enough.
 void saveConfiguration() {
-    Serial.println("System: Writing configuration to Flash...");
-    
-    auto cs = zigbeeCold.get_serial();
-    auto co = zigbeeCold.get_offset();
-    auto hs = zigbeeHot.get_serial();
-    auto ho = zigbeeHot.get_offset();  
+    loadSystemData(); // Opens NVS if a resume has not yet
+    for (auto& ch : channels) {
+        Storage::ChannelState st;
+        st.serial = ch.endpoint.get_serial();
+        st.offset = ch.endpoint.get_offset();
+        st.liters = ch.endpoint.get_val();
+        if (ch.src) {
+            // Stored only when the coordinator moved them, so a new table default still applies
+            Source::PollBounds b = ch.src->getPollBounds();
+            if (b.minMs != ch.config.poll.minMs || b.maxMs != ch.config.poll.maxMs) {
+                st.pollMinMs = b.minMs;
+                st.pollMaxMs = b.maxMs;
+            }
+        }
+        if (!ch.store.save(st)) continue;
+        Metrics::count(Metrics::Counter::NvsWrites);
 
-    Serial.printf("Config to save -> Cold SN:%lu, Cold Off:%ld, Hot SN:%lu, Hot Off:%ld\n", cs, co, hs, ho);
+        LOG_I(Sys, "Saved to Flash -> %s SN:%lu Off:%ld L:%llu (writes %lu)",
+              ch.config.name, st.serial, st.offset, st.liters, ch.store.stats().writes);
+    }
+}
 
-    // Save Cold channel settings
-    prefs.putUInt("sc", cs);
-    prefs.putInt("oc", co);
-    
-    // Save Hot channel settings
-    prefs.putUInt("sh", hs);
-    prefs.putInt("oh", ho);
-    
-    // Save current liters (since NVS is already open for writing)
-    prefs.putULong64("cl", zigbeeCold.get_val());
-    prefs.putULong64("hl", zigbeeHot.get_val());
+// Restores a channel; falls back to the per-key layout of older firmware once.
+Storage::ChannelState loadChannel(Channel& ch) {
+    Storage::ChannelState st;
+    if (ch.store.load(st)) return st;
+    if (ch.index >= sizeof(kLegacyKeys) / sizeof(kLegacyKeys[0])) return st;
+
+    const char* snKey = kLegacyKeys[ch.index][0];
+    const char* offKey = kLegacyKeys[ch.index][1];
+    const char* litKey = kLegacyKeys[ch.index][2];
+    st.serial = prefs.getUInt(snKey, 0);
+    st.offset = prefs.getInt(offKey, 0);
+    st.liters = prefs.getULong64(litKey, 0);
+    if (prefs.isKey(snKey) || prefs.isKey(litKey)) {
+        LOG_I(Sys, "Migrating %s/%s/%s to channel record", snKey, offKey, litKey);
+        if (ch.store.save(st)) {
+            prefs.remove(snKey);
+            prefs.remove(offKey);
+            prefs.remove(litKey);
+        }
+    }
+    return st;
 }
 
 // Emergency recovery: Erase all data if button is held at boot
 void checkBootRecovery() {
     if (digitalRead(BOOT_BUTTON_PIN) == LOW) {
-        Serial.println("\n!!! BOOT BUTTON HELD - RECOVERY MODE !!!");
+        LOG_W(Sys, "!!! BOOT BUTTON HELD - RECOVERY MODE !!!");
+        drainLog();
         Utils::setLed(50, 0, 0); // Red warning
         delay(3000); // Wait to confirm intention
         
         if (digitalRead(BOOT_BUTTON_PIN) == LOW) {
-            Serial.println("Erasing NVS...");
+            LOG_W(Sys, "Erasing NVS...");
             nvs_flash_erase();
             nvs_flash_init();
 
-            Serial.println("Erasing Zigbee Storage...");
+            LOG_W(Sys, "Erasing Zigbee Storage...");
             const esp_partition_t* zb_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "zb_storage");
             if (zb_part) {
                 esp_partition_erase_range(zb_part, 0, zb_part->size);
-                Serial.println("Done.");
+                LOG_W(Sys, "Done.");
             } else {
-                Serial.println("Partition 'zb_storage' not found!");
+                LOG_E(Sys, "Partition 'zb_storage' not found!");
             }
 
             Utils::flashLed(0, 50, 0, 1000); // Green success
-            Serial.println("Restarting...");
+            LOG_W(Sys, "Restarting...");
+            drainLog();
+            Serial.flush();
             ESP.restart();
         }
     }
@@ -229,28 +336,45 @@ void checkBootRecovery() {
 
 // Standard Arduino setup function.
 void setup() {
+    esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
+    bool deep_sleep_wake = wakeup_reason == ESP_SLEEP_WAKEUP_TIMER ||
+                           wakeup_reason == ESP_SLEEP_WAKEUP_EXT0 || wakeup_reason == ESP_SLEEP_WAKEUP_EXT1;
+    resumedFromSleep = kEnableDeepSleep && deep_sleep_wake && rtcState.valid();
+
     Serial.begin(115200);
-    delay(100); // Allow time for serial to initialize before printing boot messages
-    
-    // Print firmware version
-    Serial.println("\n╔════════════════════════════════════════════════════════╗");
-    Serial.printf("║  ESP32-C6 Zigbee Water Meter v%s              ║\n", firmware::version::kFirmwareVersion.data());
-    Serial.printf("║  Build: %s                              ║\n", firmware::version::kBuildTimestamp.data());
-    Serial.println("║  Copyright 2026 Andrey Nemenko                       ║");
-    Serial.println("╚════════════════════════════════════════════════════════╝\n");
+    if (resumedFromSleep) {
+        // Fast path: no banner, no NVS reads and no history scan (both wait for
+        // the first report, see loadSystemData), straight to poll-and-report
+        sleptMs = (uint32_t)((rtcClockUs() - rtcState.savedAtUs) / 1000);
+        rtcState.resumes++;
+        LOG_I(Sys, "*** RESUME #%lu after %lu s of deep sleep (%s) ***", rtcState.resumes, sleptMs / 1000,
+              wakeup_reason == ESP_SLEEP_WAKEUP_TIMER ? "Timer" : "External");
+        initHardware();
+        initSources();  // Sources are heap objects: rebuilt, but from rtcState
+        setupZigbee();  // The stack restarts with the chip; reporting from rtcState
+        setupLoopTimers();
+        resumeReportTimers();
+        return;
+    }
+    rtcState.invalidate();
+    rtcState.resumes = 0;
+    rtcState.resumeReportMs = 0;
+
+    // Firmware version; the first loop() pass prints it (see drainLog)
+    LOG_I(Sys, "ESP32-C6 Zigbee Water Meter v%s, build %s. Copyright 2026 Andrey Nemenko",
+          firmware::version::kFirmwareVersion.data(), firmware::version::kBuildTimestamp.data());
     
-    esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
     switch(wakeup_reason) {
         case ESP_SLEEP_WAKEUP_TIMER:
-            Serial.println("*** WOKE FROM DEEP SLEEP (Timer) ***");
+            LOG_I(Sys, "*** WOKE FROM DEEP SLEEP (Timer) ***");
             break;
         case ESP_SLEEP_WAKEUP_EXT0:
         case ESP_SLEEP_WAKEUP_EXT1:
-            Serial.println("*** WOKE FROM DEEP SLEEP (External) ***");
+            LOG_I(Sys, "*** WOKE FROM DEEP SLEEP (External) ***");
             break;
         case ESP_SLEEP_WAKEUP_UNDEFINED:
         default:
-            Serial.println("*** POWER-ON or RESET (not from deep sleep) ***");
+            LOG_I(Sys, "*** POWER-ON or RESET (not from deep sleep) ***");
             break;
     }
     
@@ -259,332 +383,440 @@ void setup() {
     loadSystemData();  // Layer 1: Storage (NVS)
     initSources();     // Layer 2: Drivers and Sources
     setupZigbee();     // Layer 3: Network Stack
+    setupLoopTimers(); // Layer 4: Main loop schedule
     
-    Serial.println("--- System initialized and running ---");
+    LOG_I(Sys, "--- System initialized and running ---");
     Utils::flashLed(0, 30, 0, 1000); // Final green signal
 }
 
 void initHardware() {
-    Serial.begin(115200);
     Utils::setLed(30, 0, 0); // Статус: Загрузка
 
     // Шина данных
     if constexpr (NEED_RS485) {
-        pinMode(RS485_POWER_PIN, OUTPUT);
-        digitalWrite(RS485_POWER_PIN, HIGH); // Включаем питание шины
+        busPower.begin(); // Питание шины выключено до первого опроса
+
+        rs485Uart = std::make_unique<RS485UartStream>(RS485_UART, RS485_EN);
+        if (rs485Uart->begin(RS485_BAUD, RS485_RX, RS485_TX)) {
+            rs485Line = rs485Uart.get();
+        } else {
+            LOG_W(Sys, "RS485: UART driver not installed, using Serial1");
+            rs485Uart.reset();
+            rs485Bus = std::make_unique<RS485Stream>(&Serial1, RS485_EN);
+            rs485Bus->begin(RS485_BAUD, RS485_CONFIG, RS485_RX, RS485_TX);
+            rs485Bus->setTimeout(300);
+            rs485Line = rs485Bus.get();
+        }
 
-        rs485Bus = std::make_unique<RS485Stream>(&Serial1, RS485_EN);
-        rs485Bus->begin(RS485_BAUD, RS485_CONFIG, RS485_RX, RS485_TX);
-        rs485Bus->setTimeout(300);
+        busScheduler.setPower(&busPower);
+        busTaskRunning = busScheduler.begin();
+        if (!busTaskRunning) {
+            LOG_E(Sys, "RS485: Failed to start bus task, polling inline");
+            busPower.hold(); // Inline reads are not grouped into bursts
+        }
     }
     
     pinMode(BOOT_BUTTON_PIN, INPUT_PULLUP);
 }
 
+// Opens NVS and scans the history store (reads the header of every sector).
+// A cold boot does it before the sources; a resume on its first report, or
+// earlier if something must be saved. Runs once.
 void loadSystemData() {
+    if (storage_open) return;
+    storage_open = true;
     prefs.begin("water", false);
     // Open storage. Data reading is done in initSources for localization.
-}
 
-void initSources() {
-    // 1. Read settings from memory
-    uint32_t c_sn  = prefs.getUInt("sc", 0);
-    uint32_t h_sn  = prefs.getUInt("sh", 0);
-    uint64_t c_lit = prefs.getULong64("cl", 0);
-    uint64_t h_lit = prefs.getULong64("hl", 0);
-    int32_t  c_off = prefs.getInt("oc", 0);
-    int32_t  h_off = prefs.getInt("oh", 0);
-    
-// Loaded config -> Cold SN:10128442, Cold Off:0, Hot SN:10128939, Hot Off:0
-
-    Serial.printf("Loaded config -> Cold SN:%lu, Cold Off:%ld, Hot SN:%lu, Hot Off:%ld\n", c_sn, c_off, h_sn, h_off);
-    
-    // 2. Create Drivers (Protocol Layer)
-    if constexpr (COLD_TYPE == Source::SourceType::Smart) {
-        coldDrv.reset(Driver::DriverFactory::create(COLD_DRV_MODEL, rs485Bus.get(), c_sn));
-        if (coldDrv) coldDrv->setLogger(&Serial); // Передаем raw pointer для логирования
+    if (historyFlash.begin() && history.begin()) {
+        LOG_I(Sys, "History: %u hourly / %u daily buckets (%s), %u torn record(s) recovered",
+              history.nextIndex(0, Storage::HistoryKind::Hour), history.nextIndex(0, Storage::HistoryKind::Day), kChannels[0].name,
+              history.stats().tornRecords);
     } else {
-        Serial.println("Cold driver not created");
+        LOG_E(Sys, "History: storage unavailable");
     }
+    for (size_t i = 0; i < pendingBucketCount; i++) {
+        history.append(pendingBuckets[i].channel, pendingBuckets[i].kind, pendingBuckets[i].liters);
+    }
+    pendingBucketCount = 0;
+}
 
-    if constexpr (HOT_TYPE == Source::SourceType::Smart) {
-        hotDrv.reset(Driver::DriverFactory::create(HOT_DRV_MODEL, rs485Bus.get(), h_sn));
-        if (hotDrv) hotDrv->setLogger(&Serial);
-    } else {
-        Serial.println("Hot driver not created");
-    }
-
-    // 3. Create Sources (Logic Layer)
-    coldSrc.reset(Source::SourceFactory::create(COLD_TYPE, c_lit, PULSE_COLD_PIN, coldDrv.get()));
-    hotSrc.reset(Source::SourceFactory::create(HOT_TYPE,  h_lit,  PULSE_HOT_PIN,  hotDrv.get()));
-
-    // 4. Fine Tuning (Offsets & Start)
-    if (coldSrc) { 
-        coldSrc->setPollInterval(COLD_POOL_INTERVAL);
-        coldSrc->setOffset(c_off); 
-        coldSrc->setTestMode(kEnableTestIntervals);
-        coldSrc->setSerialNumber(c_sn);
-        coldSrc->begin();
-        if constexpr (COLD_TYPE == Source::SourceType::Pulse) {
-            attachInterrupt(digitalPinToInterrupt(PULSE_COLD_PIN), isr_cold, FALLING);
+// Closed hour or day of a channel into the history store (held back until it is open).
+void recordBucket(uint8_t channel, Storage::HistoryKind kind, uint32_t liters) {
+    if (storage_open) {
+        history.append(channel, kind, liters);
+    } else if (pendingBucketCount < sizeof(pendingBuckets) / sizeof(pendingBuckets[0])) {
+        pendingBuckets[pendingBucketCount++] = { channel, kind, liters };
+    }
+}
+
+void initSources() {
+    Bus::BusScheduler* sched = busTaskRunning ? &busScheduler : nullptr;
+
+    for (auto& ch : channels) {
+        // 1. Read settings from memory (RTC after deep sleep, NVS otherwise)
+        Storage::ChannelState st;
+        if (resumedFromSleep) {
+            const Source::SourceSnapshot& snap = rtcState.channels[ch.index];
+            st.serial = snap.serial;
+            st.offset = snap.offset;
+            st.liters = snap.liters;
+            st.pollMinMs = snap.pollMinMs;
+            st.pollMaxMs = snap.pollMaxMs;
+        } else {
+            st = loadChannel(ch);
+            LOG_I(Sys, "Loaded config -> %s SN:%lu, Off:%ld", ch.config.name, st.serial, st.offset);
         }
-    } else {
-        Serial.println("Cold source not created");
-    }
-    if (hotSrc) { 
-        hotSrc->setPollInterval(HOT_POOL_INTERVAL);
-        hotSrc->setOffset(h_off); 
-        hotSrc->setTestMode(kEnableTestIntervals);
-        hotSrc->setSerialNumber(h_sn);
-        hotSrc->begin();
-        if constexpr (HOT_TYPE == Source::SourceType::Pulse) {
-            attachInterrupt(digitalPinToInterrupt(PULSE_HOT_PIN), isr_hot, FALLING);
+
+        // 2. Driver (Smart only) and source; Smart polls go through the shared bus task
+        if (!channels.build(ch.index, st, rs485Line, sched, rs485Uart.get())) {
+            LOG_E(Sys, "%s source not created", ch.config.name);
+            continue;
+        }
+
+        // 3. Fine Tuning & Start
+        Source::WaterSource* src = ch.src.get();
+        uint8_t index = ch.index;
+        src->setTestMode(kEnableTestIntervals);
+        src->onPeriodClosed([index](bool daily, uint64_t liters) {
+            recordBucket(index, daily ? Storage::HistoryKind::Day : Storage::HistoryKind::Hour, (uint32_t)liters);
+        });
+        src->begin();
+        if (resumedFromSleep) src->resume(rtcState.channels[ch.index], sleptMs, millis());
+        if (src->needsPulseIsr()) {
+            attachInterruptArg(digitalPinToInterrupt(ch.config.pin), isr_pulse, src, FALLING);
         }
-    } else {
-        Serial.println("Hot source not created");   
     }
 }
 
 void setupZigbee() {
-    // Bind sources to endpoints
-    zigbeeCold.setSource(coldSrc.get());
-    zigbeeHot.setSource(hotSrc.get());
-
-    // Register endpoints in the stack
-    zigbeeCold.begin(); 
-    zigbeeHot.begin();
-    Zigbee.addEndpoint(&zigbeeCold); 
-    Zigbee.addEndpoint(&zigbeeHot);
-
-    // Идентификация устройства
-    zigbeeCold.setManufacturerAndModel(MANUFACTURER_NAME, MODEL_ID);
-    zigbeeHot.setManufacturerAndModel(MANUFACTURER_NAME, MODEL_ID);
+    for (auto& ch : channels) {
+        // Bind source and history to the endpoint
+        ch.endpoint.setSource(ch.src.get());
+        ch.endpoint.setHistory(&history, ch.index);
+
+        // Register the endpoint in the stack (report slot == channel index)
+        if (ch.index == 0) ch.endpoint.enableDiagnostics(); // Device-wide, first endpoint only
+        ch.endpoint.begin();
+        Zigbee.addEndpoint(&ch.endpoint);
+        reportScheduler.addEndpoint(&ch.endpoint);
+
+        // Идентификация устройства
+        ch.endpoint.setManufacturerAndModel(MANUFACTURER_NAME, MODEL_ID);
+
+        // Reporting configured by the coordinator earlier (defaults otherwise)
+        ReportingTable& rt = ch.endpoint.reporting();
+        if (resumedFromSleep) {
+            rt.importConfigs(rtcState.reporting[ch.index], rt.size());
+            ch.endpoint.restoreReporting(rtcState.reporters[ch.index], sleptMs, millis());
+        } else {
+            ReportingConfig cfg[kMaxReportedAttrs];
+            if (ch.reporting.load(cfg, rt.size())) rt.importConfigs(cfg, rt.size());
+        }
+    }
 
     // Configure sleep before starting the stack
     // Set threshold: device will enter deep sleep if idle time > 60 seconds
     esp_zb_sleep_set_threshold(DEEP_SLEEP_THRESHOLD);  
     esp_zb_sleep_enable(true);
     
-    Serial.printf("Zigbee: Sleep enabled with %us threshold for deep sleep optimization\n", DEEP_SLEEP_THRESHOLD);
+    LOG_I(Sys, "Zigbee: Sleep enabled with %us threshold for deep sleep optimization", DEEP_SLEEP_THRESHOLD);
 
     // Start the stack
     if(!Zigbee.begin(ZIGBEE_END_DEVICE)) {
-        Serial.println("Zigbee: CRITICAL ERROR STARTING STACK");
-        Serial.println("Data corruption detected or Partition Scheme mismatch.");
-        Serial.println("Hold BOOT button during startup to Factory Reset.");
+        LOG_E(Sys, "Zigbee: CRITICAL ERROR STARTING STACK");
+        LOG_E(Sys, "Data corruption detected or Partition Scheme mismatch.");
+        LOG_E(Sys, "Hold BOOT button during startup to Factory Reset.");
     }
     esp_zb_core_action_handler_register(zb_action_handler);
+    esp_zb_raw_command_handler_register(zb_raw_command_handler);
     esp_zb_set_tx_power(TX_POWER);
 }
 
-// 2. Smart Zigbee Reporting
-enum ReportState { 
-    IDLE, 
-    PENDING_COLD_CONFIG, PENDING_HOT_CONFIG, 
-    PENDING_COLD_HOURLY, PENDING_HOT_HOURLY, 
-    PENDING_COLD_VALUE,  PENDING_HOT_VALUE,
-    PENDING_HEARTBEAT_COLD // A state specifically for the heartbeat sequence
-};
-static ReportState reportState = IDLE;
-static uint32_t nextActionTime = 0;
+void setupLoopTimers() {
+    uint32_t now = millis();
+    loopScheduler.attachCurrentTask(); // setup() and loop() share the Arduino loop task
+
+    // Same order as LoopTimer
+    loopScheduler.add(updateSources, now, 0);
+    loopScheduler.add(handleZigbeeReporting, now, 0);
+    loopScheduler.add(handleConfigSave, now);               // Armed by events only
+    loopScheduler.add(handleAutoSave, now, kEnableDeepSleep ? LoopScheduler::kNever : AUTOSAVE_INTERVAL); // Deep sleep saves on the way down
+    loopScheduler.add(updateStatusIndication, now, 0);
+    loopScheduler.add(checkServiceButton, now, 0);
+
+    // Finished bus bursts, pulse edges and the button cut the sleep short
+    if (busTaskRunning) busScheduler.setListener(loopScheduler.task());
+    attachInterrupt(digitalPinToInterrupt(BOOT_BUTTON_PIN), isr_wake, FALLING);
+}
 
+// Sleeps until the earliest timer or an event, then runs whatever is due.
+// No fixed tick: an idle device wakes only for polls, hour closes, reports
+// and saves (see the "Wakeups" line of the diagnostic log).
 void loop() {
-    static bool connected_logged = false;
-    static uint32_t last_loop_log = 0;
-    static uint32_t last_sleep_cycle_start = 0;  // Track sleep cycle start
-    uint32_t now = millis();
-    
-    updateSources();
+    if (loopScheduler.sleep()) onLoopEvent(millis());
+    if (leave_pending) restartAfterLeave();
+    const LoopScheduler::Stats& st = loopScheduler.stats();
+    Metrics::registry().set(Metrics::Counter::Wakeups, st.wakeups);
+    Metrics::registry().set(Metrics::Counter::AwakeMs, (uint32_t)st.awakeMs);
+    Metrics::registry().roll(millis());
+    loopScheduler.runDue(millis());
+    logDiagnostics(millis());
+    maybeDeepSleep(millis());
+    drainLog();
+}
 
-    if (Zigbee.connected()) {
-        if (!connected_logged) {
-            Serial.println("Application: Zigbee.connected() is true. Main logic is now active.");
-            connected_logged = true;
-            last_sleep_cycle_start = now;
-        }
-        handleZigbeeReporting();
-        handleAutoSave();
-        handleConfigSave();
-    } else {
-        connected_logged = false;
-    }
+// Formats what the log ring collected, if anyone is listening (USB CDC host
+// attached; always true on a plain UART console). Without a console the
+// records stay in RAM, newest kept, and cost no formatting at all. Loop task
+// only: the ring has one reader.
+void drainLog() {
+    if (Serial) Log::ring().drain(Serial);
+}
 
-    updateStatusIndication();
-    checkServiceButton();
-    
-    // Diagnostic logging with proper sleep cycle tracking
-    if (now - last_loop_log >= 120000) {
-        last_loop_log = now;
-        uint32_t sleep_cycle_duration = now - last_sleep_cycle_start;
-        // Reset cycle start for next measurement
-        uint32_t prev_cycle_start = last_sleep_cycle_start;
-        last_sleep_cycle_start = now;
-        
-        Serial.printf("System: Loop alive. Connected=%s, Uptime=%lu min, SleepCycleDuration=%lu ms\n", 
-                      Zigbee.connected() ? "YES" : "NO", now / 60000, sleep_cycle_duration);
-    }
-    
-    // Always delay to allow sleep, but more aggressively when idle
-    if (reportState == IDLE && Zigbee.connected()) {
-        delay(LOOP_IDLE_DELAY);  // 5000ms - deep sleep can trigger here
-    } else {
-        delay(100);  // Minimal delay during active reporting
-    }
+// The coordinator removed us (ZDO Leave, signalled in the stack task):
+// restart from here, so the log is drained by its only reader first.
+void restartAfterLeave() {
+    drainLog();
+    Serial.flush();
+    Utils::flashLed(50, 0, 0, 500);
+    if constexpr (NEED_RS485) busPower.shutdown();
+    delay(100);
+    esp_restart();
+}
+
+// Something happened outside the schedule (pulse, bus result, attribute
+// write, join, button): let every subsystem that may care look at it now.
+void onLoopEvent(uint32_t now) {
+    loopScheduler.arm(kTimerSources, now);
+    loopScheduler.arm(kTimerReporting, now);
+    loopScheduler.arm(kTimerConfigSave, now);
+    loopScheduler.arm(kTimerButton, now);
+    loopScheduler.arm(kTimerStatus, now + 100); // Keep the activity blink visible
 }
 
 /* --- BLOCK IMPLEMENTATIONS --- */
+// Each block is a loop timer: it gets the current time and returns how long
+// it can wait before the next run (LoopScheduler::kNever = until an event).
 
 // 1. Update Data Sources
-void updateSources() {
-    if (coldSrc) coldSrc->tick();
-    if (hotSrc)  hotSrc->tick();
+uint32_t updateSources(uint32_t now) {
+    channels.tick();
+    loopScheduler.arm(kTimerReporting, now); // Fresh readings may need a report
+    return channels.msUntilDue(millis());
 }
 
-
-void handleZigbeeReporting() {
+// 2. Smart Zigbee Reporting
+uint32_t handleZigbeeReporting(uint32_t now) {
+    static bool connected_logged = false;
     static uint32_t boot_time = millis();
-    static uint32_t last_heartbeat = 0;
-    static bool initial_config_sent = false;
-    uint32_t now = millis();
-
-    // Execute deferred action if it's time
-    if (reportState != IDLE && now >= nextActionTime) {
-        ReportState currentState = reportState;
-        reportState = IDLE; // Reset state before execution
-        switch (currentState) {
-            case PENDING_COLD_CONFIG:
-                zigbeeCold.reportConfig();
-                reportState = PENDING_HOT_CONFIG;
-                nextActionTime = now + 200;
-                break;
-            case PENDING_COLD_HOURLY:
-                zigbeeCold.reportHourly();
-                // Check if hot needs reporting (chaining)
-                if (hotSrc && hotSrc->hasHourChanged()) {
-                    reportState = PENDING_HOT_HOURLY;
-                    nextActionTime = now + 100;
-                }
-                break;
-            case PENDING_HEARTBEAT_COLD: // Heartbeat always reports both channels
-                zigbeeCold.reportValue();
-                reportState = PENDING_HOT_VALUE; // Unconditionally chain to hot report
-                nextActionTime = now + 100;
-                break;
-            case PENDING_COLD_VALUE:
-                zigbeeCold.reportValue();
-                // This was an on-change report for cold.
-                // Only chain the hot report if its value has also changed.
-                if (zigbeeHot.shouldReport()) {
-                    reportState = PENDING_HOT_VALUE;
-                    nextActionTime = now + 100;
-                }
-                break;
 
-            case PENDING_HOT_CONFIG: zigbeeHot.reportConfig(); break;
-            case PENDING_HOT_HOURLY: zigbeeHot.reportHourly(); break;
-            case PENDING_HOT_VALUE: zigbeeHot.reportValue(); break;
-            default: break;
-        }
-        return; // Executed one action per cycle
+    if (!Zigbee.connected()) {
+        connected_logged = false;
+        return LOOP_IDLE_DELAY; // Steering also wakes the loop; this is the fallback
+    }
+    if (!connected_logged) {
+        LOG_I(Sys, "Zigbee.connected() is true. Main logic is now active.");
+        connected_logged = true;
     }
 
-    // Do not schedule new reports while there are pending ones
-    if (reportState != IDLE) return;
-
-    // One-time configuration report (SN and Offset) at startup, non-blocking
+    // One-time configuration report (SN and Offset) at startup
     if (!initial_config_sent && (now - boot_time > 5000)) {
         initial_config_sent = true;
-        Serial.println("Zigbee: Reporting initial config...");
-        reportState = PENDING_COLD_CONFIG;
-        nextActionTime = now;
-        return;
+        LOG_I(Zb, "Reporting initial config...");
+        reportScheduler.postAll(ReportKind::Config);
     }
 
-    // Hourly consumption reports
-    if (coldSrc && coldSrc->hasHourChanged()) {
-        reportState = PENDING_COLD_HOURLY;
-        nextActionTime = now;
-    } else if (hotSrc && hotSrc->hasHourChanged()) {
-        zigbeeHot.reportHourly(); // Only hot
+    // After a deep-sleep wake-up: everything, as soon as the wake-up poll is in
+    if (resume_report_pending && !channels.awaitingData()) {
+        resume_report_pending = false;
+        reportScheduler.postAll(ReportKind::Value);
     }
 
-    // Total value reports (on change or heartbeat)
-    bool coldNeeds = zigbeeCold.shouldReport();
-    bool hotNeeds  = zigbeeHot.shouldReport();
-    bool isHeartbeat = (now - last_heartbeat >= HEARTBEAT_INTERVAL);
+    // Hourly consumption, then value and battery per the endpoint's reporting
+    // configuration: on change (past the min interval) or as a heartbeat (max interval)
+    for (auto& ch : channels) {
+        if (ch.src && ch.src->hasHourChanged()) reportScheduler.post(ch.index, ReportKind::Hourly);
+        if (ch.endpoint.configReportPending()) reportScheduler.post(ch.index, ReportKind::Config);
+        if (ch.endpoint.shouldReport(now)) reportScheduler.post(ch.index, ReportKind::Value);
+        if (ch.endpoint.batteryDue(now)) reportScheduler.post(ch.index, ReportKind::Battery);
+    }
 
-    if (isHeartbeat) {
-        Serial.println("Scheduling report -> Heartbeat");
-        last_heartbeat = now;
-        reportState = PENDING_HEARTBEAT_COLD; // Start the full heartbeat sequence
-        nextActionTime = now;
+    if (reportScheduler.run(now)) {
         Utils::setLed(30, 30, 30);
-    } else if (coldNeeds || hotNeeds) {
-        // Serial.printf("Scheduling report -> On-change. Cold: %s, Hot: %s\n", coldNeeds ? "YES" : "no", hotNeeds ? "YES" : "no");
-        // For on-change reports, schedule only what's needed
-        if (coldNeeds) {
-            reportState = PENDING_COLD_VALUE;
-        } else { // This means only hotNeeds is true
-            reportState = PENDING_HOT_VALUE;
+        loopScheduler.arm(kTimerStatus, now + 100);
+        if (!first_report_done) {
+            logFirstReport(now);
+            loadSystemData(); // Deferred by a resume: the report is out now
         }
-        nextActionTime = now;
-        Utils::setLed(30, 30, 30);
     }
 
-    // Battery report once an hour
-    static uint32_t last_battery = 0;
-    if (now - last_battery >= BATTERY_REPORT_INTERVAL || last_battery == 0) {
-        last_battery = now;
-        if (zigbeeCold.battery_supported()) zigbeeCold.reportBattery();
-        if (zigbeeHot.battery_supported())  zigbeeHot.reportBattery();
+    // Next min/max interval of any endpoint, initial config or report slot
+    uint32_t next = LoopScheduler::kNever;
+    for (auto& ch : channels) {
+        uint32_t ms = ch.endpoint.msUntilReport(now);
+        if (ms != 0) next = min(next, ms); // 0: posted above, its slot is in nextDue()
     }
+    if (!initial_config_sent) next = min(next, 5001 - (now - boot_time));
+    uint32_t due = reportScheduler.nextDue(now);
+    if (due != UINT32_MAX) next = min(next, due - now);
+    return next;
 }
 
 // 3. Auto-save (NVS)
-void handleAutoSave() {
-    static uint32_t last_save = 0;
-    if (millis() - last_save >= 900000) { 
-        last_save = millis();
-        saveConfiguration(); 
-    }
+uint32_t handleAutoSave(uint32_t) {
+    if (Zigbee.connected()) saveConfiguration();
+    return AUTOSAVE_INTERVAL;
 }
 
 // 3.b. Сохранение конфигурации, если она была изменена через Zigbee
-void handleConfigSave() {
-    if (zigbeeCold.isConfigDirty() || zigbeeHot.isConfigDirty()) {
+uint32_t handleConfigSave(uint32_t) {
+    bool dirty = false;
+    for (auto& ch : channels) dirty |= ch.endpoint.isConfigDirty();
+    if (dirty) {
         saveConfiguration();
-        zigbeeCold.clearConfigDirty();
-        zigbeeHot.clearConfigDirty();
+        for (auto& ch : channels) ch.endpoint.clearConfigDirty();
+    }
+
+    // Reporting configuration written by Configure Reporting
+    for (auto& ch : channels) {
+        ReportingTable& rt = ch.endpoint.reporting();
+        ReportingConfig cfg[kMaxReportedAttrs];
+        if (!rt.takeDirty(cfg)) continue;
+        loadSystemData(); // Opens NVS if a resume has not yet
+        if (!ch.reporting.save(cfg, rt.size())) {
+            rt.markDirty(); // Next pass tries again
+            continue;
+        }
+        Metrics::count(Metrics::Counter::NvsWrites);
+        LOG_I(Sys, "Saved reporting config -> %s", ch.config.name);
     }
+    loopScheduler.arm(kTimerReporting, millis()); // New intervals: plan the next report again
+    return LoopScheduler::kNever;
 }
 
 // 4. Status LED
-void updateStatusIndication() {
-    static uint32_t last_blink = 0;
+uint32_t updateStatusIndication(uint32_t) {
     if (!Zigbee.connected()) {
-        if (millis() - last_blink > 500) {
-            last_blink = millis();
-            static bool t = false; t = !t;
-            t ? Utils::setLed(20, 20, 0) : Utils::setLed(0, 0, 0);
-        }
-    } else {
-        Utils::setLed(0, 0, 0); // Heartbeat LED
-        // Utils::setLed(0, 1, 0); // Heartbeat LED
+        static bool t = false; t = !t;
+        t ? Utils::setLed(20, 20, 0) : Utils::setLed(0, 0, 0);
+        return 500; // Blink until joined
     }
+    Utils::setLed(0, 0, 0); // Heartbeat LED
+    // Utils::setLed(0, 1, 0); // Heartbeat LED
+    return LoopScheduler::kNever;
 }
 
 // 5. Service Button
-void checkServiceButton() {
+uint32_t checkServiceButton(uint32_t now) {
     static uint32_t press_start = 0;
     if (digitalRead(BOOT_BUTTON_PIN) == LOW) {
         if (press_start == 0) {
-            press_start = millis();
-        } else if (millis() - press_start > 3000) {
+            press_start = now;
+        } else if (now - press_start > 3000) {
             Utils::flashLed(50, 0, 0, 1000);
             Zigbee.factoryReset();
             ESP.restart();
         }
-    } else {
-        press_start = 0;
+        return 100; // Follow the press; the ISR catches the next one
+    }
+    press_start = 0;
+    return LoopScheduler::kNever;
+}
+
+// 6. Diagnostics: on the first wake-up after every 2 minutes (never wakes the loop by itself)
+void logDiagnostics(uint32_t now) {
+    static uint32_t last_loop_log = 0;
+    if (now - last_loop_log < 120000) return;
+    last_loop_log = now;
+
+    const LoopScheduler::Stats& st = loopScheduler.stats();
+    LOG_I(Sys, "Loop alive. Connected=%s, Uptime=%lu min, Wakeups=%lu/h (%lu total, %lu by events), Awake=%llu ms, Asleep=%llu ms",
+          Zigbee.connected() ? "YES" : "NO", now / 60000, st.wakeupsPerHour(), st.wakeups, st.eventWakeups,
+          st.awakeMs, st.asleepMs);
+    ZigbeeWaterMeter::LockStats lock;
+    for (auto& ch : channels) {
+        lock.holds += ch.endpoint.lockStats().holds;
+        lock.totalUs += ch.endpoint.lockStats().totalUs;
+        lock.maxUs = max(lock.maxUs, ch.endpoint.lockStats().maxUs);
+    }
+    LOG_I(Zb, "Lock held %lu times, max %lu us, total %llu us", lock.holds, lock.maxUs, lock.totalUs);
+    if constexpr (NEED_RS485) {
+        const Bus::BusPower::Stats& bus = busPower.stats();
+        uint32_t duty = now ? (uint32_t)((uint64_t)bus.onMs * 10000 / now) : 0; // 0.01 %
+        LOG_I(Sys, "RS485: %lu bursts, powered %lu ms (%lu.%02lu%% duty), last %lu ms / %lu uJ, warm-up %lu ms",
+              bus.bursts, bus.onMs, duty / 100, duty % 100,
+              bus.lastBurstMs, busPower.energyUj(bus.lastBurstMs), busPower.warmUpMs());
+    }
+    for (auto& ch : channels) {
+        if (!ch.src || ch.src->health().state() == Source::HealthState::Ok) continue;
+        const Source::MeterHealth& h = ch.src->health();
+        uint32_t age = h.lastSuccessAgeMs(now);
+        LOG_W(Src, "Channel %s: meter %s, %u failed polls, last read %ld s ago", ch.config.name,
+              h.state() == Source::HealthState::Offline ? "OFFLINE" : "degraded", h.failedPolls(),
+              age == Source::MeterHealth::kNever ? -1L : (long)(age / 1000));
+    }
+    if (Serial) Metrics::registry().dump(Serial, now); // Formatting only for a reader
+    if constexpr (kEnableDeepSleep) {
+        LOG_I(Sys, "Boot: first report after %lu ms (cold boot), %lu ms (last of %lu resumes)",
+              rtcState.coldBootReportMs, rtcState.resumeReportMs, rtcState.resumes);
     }
-}
\ No newline at end of file
+}
+
+// Boot-to-first-report latency; millis() counts from the start of this boot.
+void logFirstReport(uint32_t now) {
+    first_report_done = true;
+    LOG_I(Sys, "Boot: first report %lu ms after %s", now, resumedFromSleep ? "deep-sleep wake-up" : "cold boot");
+    if (resumedFromSleep) rtcState.resumeReportMs = now;
+    else rtcState.coldBootReportMs = now;
+}
+
+/* --- DEEP SLEEP --- */
+
+// Wall clock that keeps running in deep sleep (RTC timer), in microseconds.
+uint64_t rtcClockUs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (uint64_t)tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+// Carries the report state over the sleep (the endpoints' reporters were
+// restored in setupZigbee()); millis() started again at 0.
+void resumeReportTimers() {
+    initial_config_sent = rtcState.configReported;
+    resume_report_pending = true;
+}
+
+void saveRtcState(uint32_t now) {
+    for (auto& ch : channels) {
+        rtcState.channels[ch.index] = ch.src ? ch.src->snapshot(now) : Source::SourceSnapshot{};
+        ch.endpoint.saveReporting(rtcState.reporters[ch.index], now);
+        ch.endpoint.reporting().exportConfigs(rtcState.reporting[ch.index]);
+    }
+    rtcState.configReported = initial_config_sent;
+    rtcState.savedAtUs = rtcClockUs();
+    rtcState.seal();
+}
+
+// 7. Deep sleep (kEnableDeepSleep): once this wake-up's work is reported and
+// no timer is due for a while, keep the state in RTC memory and power down
+// until the earliest timer. NVS is saved as well, in case RTC memory is lost.
+void maybeDeepSleep(uint32_t now) {
+    if constexpr (!kEnableDeepSleep) return;
+    if (!Zigbee.connected() || !first_report_done || resume_report_pending) return;
+    if (!reportScheduler.idle() || !busScheduler.idle() || channels.awaitingData()) return;
+    for (auto& ch : channels) {
+        if (ch.endpoint.isConfigDirty() || ch.endpoint.reporting().isDirty()) return;
+    }
+    uint32_t ms = loopScheduler.nextDelay(now); // Hour closes keep this under an hour
+    if (ms < DEEP_SLEEP_MIN_MS) return;
+
+    saveConfiguration();
+    saveRtcState(millis());
+    LOG_I(Sys, "Deep sleep for %lu s", ms / 1000);
+    drainLog(); // RAM is lost in deep sleep
+    Serial.flush();
+    if constexpr (NEED_RS485) busPower.shutdown();
+    esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000);
+    esp_deep_sleep_start();
+}
@@ -0,0 +1,181 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <algorithm>
+#include <atomic>
+
+// Field diagnostics: a fixed set of counters and latency histograms, updated
+// from the hot paths (RS485 driver, Zigbee endpoint, main loop) and read out
+// through the diagnostics cluster or as one serial line.
+//
+// Everything is static storage indexed by enum, so an update is one relaxed
+// atomic add (amoadd on the C6) with no lookup, lock or allocation. Each
+// histogram has a single writer task, so max and the 64-bit sum are plain
+// read-modify-writes (a reader on another task may see a torn sum; it is
+// only used for the mean).
+namespace Metrics {
+
+enum class Counter : uint8_t {
+    RsTransactions,   // RS485 request/reply exchanges
+    RsCrcErrors,      // Replies with a bad CRC (or length byte)
+    RsTimeouts,       // No reply, or the line went idle mid-frame
+    ReportFrames,     // Report Attributes frames handed to the stack
+    NvsWrites,        // NVS records written (channel state, reporting config)
+    Wakeups,          // Main loop wake-ups
+    AwakeMs,          // Main loop time spent awake
+    BusBursts,        // RS485 power-ups (one per poll burst)
+    BusOnMs,          // RS485 transceiver powered time (duty cycle = this / uptime)
+    RsRetries,        // Repeated reads after a CRC error or timeout
+    RsSkipped,        // Polls skipped for a meter marked offline
+    BatteryFails,     // Polls that got the volume but not the battery values
+    Count
+};
+
+enum class Histogram : uint8_t {
+    RsTransactionUs,  // Request sent to reply checked
+    ZbLockWaitUs,     // esp_zb_lock_acquire() blocking time
+    ZbLockHoldUs,     // Report flush with the lock held
+    BusBurstMs,       // RS485 powered time per burst, warm-up included
+    BusBurstUj,       // Estimated transceiver energy per burst
+    Count
+};
+
+constexpr size_t kCounters = static_cast<size_t>(Counter::Count);
+constexpr size_t kHistograms = static_cast<size_t>(Histogram::Count);
+constexpr size_t kBuckets = 16;
+
+// Bucket b >= 1 holds values in [2^(b-1), 2^b) << shift; bucket 0 is below
+// 1 << shift, the last one is open-ended. RS485 counts in 64 us steps (last
+// bucket >= 1 s), the lock in 1 us steps (last bucket >= 16 ms), bursts in
+// 1 ms (>= 16 s) and 64 uJ (>= 1 J) steps.
+constexpr uint8_t kShift[kHistograms] = { 6, 0, 0, 0, 6 };
+
+constexpr const char* kCounterNames[kCounters] = { "rs_txn", "rs_crc", "rs_to", "frames", "nvs_w", "wakeups", "awake_ms",
+                                                     "bus_on", "bus_ms", "rs_retry", "rs_skip", "bat_fail" };
+constexpr const char* kHistogramNames[kHistograms] = { "rs_us", "lockw_us", "lockh_us", "burst_ms", "burst_uj" };
+
+// Lower bound of bucket b, in the histogram's unit.
+constexpr uint32_t bucketFloor(Histogram h, size_t b) {
+    return b == 0 ? 0 : (1UL << (b - 1)) << kShift[static_cast<size_t>(h)];
+}
+
+class Registry {
+public:
+    struct HistogramData {
+        std::atomic<uint32_t> buckets[kBuckets];
+        std::atomic<uint32_t> count;
+        std::atomic<uint32_t> max;
+        uint64_t sum;
+    };
+
+    void add(Counter c, uint32_t n = 1) { _counters[idx(c)].fetch_add(n, std::memory_order_relaxed); }
+
+    // For values another component already counts (EventScheduler::Stats).
+    void set(Counter c, uint32_t v) { _counters[idx(c)].store(v, std::memory_order_relaxed); }
+
+    void record(Histogram h, uint32_t v) {
+        HistogramData& d = _hist[idx(h)];
+        d.buckets[bucket(h, v)].fetch_add(1, std::memory_order_relaxed);
+        d.count.fetch_add(1, std::memory_order_relaxed);
+        d.sum += v;
+        if (v > d.max.load(std::memory_order_relaxed)) d.max.store(v, std::memory_order_relaxed);
+    }
+
+    uint32_t get(Counter c) const { return _counters[idx(c)].load(std::memory_order_relaxed); }
+
+    // Growth over the last completed hour (0 until one has passed).
+    uint32_t lastHour(Counter c) const { return _lastHour[idx(c)]; }
+
+    uint32_t count(Histogram h) const { return _hist[idx(h)].count.load(std::memory_order_relaxed); }
+    uint32_t max(Histogram h) const { return _hist[idx(h)].max.load(std::memory_order_relaxed); }
+    uint32_t bucketCount(Histogram h, size_t b) const {
+        return _hist[idx(h)].buckets[b].load(std::memory_order_relaxed);
+    }
+    uint32_t mean(Histogram h) const {
+        uint32_t n = count(h);
+        return n ? (uint32_t)(_hist[idx(h)].sum / n) : 0;
+    }
+
+    // Upper bound of the bucket holding the p-th percentile (p in 1..100),
+    // capped at the largest value seen. 0 if nothing was recorded.
+    uint32_t percentile(Histogram h, uint8_t p) const {
+        uint32_t n = count(h);
+        if (n == 0) return 0;
+        uint64_t rank = ((uint64_t)n * p + 99) / 100;
+        uint64_t seen = 0;
+        for (size_t b = 0; b < kBuckets; b++) {
+            seen += bucketCount(h, b);
+            if (seen >= rank) return b + 1 < kBuckets ? std::min(bucketFloor(h, b + 1), max(h)) : max(h);
+        }
+        return max(h);
+    }
+
+    // Closes the hour for lastHour() once 60 min have passed since the
+    // previous close. Cheap enough to call on every loop wake-up.
+    void roll(uint32_t now) {
+        if (now - _hourStart < 3600000UL) return;
+        _hourStart = now;
+        for (size_t i = 0; i < kCounters; i++) {
+            uint32_t v = _counters[i].load(std::memory_order_relaxed);
+            _lastHour[i] = v - _atHourStart[i];
+            _atHourStart[i] = v;
+        }
+    }
+
+    // One line: counters (total, last hour in brackets) and p50/p95/max per histogram.
+    void dump(Print& out, uint32_t now) const {
+        out.printf("Metrics: up=%lus", (unsigned long)(now / 1000));
+        for (size_t i = 0; i < kCounters; i++) {
+            out.printf(" %s=%lu(%lu)", kCounterNames[i], (unsigned long)get((Counter)i), (unsigned long)_lastHour[i]);
+        }
+        for (size_t i = 0; i < kHistograms; i++) {
+            Histogram h = (Histogram)i;
+            out.printf(" %s=%lu/%lu/%lu", kHistogramNames[i], (unsigned long)percentile(h, 50),
+                       (unsigned long)percentile(h, 95), (unsigned long)max(h));
+        }
+        out.printf("\n");
+    }
+
+    void reset() {
+        for (auto& c : _counters) c.store(0, std::memory_order_relaxed);
+        for (auto& d : _hist) {
+            for (auto& b : d.buckets) b.store(0, std::memory_order_relaxed);
+            d.count.store(0, std::memory_order_relaxed);
+            d.max.store(0, std::memory_order_relaxed);
+            d.sum = 0;
+        }
+        for (size_t i = 0; i < kCounters; i++) _lastHour[i] = _atHourStart[i] = 0;
+        _hourStart = 0;
+    }
+
+private:
+    template <typename E>
+    static constexpr size_t idx(E e) { return static_cast<size_t>(e); }
+
+    static size_t bucket(Histogram h, uint32_t v) {
+        v >>= kShift[idx(h)];
+        size_t b = v ? 32 - __builtin_clz(v) : 0;
+        return b < kBuckets ? b : kBuckets - 1;
+    }
+
+    std::atomic<uint32_t> _counters[kCounters] = {};
+    HistogramData _hist[kHistograms] = {};
+    uint32_t _lastHour[kCounters] = {};
+    uint32_t _atHourStart[kCounters] = {};
+    uint32_t _hourStart = 0;
+};
+
+// The device-wide registry. Constant-initialized (zeroed .bss), so there is
+// no init guard on access.
+inline Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+inline void count(Counter c, uint32_t n = 1) { registry().add(c, n); }
+inline void record(Histogram h, uint32_t v) { registry().record(h, v); }
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef REPORT_SCHEDULER_H
+#define REPORT_SCHEDULER_H
+
+#include <Arduino.h>
+
+// What an endpoint can be asked to report. Lower value = higher priority.
+enum class ReportKind : uint8_t { Config = 0, Hourly = 1, Value = 2, Battery = 3 };
+static constexpr uint8_t kReportKindCount = 4;
+
+// Anything that can stage reports and send them in one go (ZigbeeWaterMeter).
+class ReportSink {
+public:
+    virtual ~ReportSink() {}
+    virtual void queueReport(ReportKind kind) = 0;
+    virtual void flushReports() = 0;
+};
+
+// Data-driven report queue across any number of endpoints.
+//
+// Jobs are (endpoint, kind) pairs kept as one bit each, so posting the same
+// job twice is free and a heartbeat that lands on a pending on-change report
+// becomes one report. When it is time to send, the endpoint holding the
+// highest-priority job is served and *all* of its pending kinds go out in the
+// same flush (one frame per cluster). Flushes are spaced by at least
+// minSpacingMs so the radio and the coordinator are not flooded. Time is
+// passed in, so the scheduler runs unchanged against a fake clock.
+template <size_t MaxEndpoints>
+class ReportScheduler {
+public:
+    struct Stats {
+        uint32_t posted = 0;     // post() calls
+        uint32_t coalesced = 0;  // ... that hit an already pending job
+        uint32_t flushes = 0;    // Endpoint flushes (frame groups) sent
+        uint32_t jobsSent = 0;
+    };
+
+    explicit ReportScheduler(uint32_t minSpacingMs = 100) : _minSpacingMs(minSpacingMs) {}
+
+    // Returns the endpoint slot, or -1 if the table is full.
+    int addEndpoint(ReportSink* sink) {
+        if (_count == MaxEndpoints || !sink) return -1;
+        _slots[_count] = { sink, 0, 0 };
+        return (int)_count++;
+    }
+
+    size_t endpoints() const { return _count; }
+
+    void post(size_t slot, ReportKind kind) {
+        if (slot >= _count) return;
+        uint8_t bit = 1u << (uint8_t)kind;
+        _stats.posted++;
+        if (_slots[slot].pending & bit) {
+            _stats.coalesced++;
+            return;
+        }
+        if (_slots[slot].pending == 0) _slots[slot].since = _postSeq++;
+        _slots[slot].pending |= bit;
+    }
+
+    void postAll(ReportKind kind) {
+        for (size_t i = 0; i < _count; i++) post(i, kind);
+    }
+
+    bool pending(size_t slot, ReportKind kind) const {
+        return slot < _count && (_slots[slot].pending & (1u << (uint8_t)kind));
+    }
+
+    bool idle() const {
+        for (size_t i = 0; i < _count; i++) if (_slots[i].pending) return false;
+        return true;
+    }
+
+    // When run() will next have something to send (now if overdue); UINT32_MAX when idle.
+    uint32_t nextDue(uint32_t now) const {
+        if (idle()) return UINT32_MAX;
+        if (!_sentAny || now - _lastFlush >= _minSpacingMs) return now;
+        return _lastFlush + _minSpacingMs;
+    }
+
+    // Serves at most one endpoint if the spacing allows. Returns true if it sent.
+    bool run(uint32_t now) {
+        if (_sentAny && now - _lastFlush < _minSpacingMs) return false;
+        int best = pick();
+        if (best < 0) return false;
+
+        Slot& s = _slots[best];
+        uint8_t jobs = s.pending;
+        s.pending = 0; // Посты во время отправки станут новой задачей
+        for (uint8_t k = 0; k < kReportKindCount; k++) {
+            if (!(jobs & (1u << k))) continue;
+            s.sink->queueReport((ReportKind)k);
+            _stats.jobsSent++;
+        }
+        s.sink->flushReports();
+        _stats.flushes++;
+        _lastFlush = now;
+        _sentAny = true;
+        return true;
+    }
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    struct Slot {
+        ReportSink* sink;
+        uint8_t pending;  // Bit per ReportKind
+        uint32_t since;   // Post order of the oldest pending job (fairness on ties)
+    };
+
+    // Highest-priority pending job wins; among equals, the endpoint waiting longest.
+    int pick() const {
+        int best = -1;
+        uint8_t bestPrio = kReportKindCount;
+        for (size_t i = 0; i < _count; i++) {
+            if (!_slots[i].pending) continue;
+            uint8_t prio = __builtin_ctz(_slots[i].pending);
+            if (best < 0 || prio < bestPrio || (prio == bestPrio && (int32_t)(_slots[i].since - _slots[best].since) < 0)) {
+                best = (int)i;
+                bestPrio = prio;
+            }
+        }
+        return best;
+    }
+
+    uint32_t _minSpacingMs;
+    Slot _slots[MaxEndpoints] = {};
+    size_t _count = 0;
+    uint32_t _postSeq = 0;
+    uint32_t _lastFlush = 0;
+    bool _sentAny = false;
+    Stats _stats;
+};
+
+#endif
@@ -3,15 +3,19 @@
 
 #include "water_source.h"
 #include "pulse_source.h"
+#include "pcnt_source.h"
+#include "hwi_counters/pcnt_counter.h"
 #include "smart_source.h"
 #include "simulation_source.h" // Не забудь создать этот файл для тестов
 #include "drivers/smart_driver.h"
+#include "drivers/driver_factory.h"
 
 namespace Source {
     enum class SourceType {
         Pulse,
         Smart,
-        Test   // Новый тип
+        Test,  // Новый тип
+        PulsePcnt // Импульсы считает аппаратный PCNT, без прерывания на каждый фронт
     };
     
     class SourceFactory {
@@ -43,10 +47,51 @@ namespace Source {
                 case SourceType::Test:
                     return new SimulationSource(initialLiters);
 
+                case SourceType::PulsePcnt:
+                    {
+                        PcntCounter* counter = new PcntCounter(pin);
+                        if (counter->begin()) {
+                            PcntSource* src = new PcntSource(counter);
+                            src->setLiters(initialLiters);
+                            return src;
+                        }
+                        delete counter;
+                        // PCNT недоступен — откатываемся на прерывания (PulseSource)
+                        PulseSource* src = new PulseSource(pin);
+                        src->setLiters(initialLiters);
+                        return src;
+                    }
+
                 default:
                     return nullptr;
             }
         }
+
+        // Smart source typed on the concrete driver of `model`: the poll path
+        // calls it directly instead of through the vtable. `drv` must come from
+        // DriverFactory for the same model; other models get the generic source.
+        static WaterSource* createSmart(Driver::MeterModel model, uint64_t initialLiters, Driver::SmartMeterDriver* drv) {
+            if (drv == nullptr) return nullptr;
+            switch (model) {
+                case Driver::MeterModel::Pulsar_Du_15_20:
+                    return createTyped<Driver::MeterModel::Pulsar_Du_15_20>(initialLiters, drv);
+                case Driver::MeterModel::Modbus_Generic:
+                    return createTyped<Driver::MeterModel::Modbus_Generic>(initialLiters, drv);
+                case Driver::MeterModel::Mock:
+                    return createTyped<Driver::MeterModel::Mock>(initialLiters, drv);
+                default:
+                    return create(SourceType::Smart, initialLiters, 0, drv);
+            }
+        }
+
+    private:
+        template <Driver::MeterModel M>
+        static WaterSource* createTyped(uint64_t initialLiters, Driver::SmartMeterDriver* drv) {
+            typedef Driver::DriverFor<M> Drv;
+            BasicSmartSource<Drv>* src = new BasicSmartSource<Drv>(static_cast<Drv*>(drv));
+            src->setLiters(initialLiters); // Восстанавливаем показания
+            return src;
+        }
     };
 }
 
@@ -0,0 +1,68 @@
+#ifndef FLOW_ESTIMATOR_H
+#define FLOW_ESTIMATOR_H
+
+#include <stdint.h>
+
+namespace Source {
+    // Streaming flow-rate estimate in liters per hour.
+    //
+    // Each sample is "N liters over the last M ms" (one pulse interval, or the
+    // delta between two meter polls). Samples are smoothed with a time-weighted
+    // exponential average, so memory and work per sample are O(1) regardless of
+    // how often samples arrive. Between samples the estimate is capped by
+    // what a single liter over the elapsed time would give, which makes it
+    // decay when the pulses stop instead of holding the last value forever.
+    class FlowEstimator {
+    public:
+        // tauMs: smoothing time constant. idleTimeoutMs: no sample for this long = no flow.
+        explicit FlowEstimator(uint32_t tauMs = 60000, uint32_t idleTimeoutMs = 600000)
+            : _tauMs(tauMs), _idleTimeoutMs(idleTimeoutMs) {}
+
+        void reset() {
+            _rateLph = 0;
+            _lastIntervalMs = 0;
+            _hasSample = false;
+        }
+
+        // Adds `liters` consumed during the `ms` that ended at `now`.
+        void addSample(uint32_t liters, uint32_t ms, uint32_t now) {
+            if (ms == 0) return;
+            float sample = (float)liters * kMsInHour / ms;
+            if (!_hasSample || now - _lastSampleMs >= _idleTimeoutMs) {
+                _rateLph = sample; // First interval after idle: nothing to average with
+            } else {
+                float alpha = (float)ms / (float)(_tauMs + ms);
+                _rateLph += alpha * (sample - _rateLph);
+            }
+            _lastSampleMs = now;
+            _lastIntervalMs = ms;
+            _hasSample = true;
+        }
+
+        // Current estimate (L/h) as seen at `now`.
+        uint32_t rateLph(uint32_t now) const {
+            if (!_hasSample) return 0;
+            uint32_t elapsed = now - _lastSampleMs;
+            if (elapsed >= _idleTimeoutMs) return 0;
+            float rate = _rateLph;
+            if (elapsed > _lastIntervalMs) {
+                // Overdue sample: flow is at most one liter per elapsed time
+                float bound = kMsInHour / elapsed;
+                if (bound < rate) rate = bound;
+            }
+            return (uint32_t)(rate + 0.5f);
+        }
+
+    private:
+        static constexpr float kMsInHour = 3600000.0f;
+
+        uint32_t _tauMs;
+        uint32_t _idleTimeoutMs;
+
+        float _rateLph = 0;
+        uint32_t _lastSampleMs = 0;
+        uint32_t _lastIntervalMs = 0;
+        bool _hasSample = false;
+    };
+}
+#endif
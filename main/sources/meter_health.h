@@ -0,0 +1,98 @@
+#ifndef METER_HEALTH_H
+#define METER_HEALTH_H
+
+#include <stdint.h>
+#include <algorithm>
+
+namespace Source {
+    enum class HealthState : uint8_t {
+        Ok = 0,        // Last poll read everything on the first attempt
+        Degraded = 1,  // Last poll needed retries or failed; circuit still closed
+        Offline = 2    // Circuit open: polls are skipped
+    };
+
+    // Health of the meter behind one source (one bus address), fed with the
+    // outcome of every poll.
+    //
+    // A meter that is unplugged or configured with the wrong serial costs a
+    // full response timeout per attempt. After kTripAfter failed polls in a
+    // row the circuit opens: polls are skipped for kSkipBaseMs, then one
+    // probe without retries goes out. A failed probe doubles the skip (up to
+    // kSkipMaxMs), any successful read closes the circuit. So a dead meter
+    // costs one probe every few hours instead of retries on every poll.
+    // The skip runs in time, not polls: the poll interval is left alone.
+    class MeterHealth {
+    public:
+        static constexpr uint8_t kRetries = 2;
+        static constexpr uint8_t kTripAfter = 3;
+        static constexpr uint32_t kSkipBaseMs = 60 * 60000;
+        static constexpr uint32_t kSkipMaxMs = 24 * 3600000;
+        static constexpr uint32_t kNever = UINT32_MAX;
+
+        HealthState state() const { return _state; }
+
+        // False while the circuit is open and the skip has not run out.
+        bool allow(uint32_t now) const {
+            return _state != HealthState::Offline || (int32_t)(now - _openUntil) >= 0;
+        }
+
+        // Retries for the next poll: none for the probe of an offline meter.
+        uint8_t retries() const { return _state == HealthState::Offline ? 0 : kRetries; }
+
+        // Outcome of a poll that was allowed; attempts: reads it took.
+        void record(bool ok, uint8_t attempts, uint32_t now) {
+            if (ok) {
+                _state = attempts > 1 ? HealthState::Degraded : HealthState::Ok;
+                _failedPolls = 0;
+                _skipMs = 0;
+                _lastOkMs = now;
+                _everOk = true;
+                return;
+            }
+            if (_failedPolls < UINT8_MAX) _failedPolls++;
+            if (_state == HealthState::Offline) {
+                _skipMs = std::min(_skipMs * 2, kSkipMaxMs);
+            } else if (_failedPolls >= kTripAfter) {
+                _state = HealthState::Offline;
+                _skipMs = kSkipBaseMs;
+            } else {
+                _state = HealthState::Degraded;
+                return;
+            }
+            _openUntil = now + _skipMs;
+        }
+
+        uint8_t failedPolls() const { return _failedPolls; }
+        uint32_t skipMs() const { return _skipMs; }
+
+        // Time until polls go out again (0 unless the circuit is open).
+        uint32_t msUntilAllowed(uint32_t now) const { return allow(now) ? 0 : _openUntil - now; }
+
+        // Since the last successful read; kNever if there was none.
+        uint32_t lastSuccessAgeMs(uint32_t now) const { return _everOk ? now - _lastOkMs : kNever; }
+
+        // Other meter on this source (serial changed): start over.
+        void reset() { *this = MeterHealth(); }
+
+        // Continues on a fresh millis() timeline (deep sleep, see SourceSnapshot).
+        void restore(HealthState state, uint8_t failedPolls, uint32_t skipMs, uint32_t skipLeftMs, uint32_t lastOkAgoMs,
+                     uint32_t now) {
+            _state = state;
+            _failedPolls = failedPolls;
+            _skipMs = skipMs;
+            _openUntil = now + skipLeftMs;
+            _everOk = lastOkAgoMs != kNever;
+            _lastOkMs = now - lastOkAgoMs;
+        }
+
+    private:
+        HealthState _state = HealthState::Ok;
+        uint8_t _failedPolls = 0;
+        uint32_t _skipMs = 0;
+        uint32_t _openUntil = 0;
+        uint32_t _lastOkMs = 0;
+        bool _everOk = false;
+    };
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef PCNT_SOURCE_H
+#define PCNT_SOURCE_H
+
+#include <memory>
+#include "water_source.h"
+#include "hwi_counters/pulse_counter.h"
+
+namespace Source {
+
+// Pulse input counted by a hardware counter instead of a per-edge ISR.
+//
+// The counter owns the edges; this class only folds its (wrapping) value into
+// a 64-bit liter total when asked. One pulse = one liter, as in PulseSource.
+class PcntSource : public WaterSource {
+private:
+    std::unique_ptr<PulseCounter> _counter;
+    uint64_t _baseLiters = 0;     // Liters at the moment of the last setLiters()
+    uint64_t _basePulses = 0;     // Counter total at the same moment
+    uint64_t _flowPulses = 0;     // Counter total at the last observed change
+    uint32_t _flowMs = 0;
+
+public:
+    PcntSource(PulseCounter* counter, uint64_t initialLiters = 0)
+        : _counter(counter), _baseLiters(initialLiters) {
+        _pollInterval = 60000;
+    }
+
+    void begin() override {
+        _basePulses = _counter->total();
+        _flowPulses = _basePulses;
+        _flowMs = millis();
+    }
+
+    uint64_t getLiters() override {
+        return _baseLiters + (_counter->total() - _basePulses);
+    }
+
+    void setLiters(uint64_t l) override {
+        _baseLiters = l;
+        _basePulses = _counter->total();
+    }
+
+    // Nothing to poll: the counter is read on demand in getLiters().
+    void update() override {}
+
+    // No per-pulse timestamps here, so the flow sample is "pulses since the
+    // last change over the time since then", taken once per tick().
+    void collect() override {
+        uint64_t total = _counter->total();
+        if (total == _flowPulses) return;
+        uint32_t now = millis();
+        _flow.addSample((uint32_t)(total - _flowPulses), now - _flowMs, now);
+        _flowPulses = total;
+        _flowMs = now;
+    }
+};
+
+} // namespace Source
+
+#endif
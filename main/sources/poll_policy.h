@@ -0,0 +1,66 @@
+#ifndef POLL_POLICY_H
+#define POLL_POLICY_H
+
+#include <stdint.h>
+#include <algorithm>
+
+namespace Source {
+    // Allowed range of a source's poll interval. min == max: fixed interval.
+    struct PollBounds {
+        uint32_t minMs;
+        uint32_t maxMs;
+    };
+
+    // Poll interval driven by what the polls find.
+    //
+    // Every poll costs a bus power-up whether or not water moved, so a quiet
+    // meter (night, holidays) is polled less and less often, and a meter that
+    // shows consumption is polled quickly again:
+    //   - reading changed: interval / 2, so a burst of use (morning, evening)
+    //     is followed closely;
+    //   - unchanged: interval x 2 from the kGrowAfter-th quiet reading on.
+    // Always within the bounds. Failed reads leave the interval alone.
+    // Halving/doubling came out best over the traces in
+    // host/bench/bench_polling.cpp; dividing by 4 on a change polled more
+    // for no fresher data. A meter that moves on every poll (dripping
+    // cistern) stays near the minimum: that costs polls, but gets noticed.
+    class AdaptivePollPolicy {
+    public:
+        static constexpr uint8_t kGrowAfter = 1;
+        static constexpr uint32_t kShrinkDiv = 2;
+        static constexpr uint32_t kGrowMul = 2;
+
+        // Narrows the current interval into the new bounds (min first).
+        void setBounds(PollBounds b, uint32_t& interval) {
+            if (b.maxMs < b.minMs) b.maxMs = b.minMs;
+            _bounds = b;
+            interval = std::min(std::max(interval, b.minMs), b.maxMs);
+        }
+
+        const PollBounds& bounds() const { return _bounds; }
+        bool adaptive() const { return _bounds.maxMs > _bounds.minMs; }
+
+        // Number of unchanged readings since the last change (saturates).
+        uint8_t unchanged() const { return _unchanged; }
+        void setUnchanged(uint8_t n) { _unchanged = n; }
+
+        // Interval until the next poll after a reading that did (not) change.
+        uint32_t next(uint32_t interval, bool changed) {
+            if (!adaptive()) return interval;
+            if (changed) {
+                _unchanged = 0;
+                return std::max(interval / kShrinkDiv, _bounds.minMs);
+            }
+            if (_unchanged < UINT8_MAX) _unchanged++;
+            if (_unchanged < kGrowAfter) return interval;
+            uint64_t grown = (uint64_t)interval * kGrowMul;
+            return (uint32_t)std::min<uint64_t>(grown, _bounds.maxMs);
+        }
+
+    private:
+        PollBounds _bounds = { 0, 0 };
+        uint8_t _unchanged = 0;
+    };
+}
+
+#endif
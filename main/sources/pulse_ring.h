@@ -0,0 +1,55 @@
+#ifndef PULSE_RING_H
+#define PULSE_RING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Source {
+
+// Single-producer/single-consumer ring of 32-bit pulse timestamps.
+//
+// The producer is the pulse ISR, the consumer is the loop task. Each side
+// only writes its own index, so neither needs a lock or a read-modify-write:
+// the ISR does one store into the slot and one release-store of the head.
+// When the consumer falls behind, new timestamps are dropped (and counted);
+// pulse totals are tracked separately and never depend on the ring.
+template <size_t N>
+class PulseRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "PulseRing size must be a power of two");
+
+public:
+    // Producer side (ISR). Returns false if the ring is full.
+    bool push(uint32_t ts) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) == N) {
+            _dropped.store(_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        _buf[head & (N - 1)] = ts;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side.
+    bool pop(uint32_t& ts) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) return false;
+        ts = _buf[tail & (N - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+    uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+    uint32_t _buf[N];
+    std::atomic<uint32_t> _head{0};
+    std::atomic<uint32_t> _tail{0};
+    std::atomic<uint32_t> _dropped{0};
+};
+
+} // namespace Source
+
+#endif
@@ -1,22 +1,37 @@
 #ifndef PULSE_SOURCE_H
 #define PULSE_SOURCE_H
 
+#include <atomic>
 #include "water_source.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include "pulse_ring.h"
 
 namespace Source {
 
 class PulseSource : public WaterSource {
+public:
+    static constexpr size_t kPulseRingSize = 64;
+
 private:
     uint8_t _pin;
-    volatile uint64_t _liters = 0; // volatile по-прежнему полезен
     
     // Параметры антидребезга
     uint32_t _debounceMs = 50; 
-    volatile uint32_t _lastPulseTime = 0;
-    volatile bool _pulseDetected = false;
-    portMUX_TYPE _spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+    // Состояние ISR. Пишет только прерывание, поэтому хватает 32-битных
+    // атомиков без критических секций: _pulseCount — монотонный счетчик
+    // импульсов (переполнение безопасно, считаем разность), _lastPulseTime
+    // читается из loop без разрыва.
+    std::atomic<uint32_t> _pulseCount{0};
+    std::atomic<uint32_t> _lastPulseTime{0};
+    PulseRing<kPulseRingSize> _pulseTimes;
+
+    // Состояние loop: 64-битный итог и сколько импульсов ISR в него уже вошло.
+    uint64_t _liters = 0;
+    uint32_t _foldedCount = 0;
+
+    uint32_t _prevPulseMs = 0;
+    uint32_t _lastIntervalMs = 0;
+    bool _havePrevPulse = false;
 
 public:
     /**
@@ -36,44 +51,61 @@ public:
         // Регистрация прерывания вынесена в main.ino для гибкости
     }
 
+    bool needsPulseIsr() const override { return true; }
+
     // Метод, который вызывается ИЗ ПРЕРЫВАНИЯ (ISR)
-    // Помечен IRAM_ATTR для работы из оперативной памяти ESP32
+    // Помечен IRAM_ATTR для работы из оперативной памяти ESP32.
+    // Только один продюсер: ни блокировок, ни read-modify-write.
     void IRAM_ATTR increment() {
         uint32_t now = millis();
-        // Проверка антидребезга
-        if (now - _lastPulseTime > _debounceMs) { // Эта проверка не атомарна, но для антидребезга это допустимо
-            portENTER_CRITICAL_ISR(&_spinlock);
-            _liters++;
-            _lastPulseTime = now;
-            portEXIT_CRITICAL_ISR(&_spinlock);
-            _pulseDetected = true;
-        }
+        if (now - _lastPulseTime.load(std::memory_order_relaxed) <= _debounceMs) return;
+        _lastPulseTime.store(now, std::memory_order_relaxed);
+        _pulseTimes.push(now);
+        _pulseCount.store(_pulseCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
     }
 
     uint64_t getLiters() override {
-        uint64_t temp_liters;
-        portENTER_CRITICAL(&_spinlock);
-        temp_liters = _liters;
-        portEXIT_CRITICAL(&_spinlock);
-        return temp_liters;
+        return _liters + (uint32_t)(_pulseCount.load(std::memory_order_acquire) - _foldedCount);
     }
 
     void setLiters(uint64_t l) override {
-        portENTER_CRITICAL(&_spinlock);
+        _foldedCount = _pulseCount.load(std::memory_order_acquire);
         _liters = l;
-        portEXIT_CRITICAL(&_spinlock);
+    }
+
+    uint32_t getLastPulseTime() const { return _lastPulseTime.load(std::memory_order_relaxed); }
+    // Интервал между двумя последними импульсами (мс), 0 пока их меньше двух.
+    uint32_t getLastPulseInterval() const { return _lastIntervalMs; }
+    // Метки времени, не поместившиеся в кольцо (сами импульсы не теряются).
+    uint32_t getDroppedPulseTimes() const { return _pulseTimes.dropped(); }
+
+    // Переносит накопленные ISR импульсы в 64-битный итог и разбирает метки времени.
+    // Вызывается на каждом tick(), поэтому кольцо не успевает переполниться.
+    void collect() override {
+        uint32_t count = _pulseCount.load(std::memory_order_acquire);
+        _liters += (uint32_t)(count - _foldedCount);
+        _foldedCount = count;
+
+        uint32_t ts;
+        while (_pulseTimes.pop(ts)) onPulseTime(ts);
     }
 
     // Вызывается базовым классом WaterSource::tick() раз в _pollInterval
     void update() override {
-        if (_pulseDetected) {
-            _pulseDetected = false;
-            // Здесь можно добавить логику записи в лог или 
-            // выставления флага для сохранения в NVS (Preferences)
+        collect();
+    }
+
+private:
+    void onPulseTime(uint32_t ts) {
+        if (_havePrevPulse) {
+            _lastIntervalMs = ts - _prevPulseMs;
+            _flow.addSample(1, _lastIntervalMs, ts); // Один импульс = один литр
         }
+        _prevPulseMs = ts;
+        _havePrevPulse = true;
     }
 };
 
 } // namespace Source
 
-#endif
\ No newline at end of file
+#endif
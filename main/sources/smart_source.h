@@ -2,46 +2,206 @@
 #define SMART_SOURCE_H
 
 #include <Arduino.h>
+#include <type_traits>
 #include "water_source.h"
 #include "drivers/smart_driver.h"
+#include "bus/bus_scheduler.h"
+#include "bus/bus_retry.h"
+#include "metrics.h"
 
 namespace Source {
-    class SmartSource : public WaterSource {
-    private:
+    // Driver-independent part of a Smart source: readings, flow, bus tickets.
+    // Kept out of the template so each driver type adds only its poll path.
+    class SmartSourceBase : public WaterSource {
+    protected:
         Driver::SmartMeterDriver* _drv;
         uint64_t _liters = 0;
 
-    public:
-        SmartSource(Driver::SmartMeterDriver* drv, uint64_t initialLiters = 0) 
+        // Previous meter reading for the flow estimate
+        uint64_t _prevReadLiters = 0;
+        uint32_t _prevReadMs = 0;
+        bool _hasPrevRead = false;
+
+        Bus::BusScheduler* _bus = nullptr;
+        uint8_t _busPriority = 0;
+        Bus::BusScheduler::Ticket _ticket = Bus::BusScheduler::kNoTicket;
+
+        static constexpr Driver::ParamSet kPollParams =
+            Driver::paramBit(Driver::MeterParam::TotalVolume) |
+            Driver::paramBit(Driver::MeterParam::BatteryVoltage) |
+            Driver::paramBit(Driver::MeterParam::BatteryThresholdMin);
+        // Meter health follows the volume alone; battery values read in the
+        // same batch that do not come in are counted apart (BatteryFails).
+        static constexpr Driver::ParamSet kHealthParams = Driver::paramBit(Driver::MeterParam::TotalVolume);
+
+        // What the pending or last poll asked for
+        Driver::ParamSet _polled = 0;
+
+        SmartSourceBase(Driver::SmartMeterDriver* drv, uint64_t initialLiters)
             : _drv(drv), _liters(initialLiters) {}
 
-        void begin() override {
-            _lastPoll = millis() - _pollInterval; 
+    public:
+        ~SmartSourceBase() override {
+            if (_bus) _bus->cancel(_ticket);
         }
 
-        void setSerialNumber(uint32_t sn) override {
-            WaterSource::setSerialNumber(sn); 
-            if (_drv) _drv->setAddress(sn);
+        // Routes polls through the shared bus task instead of reading inline.
+        // Higher priority is served first when several meters are due together.
+        void setBusScheduler(Bus::BusScheduler* bus, uint8_t priority) {
+            _bus = bus;
+            _busPriority = priority;
+        }
+
+        void begin() override {
+            _lastPoll = millis() - _pollInterval;
         }
 
         uint64_t getLiters() override { return _liters; }
         void setLiters(uint64_t l) override { _liters = l; }
 
-        void update() override {
-            if (!_drv) return;
+        bool awaitingData() const override { return _ticket != Bus::BusScheduler::kNoTicket; }
+
+        void collect() override {
+            if (!_bus || _ticket == Bus::BusScheduler::kNoTicket) return;
+            Driver::MeterReading r;
+            bool ok = false;
+            uint8_t attempts = 0;
+            if (_bus->poll(_ticket, r, ok, &attempts)) {
+                _ticket = Bus::BusScheduler::kNoTicket;
+                // Expired before it reached the bus (attempts == 0): says nothing about the meter
+                if (attempts) recordPoll(r, ok, attempts);
+                apply(r);
+            }
+        }
+
+    protected:
+        // Drops a pending bus request, the flow baseline and the health record (meter changed).
+        void forgetMeter() {
+            if (_bus) {
+                _bus->cancel(_ticket); // Ответ для старого серийника больше не нужен
+                _ticket = Bus::BusScheduler::kNoTicket;
+            }
+            _hasPrevRead = false; // Другой счетчик — другая база для расхода
+            _flow.reset();
+            _health.reset();      // Новый серийник заслуживает новых попыток
+        }
+
+        // Circuit breaker: false (and counted) if this poll is skipped.
+        bool pollAllowed() {
+            if (_health.allow(millis())) return true;
+            Metrics::count(Metrics::Counter::RsSkipped);
+            return false;
+        }
+
+        void recordHealth(bool ok, uint8_t attempts) {
+            HealthState before = _health.state();
+            _health.record(ok, attempts, millis());
+            if (_health.state() == HealthState::Offline && before != HealthState::Offline) {
+                LOG_W(Src, "Meter %lu offline after %u failed polls, skipping for %lu min",
+                      _serialNumber, _health.failedPolls(), _health.skipMs() / 60000);
+            } else if (before == HealthState::Offline && ok) {
+                LOG_I(Src, "Meter %lu back online", _serialNumber);
+            }
+        }
+
+        // Health from the volume; battery values missing from a read that got it are counted apart.
+        void recordPoll(const Driver::MeterReading& r, bool ok, uint8_t attempts) {
+            recordHealth(ok, attempts);
+            Driver::ParamSet battery = _polled & ~kHealthParams;
+            if (ok && (r.valid & battery) != battery) {
+                Metrics::count(Metrics::Counter::BatteryFails);
+                LOG_D(Src, "Meter %lu: battery values not read", _serialNumber);
+            }
+        }
 
-            // 1. Читаем литры
-            float volumeM3 = 0;
-            if (_drv->getValue(Driver::MeterParam::TotalVolume, volumeM3)) {
-                _liters = (uint64_t)(volumeM3 * 1000.0f);
+        // Queues a read on the bus task; false if polling inline.
+        bool submit(Driver::ParamSet params) {
+            if (!_bus) return false;
+            // Ставим запрос в очередь шины; результат заберет collect()
+            if (_ticket == Bus::BusScheduler::kNoTicket) {
+                _polled = params;
+                _ticket = _bus->submit(_drv, params, _busPriority, millis() + _pollInterval, _health.retries(),
+                                       params & kHealthParams);
             }
+            return true;
+        }
 
-            // 2. Читаем батарейку (раз в цикл опроса)
-            // float vBat = 0;
-            // if (_drv->getValue(Driver::MeterParam::BatteryVoltage, vBat)) {
-            //     _batteryVoltage = vBat; 
-            // }
+        // Flow from the delta between two successful polls; no extra bus traffic.
+        void trackFlow(uint64_t liters) {
+            uint32_t now = millis();
+            if (_hasPrevRead && liters >= _prevReadLiters) {
+                _flow.addSample((uint32_t)(liters - _prevReadLiters), now - _prevReadMs, now);
+            } else if (_hasPrevRead) {
+                _flow.reset(); // Счетчик заменили или сбросили
+            }
+            _prevReadLiters = liters;
+            _prevReadMs = now;
+            _hasPrevRead = true;
+        }
+
+        void apply(const Driver::MeterReading& r) {
+            if (r.has(Driver::MeterParam::TotalVolume)) {
+                uint64_t liters = (uint64_t)(r.get(Driver::MeterParam::TotalVolume) * 1000.0f);
+                // Against the last known total, which after a deep-sleep resume is the RTC copy
+                adaptPollInterval(liters != _liters);
+                _liters = liters;
+                trackFlow(_liters);
+            }
+            if (r.has(Driver::MeterParam::BatteryVoltage)) {
+                _batteryVoltage = r.get(Driver::MeterParam::BatteryVoltage);
+            }
+            if (r.has(Driver::MeterParam::BatteryThresholdMin)) {
+                _batteryEmptyV = r.get(Driver::MeterParam::BatteryThresholdMin);
+            }
         }
     };
+
+    // Smart source polling a driver of type Drv.
+    //
+    // With the SmartMeterDriver interface (the SmartSource alias) any driver
+    // from DriverFactory works through virtual calls. With a concrete, final
+    // driver (see Driver::DriverFor<Model>) every call on the poll path is
+    // resolved at compile time and can be inlined, and the poll set is a
+    // constant trimmed to what the model supports.
+    template <class Drv>
+    class BasicSmartSource : public SmartSourceBase {
+    public:
+        static_assert(std::is_base_of<Driver::SmartMeterDriver, Drv>::value, "Drv must be a meter driver");
+        static constexpr bool kStatic = !std::is_same<Drv, Driver::SmartMeterDriver>::value;
+        static_assert(!kStatic || std::is_final<Drv>::value, "Concrete drivers must be final to skip the vtable");
+
+        explicit BasicSmartSource(Drv* drv, uint64_t initialLiters = 0)
+            : SmartSourceBase(drv, initialLiters) {}
+
+        Drv* driver() const { return static_cast<Drv*>(_drv); }
+
+        void setSerialNumber(uint32_t sn) override {
+            WaterSource::setSerialNumber(sn);
+            forgetMeter();
+            if (_drv) driver()->setAddress(sn);
+        }
+
+        void update() override {
+            if (!_drv || !pollAllowed()) return;
+            if (submit(pollParams())) return;
+
+            // Литры и батарейка одним пакетным запросом (одно включение шины)
+            Driver::MeterReading r;
+            uint8_t attempts = 0;
+            _polled = pollParams();
+            bool ok = Bus::readWithRetry(driver(), _polled, r, _health.retries(), &attempts, _polled & kHealthParams);
+            recordPoll(r, ok, attempts);
+            apply(r);
+        }
+
+    private:
+        Driver::ParamSet pollParams() const {
+            if constexpr (kStatic) return kPollParams & Drv::kSupportedParams;
+            else return kPollParams & _drv->supportedParams();
+        }
+    };
+
+    // Runtime-selected driver (DriverFactory).
+    typedef BasicSmartSource<Driver::SmartMeterDriver> SmartSource;
 }
-#endif
\ No newline at end of file
+#endif
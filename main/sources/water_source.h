@@ -2,8 +2,47 @@
 #define WATER_SOURCE_H
 
 #include <Arduino.h>
+#include <algorithm>
+#include <functional>
+#include "freertos/FreeRTOS.h"
+#include "flow_estimator.h"
+#include "poll_policy.h"
+#include "meter_health.h"
+#include "log.h"
 
 namespace Source {
+    // Called from tick() with the consumption of a period that has just closed.
+    typedef std::function<void(bool daily, uint64_t liters)> PeriodClosedCallback;
+
+    // Everything a source needs to carry on after its RAM was lost (deep
+    // sleep). Times are relative ("ms into the hour"), since millis() restarts
+    // at 0 on every wake-up. Plain data without initialisers: it lives in RTC
+    // memory, which no constructor may touch on a wake-up.
+    struct SourceSnapshot {
+        uint64_t liters;                 // Raw, without offset
+        uint64_t litersAtHourStart;
+        uint64_t litersAtDayStart;
+        uint64_t lastHourLiters;
+        uint64_t lastDayLiters;
+        uint32_t msIntoHour;
+        uint32_t msIntoDay;
+        uint32_t serial;
+        int32_t offset;
+        float batteryV;
+        float batteryEmptyV;
+        uint32_t pollIntervalMs;         // Adapted poll interval and its bounds
+        uint32_t pollMinMs;
+        uint32_t pollMaxMs;
+        uint8_t unchangedPolls;
+        uint8_t healthState;             // MeterHealth, times relative to the snapshot
+        uint8_t failedPolls;
+        uint32_t skipMs;
+        uint32_t skipLeftMs;
+        uint32_t lastOkAgoMs;
+        bool started;                    // Hour/day reference points are valid
+        bool hourChanged;                // Closed hour not reported yet
+    };
+
     // Abstract base class for water consumption data sources.
     //
     // Provides common logic for tracking hourly/daily consumption, offsets,
@@ -12,10 +51,14 @@ namespace Source {
     protected:
         uint32_t _pollInterval = 3000;
         uint32_t _lastPoll = 0;
+        AdaptivePollPolicy _pollPolicy;
+        MeterHealth _health;              // Fed by sources that read a meter over the bus
         
         int32_t  _offset = 0;           
         uint32_t _serialNumber = 0;     
         float    _batteryVoltage = 0;
+        float    _batteryEmptyV = 3.0f;  // 0 % (meter's shutdown threshold when known)
+        float    _batteryFullV = 3.6f;   // 100 % (nominal lithium cell)
 
         // Reference points (in liters)
         uint64_t _litersAtHourStart = 0;
@@ -36,6 +79,37 @@ namespace Source {
         uint32_t _msInHour = 3600000; // 1 hour
         uint32_t _msInDay  = 86400000; // 24 hours
 
+        // Fed by the concrete source: pulse intervals or deltas between polls
+        FlowEstimator _flow;
+
+        PeriodClosedCallback _onPeriodClosed;
+
+        // Serial number and poll bounds written from another task, waiting
+        // for tick(); the lock also covers the bounds that are in effect
+        mutable portMUX_TYPE _requestLock = portMUX_INITIALIZER_UNLOCKED;
+        uint32_t _pendingSerial = 0;
+        bool _serialPending = false;
+        PollBounds _pendingBounds = {};
+        bool _boundsPending = false;
+
+        bool takePendingSerial(uint32_t& sn) {
+            portENTER_CRITICAL(&_requestLock);
+            bool pending = _serialPending;
+            sn = _pendingSerial;
+            _serialPending = false;
+            portEXIT_CRITICAL(&_requestLock);
+            return pending;
+        }
+
+        bool takePendingBounds(PollBounds& b) {
+            portENTER_CRITICAL(&_requestLock);
+            bool pending = _boundsPending;
+            b = _pendingBounds;
+            _boundsPending = false;
+            portEXIT_CRITICAL(&_requestLock);
+            return pending;
+        }
+
     public:
         virtual ~WaterSource() {}
 
@@ -43,28 +117,88 @@ namespace Source {
         void setTestMode(bool enabled) {
             _msInHour = enabled ? 10000 : 3600000; // 10 seconds if test mode is on
             _msInDay  = enabled ? 20000 : 86400000; // 20 seconds if test mode is on
-            Serial.printf("Source: Test mode is %s. Hour interval: %lu ms\n", enabled ? "ON" : "OFF", _msInHour);
+            LOG_I(Src, "Test mode is %s. Hour interval: %lu ms", enabled ? "ON" : "OFF", _msInHour);
         }
 
-        void setPollInterval(uint32_t ms) { _pollInterval = ms; }
+        // Fixed poll interval.
+        void setPollInterval(uint32_t ms) { setPollBounds({ ms, ms }); }
+
+        // Poll interval adapting to the readings within [min, max] (see
+        // AdaptivePollPolicy); the current one is clamped into the range.
+        void setPollBounds(PollBounds b) {
+            portENTER_CRITICAL(&_requestLock);
+            _pollPolicy.setBounds(b, _pollInterval);
+            portEXIT_CRITICAL(&_requestLock);
+        }
+
+        // setPollBounds() for other tasks, applied by the next tick() like
+        // requestSerialNumber(): the interval belongs to the loop task.
+        void requestPollBounds(PollBounds b) {
+            portENTER_CRITICAL(&_requestLock);
+            _pendingBounds = b;
+            _boundsPending = true;
+            portEXIT_CRITICAL(&_requestLock);
+        }
+
+        // Requested bounds already count, as for the serial number.
+        PollBounds getPollBounds() const {
+            portENTER_CRITICAL(&_requestLock);
+            PollBounds b = _boundsPending ? _pendingBounds : _pollPolicy.bounds();
+            portEXIT_CRITICAL(&_requestLock);
+            return b;
+        }
+        uint32_t getPollInterval() const { return _pollInterval; }
+
+        // Meter reachability; sources without a bus meter stay Ok.
+        const MeterHealth& health() const { return _health; }
         
         void setOffset(int32_t liters) { _offset = liters; }
         int32_t getOffset() const { return _offset; }
 
         virtual void setSerialNumber(uint32_t sn) { 
             _serialNumber = sn; 
-            _lastPoll = 0; // Force immediate update with new SN
+            forceUpdate(); // Force immediate update with new SN
+        }
+
+        // setSerialNumber() for other tasks (Zigbee attribute writes): the
+        // driver and the bus request belong to the loop task, so the change
+        // is applied by its next tick().
+        void requestSerialNumber(uint32_t sn) {
+            portENTER_CRITICAL(&_requestLock);
+            _pendingSerial = sn;
+            _serialPending = true;
+            portEXIT_CRITICAL(&_requestLock);
+        }
+
+        // A requested serial number already counts (it is reported back at once).
+        uint32_t getSerialNumber() const {
+            portENTER_CRITICAL(&_requestLock);
+            uint32_t sn = _serialPending ? _pendingSerial : _serialNumber;
+            portEXIT_CRITICAL(&_requestLock);
+            return sn;
         }
-        uint32_t getSerialNumber() const { return _serialNumber; }
 
         virtual float getBatteryVoltage() const { return _batteryVoltage; }
 
+        // Battery charge 0-100 %, linear between the empty and full voltage.
+        uint8_t getBatteryPercent() const {
+            if (_batteryVoltage <= _batteryEmptyV) return 0;
+            if (_batteryVoltage >= _batteryFullV || _batteryFullV <= _batteryEmptyV) return 100;
+            return (uint8_t)(100.0f * (_batteryVoltage - _batteryEmptyV) / (_batteryFullV - _batteryEmptyV));
+        }
+
         // Total value for reporting (Raw + Offset)
         uint64_t getTotalLiters() { return getLiters() + (int64_t)_offset; }
         
         // Get total for the LAST COMPLETED hour
         uint64_t getLastHourConsumption() const { return _lastCompletedHourLiters; }
 
+        // Current flow rate estimate (liters per hour), 0 when idle
+        uint32_t getFlowRate() const { return _flow.rateLph(millis()); }
+
+        // Hook for persisting closed hours/days (e.g. into the history store).
+        void onPeriodClosed(PeriodClosedCallback cb) { _onPeriodClosed = cb; }
+
         // Check flag (with auto-reset)
         bool hasHourChanged() {
             if (_hourChanged) { _hourChanged = false; return true; }
@@ -77,6 +211,13 @@ namespace Source {
         void tick() {
             uint32_t now = millis();
 
+            uint32_t sn;
+            if (takePendingSerial(sn)) setSerialNumber(sn);
+            PollBounds bounds;
+            if (takePendingBounds(bounds)) setPollBounds(bounds);
+
+            collect();
+
             // Initialize timers on first run
             if (_lastHourCheck == 0) {
                 _lastHourCheck = now;
@@ -95,7 +236,8 @@ namespace Source {
                 _lastHourCheck = now;
                 _hourChanged = true; 
                 
-                Serial.printf("Source: Hour closed. Consumed: %llu L\n", _lastCompletedHourLiters);
+                LOG_I(Src, "Hour closed. Consumed: %llu L", _lastCompletedHourLiters);
+                if (_onPeriodClosed) _onPeriodClosed(false, _lastCompletedHourLiters);
             }
 
             // 2. Day closing logic
@@ -107,21 +249,99 @@ namespace Source {
                 _lastDayCheck = now;
                 _dayChanged = true;
                 
-                Serial.printf("Source: Day closed. Consumed: %llu L\n", _lastCompletedDayLiters);
+                LOG_I(Src, "Day closed. Consumed: %llu L", _lastCompletedDayLiters);
+                if (_onPeriodClosed) _onPeriodClosed(true, _lastCompletedDayLiters);
             }
 
             // 3. Standard hardware polling (driver)
-            if (now - _lastPoll >= _pollInterval) {
+            if (pollDue(now)) {
                 _lastPoll = now;
-                Serial.println("Source: Polling for new data...");
+                LOG_D(Src, "Polling for new data...");
                 update();
             }
         }
 
         virtual void update() = 0; 
+
+        // True if edges must be fed in through a GPIO interrupt (see PulseSource::increment).
+        virtual bool needsPulseIsr() const { return false; }
+
+        // Picks up results of asynchronous reads. Called on every tick(), must not block.
+        virtual void collect() {}
+
+        // True while an asynchronous read is in flight (its result not collected yet).
+        virtual bool awaitingData() const { return false; }
+
         virtual uint64_t getLiters() = 0;
         virtual void setLiters(uint64_t liters) = 0;
 
+        // State to keep across deep sleep; see resume().
+        SourceSnapshot snapshot(uint32_t now) {
+            SourceSnapshot s = {};
+            s.liters = getLiters();
+            s.litersAtHourStart = _litersAtHourStart;
+            s.litersAtDayStart = _litersAtDayStart;
+            s.lastHourLiters = _lastCompletedHourLiters;
+            s.lastDayLiters = _lastCompletedDayLiters;
+            s.msIntoHour = now - _lastHourCheck;
+            s.msIntoDay = now - _lastDayCheck;
+            s.serial = _serialNumber;
+            s.offset = _offset;
+            s.batteryV = _batteryVoltage;
+            s.batteryEmptyV = _batteryEmptyV;
+            s.pollIntervalMs = _pollInterval;
+            s.pollMinMs = _pollPolicy.bounds().minMs;
+            s.pollMaxMs = _pollPolicy.bounds().maxMs;
+            s.unchangedPolls = _pollPolicy.unchanged();
+            s.healthState = (uint8_t)_health.state();
+            s.failedPolls = _health.failedPolls();
+            s.skipMs = _health.skipMs();
+            s.skipLeftMs = _health.msUntilAllowed(now);
+            s.lastOkAgoMs = _health.lastSuccessAgeMs(now);
+            s.started = _lastHourCheck != 0;
+            s.hourChanged = _hourChanged;
+            return s;
+        }
+
+        // Continues from a snapshot taken `sleptMs` ago (by the wall clock) on
+        // what is now a fresh millis() timeline. Call after begin(). Periods
+        // that ended during the sleep close on the next tick(). The next poll
+        // is due at once: a wake-up is always for fresh data.
+        void resume(const SourceSnapshot& s, uint32_t sleptMs, uint32_t now) {
+            setLiters(s.liters);
+            _offset = s.offset;
+            _serialNumber = s.serial;
+            _litersAtHourStart = s.litersAtHourStart;
+            _litersAtDayStart = s.litersAtDayStart;
+            _lastCompletedHourLiters = s.lastHourLiters;
+            _lastCompletedDayLiters = s.lastDayLiters;
+            _batteryVoltage = s.batteryV;
+            if (s.batteryEmptyV > 0) _batteryEmptyV = s.batteryEmptyV;
+            _hourChanged = s.hourChanged;
+            if (s.pollMaxMs) {
+                // Night-time back-off carries over: the wake-up poll itself is not skipped
+                _pollInterval = s.pollIntervalMs;
+                setPollBounds({ s.pollMinMs, s.pollMaxMs });
+                _pollPolicy.setUnchanged(s.unchangedPolls);
+            }
+            if (s.healthState <= (uint8_t)HealthState::Offline) {
+                // A dead meter stays skipped across wake-ups; the sleep counts towards the skip
+                uint32_t left = s.skipLeftMs > sleptMs ? s.skipLeftMs - sleptMs : 0;
+                uint32_t ago = s.lastOkAgoMs == MeterHealth::kNever
+                                   ? MeterHealth::kNever
+                                   : (uint32_t)std::min<uint64_t>((uint64_t)s.lastOkAgoMs + sleptMs, MeterHealth::kNever - 1);
+                _health.restore((HealthState)s.healthState, s.failedPolls, s.skipMs, left, ago, now);
+            }
+            if (s.started) {
+                // Capped so an overlong sleep closes the period once instead of wrapping
+                _lastHourCheck = now - (uint32_t)std::min(s.msIntoHour + (uint64_t)sleptMs, (uint64_t)_msInHour);
+                _lastDayCheck = now - (uint32_t)std::min(s.msIntoDay + (uint64_t)sleptMs, (uint64_t)_msInDay);
+                if (_lastHourCheck == 0) _lastHourCheck = 1; // 0 means "not started"
+                if (_lastDayCheck == 0) _lastDayCheck = 1;
+            }
+            forceUpdate();
+        }
+
         // Restore snapshots from Preferences at startup
         void restoreSnapshots(uint64_t hourLiters, uint64_t dayLiters) {
             _litersAtHourStart = hourLiters;
@@ -129,6 +349,31 @@ namespace Source {
         }
 
         void forceUpdate() { _lastPoll = millis() - _pollInterval; }
+
+        // True if the next tick() will poll the hardware.
+        bool pollDue(uint32_t now) const { return now - _lastPoll >= _pollInterval; }
+
+        // Time until the next poll alone; 0 if overdue.
+        uint32_t msUntilPoll(uint32_t now) const { return remaining(_lastPoll, _pollInterval, now); }
+
+        // Time until tick() has work of its own: the next poll or hour/day close.
+        // 0 if overdue or not started yet. Lets the main loop sleep until then.
+        uint32_t msUntilDue(uint32_t now) const {
+            if (_lastHourCheck == 0) return 0;
+            uint32_t d = remaining(_lastPoll, _pollInterval, now);
+            d = std::min(d, remaining(_lastHourCheck, _msInHour, now));
+            return std::min(d, remaining(_lastDayCheck, _msInDay, now));
+        }
+
+    protected:
+        // Feeds the outcome of a successful poll to the poll policy.
+        void adaptPollInterval(bool changed) { _pollInterval = _pollPolicy.next(_pollInterval, changed); }
+
+    private:
+        static uint32_t remaining(uint32_t since, uint32_t period, uint32_t now) {
+            uint32_t elapsed = now - since;
+            return elapsed >= period ? 0 : period - elapsed;
+        }
     };
 }
 #endif
\ No newline at end of file
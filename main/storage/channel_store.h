@@ -0,0 +1,189 @@
+#ifndef CHANNEL_STORE_H
+#define CHANNEL_STORE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "drivers/crc16_modbus.h"
+
+namespace Storage {
+
+// What survives a reboot for one metering channel.
+struct ChannelState {
+    uint32_t serial = 0;
+    int32_t offset = 0;
+    uint64_t liters = 0;
+    // Poll interval range set by the coordinator; 0/0 = channel table default
+    uint32_t pollMinMs = 0;
+    uint32_t pollMaxMs = 0;
+};
+
+// Persists a ChannelState as one versioned, CRC-protected NVS blob.
+//
+// Two keys per channel ("ch<N>a"/"ch<N>b") are written alternately, so a
+// reset in the middle of a write leaves the previous slot intact; load()
+// takes the valid slot with the newer sequence number. save() compares with
+// what is already on flash and skips the write when the settings are
+// unchanged and liters moved by less than the threshold. Version 1 records
+// (no poll bounds) still load; the next write replaces them.
+class ChannelStore {
+public:
+    struct Stats {
+        uint32_t writes = 0;
+        uint32_t bytes = 0;
+        uint32_t skipped = 0;   // save() calls with nothing worth writing
+        uint32_t badSlots = 0;  // Slots rejected by load() (CRC/version)
+    };
+
+    ChannelStore(Preferences* prefs, uint8_t channel, uint32_t litersThreshold = 10)
+        : _prefs(prefs), _threshold(litersThreshold) {
+        snprintf(_keys[0], sizeof(_keys[0]), "ch%ua", channel);
+        snprintf(_keys[1], sizeof(_keys[1]), "ch%ub", channel);
+    }
+
+    // Restores the newest valid record. False if neither slot holds one.
+    bool load(ChannelState& out) {
+        _probed = true;
+        Record r[2];
+        bool ok[2] = { readSlot(0, r[0]), readSlot(1, r[1]) };
+        if (!ok[0] && !ok[1]) return false;
+
+        int slot = !ok[0] ? 1 : !ok[1] ? 0 : ((int32_t)(r[1].seq - r[0].seq) > 0 ? 1 : 0);
+        _saved = r[slot];
+        _slot = slot;
+        _loaded = true;
+        out.serial = _saved.serial;
+        out.offset = _saved.offset;
+        out.liters = _saved.liters;
+        out.pollMinMs = _saved.pollMinMs;
+        out.pollMaxMs = _saved.pollMaxMs;
+        return true;
+    }
+
+    // Writes `s` into the older slot if it differs enough from the last record.
+    // Returns true if a write happened.
+    bool save(const ChannelState& s) {
+        if (!_probed) {
+            // Nobody called load() (deep-sleep resume): find the newest slot first,
+            // or this write could land behind a record with a higher sequence
+            ChannelState ignored;
+            load(ignored);
+        }
+        if (_loaded && !isDirty(s)) {
+            _stats.skipped++;
+            return false;
+        }
+
+        Record r;
+        memset(&r, 0, sizeof(r));
+        r.version = kVersion;
+        r.seq = _loaded ? _saved.seq + 1 : 1;
+        r.serial = s.serial;
+        r.offset = s.offset;
+        r.liters = s.liters;
+        r.pollMinMs = s.pollMinMs;
+        r.pollMaxMs = s.pollMaxMs;
+        r.crc = crcOf(r);
+
+        int slot = _loaded ? 1 - _slot : 0;
+        size_t n = _prefs->putBytes(_keys[slot], &r, sizeof(r));
+        _stats.writes++;
+        _stats.bytes += n;
+        if (n != sizeof(r)) return false; // Старый слот остается действующим
+
+        _saved = r;
+        _slot = slot;
+        _loaded = true;
+        return true;
+    }
+
+    bool isDirty(const ChannelState& s) const {
+        if (!_loaded) return true;
+        if (s.serial != _saved.serial || s.offset != _saved.offset) return true;
+        if (s.pollMinMs != _saved.pollMinMs || s.pollMaxMs != _saved.pollMaxMs) return true;
+        uint64_t delta = s.liters > _saved.liters ? s.liters - _saved.liters : _saved.liters - s.liters;
+        return delta >= _threshold;
+    }
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    static constexpr uint8_t kVersion = 2;
+
+    struct Record {
+        uint8_t version;
+        uint8_t reserved[3];
+        uint32_t seq;
+        uint32_t serial;
+        int32_t offset;
+        uint64_t liters;
+        uint32_t pollMinMs;
+        uint32_t pollMaxMs;
+        uint16_t crc;
+        uint16_t reserved2;
+        uint32_t reserved3;
+    };
+    static_assert(sizeof(Record) == 40, "Channel record layout");
+
+    // Layout of version 1: the same fields up to liters, no poll bounds.
+    struct RecordV1 {
+        uint8_t version;
+        uint8_t reserved[3];
+        uint32_t seq;
+        uint32_t serial;
+        int32_t offset;
+        uint64_t liters;
+        uint16_t crc;
+        uint16_t reserved2;
+        uint32_t reserved3;
+    };
+    static_assert(sizeof(RecordV1) == 32, "Channel record v1 layout");
+
+    static uint16_t crcOf(const Record& r) {
+        return Driver::Crc16Modbus::compute(reinterpret_cast<const uint8_t*>(&r), offsetof(Record, crc));
+    }
+
+    bool readSlot(int slot, Record& r) {
+        if (!_prefs->isKey(_keys[slot])) return false;
+        size_t len = _prefs->getBytesLength(_keys[slot]);
+        if (len == sizeof(RecordV1)) return readSlotV1(slot, r);
+        if (len != sizeof(Record)) {
+            _stats.badSlots++;
+            return false;
+        }
+        if (_prefs->getBytes(_keys[slot], &r, sizeof(r)) != sizeof(r) || r.version != kVersion || r.crc != crcOf(r)) {
+            _stats.badSlots++;
+            return false;
+        }
+        return true;
+    }
+
+    bool readSlotV1(int slot, Record& r) {
+        RecordV1 v1;
+        if (_prefs->getBytes(_keys[slot], &v1, sizeof(v1)) != sizeof(v1) || v1.version != 1 ||
+            v1.crc != Driver::Crc16Modbus::compute(reinterpret_cast<const uint8_t*>(&v1), offsetof(RecordV1, crc))) {
+            _stats.badSlots++;
+            return false;
+        }
+        memset(&r, 0, sizeof(r));
+        r.version = v1.version;
+        r.seq = v1.seq;
+        r.serial = v1.serial;
+        r.offset = v1.offset;
+        r.liters = v1.liters;
+        return true;
+    }
+
+    Preferences* _prefs;
+    uint32_t _threshold;
+    char _keys[2][8];
+
+    Record _saved = {};
+    int _slot = 0;
+    bool _loaded = false;
+    bool _probed = false; // load() ran, so _slot/_saved reflect the flash
+    Stats _stats;
+};
+
+} // namespace Storage
+
+#endif
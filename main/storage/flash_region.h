@@ -0,0 +1,27 @@
+#ifndef FLASH_REGION_H
+#define FLASH_REGION_H
+
+#include <Arduino.h>
+
+// Raw NOR flash area split into erase sectors.
+//
+// Follows NOR rules: erase() sets a whole sector to 0xFF, write() can only
+// clear bits. Stores built on top never rewrite a byte in place, so the same
+// code runs on the SPI flash partition on the device and on a file-backed
+// emulation on the host.
+class FlashRegion {
+public:
+    virtual ~FlashRegion() {}
+
+    virtual bool begin() = 0;
+
+    virtual size_t size() const = 0;
+    virtual size_t sectorSize() const = 0;
+    size_t sectorCount() const { return sectorSize() ? size() / sectorSize() : 0; }
+
+    virtual bool read(size_t offset, void* dst, size_t len) = 0;
+    virtual bool write(size_t offset, const void* src, size_t len) = 0;
+    virtual bool eraseSector(size_t index) = 0;
+};
+
+#endif
@@ -0,0 +1,349 @@
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "flash_region.h"
+#include "drivers/crc16_modbus.h"
+
+namespace Storage {
+
+enum class HistoryKind : uint8_t { Hour = 0, Day = 1 };
+
+// Read/append view of the history, independent of the channel count.
+class HistoryLog {
+public:
+    virtual ~HistoryLog() {}
+    virtual bool append(uint8_t channel, HistoryKind kind, uint32_t liters) = 0;
+    // Index the next bucket of this series will get (= buckets recorded so far).
+    virtual uint32_t nextIndex(uint8_t channel, HistoryKind kind) const = 0;
+    // Oldest bucket index still on flash.
+    virtual uint32_t firstIndex(uint8_t channel, HistoryKind kind) const = 0;
+    // Reads up to maxCount consecutive buckets starting at `from` (clamped to
+    // the oldest one kept). Returns the count; `first` is the index of out[0].
+    virtual size_t read(uint8_t channel, HistoryKind kind, uint32_t from, uint32_t* out, size_t maxCount, uint32_t& first) = 0;
+};
+
+// Append-only consumption history (hourly and daily buckets per channel).
+//
+// Layout: the region is a ring of erase sectors, each starting with a header
+// that carries a sequence number, its erase count and, per series, the index
+// the next bucket of that series will get. Records follow back to back:
+//
+//   [tag][liters, LEB128 varint][check]
+//
+// The bucket index is not stored: it is the header base plus the number of
+// earlier records of the same series in the sector. Values are bucket
+// consumption (the delta of the meter total), so a quiet hour costs 3 bytes.
+// Appending is one small flash write at a known offset, O(1). When a sector
+// fills up the next one in the ring is erased and reused, so every sector is
+// erased once per lap of the ring.
+//
+// Crash safety: a sector counts only once its header (written right after
+// the erase) passes its CRC; a record only if its check byte matches. Boot
+// scans the headers into a RAM index, then the newest sector to find the
+// append point. A torn record closes its sector; appends continue in the next.
+//
+// The channel count is fixed at compile time: header and RAM index hold one
+// base per series, so both grow by 8 bytes per channel. The magic carries the
+// count ("WMH1" for two channels), so a region formatted for a different
+// count reads as blank and is reused from scratch.
+//
+// Appends come from the loop task, reads from the Zigbee task (history
+// requests): every public call holds a mutex for its whole flash access. Not
+// a portMUX, since opening a sector erases flash.
+template <uint8_t Channels>
+class BasicHistoryStore : public HistoryLog {
+public:
+    static_assert(Channels >= 1 && Channels <= 32, "Series id must fit the record tag");
+    static constexpr uint8_t kMaxChannels = Channels;
+    static constexpr size_t kSeries = kMaxChannels * 2;
+    // RAM index is 4 + 8 * Channels bytes per sector; the rest of a larger partition stays unused.
+    static constexpr size_t kMaxSectors = 128;
+
+    struct Stats {
+        uint32_t appends = 0;
+        uint32_t sectorsOpened = 0;
+        uint32_t tornRecords = 0;  // Found on boot
+        uint32_t writeErrors = 0;
+        uint32_t maxEraseCount = 0;
+    };
+
+    explicit BasicHistoryStore(FlashRegion* flash)
+        : _flash(flash), _mutex(xSemaphoreCreateRecursiveMutexStatic(&_mutexBuf)) {}
+
+    // Rebuilds the sector index and the append point from flash.
+    bool begin() {
+        Guard g(this);
+        _ready = false;
+        _sectors = _flash ? _flash->sectorCount() : 0;
+        if (_sectors > kMaxSectors) _sectors = kMaxSectors;
+        if (_sectors < 2 || _flash->sectorSize() <= sizeof(Header)) return false;
+
+        _active = kNone;
+        for (size_t i = 0; i < _sectors; i++) {
+            Header h;
+            _index[i].seq = 0;
+            if (!readHeader(i, h)) continue;
+            _index[i].seq = h.seq;
+            memcpy(_index[i].base, h.base, sizeof(h.base));
+            if (h.eraseCount > _stats.maxEraseCount) _stats.maxEraseCount = h.eraseCount;
+            if (_active == kNone || h.seq > _index[_active].seq) _active = i;
+        }
+
+        memset(_next, 0, sizeof(_next));
+        if (_active == kNone) {
+            _ready = true; // Чистая флешка: первый сектор откроется при первой записи
+            _writeOff = 0;
+            return true;
+        }
+
+        // Доходим до конца последнего сектора: там точка записи и текущие индексы
+        memcpy(_next, _index[_active].base, sizeof(_next));
+        Cursor c(this, _active);
+        uint8_t series;
+        uint32_t value;
+        Scan st;
+        while ((st = c.next(series, value)) == Scan::Record) _next[series]++;
+        if (st == Scan::Torn) {
+            _stats.tornRecords++;
+            _writeOff = sectorEnd(_active); // Хвост сектора не трогаем
+        } else {
+            _writeOff = c.offset();
+        }
+        _ready = true;
+        return true;
+    }
+
+    bool append(uint8_t channel, HistoryKind kind, uint32_t liters) override {
+        Guard g(this);
+        if (!_ready || channel >= kMaxChannels) return false;
+        uint8_t series = seriesOf(channel, kind);
+
+        uint8_t rec[kMaxRecordLen];
+        size_t len = 0;
+        rec[len++] = kTagMark | series;
+        do {
+            uint8_t b = liters & 0x7F;
+            liters >>= 7;
+            rec[len++] = liters ? (b | 0x80) : b;
+        } while (liters);
+        rec[len] = check(rec, len);
+        len++;
+
+        if (_active == kNone || _writeOff + len > sectorEnd(_active)) {
+            if (!openNextSector()) return false;
+        }
+        if (!_flash->write(_writeOff, rec, len)) {
+            _stats.writeErrors++;
+            _writeOff = sectorEnd(_active); // Недописанная запись закрывает сектор
+            return false;
+        }
+        _writeOff += len;
+        _next[series]++;
+        _stats.appends++;
+        return true;
+    }
+
+    uint32_t nextIndex(uint8_t channel, HistoryKind kind) const override {
+        Guard g(this);
+        return channel < kMaxChannels ? _next[seriesOf(channel, kind)] : 0;
+    }
+
+    uint32_t firstIndex(uint8_t channel, HistoryKind kind) const override {
+        Guard g(this);
+        size_t oldest = oldestSector();
+        if (channel >= kMaxChannels || oldest == kNone) return 0;
+        return _index[oldest].base[seriesOf(channel, kind)];
+    }
+
+    size_t read(uint8_t channel, HistoryKind kind, uint32_t from, uint32_t* out, size_t maxCount, uint32_t& first) override {
+        Guard g(this);
+        first = from;
+        if (!_ready || channel >= kMaxChannels || _active == kNone || maxCount == 0) return 0;
+        uint8_t want = seriesOf(channel, kind);
+        uint32_t oldestIdx = firstIndex(channel, kind);
+        if (from < oldestIdx) from = oldestIdx;
+        first = from;
+        if (from >= _next[want]) return 0;
+
+        // Индекс в RAM: последний сектор, открытый до нужного бакета
+        size_t start = kNone;
+        for (size_t s = 0; s < _sectors; s++) {
+            if (_index[s].seq == 0 || _index[s].base[want] > from) continue;
+            if (start == kNone || _index[s].seq > _index[start].seq) start = s;
+        }
+        if (start == kNone) return 0;
+
+        size_t n = 0;
+        for (size_t s = start;; s = (s + 1) % _sectors) {
+            if (_index[s].seq != 0) {
+                uint32_t idx = _index[s].base[want];
+                Cursor c(this, s);
+                uint8_t series;
+                uint32_t value;
+                while (n < maxCount && c.next(series, value) == Scan::Record) {
+                    if (series != want) continue;
+                    if (idx++ >= from) out[n++] = value;
+                }
+            }
+            if (n == maxCount || s == _active) break;
+        }
+        return n;
+    }
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    class Guard {
+    public:
+        explicit Guard(const BasicHistoryStore* s) : _m(s->_mutex) { xSemaphoreTakeRecursive(_m, portMAX_DELAY); }
+        ~Guard() { xSemaphoreGiveRecursive(_m); }
+    private:
+        SemaphoreHandle_t _m;
+    };
+
+    struct Header {
+        uint32_t magic;
+        uint32_t seq;
+        uint32_t eraseCount;
+        uint32_t base[kSeries];
+        uint16_t crc;
+        uint16_t reserved;
+    };
+    static_assert(sizeof(Header) == 16 + 4 * kSeries, "History sector header layout");
+
+    struct SectorIndex {
+        uint32_t seq;  // 0 = пустой или битый сектор
+        uint32_t base[kSeries];
+    };
+
+    enum class Scan { Record, End, Torn };
+
+    // Sequential record reader over one sector with a small read-ahead buffer.
+    class Cursor {
+    public:
+        Cursor(BasicHistoryStore* store, size_t sector)
+            : _store(store), _off(store->sectorStart(sector) + sizeof(Header)), _end(store->sectorEnd(sector)) {}
+
+        Scan next(uint8_t& series, uint32_t& value) {
+            uint8_t rec[kMaxRecordLen];
+            size_t len = 0;
+            if (!peek(rec, 1) || rec[0] == 0xFF) return Scan::End;
+            if ((rec[0] & ~kSeriesMask) != kTagMark || (rec[0] & kSeriesMask) >= kSeries) return Scan::Torn;
+            len = 1;
+            value = 0;
+            for (;;) {
+                if (len == kMaxRecordLen - 1 || !peek(rec, len + 1)) return Scan::Torn;
+                uint8_t b = rec[len];
+                value |= (uint32_t)(b & 0x7F) << (7 * (len - 1));
+                len++;
+                if (!(b & 0x80)) break;
+            }
+            if (!peek(rec, len + 1) || rec[len] != check(rec, len)) return Scan::Torn;
+            series = rec[0] & kSeriesMask;
+            _off += len + 1;
+            return Scan::Record;
+        }
+
+        size_t offset() const { return _off; }
+
+    private:
+        // Copies `len` bytes at the cursor, refilling the buffer as needed.
+        bool peek(uint8_t* dst, size_t len) {
+            if (_off + len > _end) return false;
+            if (_off < _bufOff || _off + len > _bufOff + _bufLen) {
+                _bufOff = _off;
+                _bufLen = _end - _off < sizeof(_buf) ? _end - _off : sizeof(_buf);
+                if (!_store->_flash->read(_bufOff, _buf, _bufLen)) return false;
+            }
+            memcpy(dst, _buf + (_off - _bufOff), len);
+            return true;
+        }
+
+        BasicHistoryStore* _store;
+        size_t _off;
+        size_t _end;
+        uint8_t _buf[64];
+        size_t _bufOff = 0;
+        size_t _bufLen = 0;
+    };
+
+    static constexpr uint32_t kMagic = 0x00484D57 | ((uint32_t)('0' + Channels - 1) << 24); // "WMH" + (Channels - 1)
+    static constexpr uint8_t kTagMark = 0x80;      // Never 0xFF, so erased flash ends the log
+    static constexpr uint8_t kSeriesMask = 0x3F;
+    static constexpr size_t kMaxRecordLen = 1 + 5 + 1;
+    static constexpr size_t kNone = SIZE_MAX;
+
+    static uint8_t seriesOf(uint8_t channel, HistoryKind kind) { return (uint8_t)(channel * 2 + (uint8_t)kind); }
+    static uint8_t check(const uint8_t* rec, size_t len) { return Driver::Crc16Modbus::compute(rec, len) & 0xFF; }
+
+    size_t sectorStart(size_t s) const { return s * _flash->sectorSize(); }
+    size_t sectorEnd(size_t s) const { return (s + 1) * _flash->sectorSize(); }
+
+    size_t oldestSector() const {
+        size_t oldest = kNone;
+        for (size_t i = 0; i < _sectors; i++) {
+            if (_index[i].seq == 0) continue;
+            if (oldest == kNone || _index[i].seq < _index[oldest].seq) oldest = i;
+        }
+        return oldest;
+    }
+
+    bool readHeader(size_t s, Header& h) {
+        if (!_flash->read(sectorStart(s), &h, sizeof(h))) return false;
+        return h.magic == kMagic && h.seq != 0 &&
+               h.crc == Driver::Crc16Modbus::compute(reinterpret_cast<const uint8_t*>(&h), offsetof(Header, crc));
+    }
+
+    bool openNextSector() {
+        size_t s = _active == kNone ? 0 : (_active + 1) % _sectors;
+        Header old;
+        uint32_t erases = readHeader(s, old) ? old.eraseCount : 0;
+
+        _index[s].seq = 0; // Сектор перестает существовать до записи нового заголовка
+        if (!_flash->eraseSector(s)) {
+            _stats.writeErrors++;
+            return false;
+        }
+
+        Header h;
+        memset(&h, 0xFF, sizeof(h));
+        h.magic = kMagic;
+        h.seq = _active == kNone ? 1 : _index[_active].seq + 1;
+        h.eraseCount = erases + 1;
+        memcpy(h.base, _next, sizeof(h.base));
+        h.crc = Driver::Crc16Modbus::compute(reinterpret_cast<const uint8_t*>(&h), offsetof(Header, crc));
+        if (!_flash->write(sectorStart(s), &h, sizeof(h))) {
+            _stats.writeErrors++;
+            return false;
+        }
+
+        _index[s].seq = h.seq;
+        memcpy(_index[s].base, h.base, sizeof(h.base));
+        _active = s;
+        _writeOff = sectorStart(s) + sizeof(Header);
+        _stats.sectorsOpened++;
+        if (h.eraseCount > _stats.maxEraseCount) _stats.maxEraseCount = h.eraseCount;
+        return true;
+    }
+
+    FlashRegion* _flash;
+    StaticSemaphore_t _mutexBuf;
+    SemaphoreHandle_t _mutex;
+    bool _ready = false;
+    size_t _sectors = 0;
+    SectorIndex _index[kMaxSectors];
+    size_t _active = kNone;
+    size_t _writeOff = 0;
+    uint32_t _next[kSeries] = {};
+    Stats _stats;
+};
+
+// The original two-channel (cold/hot) layout.
+typedef BasicHistoryStore<2> HistoryStore;
+
+} // namespace Storage
+
+#endif
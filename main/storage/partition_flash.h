@@ -0,0 +1,47 @@
+#ifndef PARTITION_FLASH_H
+#define PARTITION_FLASH_H
+
+#include "flash_region.h"
+#include "esp_partition.h"
+#include "log.h"
+
+// FlashRegion over a data partition from partitions.csv (by default the
+// "spiffs" partition, which no filesystem mounts in this firmware).
+//
+// Writes go straight to SPI flash through esp_partition_*; the cache is
+// disabled for the duration of each call, so keep writes small (a history
+// record is a few bytes) and never call from an ISR.
+class PartitionFlash : public FlashRegion {
+public:
+    explicit PartitionFlash(const char* label = "spiffs") : _label(label) {}
+
+    bool begin() override {
+        _part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, _label);
+        if (!_part) {
+            LOG_E(Sys, "Flash: partition '%s' not found", _label);
+            return false;
+        }
+        return true;
+    }
+
+    size_t size() const override { return _part ? _part->size : 0; }
+    size_t sectorSize() const override { return SPI_FLASH_SEC_SIZE; }
+
+    bool read(size_t offset, void* dst, size_t len) override {
+        return _part && esp_partition_read(_part, offset, dst, len) == ESP_OK;
+    }
+
+    bool write(size_t offset, const void* src, size_t len) override {
+        return _part && esp_partition_write(_part, offset, src, len) == ESP_OK;
+    }
+
+    bool eraseSector(size_t index) override {
+        return _part && esp_partition_erase_range(_part, index * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE) == ESP_OK;
+    }
+
+private:
+    const char* _label;
+    const esp_partition_t* _part = nullptr;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef REPORTING_STORE_H
+#define REPORTING_STORE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "drivers/crc16_modbus.h"
+#include "zcl_reporting.h"
+
+namespace Storage {
+
+// Persists the reporting configuration of one endpoint (what the coordinator
+// set with Configure Reporting) as one versioned, CRC-protected NVS blob
+// "rc<N>". It changes a handful of times in the device's life, so a single
+// key is enough: a torn write fails the CRC and the endpoint falls back to
+// its defaults until the coordinator configures it again.
+class ReportingStore {
+public:
+    ReportingStore(Preferences* prefs, uint8_t channel) : _prefs(prefs) {
+        snprintf(_key, sizeof(_key), "rc%u", channel);
+    }
+
+    // False if nothing valid is stored for exactly `n` attributes.
+    bool load(ReportingConfig* out, size_t n) {
+        Record r;
+        if (n > kMaxReportedAttrs || !_prefs->isKey(_key)) return false;
+        if (_prefs->getBytesLength(_key) != sizeof(Record)) return false;
+        if (_prefs->getBytes(_key, &r, sizeof(r)) != sizeof(r)) return false;
+        if (r.version != kVersion || r.count != n || r.crc != crcOf(r)) return false;
+        memcpy(out, r.configs, n * sizeof(ReportingConfig));
+        return true;
+    }
+
+    bool save(const ReportingConfig* cfg, size_t n) {
+        if (n > kMaxReportedAttrs) return false;
+        Record r;
+        memset(&r, 0, sizeof(r));
+        r.version = kVersion;
+        r.count = (uint8_t)n;
+        memcpy(r.configs, cfg, n * sizeof(ReportingConfig));
+        r.crc = crcOf(r);
+        return _prefs->putBytes(_key, &r, sizeof(r)) == sizeof(r);
+    }
+
+private:
+    static constexpr uint8_t kVersion = 1;
+
+    struct Record {
+        uint8_t version;
+        uint8_t count;
+        uint16_t crc;
+        ReportingConfig configs[kMaxReportedAttrs];
+    };
+    static_assert(sizeof(ReportingConfig) == 8, "Reporting config layout");
+    static_assert(sizeof(Record) == 4 + 8 * kMaxReportedAttrs, "Reporting record layout");
+
+    static uint16_t crcOf(const Record& r) {
+        return Driver::Crc16Modbus::compute(reinterpret_cast<const uint8_t*>(r.configs), sizeof(r.configs)) ^
+               (uint16_t)(r.version | (r.count << 8));
+    }
+
+    Preferences* _prefs;
+    char _key[8];
+};
+
+} // namespace Storage
+
+#endif
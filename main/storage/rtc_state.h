@@ -0,0 +1,62 @@
+#ifndef RTC_STATE_H
+#define RTC_STATE_H
+
+#include <Arduino.h>
+#include <type_traits>
+#include "drivers/crc16_modbus.h"
+#include "sources/water_source.h"
+#include "zcl_reporting.h"
+
+namespace Storage {
+
+// Device state kept in RTC memory across deep sleep (RTC_DATA_ATTR in
+// main.ino), so a timer/EXT wake-up can skip NVS and go straight to
+// poll-and-report. NVS stays the source of truth: after a power loss or a
+// firmware with a different layout the record fails valid() and the device
+// boots the slow way.
+//
+// Plain data on purpose: a constructor would wipe the record on every boot.
+template <size_t Channels>
+struct RtcState {
+    static constexpr uint32_t kMagic = 0x32435257; // "WRC2"
+
+    uint32_t magic;
+    uint16_t size;                  // sizeof(*this): layout changes invalidate the record
+    uint16_t crc;
+
+    uint32_t resumes;               // Deep-sleep wake-ups since the last cold boot
+    uint64_t savedAtUs;             // RTC clock when the record was sealed
+
+    bool configReported;            // Initial SN/offset report already sent
+
+    // Boot-to-first-report latency, kept for the diagnostic log
+    uint32_t coldBootReportMs;
+    uint32_t resumeReportMs;
+
+    Source::SourceSnapshot channels[Channels];
+    ReporterState reporters[Channels][kMaxReportedAttrs]; // Per endpoint reporting table slot
+    ReportingConfig reporting[Channels][kMaxReportedAttrs]; // Same as in NVS: no sleep while unsaved
+
+    void seal() {
+        magic = kMagic;
+        size = sizeof(*this);
+        crc = 0;
+        crc = Driver::Crc16Modbus::compute(reinterpret_cast<const uint8_t*>(this), sizeof(*this));
+    }
+
+    bool valid() const {
+        if (magic != kMagic || size != sizeof(*this)) return false;
+        RtcState copy;
+        memcpy(&copy, this, sizeof(copy)); // Padding included, as in seal()
+        copy.crc = 0;
+        return Driver::Crc16Modbus::compute(reinterpret_cast<const uint8_t*>(&copy), sizeof(copy)) == crc;
+    }
+
+    void invalidate() { magic = 0; }
+};
+
+static_assert(std::is_trivially_default_constructible<RtcState<1>>::value, "RtcState must not have a constructor");
+
+}
+
+#endif
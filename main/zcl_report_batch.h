@@ -0,0 +1,136 @@
+#ifndef ZCL_REPORT_BATCH_H
+#define ZCL_REPORT_BATCH_H
+
+#include "esp_zigbee_core.h"
+
+// Collects attribute values of one cluster and sends them to the coordinator
+// as a single ZCL Report Attributes frame.
+//
+// esp_zb_zcl_report_attr_cmd_req() reports one attribute per frame, so the
+// frame is encoded here and handed to the APS layer directly. Values are
+// also written to the local attribute table, so reads from the coordinator
+// agree with what was reported. send() must be called with the Zigbee lock
+// held; it never blocks or sleeps.
+class ZclReportBatch {
+public:
+    // Worst case of one endpoint: Config + Hourly + Value in one frame (see
+    // the static_assert in zigbee_water_meter.h), 66 bytes of attributes.
+    static constexpr size_t kMaxAttrs = 9;
+    static constexpr size_t kMaxPayload = kMaxAttrs * (3 + 8); // id, type, value up to 64 bit
+
+    struct Stats {
+        uint32_t frames = 0;     // Multi-attribute frames sent
+        uint32_t attrs = 0;      // Attributes carried by them
+        uint32_t fallbacks = 0;  // Frames that went out one attribute at a time
+    };
+
+    explicit ZclReportBatch(uint16_t clusterId) : _cluster(clusterId) {}
+
+    // Queues an attribute (little-endian value). A second add() of the same
+    // attribute before send() replaces the value.
+    bool add(uint16_t attrId, uint8_t type, const void* value, uint8_t len) {
+        for (size_t i = 0; i < _count; i++) {
+            if (_attrs[i].id != attrId) continue;
+            if (_attrs[i].len != len) return false;
+            memcpy(&_payload[_attrs[i].at], value, len);
+            return true;
+        }
+        if (_count == kMaxAttrs || _len + 3 + len > kMaxPayload) return false;
+        _payload[_len++] = attrId & 0xFF;
+        _payload[_len++] = attrId >> 8;
+        _payload[_len++] = type;
+        _attrs[_count++] = { attrId, (uint8_t)_len, len };
+        memcpy(&_payload[_len], value, len);
+        _len += len;
+        return true;
+    }
+
+    bool empty() const { return _count == 0; }
+    size_t size() const { return _count; }
+    uint16_t cluster() const { return _cluster; }
+
+    // Sends everything queued as one frame and clears the batch. Lock must be held.
+    esp_err_t send(uint8_t endpoint) {
+        if (_count == 0) return ESP_OK;
+
+        for (size_t i = 0; i < _count; i++) {
+            esp_zb_zcl_set_attribute_val(endpoint, _cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, _attrs[i].id,
+                                         &_payload[_attrs[i].at], false);
+        }
+
+        // ZCL header: profile-wide, server to client, no default response
+        uint8_t frame[kHeaderLen + kMaxPayload];
+        frame[0] = 0x18;
+        frame[1] = nextSeq();
+        frame[2] = kCmdReportAttributes;
+        memcpy(&frame[kHeaderLen], _payload, _len);
+
+        esp_zb_apsde_data_req_t req;
+        memset(&req, 0, sizeof(req));
+        req.dst_addr_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT;
+        req.dst_addr.addr_short = 0x0000; // Координатор, как и в одиночных репортах
+        req.dst_endpoint = 1;
+        req.profile_id = ESP_ZB_AF_HA_PROFILE_ID;
+        req.cluster_id = _cluster;
+        req.src_endpoint = endpoint;
+        req.asdu_length = kHeaderLen + _len;
+        req.asdu = frame;
+        req.radius = 0; // Stack default
+
+        esp_err_t err = esp_zb_aps_data_request(&req);
+        if (err == ESP_OK) {
+            _stats.frames++;
+            _stats.attrs += _count;
+        } else {
+            // APS refused the frame: one standard report per attribute instead
+            _stats.fallbacks++;
+            for (size_t i = 0; i < _count; i++) sendSingle(endpoint, _attrs[i].id);
+        }
+        clear();
+        return err;
+    }
+
+    void clear() {
+        _count = 0;
+        _len = 0;
+    }
+
+    const Stats& stats() const { return _stats; }
+
+private:
+    static constexpr uint8_t kCmdReportAttributes = 0x0A;
+    static constexpr size_t kHeaderLen = 3;
+
+    struct Entry {
+        uint16_t id;
+        uint8_t at;   // Offset of the value in _payload
+        uint8_t len;
+    };
+
+    static uint8_t nextSeq() {
+        static uint8_t seq = 0;
+        return seq++;
+    }
+
+    void sendSingle(uint8_t endpoint, uint16_t attrId) {
+        esp_zb_zcl_report_attr_cmd_t cmd;
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT;
+        cmd.clusterID = _cluster;
+        cmd.attributeID = attrId;
+        cmd.direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI;
+        cmd.zcl_basic_cmd.src_endpoint = endpoint;
+        cmd.zcl_basic_cmd.dst_addr_u.addr_short = 0x0000;
+        cmd.zcl_basic_cmd.dst_endpoint = 1;
+        esp_zb_zcl_report_attr_cmd_req(&cmd);
+    }
+
+    uint16_t _cluster;
+    Entry _attrs[kMaxAttrs];
+    size_t _count = 0;
+    uint8_t _payload[kMaxPayload];
+    size_t _len = 0;
+    Stats _stats;
+};
+
+#endif
@@ -0,0 +1,332 @@
+#ifndef ZCL_REPORTING_H
+#define ZCL_REPORTING_H
+
+#include <Arduino.h>
+#include <algorithm>
+#include "freertos/FreeRTOS.h"
+#include "esp_zigbee_core.h"
+
+// ZCL attribute reporting configuration (Configure Reporting, 0x06).
+//
+// Reports are sent by the application (ZclReportBatch), not by the stack's
+// reporting engine, so the configuration the coordinator writes is kept and
+// enforced here: an attribute is reported when it moved by at least the
+// reportable change and the minimum interval has passed since its last
+// report, or when the maximum interval has passed regardless of the value.
+// The minimum interval caps the frame rate under heavy consumption, the
+// maximum interval bounds how stale the coordinator's view can get.
+
+// Interval and change values as they travel in the ZCL frame.
+struct ReportingConfig {
+    uint16_t minIntervalS;      // No report sooner than this after the previous one
+    uint16_t maxIntervalS;      // Report at least this often; 0 = on change only, 0xFFFF = never
+    uint32_t reportableChange;  // Smallest change worth a report, in attribute units (0 = any)
+};
+
+static constexpr uint16_t kReportingOff = 0xFFFF;
+static constexpr size_t kMaxReportedAttrs = 4;
+
+// Reporter state carried over deep sleep (see storage/rtc_state.h).
+struct ReporterState {
+    uint64_t lastValue;
+    uint32_t msSinceReport;
+    uint8_t reported;
+};
+
+// Report timing of one attribute: its configuration plus the last value sent and when.
+class AttributeReporter {
+public:
+    ReportingConfig config = { 0, 0, 0 };
+
+    bool enabled() const { return config.maxIntervalS != kReportingOff; }
+    bool reported() const { return _reported; }
+    uint64_t lastValue() const { return _lastValue; }
+
+    // Value moved by at least the reportable change since the last report.
+    bool exceeds(uint64_t value) const {
+        if (!_reported) return true;
+        uint64_t delta = value > _lastValue ? value - _lastValue : _lastValue - value;
+        return delta >= (config.reportableChange ? config.reportableChange : 1);
+    }
+
+    // `changed`: the caller's verdict on the value (usually exceeds()).
+    bool due(uint32_t now, bool changed) const { return msUntilDue(now, changed) == 0; }
+
+    // Time until due() turns true with the value as it is now; UINT32_MAX if it never will.
+    uint32_t msUntilDue(uint32_t now, bool changed) const {
+        if (!enabled()) return UINT32_MAX;
+        if (!_reported) return 0;
+        uint32_t minMs = config.minIntervalS * 1000UL;
+        uint32_t maxMs = config.maxIntervalS * 1000UL;
+        uint32_t at;
+        if (changed) at = minMs;
+        else if (config.maxIntervalS) at = std::max(minMs, maxMs);
+        else return UINT32_MAX;
+        uint32_t since = now - _reportedAt;
+        return since >= at ? 0 : at - since;
+    }
+
+    void markReported(uint64_t value, uint32_t now) {
+        _lastValue = value;
+        _reportedAt = now;
+        _reported = true;
+    }
+
+    ReporterState save(uint32_t now) const {
+        return { _lastValue, _reported ? now - _reportedAt : 0, (uint8_t)_reported };
+    }
+
+    // `sleptMs` passed while the state sat in RTC memory.
+    void restore(const ReporterState& s, uint32_t sleptMs, uint32_t now) {
+        uint64_t since = (uint64_t)s.msSinceReport + sleptMs;
+        _lastValue = s.lastValue;
+        _reportedAt = now - (uint32_t)std::min<uint64_t>(since, INT32_MAX);
+        _reported = s.reported != 0;
+    }
+
+private:
+    uint64_t _lastValue = 0;
+    uint32_t _reportedAt = 0;
+    bool _reported = false;
+};
+
+// The reported attributes of one endpoint and the ZCL commands that
+// configure them. Attributes outside the table answer UNREPORTABLE_ATTRIBUTE.
+//
+// Configure Reporting arrives in the Zigbee task while the loop task reads
+// the configs to plan reports: the table methods take the lock themselves,
+// reads through operator[] must hold a Guard.
+class ReportingTable {
+public:
+    class Guard {
+    public:
+        explicit Guard(const ReportingTable& t) : _t(t) { portENTER_CRITICAL(&_t._lock); }
+        ~Guard() { portEXIT_CRITICAL(&_t._lock); }
+    private:
+        const ReportingTable& _t;
+    };
+
+    static constexpr uint8_t kCmdConfigureReporting = 0x06;
+    static constexpr uint8_t kCmdConfigureReportingResponse = 0x07;
+    static constexpr uint8_t kCmdReadReportingConfig = 0x08;
+    static constexpr uint8_t kCmdReadReportingConfigResponse = 0x09;
+
+    static constexpr uint8_t kStatusSuccess = 0x00;
+    static constexpr uint8_t kStatusMalformed = 0x80;
+    static constexpr uint8_t kStatusInvalidValue = 0x87;
+    static constexpr uint8_t kStatusInvalidDataType = 0x8D;
+    static constexpr uint8_t kStatusUnreportable = 0x8C;
+
+    // Largest response: one full record per table entry plus one status per
+    // rejected record of a request that fits in an APS frame.
+    static constexpr size_t kMaxResponse = 80;
+
+    // Returns the slot index, or -1 if the table is full.
+    int add(uint16_t cluster, uint16_t attr, uint8_t type, const ReportingConfig& defaults) {
+        if (_count == kMaxReportedAttrs) return -1;
+        Slot& s = _slots[_count];
+        s.cluster = cluster;
+        s.attr = attr;
+        s.type = type;
+        s.defaults = defaults;
+        s.reporter.config = defaults;
+        return (int)_count++;
+    }
+
+    size_t size() const { return _count; }
+
+    // Slot still on the device's defaults (never configured, or reverted).
+    bool isDefault(size_t i) const {
+        Guard g(*this);
+        const ReportingConfig& c = _slots[i].reporter.config;
+        const ReportingConfig& d = _slots[i].defaults;
+        return c.minIntervalS == d.minIntervalS && c.maxIntervalS == d.maxIntervalS &&
+               c.reportableChange == d.reportableChange;
+    }
+    AttributeReporter& operator[](size_t i) { return _slots[i].reporter; }
+    const AttributeReporter& operator[](size_t i) const { return _slots[i].reporter; }
+
+    // Set by Configure Reporting; the owner persists the configs (takeDirty()).
+    bool isDirty() const { return _dirty; }
+    void markDirty() { _dirty = true; }
+
+    // Copies the configs and clears the dirty flag in one step, so a
+    // Configure Reporting in between is not lost. False if nothing changed.
+    bool takeDirty(ReportingConfig* out) {
+        Guard g(*this);
+        if (!_dirty) return false;
+        exportConfigs(out);
+        _dirty = false;
+        return true;
+    }
+
+    void exportConfigs(ReportingConfig* out) const {
+        Guard g(*this);
+        for (size_t i = 0; i < _count; i++) out[i] = _slots[i].reporter.config;
+    }
+    void importConfigs(const ReportingConfig* in, size_t n) {
+        Guard g(*this);
+        for (size_t i = 0; i < _count && i < n; i++) _slots[i].reporter.config = in[i];
+    }
+
+    // Applies a Configure Reporting payload for `cluster` and writes the
+    // response payload to `out`. Returns its length.
+    size_t configure(uint16_t cluster, const uint8_t* in, size_t len, uint8_t* out) {
+        Guard g(*this);
+        size_t pos = 0, n = 0;
+        bool failed = false;
+        while (pos < len) {
+            uint8_t direction = in[pos];
+            if (pos + 3 > len) return status(out, kStatusMalformed);
+            uint16_t attr = get16(&in[pos + 1]);
+            pos += 3;
+
+            if (direction != 0x00) {
+                // Receiving reports (timeout period) is a client matter
+                if (pos + 2 > len) return status(out, kStatusMalformed);
+                pos += 2;
+                n = reject(out, n, kStatusUnreportable, direction, attr, failed);
+                continue;
+            }
+            if (pos + 5 > len) return status(out, kStatusMalformed);
+            uint8_t type = in[pos];
+            uint16_t minS = get16(&in[pos + 1]);
+            uint16_t maxS = get16(&in[pos + 3]);
+            pos += 5;
+            size_t changeLen = analogSize(type);
+            if (pos + changeLen > len) return status(out, kStatusMalformed);
+            uint64_t change = 0;
+            for (size_t i = 0; i < changeLen; i++) change |= (uint64_t)in[pos + i] << (8 * i);
+            pos += changeLen;
+
+            Slot* s = find(cluster, attr);
+            if (!s) {
+                n = reject(out, n, kStatusUnreportable, direction, attr, failed);
+            } else if (type != s->type) {
+                n = reject(out, n, kStatusInvalidDataType, direction, attr, failed);
+            } else if (minS == 0xFFFF && maxS == 0) {
+                s->reporter.config = s->defaults; // "Back to the device's defaults"
+                _dirty = true;
+            } else if (maxS != 0 && maxS != kReportingOff && maxS < minS) {
+                n = reject(out, n, kStatusInvalidValue, direction, attr, failed);
+            } else {
+                s->reporter.config = { minS, maxS, (uint32_t)std::min<uint64_t>(change, UINT32_MAX) };
+                _dirty = true;
+            }
+        }
+        return failed ? n : status(out, kStatusSuccess);
+    }
+
+    // Answers a Read Reporting Configuration payload for `cluster` into `out`.
+    size_t readConfigs(uint16_t cluster, const uint8_t* in, size_t len, uint8_t* out) const {
+        Guard g(*this);
+        size_t n = 0;
+        for (size_t pos = 0; pos + 3 <= len; pos += 3) {
+            uint8_t direction = in[pos];
+            uint16_t attr = get16(&in[pos + 1]);
+            const Slot* s = find(cluster, attr);
+            size_t need = 4 + (s ? 5 + analogSize(s->type) : 0);
+            if (n + need > kMaxResponse) break;
+            out[n] = (s && direction == 0x00) ? kStatusSuccess : kStatusUnreportable;
+            out[n + 1] = direction;
+            put16(&out[n + 2], attr);
+            if (out[n] != kStatusSuccess) {
+                n += 4;
+                continue;
+            }
+            const ReportingConfig& c = s->reporter.config;
+            out[n + 4] = s->type;
+            put16(&out[n + 5], c.minIntervalS);
+            put16(&out[n + 7], c.maxIntervalS);
+            n += 9;
+            for (size_t i = 0; i < analogSize(s->type); i++) out[n++] = (uint8_t)((uint64_t)c.reportableChange >> (8 * i));
+        }
+        return n;
+    }
+
+    // Sends a response command back to the requester. Runs in the stack
+    // callback (no lock needed there).
+    static esp_err_t sendResponse(uint8_t endpoint, uint16_t cluster, uint16_t dstAddr, uint8_t dstEndpoint,
+                                  uint8_t seq, uint8_t cmd, const uint8_t* payload, size_t len) {
+        uint8_t frame[3 + kMaxResponse];
+        frame[0] = 0x18; // Profile-wide, server to client, no default response
+        frame[1] = seq;  // Same as the request
+        frame[2] = cmd;
+        memcpy(&frame[3], payload, len);
+
+        esp_zb_apsde_data_req_t req;
+        memset(&req, 0, sizeof(req));
+        req.dst_addr_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT;
+        req.dst_addr.addr_short = dstAddr;
+        req.dst_endpoint = dstEndpoint;
+        req.profile_id = ESP_ZB_AF_HA_PROFILE_ID;
+        req.cluster_id = cluster;
+        req.src_endpoint = endpoint;
+        req.asdu_length = 3 + len;
+        req.asdu = frame;
+        return esp_zb_aps_data_request(&req);
+    }
+
+    // Size of the reportable change field: analog (integer) types only.
+    static size_t analogSize(uint8_t type) {
+        switch (type) {
+            case ESP_ZB_ZCL_ATTR_TYPE_U8:  return 1;
+            case ESP_ZB_ZCL_ATTR_TYPE_U16:
+            case ESP_ZB_ZCL_ATTR_TYPE_S16: return 2;
+            case ESP_ZB_ZCL_ATTR_TYPE_U24: return 3;
+            case ESP_ZB_ZCL_ATTR_TYPE_U32:
+            case ESP_ZB_ZCL_ATTR_TYPE_S32: return 4;
+            case ESP_ZB_ZCL_ATTR_TYPE_U48: return 6;
+            default: return 0;
+        }
+    }
+
+private:
+    struct Slot {
+        uint16_t cluster;
+        uint16_t attr;
+        uint8_t type;
+        ReportingConfig defaults;
+        AttributeReporter reporter;
+    };
+
+    Slot _slots[kMaxReportedAttrs];
+    size_t _count = 0;
+    bool _dirty = false;
+    mutable portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+
+    Slot* find(uint16_t cluster, uint16_t attr) {
+        for (size_t i = 0; i < _count; i++) {
+            if (_slots[i].cluster == cluster && _slots[i].attr == attr) return &_slots[i];
+        }
+        return nullptr;
+    }
+    const Slot* find(uint16_t cluster, uint16_t attr) const {
+        return const_cast<ReportingTable*>(this)->find(cluster, attr);
+    }
+
+    // All records accepted: the response is a single SUCCESS status.
+    static size_t status(uint8_t* out, uint8_t st) {
+        out[0] = st;
+        return 1;
+    }
+
+    // A failed record: status, direction and attribute id. Records that do
+    // not fit are dropped from the response (they were not applied either way).
+    static size_t reject(uint8_t* out, size_t n, uint8_t st, uint8_t direction, uint16_t attr, bool& failed) {
+        failed = true;
+        if (n + 4 > kMaxResponse) return n;
+        out[n] = st;
+        out[n + 1] = direction;
+        put16(&out[n + 2], attr);
+        return n + 4;
+    }
+
+    static uint16_t get16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+    static void put16(uint8_t* p, uint16_t v) {
+        p[0] = v & 0xFF;
+        p[1] = v >> 8;
+    }
+};
+
+#endif
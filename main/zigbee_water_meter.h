@@ -6,6 +6,13 @@
 #include <Preferences.h>
 #include <functional>
 #include "sources/water_source.h"
+#include "storage/history_store.h"
+#include "zcl_report_batch.h"
+#include "zcl_reporting.h"
+#include "diagnostics_cluster.h"
+#include "metrics.h"
+#include "log.h"
+#include "report_scheduler.h"
 
 typedef std::function<void()> SettingsChangedCallback;
 
@@ -23,12 +30,61 @@ static constexpr uint16_t kAttrIdOffset = 0x0100;
 static constexpr uint16_t kAttrIdSerialNumber = 0x0102;
 // Custom attribute for hourly consumption, outside of ZCL standard range.
 static constexpr uint16_t kAttrHourlyConsumption = 0x0400;
-
-class ZigbeeWaterMeter : public ZigbeeEP {
+// Custom attribute for the current flow rate estimate (liters per hour).
+static constexpr uint16_t kAttrFlowRate = 0x0410;
+// History read path: the coordinator writes a request (0x0420), then reads
+// the page (0x0421). Request: bit 24 = kind (0 hour, 1 day), bits 0-23 = first
+// bucket index, kHistoryLatest for the newest page.
+static constexpr uint16_t kAttrHistoryRequest = 0x0420;
+static constexpr uint16_t kAttrHistoryData = 0x0421;
+static constexpr uint32_t kHistoryLatest = 0xFFFFFF;
+static constexpr size_t kHistoryPageSize = 10;
+// Page: kind(1) first(u32) next(u32) count(1) liters(u32 x kHistoryPageSize), little-endian.
+// Always full length so the octet string attribute never changes size.
+static constexpr size_t kHistoryPageLen = 10 + 4 * kHistoryPageSize;
+// Poll interval range of the source (u32, seconds). Writing one bound past
+// the other moves the other along.
+static constexpr uint16_t kAttrPollIntervalMin = 0x0430;
+static constexpr uint16_t kAttrPollIntervalMax = 0x0431;
+static constexpr uint32_t kPollIntervalFloorS = 10;
+// Meter health (u8: 0 ok, 1 degraded, 2 offline, see Source::MeterHealth) and
+// seconds since its last successful read (u32, 0xFFFFFFFF: none yet). Sent
+// with the value report when the state changed and while it is not ok.
+static constexpr uint16_t kAttrMeterHealth = 0x0440;
+static constexpr uint16_t kAttrLastReadAge = 0x0441;
+
+// Attributes each report kind puts into the metering batch. ReportScheduler
+// sends every pending kind of an endpoint in one frame, so the batch must
+// hold them all at once (Battery goes into the power cluster batch).
+static constexpr size_t kConfigReportAttrs = 4;  // Offset, serial, poll min/max
+static constexpr size_t kHourlyReportAttrs = 1;
+static constexpr size_t kValueReportAttrs = 4;   // Total, flow, health, last read age
+static_assert(kConfigReportAttrs + kHourlyReportAttrs + kValueReportAttrs <= ZclReportBatch::kMaxAttrs,
+              "Metering batch too small for Config + Hourly + Value");
+
+// Flow changes smaller than this (L/h, or 1/8 of the last value if larger)
+// do not trigger a report on their own. Default reportable change of 0x0410;
+// a configured one replaces both.
+static constexpr uint32_t kFlowReportDeltaLph = 30;
+
+// Reporting until the coordinator sends Configure Reporting: min s, max s,
+// reportable change in attribute units (liters, L/h, 0.5 %). The max
+// intervals stand in for the former fixed 30 min heartbeat.
+static constexpr ReportingConfig kValueReportingDefault = { 10, 1800, 1 };
+static constexpr ReportingConfig kFlowReportingDefault = { 10, 0, kFlowReportDeltaLph };
+static constexpr ReportingConfig kBatteryReportingDefault = { 300, 1800, 2 };
+
+class ZigbeeWaterMeter : public ZigbeeEP, public ReportSink {
 public:
     ZigbeeWaterMeter(uint8_t endpoint, bool with_battery = false) : 
         ZigbeeEP(endpoint), _with_battery(with_battery) {
         _device_id = ESP_ZB_HA_METER_INTERFACE_DEVICE_ID;
+        // Same order as ReportSlot
+        _reporting.add(ESP_ZB_ZCL_CLUSTER_ID_METERING, 0x0000, ESP_ZB_ZCL_ATTR_TYPE_U48, kValueReportingDefault);
+        _reporting.add(ESP_ZB_ZCL_CLUSTER_ID_METERING, kAttrFlowRate, ESP_ZB_ZCL_ATTR_TYPE_U32, kFlowReportingDefault);
+        if (_with_battery) {
+            _reporting.add(ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x0021, ESP_ZB_ZCL_ATTR_TYPE_U8, kBatteryReportingDefault);
+        }
     }
 
     // Flag indicating that configuration (SN, Offset) was changed via Zigbee.
@@ -36,6 +92,8 @@ public:
     void clearConfigDirty() { _config_dirty = false; }
 
     void setSource(Source::WaterSource* s) { _source = s; }
+    // Channel of this endpoint in the shared history store.
+    void setHistory(Storage::HistoryLog* h, uint8_t channel) { _history = h; _historyChannel = channel; }
 
     // Proxy methods interacting directly with the Source.
     void set_val(uint64_t v) { if (_source) _source->setLiters(v); }
@@ -54,12 +112,88 @@ public:
         return _source ? _source->getOffset() : 0; 
     }
 
-    // Checks if a report is required based on value changes or immediate flags.
-    bool shouldReport() {
+    // Checks if a Value report is due: a pending config report, or total/flow
+    // per their reporting configuration (change past the min interval, or the
+    // max interval elapsed).
+    bool shouldReport(uint32_t now) {
         if (!_source) return false;
-        // If a write command for SN/Offset was received or data in source changed
-        return _needs_immediate_report || (_source->getTotalLiters() != _lastReportedValue);
+        ReportingTable::Guard g(_reporting);
+        AttributeReporter& total = _reporting[kSlotTotal];
+        AttributeReporter& flow = _reporting[kSlotFlow];
+        return _needs_immediate_report || healthChanged() || total.due(now, total.exceeds(_source->getTotalLiters())) ||
+               flow.due(now, flowChanged());
     }
+    bool shouldReport() { return shouldReport(millis()); }
+
+    // Battery report due per the Power Config reporting configuration.
+    bool batteryDue(uint32_t now) const {
+        if (!_with_battery) return false;
+        ReportingTable::Guard g(_reporting);
+        const AttributeReporter& r = _reporting[kSlotBattery];
+        return r.due(now, r.exceeds(batteryZcl()));
+    }
+
+    // Time until shouldReport() or batteryDue() turns true with the readings
+    // as they are; UINT32_MAX if only a new reading can make it so.
+    uint32_t msUntilReport(uint32_t now) const {
+        if (!_source) return UINT32_MAX;
+        if (_needs_immediate_report || healthChanged()) return 0;
+        ReportingTable::Guard g(_reporting);
+        const AttributeReporter& total = _reporting[kSlotTotal];
+        const AttributeReporter& flow = _reporting[kSlotFlow];
+        uint32_t ms = std::min(total.msUntilDue(now, total.exceeds(_source->getTotalLiters())),
+                               flow.msUntilDue(now, flowChanged()));
+        if (_with_battery) {
+            const AttributeReporter& b = _reporting[kSlotBattery];
+            ms = std::min(ms, b.msUntilDue(now, b.exceeds(batteryZcl())));
+        }
+        return ms;
+    }
+
+    // Configure Reporting (0x06) and Read Reporting Configuration (0x08)
+    // addressed to this endpoint; answers the requester. Runs in the stack
+    // callback, so no Zigbee lock here (the table takes its own). False for
+    // any other command.
+    bool handleReportingCommand(uint8_t cmd, uint16_t cluster, uint8_t seq, uint16_t srcAddr, uint8_t srcEndpoint,
+                                const uint8_t* payload, size_t len) {
+        uint8_t resp[ReportingTable::kMaxResponse];
+        size_t n;
+        if (cmd == ReportingTable::kCmdConfigureReporting) {
+            n = _reporting.configure(cluster, payload, len, resp);
+            cmd = ReportingTable::kCmdConfigureReportingResponse;
+        } else if (cmd == ReportingTable::kCmdReadReportingConfig) {
+            n = _reporting.readConfigs(cluster, payload, len, resp);
+            cmd = ReportingTable::kCmdReadReportingConfigResponse;
+        } else {
+            return false;
+        }
+        ReportingTable::sendResponse(_endpoint, cluster, srcAddr, srcEndpoint, seq, cmd, resp, n);
+        if (cmd == ReportingTable::kCmdConfigureReportingResponse) {
+            LOG_I(Zb, "EP %d: Reporting configured (0x%04X): %s", _endpoint, cluster,
+                  resp[0] == ReportingTable::kStatusSuccess && n == 1 ? "ok" : "rejected in part");
+        }
+        return true;
+    }
+
+    // Reporting configuration, for persistence (see storage/reporting_store.h).
+    ReportingTable& reporting() { return _reporting; }
+
+    // Reporter timing across deep sleep: one ReporterState per table slot.
+    void saveReporting(ReporterState* out, uint32_t now) const {
+        ReportingTable::Guard g(_reporting);
+        for (size_t i = 0; i < _reporting.size(); i++) out[i] = _reporting[i].save(now);
+    }
+    void restoreReporting(const ReporterState* in, uint32_t sleptMs, uint32_t now) {
+        ReportingTable::Guard g(_reporting);
+        for (size_t i = 0; i < _reporting.size(); i++) _reporting[i].restore(in[i], sleptMs, now);
+    }
+
+    // Adds the device-wide diagnostics cluster (see diagnostics_cluster.h) to
+    // this endpoint; call before begin(). One endpoint per device carries it.
+    void enableDiagnostics() { _diagnostics = true; }
+
+    // A coordinator write changed SN/Offset and the new values were not reported yet.
+    bool configReportPending() const { return _needs_immediate_report; }
 
     void begin() {
         _cluster_list = esp_zb_zcl_cluster_list_create();
@@ -71,7 +205,9 @@ public:
         // 2. Power Config Cluster
         if (_with_battery) {
             uint8_t battery_perc = 200; 
+            uint8_t battery_volt = 0;
             esp_zb_attribute_list_t *p_attr = esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG);
+            esp_zb_cluster_add_attr(p_attr, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x0020, 0x20, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &battery_volt);
             esp_zb_cluster_add_attr(p_attr, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x0021, 0x20, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &battery_perc);
             esp_zb_cluster_list_add_power_config_cluster(_cluster_list, p_attr, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
         }
@@ -80,7 +216,6 @@ public:
         esp_zb_attribute_list_t *m_attr = esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_METERING);
         uint8_t def_u48[6] = {0};
         uint8_t uom = 0x07; uint8_t fmt = 0x4B; uint8_t type = 0x02;
-        int32_t def_off = 0; uint32_t def_sn = 0;
 
         // Main Value (0x0000)
         esp_zb_cluster_add_attr(m_attr, ESP_ZB_ZCL_CLUSTER_ID_METERING, 0x0000, ESP_ZB_ZCL_ATTR_TYPE_U48, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, def_u48);
@@ -88,6 +223,25 @@ public:
         // Custom Attribute: Hourly Consumption (0x0400) - liters
         uint32_t def_hourly = 0;
         esp_zb_cluster_add_attr(m_attr, ESP_ZB_ZCL_CLUSTER_ID_METERING, 0x0400, ESP_ZB_ZCL_ATTR_TYPE_U32, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &def_hourly);
+        // Custom Attribute: Flow Rate (0x0410) - liters per hour
+        uint32_t def_flow = 0;
+        esp_zb_cluster_add_attr(m_attr, ESP_ZB_ZCL_CLUSTER_ID_METERING, kAttrFlowRate, ESP_ZB_ZCL_ATTR_TYPE_U32, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &def_flow);
+        // Custom Attributes: History request/page (0x0420, 0x0421)
+        if (_history) {
+            uint32_t def_req = kHistoryLatest;
+            uint8_t def_page[1 + kHistoryPageLen] = { (uint8_t)kHistoryPageLen };
+            esp_zb_cluster_add_attr(m_attr, ESP_ZB_ZCL_CLUSTER_ID_METERING, kAttrHistoryRequest, ESP_ZB_ZCL_ATTR_TYPE_U32, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &def_req);
+            esp_zb_cluster_add_attr(m_attr, ESP_ZB_ZCL_CLUSTER_ID_METERING, kAttrHistoryData, ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, def_page);
+        }
+        // Custom Attributes: poll interval range (0x0430, 0x0431), seconds
+        uint32_t def_poll = 0;
+        esp_zb_cluster_add_attr(m_attr, ESP_ZB_ZCL_CLUSTER_ID_METERING, kAttrPollIntervalMin, ESP_ZB_ZCL_ATTR_TYPE_U32, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &def_poll);
+        esp_zb_cluster_add_attr(m_attr, ESP_ZB_ZCL_CLUSTER_ID_METERING, kAttrPollIntervalMax, ESP_ZB_ZCL_ATTR_TYPE_U32, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &def_poll);
+        // Custom Attributes: meter health (0x0440, 0x0441)
+        uint8_t def_health = 0;
+        uint32_t def_age = Source::MeterHealth::kNever;
+        esp_zb_cluster_add_attr(m_attr, ESP_ZB_ZCL_CLUSTER_ID_METERING, kAttrMeterHealth, ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &def_health);
+        esp_zb_cluster_add_attr(m_attr, ESP_ZB_ZCL_CLUSTER_ID_METERING, kAttrLastReadAge, ESP_ZB_ZCL_ATTR_TYPE_U32, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &def_age);
         // Settings (0x0100, 0x0102)
         esp_zb_cluster_add_attr(m_attr, ESP_ZB_ZCL_CLUSTER_ID_METERING, 0x0100, ESP_ZB_ZCL_ATTR_TYPE_U48, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, def_u48);
         esp_zb_cluster_add_attr(m_attr, ESP_ZB_ZCL_CLUSTER_ID_METERING, 0x0102, ESP_ZB_ZCL_ATTR_TYPE_U48, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, def_u48);
@@ -101,63 +255,94 @@ public:
         esp_zb_cluster_add_attr(m_attr, ESP_ZB_ZCL_CLUSTER_ID_METERING, 0x0302, ESP_ZB_ZCL_ATTR_TYPE_U16, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &_divisor);
 
         esp_zb_cluster_list_add_metering_cluster(_cluster_list, m_attr, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+
+        // 4. Diagnostics (manufacturer-specific)
+        if (_diagnostics) {
+            esp_zb_cluster_list_add_custom_cluster(_cluster_list, Metrics::DiagnosticsCluster::create(), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+        }
         _ep_config = { .endpoint = _endpoint, .app_profile_id = ESP_ZB_AF_HA_PROFILE_ID, .app_device_id = _device_id, .app_device_version = 0 };
     }
 
-    // Reports the current total volume to the Zigbee coordinator.
-    void reportValue() {
+    // Time the Zigbee lock was held by flushReports().
+    struct LockStats {
+        uint32_t holds = 0;
+        uint64_t totalUs = 0;
+        uint32_t maxUs = 0;
+    };
+
+    // Queues the current total volume and flow rate, and the meter health when
+    // there is news about it.
+    void queueValue() {
         if (!_source) return;
-        // Serial.printf("EP %d: Checking if report needed... ", _endpoint);
         uint64_t total = _source->getTotalLiters();
+        uint32_t flow = _source->getFlowRate();
         uint8_t zb_u48[6];
         for (int i = 0; i < 6; i++) zb_u48[i] = (total >> (i * 8)) & 0xFF;
 
-        esp_zb_lock_acquire(portMAX_DELAY);
-        esp_zb_zcl_set_attribute_val(_endpoint, ESP_ZB_ZCL_CLUSTER_ID_METERING, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, 0x0000, zb_u48, false);
-        sendReportCmd(0x0000); 
-        esp_zb_lock_release();
+        uint32_t now = millis();
+        AttributeReporter& flowReporter = _reporting[kSlotFlow];
+        bool flowOn;
+        {
+            ReportingTable::Guard g(_reporting);
+            flowOn = flowReporter.enabled();
+        }
 
-        _lastReportedValue = _source->getTotalLiters();
+        // Only what made it into the batch counts as reported; the rest stays due
+        bool queued = _meteringReport.add(0x0000, ESP_ZB_ZCL_ATTR_TYPE_U48, zb_u48, 6);
+        if (flowOn && (flow != flowReporter.lastValue() || !flowReporter.reported())) {
+            if (_meteringReport.add(kAttrFlowRate, ESP_ZB_ZCL_ATTR_TYPE_U32, &flow, 4)) {
+                flowReporter.markReported(flow, now);
+            } else {
+                queued = false;
+            }
+        }
+        const Source::MeterHealth& health = _source->health();
+        if (healthChanged() || health.state() != Source::HealthState::Ok) {
+            uint8_t state = (uint8_t)health.state();
+            uint32_t age = health.lastSuccessAgeMs(now);
+            if (age != Source::MeterHealth::kNever) age /= 1000;
+            if (_meteringReport.add(kAttrMeterHealth, ESP_ZB_ZCL_ATTR_TYPE_U8, &state, 1) &&
+                _meteringReport.add(kAttrLastReadAge, ESP_ZB_ZCL_ATTR_TYPE_U32, &age, 4)) {
+                _reportedHealth = health.state();
+            } else {
+                queued = false;
+            }
+        }
+        if (!queued) {
+            LOG_W(Zb, "EP %d: value report does not fit the batch", _endpoint);
+            return;
+        }
+
+        _reporting[kSlotTotal].markReported(total, now);
         _needs_immediate_report = false;
     }
 
-    // Reports the consumption for the last completed hour.
-    void reportHourly() {
+    // Queues the consumption for the last completed hour.
+    void queueHourly() {
         if (!_source) return;
         uint32_t hourly = (uint32_t)_source->getLastHourConsumption();
-
-        esp_zb_lock_acquire(portMAX_DELAY);
-        esp_zb_zcl_set_attribute_val(_endpoint, ESP_ZB_ZCL_CLUSTER_ID_METERING, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, 0x0400, &hourly, false);
-        sendReportCmd(0x0400); 
-        esp_zb_lock_release();
-        
-        Serial.printf("EP %d: Reported LAST HOUR consumption: %u\n", _endpoint, hourly);
+        _meteringReport.add(kAttrHourlyConsumption, ESP_ZB_ZCL_ATTR_TYPE_U32, &hourly, 4);
+        LOG_I(Zb, "EP %d: Reported LAST HOUR consumption: %u", _endpoint, hourly);
     }
 
-    // Reports the battery percentage.
-    void reportBattery() {
+    // Queues the battery percentage and, when the meter provides it, the voltage.
+    void queueBattery() {
         if (!_with_battery) return;
-        uint8_t zb_val = _battery_level * 2;
+        float volts = _source ? _source->getBatteryVoltage() : 0;
+        uint8_t zb_val = batteryZcl();
 
-        esp_zb_lock_acquire(portMAX_DELAY);
-        
-        esp_zb_zcl_set_attribute_val(
-            _endpoint, 
-            ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 
-            ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, 
-            0x0021, /* BatteryPercentageRemaining */
-            &zb_val, 
-            false
-        );
-        
-        sendReportCmd(0x0021, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG);
-        esp_zb_lock_release();
+        if (volts > 0) {
+            uint8_t zb_volt = (uint8_t)(volts * 10.0f + 0.5f); // ZCL unit: 100 mV
+            _powerReport.add(0x0020 /* BatteryVoltage */, ESP_ZB_ZCL_ATTR_TYPE_U8, &zb_volt, 1);
+        }
+        _powerReport.add(0x0021 /* BatteryPercentageRemaining */, ESP_ZB_ZCL_ATTR_TYPE_U8, &zb_val, 1);
+        _reporting[kSlotBattery].markReported(zb_val, millis());
     }
 
-    // Reports configuration attributes (Offset and Serial Number).
-    void reportConfig() {
+    // Queues configuration attributes (Offset, Serial Number, poll interval range).
+    void queueConfig() {
         if (!_source) return;
-        
+
         // Pack 32-bit numbers into 48-bit buffers (6 bytes)
         auto packU48 = [](uint32_t val, uint8_t* buf) {
             memset(buf, 0, 6);
@@ -167,20 +352,78 @@ public:
         uint8_t buf_off[6]; packU48((uint32_t)_source->getOffset(), buf_off);
         uint8_t buf_sn[6];  packU48(_source->getSerialNumber(), buf_sn);
 
+        Source::PollBounds bounds = _source->getPollBounds();
+        uint32_t poll_min = bounds.minMs / 1000;
+        uint32_t poll_max = bounds.maxMs / 1000;
+        bool queued = _meteringReport.add(kAttrIdOffset, ESP_ZB_ZCL_ATTR_TYPE_U48, buf_off, 6);
+        queued &= _meteringReport.add(kAttrIdSerialNumber, ESP_ZB_ZCL_ATTR_TYPE_U48, buf_sn, 6);
+        queued &= _meteringReport.add(kAttrPollIntervalMin, ESP_ZB_ZCL_ATTR_TYPE_U32, &poll_min, 4);
+        queued &= _meteringReport.add(kAttrPollIntervalMax, ESP_ZB_ZCL_ATTR_TYPE_U32, &poll_max, 4);
+        if (queued) _needs_immediate_report = false;
+        else LOG_W(Zb, "EP %d: config report does not fit the batch", _endpoint); // Stays due
+    }
+
+    // Sends everything queued: one Report Attributes frame per cluster, one
+    // short lock window, no waiting while the lock is held.
+    void flushReports() override {
+        if (_meteringReport.empty() && _powerReport.empty()) return;
+        uint32_t frames = !_meteringReport.empty() + !_powerReport.empty();
+
+        uint32_t t0 = micros();
         esp_zb_lock_acquire(portMAX_DELAY);
-        esp_zb_zcl_set_attribute_val(_endpoint, ESP_ZB_ZCL_CLUSTER_ID_METERING, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, 0x0100, buf_off, false);
-        esp_zb_zcl_set_attribute_val(_endpoint, ESP_ZB_ZCL_CLUSTER_ID_METERING, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, 0x0102, buf_sn, false);
-        
-        sendReportCmd(0x0100); 
-        delay(100);
-        sendReportCmd(0x0102); 
+        uint32_t t1 = micros();
+        _meteringReport.send(_endpoint);
+        _powerReport.send(_endpoint);
+        uint32_t held = micros() - t1;
         esp_zb_lock_release();
-        _needs_immediate_report = false;
+
+        Metrics::record(Metrics::Histogram::ZbLockWaitUs, t1 - t0);
+        Metrics::record(Metrics::Histogram::ZbLockHoldUs, held);
+        Metrics::count(Metrics::Counter::ReportFrames, frames);
+        _lockStats.holds++;
+        _lockStats.totalUs += held;
+        if (held > _lockStats.maxUs) _lockStats.maxUs = held;
+    }
+
+    // Entry point for ReportScheduler.
+    void queueReport(ReportKind kind) override {
+        switch (kind) {
+            case ReportKind::Config:  queueConfig();  break;
+            case ReportKind::Hourly:  queueHourly();  break;
+            case ReportKind::Value:   queueValue();   break;
+            case ReportKind::Battery: queueBattery(); break;
+        }
     }
 
+    // Single-purpose reports (queue + flush).
+    void reportValue()   { queueValue();   flushReports(); }
+    void reportHourly()  { queueHourly();  flushReports(); }
+    void reportBattery() { queueBattery(); flushReports(); }
+    void reportConfig()  { queueConfig();  flushReports(); }
+
+    const LockStats& lockStats() const { return _lockStats; }
+    const ZclReportBatch::Stats& meteringReportStats() const { return _meteringReport.stats(); }
+
     // Handles incoming write requests for attributes.
     void handleAttributeWrite(const esp_zb_zcl_set_attr_value_message_t *message) {
+        if (message->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_METERING && message->attribute.id == kAttrHistoryRequest) {
+            if (message->attribute.data.type == ESP_ZB_ZCL_ATTR_TYPE_U32 && message->attribute.data.value) {
+                uint32_t req;
+                memcpy(&req, message->attribute.data.value, 4);
+                serveHistory(req);
+            }
+            return;
+        }
+
         if (!_source) return;
+        if (message->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_METERING &&
+            (message->attribute.id == kAttrPollIntervalMin || message->attribute.id == kAttrPollIntervalMax)) {
+            if (message->attribute.data.type != ESP_ZB_ZCL_ATTR_TYPE_U32 || !message->attribute.data.value) return;
+            uint32_t sec;
+            memcpy(&sec, message->attribute.data.value, 4);
+            setPollBounds(message->attribute.id, sec);
+            return;
+        }
         if (message->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_METERING) {
             auto unpackU32 = [](const esp_zb_zcl_attribute_t* attr, uint32_t& out_val) -> bool {
                 if (attr->data.type != ESP_ZB_ZCL_ATTR_TYPE_U48) return false;
@@ -191,7 +434,7 @@ public:
 
                 // The value must fit in 32 bits for SN/Offset.
                 if (temp_val > UINT32_MAX) {
-                    Serial.printf("Error: Received U48 value %llu exceeds U32 max for attribute 0x%04X\n", temp_val, attr->id);
+                    LOG_E(Zb, "Received U48 value %llu exceeds U32 max for attribute 0x%04X", temp_val, attr->id);
                     return false;
                 }
                 out_val = (uint32_t)temp_val;
@@ -209,7 +452,7 @@ public:
                 changed = true;
             }
             else if (id == kAttrIdSerialNumber) { 
-                _source->setSerialNumber(val);
+                _source->requestSerialNumber(val); // Applied on the loop task
                 changed = true;
             }
 
@@ -221,31 +464,98 @@ public:
     }
 
 private:
-    void sendReportCmd(uint16_t attrId, uint16_t clusterId = ESP_ZB_ZCL_CLUSTER_ID_METERING) {
-        esp_zb_zcl_report_attr_cmd_t cmd;
-        memset(&cmd, 0, sizeof(cmd));
-        // Возвращаем прямую отправку координатору, так как Binding Table может быть пустой
-        cmd.address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT;
-        cmd.clusterID = clusterId;
-        cmd.attributeID = attrId;
-        cmd.direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI;
-        cmd.zcl_basic_cmd.src_endpoint = _endpoint;
-        cmd.zcl_basic_cmd.dst_addr_u.addr_short = 0x0000; // Адрес координатора
-        cmd.zcl_basic_cmd.dst_endpoint = 1;               // Стандартный эндпоинт координатора
-        esp_zb_zcl_report_attr_cmd_req(&cmd);
+    // Passes a written poll bound (seconds) to the source, which applies it on
+    // the loop task. The config report that follows puts the effective range
+    // back into the attribute table.
+    void setPollBounds(uint16_t id, uint32_t sec) {
+        sec = std::min(std::max(sec, kPollIntervalFloorS), UINT32_MAX / 1000);
+        Source::PollBounds b = _source->getPollBounds();
+        if (id == kAttrPollIntervalMin) {
+            b.minMs = sec * 1000;
+            b.maxMs = std::max(b.maxMs, b.minMs);
+        } else {
+            b.maxMs = sec * 1000;
+            b.minMs = std::min(b.minMs, b.maxMs);
+        }
+        _source->requestPollBounds(b);
+        LOG_I(Zb, "EP %d: Poll interval %lu..%lu s", _endpoint, b.minMs / 1000, b.maxMs / 1000);
+        _config_dirty = true;
+        _needs_immediate_report = true;
+    }
+
+    // Slots of _reporting
+    enum ReportSlot : uint8_t { kSlotTotal, kSlotFlow, kSlotBattery };
+
+    // BatteryPercentageRemaining in ZCL units (0.5 %).
+    uint8_t batteryZcl() const {
+        float volts = _source ? _source->getBatteryVoltage() : 0;
+        uint8_t level = volts > 0 ? _source->getBatteryPercent() : _battery_level;
+        return level * 2;
+    }
+
+    // Fills the history page attribute; runs in the stack callback, so no lock here.
+    void serveHistory(uint32_t request) {
+        if (!_history) return;
+        Storage::HistoryKind kind = (request >> 24) & 1 ? Storage::HistoryKind::Day : Storage::HistoryKind::Hour;
+        uint32_t next = _history->nextIndex(_historyChannel, kind);
+        uint32_t from = request & kHistoryLatest;
+        if (from == kHistoryLatest) from = next > kHistoryPageSize ? next - kHistoryPageSize : 0;
+
+        uint32_t values[kHistoryPageSize] = {};
+        uint32_t first = from;
+        size_t n = _history->read(_historyChannel, kind, from, values, kHistoryPageSize, first);
+
+        uint8_t page[1 + kHistoryPageLen];
+        auto put32 = [](uint8_t* p, uint32_t v) { for (int i = 0; i < 4; i++) p[i] = (v >> (i * 8)) & 0xFF; };
+        page[0] = kHistoryPageLen;
+        page[1] = (uint8_t)kind;
+        put32(&page[2], first);
+        put32(&page[6], next);
+        page[10] = (uint8_t)n;
+        for (size_t i = 0; i < kHistoryPageSize; i++) put32(&page[11 + 4 * i], values[i]);
+        esp_zb_zcl_set_attribute_val(_endpoint, ESP_ZB_ZCL_CLUSTER_ID_METERING, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, kAttrHistoryData, page, false);
+
+        LOG_I(Zb, "EP %d: History %s from %u: %u bucket(s)", _endpoint, kind == Storage::HistoryKind::Day ? "day" : "hour", first, n);
     }
 
+    // Flow is re-estimated continuously; only a change by the reportable
+    // change or a start/stop is worth a frame. On the default configuration
+    // the threshold is also at least 1/8 of the last value; a coordinator's
+    // Configure Reporting is taken as is. Caller holds the reporting Guard.
+    bool flowChanged() const {
+        const AttributeReporter& r = _reporting[kSlotFlow];
+        uint32_t flow = _source->getFlowRate();
+        uint32_t last = (uint32_t)r.lastValue();
+        if (!r.reported()) return flow != 0;
+        if (flow == last) return false;
+        if (flow == 0 || last == 0) return true;
+        uint32_t diff = flow > last ? flow - last : last - flow;
+        uint32_t threshold = r.config.reportableChange;
+        if (_reporting.isDefault(kSlotFlow)) threshold = std::max(threshold, last / 8);
+        return diff >= threshold;
+    }
+
+    bool healthChanged() const { return _source->health().state() != _reportedHealth; }
+
     Source::WaterSource* _source = nullptr;
+    Storage::HistoryLog* _history = nullptr;
+    uint8_t _historyChannel = 0;
 
     bool _with_battery;
+    bool _diagnostics = false;
 
     uint8_t _battery_level = 100;
     
     uint16_t _multiplier = 1;
     uint16_t _divisor = 1000;
 
-    uint64_t _lastReportedValue = 0xFFFFFFFFFFFFFFFF; // Initialize to "unknown" to ensure first report
+    ReportingTable _reporting; // Last reported values and when, per reported attribute
+
+    ZclReportBatch _meteringReport{ESP_ZB_ZCL_CLUSTER_ID_METERING};
+    ZclReportBatch _powerReport{ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG};
+    LockStats _lockStats;
     bool _needs_immediate_report = false;
+    Source::HealthState _reportedHealth = Source::HealthState::Ok;
     volatile bool _config_dirty = false;
 };
 
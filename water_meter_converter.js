@@ -1,11 +1,21 @@
 const exposes = require('zigbee-herdsman-converters/lib/exposes');
 const ea = exposes.access;
 
+// Эндпоинты с кластером Metering: по одному на канал из таблицы прошивки.
+// До интервью устройства (device ещё нет) — классическая пара cold/hot.
+const meterEndpoints = (device) => {
+    if (!device || !device.endpoints) return [1, 2];
+    const ids = device.endpoints
+        .filter((e) => e.supportsInputCluster && e.supportsInputCluster('seMetering'))
+        .map((e) => e.ID);
+    return ids.length ? ids : [1, 2];
+};
+
 const definition = {
     zigbeeModel: ['C6_WATER_METER'],
     model: 'C6_WATER_METER',
     vendor: 'MuseLab',
-    description: 'Professional Dual Channel Water Meter ESP32-C6',
+    description: 'Professional Multi-Channel Water Meter ESP32-C6',
     fromZigbee: [
         {
             cluster: 'seMetering',
@@ -27,6 +37,10 @@ const definition = {
                 if (data.hasOwnProperty('instantaneousDemand')) {
                     result[`hourly_consumption_${ep}`] = parseValue(data['instantaneousDemand']) / 1000;
                 }
+                // Мгновенный расход (кастомный 0x0410, л/ч) — herdsman не знает имени, ключ числовой
+                if (data.hasOwnProperty('1040')) {
+                    result[`flow_rate_${ep}`] = parseValue(data['1040']) / 1000;
+                }
                 // Оффсет (Tier 1) и Серийник (Tier 2)
                 if (data.hasOwnProperty('currentTier1SummDelivered')) {
                     result[`offset_${ep}`] = parseValue(data['currentTier1SummDelivered']) / 1000;
@@ -41,9 +55,14 @@ const definition = {
             cluster: 'genPowerCfg',
             type: ['attributeReport', 'readResponse'],
             convert: (model, msg, publish, options, meta) => {
+                const result = {};
                 if (msg.data.hasOwnProperty('batteryPercentageRemaining')) {
-                    return { battery: Math.round(msg.data['batteryPercentageRemaining'] / 2) };
+                    result.battery = Math.round(msg.data['batteryPercentageRemaining'] / 2);
                 }
+                if (msg.data.hasOwnProperty('batteryVoltage')) {
+                    result.battery_voltage = msg.data['batteryVoltage'] / 10;
+                }
+                return result;
             },
         }
     ],
@@ -64,87 +83,69 @@ const definition = {
             },
         }
     ],
-    exposes: [
-        // Профи используют явное определение объектов, если методы-цепочки не работают
-        {
-            type: 'numeric',
-            name: 'water_total',
-            label: 'Total Consumption',
-            endpoint: '1',
-            property: 'water_total_1',
-            access: ea.STATE,
-            unit: 'm³',
-            device_class: 'water',
-            state_class: 'total_increasing',
-            icon: 'mdi:counter'
-        },
-        {
-            type: 'numeric',
-            name: 'hourly_consumption',
-            label: 'Hourly Consumption',
-            endpoint: '1',
-            property: 'hourly_consumption_1',
-            access: ea.STATE,
-            unit: 'm³',
-            device_class: 'water',
-            state_class: 'total_increasing',
-            icon: 'mdi:water-plus'
-        },
-        {
-            type: 'numeric',
-            name: 'offset',
-            label: 'Calibration Offset',
-            endpoint: '1',
-            property: 'offset_1',
-            access: ea.ALL,
-            unit: 'm³',
-            category: 'config',
-            icon: 'mdi:wrench'
-        },
-        {
-            type: 'numeric',
-            name: 'serial',
-            label: 'Serial Number',
-            endpoint: '1',
-            property: 'serial_1',
-            access: ea.ALL,
-            category: 'config',
-            icon: 'mdi:identifier'
-        },
-        // Копируем для эндпоинта 2
-        {
-            type: 'numeric', name: 'water_total', label: 'Total Consumption', endpoint: '2',
-            property: 'water_total_2', access: ea.STATE, unit: 'm³',
-            device_class: 'water', state_class: 'total_increasing', icon: 'mdi:counter'
-        },
-        {
-            type: 'numeric', name: 'hourly_consumption', label: 'Hourly Consumption', endpoint: '2',
-            property: 'hourly_consumption_2', access: ea.STATE, unit: 'm³',
-            device_class: 'water', state_class: 'total_increasing', icon: 'mdi:water-plus'
-        },
-        {
-            type: 'numeric', name: 'offset', label: 'Calibration Offset', endpoint: '2',
-            property: 'offset_2', access: ea.ALL, unit: 'm³', category: 'config', icon: 'mdi:wrench'
-        },
-        {
-            type: 'numeric', name: 'serial', label: 'Serial Number', endpoint: '2',
-            property: 'serial_2', access: ea.ALL, category: 'config', icon: 'mdi:identifier'
-        },
-        // Батарейка в стиле "diagnostic"
-        {
-            type: 'numeric',
-            name: 'battery',
-            property: 'battery',
-            access: ea.STATE,
-            unit: '%',
-            device_class: 'battery',
-            state_class: 'measurement',
-            category: 'diagnostic',
-            label: 'Battery'
+    // Одна группа сущностей на каждый канал (эндпоинт 1..N прошивки)
+    exposes: (device, options) => {
+        const list = [];
+        for (const ep of meterEndpoints(device)) {
+            list.push(
+                {
+                    type: 'numeric', name: 'water_total', label: 'Total Consumption', endpoint: `${ep}`,
+                    property: `water_total_${ep}`, access: ea.STATE, unit: 'm³',
+                    device_class: 'water', state_class: 'total_increasing', icon: 'mdi:counter'
+                },
+                {
+                    type: 'numeric', name: 'hourly_consumption', label: 'Hourly Consumption', endpoint: `${ep}`,
+                    property: `hourly_consumption_${ep}`, access: ea.STATE, unit: 'm³',
+                    device_class: 'water', state_class: 'total_increasing', icon: 'mdi:water-plus'
+                },
+                {
+                    type: 'numeric', name: 'flow_rate', label: 'Flow Rate', endpoint: `${ep}`,
+                    property: `flow_rate_${ep}`, access: ea.STATE, unit: 'm³/h',
+                    device_class: 'volume_flow_rate', state_class: 'measurement', icon: 'mdi:water-pump'
+                },
+                {
+                    type: 'numeric', name: 'offset', label: 'Calibration Offset', endpoint: `${ep}`,
+                    property: `offset_${ep}`, access: ea.ALL, unit: 'm³', category: 'config', icon: 'mdi:wrench'
+                },
+                {
+                    type: 'numeric', name: 'serial', label: 'Serial Number', endpoint: `${ep}`,
+                    property: `serial_${ep}`, access: ea.ALL, category: 'config', icon: 'mdi:identifier'
+                },
+            );
         }
-    ],
+        // Батарейка в стиле "diagnostic"
+        list.push(
+            {
+                type: 'numeric',
+                name: 'battery',
+                property: 'battery',
+                access: ea.STATE,
+                unit: '%',
+                device_class: 'battery',
+                state_class: 'measurement',
+                category: 'diagnostic',
+                label: 'Battery'
+            },
+            {
+                type: 'numeric',
+                name: 'battery_voltage',
+                property: 'battery_voltage',
+                access: ea.STATE,
+                unit: 'V',
+                device_class: 'voltage',
+                state_class: 'measurement',
+                category: 'diagnostic',
+                label: 'Battery Voltage'
+            }
+        );
+        return list;
+    },
     meta: { multiEndpoint: true },
-    endpoint: (device) => { return { '1': 1, '2': 2 }; },
+    endpoint: (device) => {
+        const map = {};
+        for (const ep of meterEndpoints(device)) map[`${ep}`] = ep;
+        return map;
+    },
 };
 
 module.exports = definition;
\ No newline at end of file